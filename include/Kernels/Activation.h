@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Kernels/ElementType.h"
+#include "Kernels/KernelShape.h"
 #include "llvm/IR/Module.h"
 
 namespace llvm {
@@ -14,4 +16,15 @@ class Type;
 /// \return The created ReLU activation function.
 Function *createReLUFunction(Module &M, Type *InputTy, Type *OutputTy);
 
+/// Create a shape-generic ReLU activation function.
+/// The function takes (input, output, Size) with the element count as an i64
+/// argument, which is ignored when \p Size is not DynamicDim.
+/// \param M The module in which to create the function.
+/// \param Size The number of elements, or DynamicDim.
+/// \param Name The name of the created function.
+/// \param ElemTy The storage format of the input and output tensors.
+/// \return The created ReLU activation function.
+Function *createReLUFunction(Module &M, int64_t Size, const Twine &Name = "ReLU",
+                             TensorElementType ElemTy = TensorElementType::F32);
+
 } // namespace llvm
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Kernels/KernelShape.h"
+#include "llvm/IR/Module.h"
+
+namespace llvm {
+
+class Function;
+
+/// Extents of a scaled dot-product attention. Q and the output are
+/// BatchxSeqQxHeadDim, K and V are BatchxSeqKxHeadDim, all row-major, with
+/// batch and head folded into Batch. Extents set to DynamicDim are runtime
+/// arguments.
+struct AttentionDims {
+  int64_t Batch = DynamicDim, SeqQ = DynamicDim, SeqK = DynamicDim, HeadDim = DynamicDim;
+};
+
+/// Create a fused attention Out = softmax(Q * K^T / sqrt(HeadDim)) * V.
+/// The function takes (Q, K, V, Out, Batch, SeqQ, SeqK, HeadDim). Queries are
+/// processed QueryBlock rows at a time against KeyBlock keys at a time, so
+/// each key and value tile is reused by every row of the query tile while it
+/// is in cache. Softmax is computed online: each row keeps a running maximum
+/// and sum in scalars and rescales its output accumulator whenever the
+/// maximum grows, so only KeyBlock scores exist at any time and the
+/// SeqQxSeqK score matrix is never materialized.
+/// \param M The module in which to create the function.
+/// \param Dims The extents to constant-fold into the function.
+/// \param QueryBlock The number of query rows per tile.
+/// \param KeyBlock The number of keys per tile.
+/// \param Causal Whether query i only attends keys j <= i + SeqK - SeqQ, as in
+/// decoder self-attention. Requires SeqK >= SeqQ. Fully masked key tiles are
+/// skipped.
+/// \param Name The name of the created function.
+/// \return The created attention function.
+Function *createAttentionFunction(Module &M, const AttentionDims &Dims, unsigned QueryBlock = 4,
+                                  unsigned KeyBlock = 64, bool Causal = false, const Twine &Name = "attention");
+
+} // namespace llvm
@@ -1,10 +1,13 @@
 #pragma once
 
+#include "Kernels/ElementType.h"
+#include "Kernels/KernelShape.h"
 #include "llvm/IR/Module.h"
 
 namespace llvm {
 
 class Function;
+class GlobalVariable;
 class Type;
 
 /// Create a convolution function.
@@ -14,10 +17,117 @@ class Type;
 /// \param OutputTy The type of the output tensor.
 /// \param StrideH The stride in the height dimension.
 /// \param StrideW The stride in the width dimension.
-/// \param PadH The padding in the height dimension.
-/// \param PadW The padding in the width dimension.
+/// \param PadH The padding in the height dimension; ignored, this variant does not pad.
+/// \param PadW The padding in the width dimension; ignored, this variant does not pad.
 /// \return The created convolution function.
 Function *createConvolutionFunction(Module &M, Type *InputTy, Type *WeightTy, Type *OutputTy,
                                     unsigned StrideH, unsigned StrideW, unsigned PadH, unsigned PadW);
 
+/// Extents of an NCHW convolution. Input is NxCxHxW, weight is KxCxRxS and
+/// output is NxKxOHxOW. Extents set to DynamicDim are runtime arguments.
+struct ConvolutionDims {
+  int64_t N = DynamicDim, C = DynamicDim, H = DynamicDim, W = DynamicDim;
+  int64_t K = DynamicDim, R = DynamicDim, S = DynamicDim;
+};
+
+/// Create a shape-generic NCHW convolution function.
+/// The function takes (input, weight, output, N, C, H, W, K, R, S) with every
+/// extent as an i64 argument, so variants specialized for different \p Dims are
+/// interchangeable. Arguments for extents fixed in \p Dims are ignored.
+/// Reduced-precision variants still accumulate in fp32 and round once per output.
+/// \param M The module in which to create the function.
+/// \param Dims The extents to constant-fold into the function.
+/// \param StrideH The stride in the height dimension.
+/// \param StrideW The stride in the width dimension.
+/// \param PadH The zero padding in the height dimension.
+/// \param PadW The zero padding in the width dimension.
+/// \param Name The name of the created function.
+/// \param ElemTy The storage format of the input, weight and output tensors.
+/// \return The created convolution function.
+Function *createConvolutionFunction(Module &M, const ConvolutionDims &Dims, unsigned StrideH, unsigned StrideW,
+                                    unsigned PadH, unsigned PadW, const Twine &Name = "convolution",
+                                    TensorElementType ElemTy = TensorElementType::F32);
+
+/// Create a shape-generic dilated NCHW convolution. Filter taps are DilationH
+/// input rows and DilationW input columns apart, so the output extent is
+/// OH = (H + 2 * PadH - DilationH * (R - 1) - 1) / StrideH + 1. The function
+/// has the signature of the NCHW convolution above.
+/// \param M The module in which to create the function.
+/// \param Dims The extents to constant-fold into the function.
+/// \param StrideH The stride in the height dimension.
+/// \param StrideW The stride in the width dimension.
+/// \param PadH The zero padding in the height dimension.
+/// \param PadW The zero padding in the width dimension.
+/// \param DilationH The spacing of filter taps in the height dimension.
+/// \param DilationW The spacing of filter taps in the width dimension.
+/// \param Name The name of the created function.
+/// \param ElemTy The storage format of the input, weight and output tensors.
+/// \return The created convolution function.
+Function *createDilatedConvolutionFunction(Module &M, const ConvolutionDims &Dims, unsigned StrideH,
+                                           unsigned StrideW, unsigned PadH, unsigned PadW, unsigned DilationH,
+                                           unsigned DilationW, const Twine &Name = "dilatedConvolution",
+                                           TensorElementType ElemTy = TensorElementType::F32);
+
+/// Create a shape-generic NCHW transposed convolution (deconvolution). Input is
+/// NxCxHxW, weight is CxKxRxS and output is NxKxOHxOW with
+/// OH = (H - 1) * StrideH + R - 2 * PadH. The output is split into
+/// StrideH * StrideW phases by position modulo the stride. Each phase is a dense
+/// convolution with the filter taps that land on it, so no zero-inserted input
+/// is built and no multiply by an inserted zero is performed. The function has
+/// the signature of the NCHW convolution above.
+/// \param M The module in which to create the function.
+/// \param Dims The extents to constant-fold into the function.
+/// \param StrideH The upsampling stride in the height dimension.
+/// \param StrideW The upsampling stride in the width dimension.
+/// \param PadH The rows cropped from each side of the full output.
+/// \param PadW The columns cropped from each side of the full output.
+/// \param Name The name of the created function.
+/// \param ElemTy The storage format of the input, weight and output tensors.
+/// \return The created transposed convolution function.
+Function *createTransposedConvolutionFunction(Module &M, const ConvolutionDims &Dims, unsigned StrideH,
+                                              unsigned StrideW, unsigned PadH, unsigned PadW,
+                                              const Twine &Name = "transposedConvolution",
+                                              TensorElementType ElemTy = TensorElementType::F32);
+
+/// Create an NCHW convolution that reads weights packed by
+/// packConvolutionWeights. The function has the signature of the NCHW
+/// convolution above. Each filter tap loads the weights of KBlock output
+/// channels as one vector and multiplies it by a broadcast input element, so
+/// the weight stream is contiguous and every input load feeds KBlock outputs.
+/// \param M The module in which to create the function.
+/// \param Dims The extents to constant-fold into the function.
+/// \param KBlock The number of output channels per packed block.
+/// \param StrideH The stride in the height dimension.
+/// \param StrideW The stride in the width dimension.
+/// \param PadH The zero padding in the height dimension.
+/// \param PadW The zero padding in the width dimension.
+/// \param PackedWeights A global from createPackedWeightGlobal to read instead
+/// of the weight argument, or null to read the weight argument.
+/// \param Bias A global of K floats added to each output channel, such as a
+/// bias from foldBatchNorm, or null for no bias.
+/// \param Name The name of the created function.
+/// \return The created convolution function.
+Function *createPackedConvolutionFunction(Module &M, const ConvolutionDims &Dims, unsigned KBlock, unsigned StrideH,
+                                          unsigned StrideW, unsigned PadH, unsigned PadW,
+                                          GlobalVariable *PackedWeights = nullptr, GlobalVariable *Bias = nullptr,
+                                          const Twine &Name = "packedConvolution");
+
+/// Create a Winograd F(2x2, 3x3) NCHW convolution for stride 1 and 3x3 filters
+/// that reads weights transformed by transformWinogradWeights. The function has
+/// the signature of the NCHW convolution above. Each 2x2 output tile costs 16
+/// multiplies per input channel instead of 36.
+/// \param M The module in which to create the function.
+/// \param Dims The extents to constant-fold into the function; R and S must be 3.
+/// \param PadH The zero padding in the height dimension.
+/// \param PadW The zero padding in the width dimension.
+/// \param TransformedWeights A global from createPackedWeightGlobal to read
+/// instead of the weight argument, or null to read the weight argument.
+/// \param Bias A global of K floats added to each output channel, or null.
+/// \param Name The name of the created function.
+/// \return The created convolution function.
+Function *createWinogradConvolutionFunction(Module &M, const ConvolutionDims &Dims, unsigned PadH, unsigned PadW,
+                                            GlobalVariable *TransformedWeights = nullptr,
+                                            GlobalVariable *Bias = nullptr,
+                                            const Twine &Name = "winogradConvolution");
+
 } // namespace llvm
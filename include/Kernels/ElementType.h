@@ -0,0 +1,38 @@
+#pragma once
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/IRBuilder.h"
+
+namespace llvm {
+
+class Type;
+class Value;
+
+/// Storage format of a kernel's tensors. Kernels always compute and accumulate
+/// in fp32; reduced-precision elements are widened on load and narrowed on store.
+enum class TensorElementType { F32, F16, BF16 };
+
+/// Return the short name of \p ElemTy ("f32", "f16" or "bf16").
+StringRef getTensorElementTypeName(TensorElementType ElemTy);
+
+/// Parse a name returned by getTensorElementTypeName.
+Optional<TensorElementType> parseTensorElementType(StringRef Name);
+
+/// Return the in-memory type of one element.
+/// bf16 is stored as i16 because LLVM 14 backends cannot select bfloat
+/// conversions; fp16 uses half, which lowers to F16C or NEON conversions.
+/// \param Context The context in which to create the type.
+/// \param ElemTy The storage format.
+/// \return float, half or i16.
+Type *getTensorStorageType(LLVMContext &Context, TensorElementType ElemTy);
+
+/// Load element \p Index of \p Base and widen it to float.
+Value *createTensorLoad(IRBuilder<> &Builder, TensorElementType ElemTy, Value *Base, Value *Index,
+                        const Twine &Name = "");
+
+/// Narrow the float \p Val to \p ElemTy and store it to element \p Index of \p Base.
+/// bf16 rounds to nearest even and keeps NaNs quiet.
+void createTensorStore(IRBuilder<> &Builder, TensorElementType ElemTy, Value *Val, Value *Base, Value *Index);
+
+} // namespace llvm
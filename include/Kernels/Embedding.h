@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Kernels/KernelShape.h"
+#include "llvm/IR/Module.h"
+
+namespace llvm {
+
+class Function;
+
+/// How an embedding bag pools the rows it gathers.
+enum class EmbeddingBagMode { Sum, Mean };
+
+/// Create an embedding lookup, Output[I] = Table[Indices[I]] row by row.
+/// The function takes (table, indices, output, NumIndices, Dim), with the
+/// table and output row-major with Dim floats per row and the indices i64.
+/// Rows are copied with vectors across the embedding dimension. While row I
+/// is copied, the cache lines of row I + PrefetchDistance are prefetched, so
+/// the random accesses into a large table overlap instead of stalling one
+/// after another. Indices are not range-checked.
+/// \param M The module in which to create the function.
+/// \param Dim The number of floats per row, or DynamicDim.
+/// \param PrefetchDistance How many indices ahead to prefetch; 0 disables it.
+/// \param Name The name of the created function.
+/// \return The created lookup function.
+Function *createEmbeddingLookupFunction(Module &M, int64_t Dim, unsigned PrefetchDistance = 8,
+                                        const Twine &Name = "embeddingLookup");
+
+/// Create an embedding bag, which pools the rows of each bag into one output
+/// row. The function takes (table, indices, offsets, output, BagBegin, BagEnd,
+/// Dim) and fills output rows [BagBegin, BagEnd). Bag B gathers the table
+/// rows Indices[Offsets[B]] to Indices[Offsets[B + 1] - 1], so Offsets holds
+/// one entry more than there are bags. Empty bags produce zero rows. Passing a
+/// bag range lets callers split the bags across threads with one kernel; see
+/// parallelEmbeddingBag. Rows are accumulated and prefetched as in
+/// createEmbeddingLookupFunction, looking ahead across bag boundaries up to
+/// the end of the range.
+/// \param M The module in which to create the function.
+/// \param Mode Whether bags are summed or averaged.
+/// \param Dim The number of floats per row, or DynamicDim.
+/// \param PrefetchDistance How many indices ahead to prefetch; 0 disables it.
+/// \param Name The name of the created function.
+/// \return The created embedding bag function.
+Function *createEmbeddingBagFunction(Module &M, EmbeddingBagMode Mode, int64_t Dim, unsigned PrefetchDistance = 8,
+                                     const Twine &Name = "embeddingBag");
+
+} // namespace llvm
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Kernels/KernelShape.h"
+#include "llvm/IR/Module.h"
+
+namespace llvm {
+
+class Function;
+class GlobalVariable;
+
+/// Extents of a GEMM C = A * B with A MxK, B KxN and C MxN. Extents set to
+/// DynamicDim are runtime arguments.
+struct GemmDims {
+  int64_t M = DynamicDim, K = DynamicDim, N = DynamicDim;
+};
+
+/// Create a GEMM whose right-hand side is packed by packGemmWeights.
+/// The function takes (A, B, C, M, K, N) with A and C row-major and B packed
+/// into panels of NBlock columns. Every element of A is broadcast against one
+/// contiguous panel row, accumulating NBlock outputs in a vector register.
+/// \param M The module in which to create the function.
+/// \param Dims The extents to constant-fold into the function.
+/// \param NBlock The number of columns per packed panel.
+/// \param PackedB A global from createPackedWeightGlobal to read instead of
+/// the B argument, or null to read the B argument.
+/// \param Name The name of the created function.
+/// \return The created GEMM function.
+Function *createPackedGemmFunction(Module &M, const GemmDims &Dims, unsigned NBlock,
+                                   GlobalVariable *PackedB = nullptr, const Twine &Name = "packedGemm");
+
+/// Create a batch of independent row-major GEMMs C[b] = A[b] * B[b].
+/// The function takes (A, B, C, Batch, M, K, N) with A BatchxMxK and C
+/// BatchxMxN. B is BatchxKxN, or BatchxNxK when \p TransposeB is set, and
+/// holds a single matrix used by every batch entry when \p SharedB is set, as
+/// for the Q, K and V projections of a sequence batch. Plain B is streamed as
+/// rows scaled by a broadcast element of A; transposed B is read as dot
+/// products of contiguous rows.
+/// \param M The module in which to create the function.
+/// \param Dims The extents of one GEMM to constant-fold into the function.
+/// \param Batch The number of GEMMs, or DynamicDim for a runtime argument.
+/// \param TransposeB Whether B is stored transposed, NxK per batch entry.
+/// \param SharedB Whether every batch entry multiplies by the same B.
+/// \param Name The name of the created function.
+/// \return The created batched GEMM function.
+Function *createBatchedGemmFunction(Module &M, const GemmDims &Dims, int64_t Batch = DynamicDim,
+                                    bool TransposeB = false, bool SharedB = false,
+                                    const Twine &Name = "batchedGemm");
+
+} // namespace llvm
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/IR/IRBuilder.h"
+
+#include <cstdint>
+
+namespace llvm {
+
+class Value;
+
+/// Marks a kernel dimension whose extent is only known at run time. Such
+/// extents are read from the matching i64 argument of the generated function.
+constexpr int64_t DynamicDim = -1;
+
+/// Return \p Extent as an i64 constant, or \p Arg when the extent is dynamic.
+Value *getDimValue(IRBuilder<> &Builder, int64_t Extent, Value *Arg);
+
+/// Append a mangled form of \p Dims such as "1x3xDx224" to \p Out, where "D"
+/// stands for a dynamic extent.
+void getShapeSuffix(ArrayRef<int64_t> Dims, SmallVectorImpl<char> &Out);
+
+} // namespace llvm
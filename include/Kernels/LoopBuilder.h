@@ -0,0 +1,72 @@
+#pragma once
+
+#include "llvm/IR/IRBuilder.h"
+
+#include <functional>
+
+namespace llvm {
+
+class Type;
+class Value;
+
+/// Emit a counted loop from \p Start to \p End at the builder's insertion point.
+/// The loop is guarded so that it is skipped entirely when Start >= End. On
+/// return the builder is positioned in the block following the loop.
+/// \param Builder The IR builder to emit the loop with.
+/// \param Start The initial value of the induction variable.
+/// \param End The exclusive upper bound of the induction variable.
+/// \param Name The prefix used for the loop's blocks and values.
+/// \param Body Callback that emits the loop body given the induction variable.
+void createLoop(IRBuilder<> &Builder, Value *Start, Value *End, const Twine &Name,
+                std::function<void(IRBuilder<> &, Value *)> Body);
+
+/// Lanes per strip in the vectorized kernels; eight floats fill an AVX register.
+constexpr unsigned StripWidth = 8;
+
+/// Callback emitting one strip of a strip-mined loop, covering \p Width
+/// consecutive elements starting at \p Index.
+using StripBody = std::function<void(IRBuilder<> &, Value *Index, unsigned Width)>;
+
+/// Emit \p Body over [0, Extent) as a loop over Width-wide strips followed by
+/// a scalar loop over the remainder. On return the builder is positioned after
+/// both loops.
+/// \param Builder The IR builder to emit the loops with.
+/// \param Extent The number of elements to cover.
+/// \param Width The number of elements per vector strip.
+/// \param Name The prefix used for the loops' blocks and values.
+/// \param Body Callback that emits one strip, called with Width for the vector
+/// loop and with 1 for the remainder loop.
+/// \param BetweenLoops Optional callback emitted after the vector loop, where
+/// per-lane state is combined before the remainder.
+void createStripMinedLoop(IRBuilder<> &Builder, Value *Extent, unsigned Width, const Twine &Name, StripBody Body,
+                          std::function<void(IRBuilder<> &)> BetweenLoops = nullptr);
+
+/// \return \p FloatTy for a width of 1, otherwise a Width-lane vector of it.
+Type *getStripType(Type *FloatTy, unsigned Width);
+
+/// \return \p V broadcast to a Width-lane strip.
+Value *createStripSplat(IRBuilder<> &Builder, Value *V, unsigned Width);
+
+/// Load \p Width consecutive floats of \p Base starting at element \p Offset.
+/// \return The loaded float or vector.
+Value *createStripLoad(IRBuilder<> &Builder, Value *Base, Value *Offset, unsigned Width);
+
+/// Store the strip \p V of \p Width floats to \p Base starting at element \p Offset.
+void createStripStore(IRBuilder<> &Builder, Value *V, Value *Base, Value *Offset, unsigned Width);
+
+/// Emit the dot product of \p Extent consecutive floats of \p A and \p B as a
+/// strip-mined loop with a Width-lane accumulator. The accumulators are
+/// allocated in the entry block of the function being built.
+/// \param Builder The IR builder to emit the loops with.
+/// \param A The first operand.
+/// \param AOffset The element offset of the first operand.
+/// \param B The second operand.
+/// \param BOffset The element offset of the second operand.
+/// \param Extent The number of products to sum.
+/// \param Width The number of elements per vector strip.
+/// \param Name The prefix used for the loops' blocks and values.
+/// \return The sum of products.
+Value *createDotProduct(IRBuilder<> &Builder, Value *A, Value *AOffset, Value *B, Value *BOffset, Value *Extent,
+                        unsigned Width, const Twine &Name);
+
+} // namespace llvm
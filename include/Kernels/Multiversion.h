@@ -0,0 +1,38 @@
+#pragma once
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/IR/Module.h"
+
+namespace llvm {
+
+class Function;
+class GlobalValue;
+
+/// Instruction set variants a kernel can be specialized for.
+enum class KernelISA { Generic, SSE42, AVX2, AVX512, NEON };
+
+/// Return the name suffix used for the clone of a kernel built for \p ISA.
+StringRef getKernelISASuffix(KernelISA ISA);
+
+/// Return the target features enabled in the clone of a kernel built for \p ISA.
+StringRef getKernelISAFeatures(KernelISA ISA);
+
+/// Return the variants worth emitting for \p TT, ordered from most to least preferred.
+/// On AArch64 NEON is part of the base ISA, so a single NEON variant is returned.
+SmallVector<KernelISA, 4> getMultiversionISAs(const Triple &TT);
+
+/// Multiversion a kernel function.
+/// The kernel is cloned once per ISA in \p ISAs, each clone carrying the matching
+/// "target-features" attribute, and the original becomes the generic fallback.
+/// Callers of the kernel are redirected to a dispatcher that binds the best
+/// variant for the running CPU once: an ifunc on ELF targets, otherwise a thunk
+/// that caches the resolved pointer on first call.
+/// \param M The module containing the kernel.
+/// \param Kernel The kernel to multiversion.
+/// \param ISAs The variants to emit, ordered from most to least preferred.
+/// \return The dispatching global that replaced the kernel's symbol.
+GlobalValue *createMultiversionedKernel(Module &M, Function &Kernel, ArrayRef<KernelISA> ISAs);
+
+} // namespace llvm
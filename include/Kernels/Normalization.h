@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Kernels/KernelShape.h"
+#include "llvm/IR/Module.h"
+
+namespace llvm {
+
+class Function;
+
+/// Create a row-wise softmax over a row-major Rows x Cols tensor.
+/// The function takes (input, output, Rows, Cols), with extents fixed here
+/// ignoring their argument. Each row is read twice rather than three times:
+/// one vectorized pass keeps a running maximum and a running sum of
+/// exponentials rescaled whenever the maximum grows, and a second pass writes
+/// exp(x - max) / sum.
+/// \param M The module in which to create the function.
+/// \param Rows The number of rows, or DynamicDim.
+/// \param Cols The length of each row, or DynamicDim.
+/// \param Name The name of the created function.
+/// \return The created softmax function.
+Function *createSoftmaxFunction(Module &M, int64_t Rows, int64_t Cols, const Twine &Name = "softmax");
+
+/// Create a row-wise layer normalization over a row-major Rows x Cols tensor:
+/// y = (x - mean) / sqrt(variance + Epsilon) * gamma + beta, with gamma and beta
+/// holding Cols elements. The function takes (input, gamma, beta, output, Rows,
+/// Cols). Mean and variance come from a single vectorized pass of Welford
+/// updates, which avoids both a separate mean pass and the cancellation of
+/// computing E[x^2] - E[x]^2.
+/// \param M The module in which to create the function.
+/// \param Rows The number of rows, or DynamicDim.
+/// \param Cols The length of each row, or DynamicDim.
+/// \param Epsilon The value added to the variance.
+/// \param Name The name of the created function.
+/// \return The created layer normalization function.
+Function *createLayerNormFunction(Module &M, int64_t Rows, int64_t Cols, float Epsilon = 1e-5f,
+                                  const Twine &Name = "layerNorm");
+
+} // namespace llvm
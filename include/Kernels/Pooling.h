@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Kernels/ElementType.h"
+#include "Kernels/KernelShape.h"
 #include "llvm/IR/Module.h"
 
 namespace llvm {
@@ -19,4 +21,25 @@ class Type;
 Function *createMaxPoolingFunction(Module &M, Type *InputTy, Type *OutputTy,
                                    unsigned KernelH, unsigned KernelW, unsigned StrideH, unsigned StrideW);
 
+/// Extents of an NCHW pooling input. Extents set to DynamicDim are runtime arguments.
+struct PoolingDims {
+  int64_t N = DynamicDim, C = DynamicDim, H = DynamicDim, W = DynamicDim;
+};
+
+/// Create a shape-generic NCHW max pooling function.
+/// The function takes (input, output, N, C, H, W) with every extent as an i64
+/// argument. Arguments for extents fixed in \p Dims are ignored.
+/// \param M The module in which to create the function.
+/// \param Dims The extents to constant-fold into the function.
+/// \param KernelH The height of the pooling kernel.
+/// \param KernelW The width of the pooling kernel.
+/// \param StrideH The stride in the height dimension.
+/// \param StrideW The stride in the width dimension.
+/// \param Name The name of the created function.
+/// \param ElemTy The storage format of the input and output tensors.
+/// \return The created max pooling function.
+Function *createMaxPoolingFunction(Module &M, const PoolingDims &Dims, unsigned KernelH, unsigned KernelW,
+                                   unsigned StrideH, unsigned StrideW, const Twine &Name = "maxPooling",
+                                   TensorElementType ElemTy = TensorElementType::F32);
+
 } // namespace llvm
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Kernels/KernelShape.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Module.h"
+
+namespace llvm {
+
+class Function;
+
+/// The operation a reduction kernel applies over the reduced axes.
+enum class ReductionKind { Sum, Mean, Max, Min, ArgMax, L2Norm };
+
+/// Return the short name of \p Kind ("sum", "mean", "max", "min", "argmax" or "l2").
+StringRef getReductionKindName(ReductionKind Kind);
+
+/// Parse a name returned by getReductionKindName.
+Optional<ReductionKind> parseReductionKind(StringRef Name);
+
+/// Create a reduction of a row-major N-D float tensor over \p Axes.
+/// The function takes (input, output, indices, shape) where shape points to
+/// the Shape.size() extents of the input; entries for extents fixed in
+/// \p Shape are ignored. The output has the input's shape with every reduced
+/// axis of extent 1. ArgMax writes the maximum to output and its row-major
+/// position within the reduced axes to the i64 indices tensor; the other
+/// kinds ignore indices, which may be null.
+///
+/// The innermost axis is always the vectorized one. When it is reduced, each
+/// output keeps a vector of partial accumulators that is combined by a
+/// shuffle tree once the reduced axes are exhausted. When it is kept, a vector
+/// strip of adjacent outputs is accumulated at once and no horizontal combine
+/// is needed.
+/// \param M The module in which to create the function.
+/// \param Kind The reduction to perform.
+/// \param Shape The extents to constant-fold into the function.
+/// \param Axes The distinct axes to reduce; must not be empty.
+/// \param Partial Whether to store raw accumulators for parallelReduce to
+/// merge: Mean stores the sum and L2Norm the sum of squares.
+/// \param Name The name of the created function.
+/// \return The created reduction function.
+Function *createReductionFunction(Module &M, ReductionKind Kind, ArrayRef<int64_t> Shape, ArrayRef<unsigned> Axes,
+                                  bool Partial = false, const Twine &Name = "reduce");
+
+} // namespace llvm
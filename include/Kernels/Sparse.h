@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Kernels/Convolution.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/IR/Module.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace llvm {
+
+class Function;
+
+/// A pruned weight matrix in block compressed sparse row (BSR) format. Only
+/// blocks holding a nonzero element are stored; 1x1 blocks make this plain CSR.
+struct SparseMatrix {
+  int64_t Rows = 0, Cols = 0;
+  unsigned BlockH = 1, BlockW = 1;
+  /// Index into ColIndices of the first block of each block row, followed by
+  /// the total number of blocks.
+  std::vector<int32_t> RowOffsets;
+  /// Block column of each stored block.
+  std::vector<int32_t> ColIndices;
+  /// Stored blocks, each BlockH x BlockW in row-major order.
+  std::vector<float> Values;
+
+  /// Compress a row-major dense matrix, dropping blocks that are entirely zero.
+  /// \p Rows and \p Cols must be multiples of the block extents.
+  static SparseMatrix fromDense(ArrayRef<float> Dense, int64_t Rows, int64_t Cols, unsigned BlockH = 1,
+                                unsigned BlockW = 1);
+
+  int64_t getNumBlockRows() const { return Rows / BlockH; }
+  int64_t getNumBlocks() const { return ColIndices.size(); }
+};
+
+/// Create a sparse GEMM C = A * B whose sparse A is read at run time.
+/// The function takes (rowOffsets, colIndices, values, B, C, BlockRows, N) with
+/// A given as the arrays of a SparseMatrix with BlockRows block rows, and B and
+/// C dense and row-major with N columns. Each stored block is applied as a
+/// BlockH x BlockW register tile across a row of B, so zero blocks cost nothing.
+/// \param M The module in which to create the function.
+/// \param BlockH The block height of A.
+/// \param BlockW The block width of A.
+/// \param N The number of columns of B and C, or DynamicDim.
+/// \param Name The name of the created function.
+/// \return The created sparse GEMM function.
+Function *createSparseGemmFunction(Module &M, unsigned BlockH, unsigned BlockW, int64_t N,
+                                   const Twine &Name = "sparseGemm");
+
+/// Create a sparse GEMM C = A * B with the sparsity pattern and values of \p A
+/// specialized into the code. The function takes (B, C, N). Every block row
+/// becomes one loop over the columns of B that keeps its BlockH accumulators in
+/// registers and multiplies by the nonzero weights as immediates.
+/// \param M The module in which to create the function.
+/// \param A The sparse weights.
+/// \param N The number of columns of B and C, or DynamicDim.
+/// \param Name The name of the created function.
+/// \return The created sparse GEMM function.
+Function *createSparseGemmFunction(Module &M, const SparseMatrix &A, int64_t N,
+                                   const Twine &Name = "sparseGemm");
+
+/// Create an NCHW convolution whose pruned weights are read at run time.
+/// The weights are a SparseMatrix of K rows and C * R * S columns, with column
+/// (c * R + r) * S + s holding weight[k][c][r][s]. The function takes
+/// (input, rowOffsets, colIndices, values, output, N, C, H, W, K, R, S). For each
+/// stored weight column it accumulates the whole shifted input plane into
+/// BlockH output planes, clipping the plane to the padding instead of testing
+/// every element, so zero weights are never visited.
+/// \param M The module in which to create the function.
+/// \param Dims The extents to constant-fold into the function.
+/// \param BlockH The block height of the weights, in output channels.
+/// \param BlockW The block width of the weights, in weight columns.
+/// \param StrideH The stride in the height dimension.
+/// \param StrideW The stride in the width dimension.
+/// \param PadH The zero padding in the height dimension.
+/// \param PadW The zero padding in the width dimension.
+/// \param Name The name of the created function.
+/// \return The created sparse convolution function.
+Function *createSparseConvolutionFunction(Module &M, const ConvolutionDims &Dims, unsigned BlockH, unsigned BlockW,
+                                          unsigned StrideH, unsigned StrideW, unsigned PadH, unsigned PadW,
+                                          const Twine &Name = "sparseConvolution");
+
+/// Create an NCHW convolution with the pruned weights \p Weights specialized
+/// into the code. The function takes (input, output, N, C, H, W, K, R, S);
+/// Dims.C, Dims.R and Dims.S must be known to decode the weight columns.
+/// \param M The module in which to create the function.
+/// \param Dims The extents to constant-fold into the function.
+/// \param Weights The sparse weights, laid out as for the runtime variant.
+/// \param StrideH The stride in the height dimension.
+/// \param StrideW The stride in the width dimension.
+/// \param PadH The zero padding in the height dimension.
+/// \param PadW The zero padding in the width dimension.
+/// \param Name The name of the created function.
+/// \return The created sparse convolution function.
+Function *createSparseConvolutionFunction(Module &M, const ConvolutionDims &Dims, const SparseMatrix &Weights,
+                                          unsigned StrideH, unsigned StrideW, unsigned PadH, unsigned PadW,
+                                          const Twine &Name = "sparseConvolution");
+
+} // namespace llvm
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Kernels/ElementType.h"
+#include "Kernels/KernelShape.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Module.h"
+
+#include <cstdint>
+
+namespace llvm {
+
+class Function;
+class StructType;
+
+/// The largest rank a TensorDescriptor can describe.
+constexpr unsigned MaxTensorRank = 8;
+
+/// Runtime description of one tensor passed through the descriptor ABI. The
+/// layout is shared with generated code, so every field is 64 bits wide.
+/// Strides count elements, not bytes.
+struct TensorDescriptor {
+  void *Data = nullptr;
+  int64_t Rank = 0;
+  int64_t Dims[MaxTensorRank] = {};
+  int64_t Strides[MaxTensorRank] = {};
+  int64_t ElementType = 0;
+
+  /// Describe a contiguous row-major tensor of extents \p Dims at \p Data.
+  static TensorDescriptor getContiguous(void *Data, ArrayRef<int64_t> Dims,
+                                        TensorElementType ElemTy = TensorElementType::F32);
+};
+
+/// Return the IR type matching TensorDescriptor.
+StructType *getTensorDescriptorType(LLVMContext &Context);
+
+/// Facts the caller guarantees about one tensor argument of a kernel.
+struct TensorArgInfo {
+  /// The index of the kernel's pointer parameter.
+  unsigned ArgNo = 0;
+  /// The tensor's extents. DynamicDim extents are checked only for rank.
+  SmallVector<int64_t, 4> Dims;
+  TensorElementType ElemTy = TensorElementType::F32;
+  /// The guaranteed alignment of the base pointer in bytes.
+  unsigned Alignment = 64;
+  /// Whether no other tensor argument overlaps this one.
+  bool NoAlias = true;
+  /// Whether the kernel only reads the tensor.
+  bool ReadOnly = false;
+};
+
+/// Where the descriptor entry finds one i64 extent argument of a kernel.
+struct ExtentSource {
+  unsigned Tensor;
+  unsigned Dim;
+};
+
+/// Attach the guarantees in \p Tensors to the pointer parameters of
+/// \p Kernel: nonnull, nocapture, align and, where requested, noalias and
+/// readonly. Tensors whose extents are all static also get dereferenceable.
+/// An llvm.assume alignment fact is emitted at the top of the kernel for each
+/// tensor, because parameter attributes are dropped when the kernel is
+/// inlined but the assumption is not.
+/// \param Kernel The generated kernel.
+/// \param Tensors One entry per tensor parameter.
+void addTensorArgumentGuarantees(Function &Kernel, ArrayRef<TensorArgInfo> Tensors);
+
+/// Create `i32 Name(const TensorDescriptor *Tensors)`, an entry point that
+/// calls \p Kernel with Tensors[I].Data for the pointer parameter of
+/// Tensors[I] and with descriptor extents for its i64 parameters, in order.
+/// The entry first checks each descriptor against \p Tensors: rank, element
+/// type, static extents, contiguous row-major strides, non-null and aligned
+/// base, and for a noalias tensor a byte range disjoint from the earlier
+/// tensors' (a tensor overlapping a later noalias one is reported as the later
+/// one). The attributes from addTensorArgumentGuarantees therefore never
+/// receive a pointer that breaks them.
+/// \param M The module containing the kernel.
+/// \param Kernel The kernel to call.
+/// \param Tensors The tensor parameters of the kernel.
+/// \param Extents The source of each i64 parameter of the kernel, in order.
+/// \param Name The name of the created function.
+/// \return The entry point. It returns 0 after running the kernel, or I + 1
+/// without running it when descriptor I does not match.
+Function *createTensorDescriptorEntry(Module &M, Function &Kernel, ArrayRef<TensorArgInfo> Tensors,
+                                      ArrayRef<ExtentSource> Extents, const Twine &Name);
+
+} // namespace llvm
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Kernels/Convolution.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Alignment.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace llvm {
+
+class GlobalVariable;
+
+/// Reorder KxCxRxS convolution weights into the layout read by
+/// createPackedConvolutionFunction: [ceil(K / KBlock)][C][R][S][KBlock], with
+/// the output channels of the last block zero-padded. Each filter tap then
+/// reads the weights of KBlock output channels as one contiguous vector.
+/// \param Weights The weights in KCRS order.
+/// \param Dims The convolution extents; K, C, R and S must be known.
+/// \param KBlock The number of output channels per block.
+/// \return The packed weights.
+std::vector<float> packConvolutionWeights(ArrayRef<float> Weights, const ConvolutionDims &Dims, unsigned KBlock);
+
+/// Reorder the row-major KxN right-hand side of a GEMM into the panels read by
+/// createPackedGemmFunction: [ceil(N / NBlock)][K][NBlock], with the columns of
+/// the last panel zero-padded.
+/// \param B The matrix in row-major order.
+/// \param K The number of rows of \p B.
+/// \param N The number of columns of \p B.
+/// \param NBlock The number of columns per panel.
+/// \return The packed matrix.
+std::vector<float> packGemmWeights(ArrayRef<float> B, int64_t K, int64_t N, unsigned NBlock);
+
+/// Transform KxCx3x3 convolution weights for Winograd F(2x2, 3x3) as read by
+/// createWinogradConvolutionFunction. Each 3x3 filter g becomes the 4x4 tile
+/// G g G^T, stored as [K][C][16].
+/// \param Weights The weights in KCRS order with R = S = 3.
+/// \param K The number of output channels.
+/// \param C The number of input channels.
+/// \return The transformed weights.
+std::vector<float> transformWinogradWeights(ArrayRef<float> Weights, int64_t K, int64_t C);
+
+/// Whether a convolution can use the Winograd F(2x2, 3x3) kernel.
+bool isWinogradEligible(const ConvolutionDims &Dims, unsigned StrideH, unsigned StrideW);
+
+/// Inference-mode batch normalization parameters with one entry per channel:
+/// y = Gamma * (x - Mean) / sqrt(Variance + Epsilon) + Beta.
+struct BatchNormParams {
+  ArrayRef<float> Gamma, Beta, Mean, Variance;
+  float Epsilon = 1e-5f;
+};
+
+/// Fold a batch normalization that follows a convolution into the
+/// convolution's weights and bias, so the normalization costs nothing at
+/// inference time. Output channel k is scaled by Gamma[k] / sqrt(Variance[k] +
+/// Epsilon) and shifted accordingly. Fold before packing or transforming the
+/// weights.
+/// \param Weights The weights in KCRS order with K = Gamma.size(), updated in place.
+/// \param Bias The convolution bias, updated in place; an empty bias is treated
+/// as zero and resized to K.
+/// \param BatchNorm The normalization to fold.
+void foldBatchNorm(std::vector<float> &Weights, std::vector<float> &Bias, const BatchNormParams &BatchNorm);
+
+/// Emit packed weights as an aligned, internal constant global so they are
+/// baked into the module or object file and never repacked at run time.
+/// \param M The module in which to create the global.
+/// \param Packed The packed weights.
+/// \param Name The name of the global.
+/// \param Alignment The alignment of the global; defaults to a cache line.
+/// \return The created global.
+GlobalVariable *createPackedWeightGlobal(Module &M, ArrayRef<float> Packed, const Twine &Name,
+                                         Align Alignment = Align(64));
+
+} // namespace llvm
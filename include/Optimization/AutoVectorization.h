@@ -8,6 +8,7 @@ class FunctionPass;
 
 /// Create an auto-vectorization pass.
 /// This pass automatically vectorizes loops that can be safely and efficiently executed using SIMD instructions.
+/// Requires the analyses registered by initializeAnalysis() and initializeVectorization().
 /// \return The created auto-vectorization pass.
 FunctionPass *createAutoVectorizationPass();
 
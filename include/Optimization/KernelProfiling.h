@@ -0,0 +1,17 @@
+#pragma once
+
+#include "llvm/IR/PassManager.h"
+
+namespace llvm {
+
+class ModulePass;
+
+/// Create a kernel profiling instrumentation pass.
+/// This opt-in pass brackets every externally visible kernel and each of its
+/// outermost loop nests with llvm.readcyclecounter reads, and counts loop trip
+/// counts and bytes loaded or stored. Results are accumulated into per-region
+/// counters that register with the runtime in Runtime/KernelProfiler.h.
+/// \return The created kernel profiling pass.
+ModulePass *createKernelProfilingPass();
+
+} // namespace llvm
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Kernels/Convolution.h"
+#include "Runtime/KernelProfileData.h"
+#include "llvm/IR/PassManager.h"
+
+namespace llvm {
+
+class ModulePass;
+
+/// Thresholds that turn profiled trip counts into loop hints.
+struct ProfileGuidedConfig {
+  /// Loops averaging at most this many iterations per entry are unrolled by
+  /// that count and left scalar.
+  unsigned SmallLoopIterations = 8;
+  /// Widest vectorization factor requested for longer innermost loops.
+  unsigned MaxVectorWidth = 16;
+  /// Largest interleave count requested for longer innermost loops.
+  unsigned MaxInterleave = 4;
+};
+
+/// Loop hints chosen for a profiled loop. Zero leaves the choice to the cost model.
+struct ProfiledLoopHints {
+  unsigned UnrollCount = 0;
+  unsigned VectorWidth = 0;
+  unsigned InterleaveCount = 0;
+};
+
+/// Choose hints for a loop from its average iterations per entry.
+/// \param Iterations The average number of iterations per entry.
+/// \param Innermost Whether the loop contains no other loop. Only innermost
+/// loops are given a vector width.
+/// \param Config The thresholds to apply.
+/// \return The chosen hints.
+ProfiledLoopHints getProfiledLoopHints(double Iterations, bool Innermost, const ProfileGuidedConfig &Config);
+
+enum class ConvolutionAlgorithm { Direct, Winograd };
+
+/// Choose between the direct and Winograd convolution kernels. When both
+/// kernels have profiled cycles, the one that was faster per call wins.
+/// Otherwise Winograd is used whenever the convolution is eligible.
+/// \param Profile The profile to consult.
+/// \param DirectKernel The name of the profiled direct kernel.
+/// \param WinogradKernel The name of the profiled Winograd kernel.
+/// \param Dims The extents of the convolution.
+/// \param StrideH The stride in the height dimension.
+/// \param StrideW The stride in the width dimension.
+/// \return The algorithm to compile.
+ConvolutionAlgorithm selectConvolutionAlgorithm(const KernelProfileData &Profile, StringRef DirectKernel,
+                                                StringRef WinogradKernel, const ConvolutionDims &Dims,
+                                                unsigned StrideH, unsigned StrideW);
+
+/// Create a profile-guided specialization pass.
+/// This pass reads the loop trip counts that the kernel profiling pass recorded
+/// for each outermost loop nest and attaches them to the matching loops of a
+/// freshly generated module: branch weights on the loop exit, and unroll,
+/// vector width and interleave hints for the standard pipeline to honor.
+/// Regions are matched by loop index and header name, so the profile must come
+/// from the same generator as the module.
+/// \param Profile The profile to apply.
+/// \param Config The thresholds for choosing hints.
+/// \return The created profile-guided specialization pass.
+ModulePass *createProfileGuidedSpecializationPass(const KernelProfileData &Profile = KernelProfileData(),
+                                                  const ProfileGuidedConfig &Config = ProfileGuidedConfig());
+
+} // namespace llvm
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+
+namespace llvm {
+
+class FunctionPass;
+class LoopInfo;
+class ScalarEvolution;
+
+/// Machine parameters a roofline estimate is measured against.
+struct RooflineConfig {
+  /// Peak floating-point throughput in GFLOP/s.
+  double PeakGFlops = 100.0;
+  /// Peak memory bandwidth in GB/s.
+  double PeakGBps = 20.0;
+  /// Cache line size; strided accesses move at most this many bytes each.
+  unsigned CacheLineBytes = 64;
+  /// Trip count assumed for loops whose trip count SCEV cannot bound.
+  unsigned DefaultTripCount = 100;
+};
+
+/// Static work and traffic estimate for one outermost loop nest, or for the
+/// straight-line code outside any loop.
+struct RooflineEstimate {
+  std::string Region;
+  /// Floating-point operations executed, counting each vector lane.
+  double Flops = 0.0;
+  /// Bytes moved to or from memory. Accesses are only multiplied by the trip
+  /// counts of loops their address varies in, so loop-invariant reuse is free.
+  double Bytes = 0.0;
+  /// Whether every trip count involved was an exact constant.
+  bool Exact = true;
+
+  double getArithmeticIntensity() const { return Bytes ? Flops / Bytes : 0.0; }
+  double getComputeSeconds(const RooflineConfig &Config) const { return Flops / (Config.PeakGFlops * 1e9); }
+  double getMemorySeconds(const RooflineConfig &Config) const { return Bytes / (Config.PeakGBps * 1e9); }
+  bool isComputeBound(const RooflineConfig &Config) const {
+    return getComputeSeconds(Config) >= getMemorySeconds(Config);
+  }
+  /// Lower bound on run time: the slower of the compute and memory roofs.
+  double getPredictedSeconds(const RooflineConfig &Config) const {
+    return isComputeBound(Config) ? getComputeSeconds(Config) : getMemorySeconds(Config);
+  }
+};
+
+/// Estimate FLOPs and bytes moved for every outermost loop nest of \p F from
+/// SCEV trip counts and access strides.
+/// \param F The kernel function to analyze.
+/// \param LI Loop info for \p F.
+/// \param SE Scalar evolution for \p F.
+/// \param Config The machine parameters.
+/// \return One estimate per loop nest, plus one for straight-line code if it does any work.
+SmallVector<RooflineEstimate, 4> estimateRoofline(Function &F, LoopInfo &LI, ScalarEvolution &SE,
+                                                  const RooflineConfig &Config);
+
+/// Print a roofline report for \p Kernel, including a total over all regions.
+void printRoofline(raw_ostream &OS, StringRef Kernel, ArrayRef<RooflineEstimate> Estimates,
+                   const RooflineConfig &Config);
+
+/// Create a roofline analysis pass.
+/// This pass reports arithmetic intensity and the predicted roofline-bound time
+/// of every kernel to stderr. Running it before and after a transformation shows
+/// how far the transformation moved each kernel toward its bound.
+/// \param Config The machine parameters to estimate against.
+/// \return The created roofline analysis pass.
+FunctionPass *createRooflineAnalysisPass(const RooflineConfig &Config = RooflineConfig());
+
+} // namespace llvm
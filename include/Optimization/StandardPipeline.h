@@ -0,0 +1,16 @@
+#pragma once
+
+#include "llvm/IR/Module.h"
+#include "llvm/Passes/OptimizationLevel.h"
+
+namespace llvm {
+
+class TargetMachine;
+
+/// Run one of LLVM's standard optimization pipelines over a module.
+/// \param M The module to optimize.
+/// \param TM The target to tune for, or null for target-independent tuning.
+/// \param Level The optimization level (O0-O3, Os, Oz).
+void runStandardPipeline(Module &M, TargetMachine *TM, OptimizationLevel Level);
+
+} // namespace llvm
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "llvm/IR/PassManager.h"
+
+namespace llvm {
+
+class FunctionPass;
+
+/// Limits for the unroll-and-jam pass.
+struct UnrollAndJamConfig {
+  /// Largest number of outer iterations jammed together.
+  unsigned MaxCount = 8;
+  /// Small constant innermost loops are fully unrolled first, so filter-tap
+  /// loops do not hide the reduction loop, as long as the unrolled nest holds
+  /// at most this many copies of the original body.
+  unsigned FullUnrollCopies = 16;
+};
+
+/// Choose how many outer iterations to jam so that every copy keeps its
+/// values in registers.
+/// \param NumRegisters The number of vector registers of the target.
+/// \param SharedValues Values loaded once and reused by every copy, such as
+/// weights that do not depend on the outer loop.
+/// \param ValuesPerCopy Values each copy keeps live, such as its accumulator
+/// and one loaded operand.
+/// \param Config The limits to apply.
+/// \return A power of two between 1 and Config.MaxCount; 1 means do not jam.
+unsigned getUnrollAndJamCount(unsigned NumRegisters, unsigned SharedValues, unsigned ValuesPerCopy,
+                              const UnrollAndJamConfig &Config);
+
+/// Create an unroll-and-jam pass.
+/// For each loop whose only subloop is innermost, such as an output pixel or
+/// panel loop around a channel reduction, this pass unrolls the outer loop
+/// and fuses the copies of the inner loop. Loads in the inner loop that do not
+/// depend on the outer loop are then issued once per jammed group instead of
+/// once per outer iteration, raising the number of FMAs per load. Loops are
+/// jammed only when they have such loads and the dependence analysis proves
+/// the reordering safe. The count comes from the target's vector register
+/// count. Accumulators kept in allocas are promoted first, and small constant
+/// innermost loops are fully unrolled first. Kernels whose tensor arguments
+/// are not noalias are left alone, because the output store may then alias
+/// the loads.
+/// \param Config The limits to apply.
+/// \return The created unroll-and-jam pass.
+FunctionPass *createUnrollAndJamPass(const UnrollAndJamConfig &Config = UnrollAndJamConfig());
+
+} // namespace llvm
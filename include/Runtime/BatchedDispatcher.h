@@ -0,0 +1,102 @@
+#pragma once
+
+#include "llvm/ADT/ArrayRef.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace llvm {
+
+/// One independent inference request: a single sample's input and the
+/// buffer that receives its output.
+struct InferenceRequest {
+  const void *Input;
+  void *Output;
+};
+
+/// Options for BatchedDispatcher.
+struct BatchingOptions {
+  /// The most requests coalesced into one kernel invocation.
+  unsigned MaxBatchSize = 32;
+  /// How long the oldest queued request may wait for others to join its
+  /// batch before the batch runs anyway.
+  std::chrono::microseconds MaxQueueDelay{500};
+};
+
+/// Coalesces small independent requests into batched kernel invocations.
+/// Kernels generated with a dynamic batch extent, such as convolution and
+/// pooling with DynamicDim N or a ReLU over N samples, process a batch in one
+/// call. Each layer's weights are then streamed from memory once per batch
+/// rather than once per request, and per-call overhead is paid once.
+///
+/// The dispatcher gathers the inputs of a batch into one contiguous staging
+/// buffer, runs the batch kernel, and scatters each sample of the batched
+/// output back to its request. A single-request batch skips both copies.
+class BatchedDispatcher {
+public:
+  /// Runs a whole network or layer on \p BatchSize samples stored back to
+  /// back in \p Input, writing them back to back to \p Output.
+  using BatchKernel = std::function<void(const void *Input, void *Output, int64_t BatchSize)>;
+
+  /// Start the dispatch thread.
+  /// \param Kernel The batched kernel.
+  /// \param InputSampleSize The bytes of one request's input.
+  /// \param OutputSampleSize The bytes of one request's output.
+  /// \param Options The batch size and queueing delay limits.
+  BatchedDispatcher(BatchKernel Kernel, size_t InputSampleSize, size_t OutputSampleSize,
+                    BatchingOptions Options = BatchingOptions());
+
+  /// Finish every submitted request and stop the dispatch thread.
+  ~BatchedDispatcher();
+
+  /// Queue one request. It runs once MaxBatchSize requests are queued or it
+  /// has waited MaxQueueDelay, whichever comes first. Safe to call from
+  /// several threads. The buffers must stay valid until the future is ready.
+  /// \return A future that becomes ready when the request's output is written.
+  std::future<void> submit(const void *Input, void *Output);
+
+  /// Run \p Requests on the calling thread, in batches of at most
+  /// MaxBatchSize, without waiting for further requests.
+  void runBatched(ArrayRef<InferenceRequest> Requests);
+
+  /// The number of kernel invocations so far.
+  uint64_t getNumBatches() const { return NumBatches.load(std::memory_order_relaxed); }
+
+private:
+  struct Pending {
+    InferenceRequest Request;
+    std::promise<void> Done;
+    std::chrono::steady_clock::time_point Arrival;
+  };
+
+  void runWorker();
+  /// Gather, run and scatter one batch of at most MaxBatchSize requests.
+  void runBatch(ArrayRef<InferenceRequest> Batch);
+
+  BatchKernel Kernel;
+  size_t InputSampleSize, OutputSampleSize;
+  BatchingOptions Options;
+
+  std::mutex Mutex;
+  std::condition_variable Arrived;
+  std::deque<Pending> Queue;
+  bool ShuttingDown = false;
+
+  /// Staging buffers, shared by the dispatch thread and runBatched callers.
+  std::mutex StagingMutex;
+  std::vector<char> StagedInput, StagedOutput;
+  std::atomic<uint64_t> NumBatches{0};
+
+  std::thread Worker;
+};
+
+} // namespace llvm
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+
+namespace llvm {
+
+/// Size of the region that two cores must not both write to avoid false sharing.
+constexpr size_t CacheLineSize = 64;
+
+/// A bounded, lock-free queue with one producer thread and one consumer
+/// thread. Head and tail live on separate cache lines, and each side caches
+/// the other side's index so that it only touches the shared line when the
+/// queue looks full or empty.
+template <typename T> class SPSCQueue {
+public:
+  /// \param Capacity The number of slots, which must be a power of two.
+  explicit SPSCQueue(size_t Capacity) : Mask(Capacity - 1), Slots(new T[Capacity]) {
+    assert(Capacity && (Capacity & Mask) == 0 && "capacity must be a power of two");
+  }
+
+  /// Append \p Value, or return false if the queue is full. Producer only.
+  bool tryPush(const T &Value) {
+    size_t Tail = Producer.Index.load(std::memory_order_relaxed);
+    if (Tail - Producer.Cached > Mask) {
+      Producer.Cached = Consumer.Index.load(std::memory_order_acquire);
+      if (Tail - Producer.Cached > Mask)
+        return false;
+    }
+    Slots[Tail & Mask] = Value;
+    Producer.Index.store(Tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Remove the oldest element into \p Value, or return false if the queue is
+  /// empty. Consumer only.
+  bool tryPop(T &Value) {
+    size_t Head = Consumer.Index.load(std::memory_order_relaxed);
+    if (Head == Consumer.Cached) {
+      Consumer.Cached = Producer.Index.load(std::memory_order_acquire);
+      if (Head == Consumer.Cached)
+        return false;
+    }
+    Value = Slots[Head & Mask];
+    Consumer.Index.store(Head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  struct alignas(CacheLineSize) Side {
+    std::atomic<size_t> Index{0};
+    /// The other side's index as last seen by this side.
+    size_t Cached = 0;
+  };
+
+  const size_t Mask;
+  std::unique_ptr<T[]> Slots;
+  Side Producer;
+  Side Consumer;
+};
+
+/// A bounded, lock-free queue for any number of producers and consumers.
+/// Each slot carries a sequence number that tells a producer whether the slot
+/// is free for its ticket and a consumer whether it has been filled, so
+/// threads only contend on the head or tail counter, never on a lock.
+template <typename T> class MPMCQueue {
+public:
+  /// \param Capacity The number of slots, which must be a power of two.
+  explicit MPMCQueue(size_t Capacity) : Mask(Capacity - 1), Slots(new Slot[Capacity]) {
+    assert(Capacity && (Capacity & Mask) == 0 && "capacity must be a power of two");
+    for (size_t I = 0; I < Capacity; ++I)
+      Slots[I].Sequence.store(I, std::memory_order_relaxed);
+  }
+
+  /// Append \p Value, or return false if the queue is full.
+  bool tryPush(const T &Value) {
+    size_t Ticket = Tail.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot &S = Slots[Ticket & Mask];
+      size_t Sequence = S.Sequence.load(std::memory_order_acquire);
+      auto Lag = static_cast<std::ptrdiff_t>(Sequence - Ticket);
+      if (Lag == 0) {
+        if (Tail.compare_exchange_weak(Ticket, Ticket + 1, std::memory_order_relaxed)) {
+          S.Value = Value;
+          S.Sequence.store(Ticket + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (Lag < 0) {
+        return false;
+      } else {
+        Ticket = Tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /// Remove the oldest element into \p Value, or return false if the queue is empty.
+  bool tryPop(T &Value) {
+    size_t Ticket = Head.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot &S = Slots[Ticket & Mask];
+      size_t Sequence = S.Sequence.load(std::memory_order_acquire);
+      auto Lag = static_cast<std::ptrdiff_t>(Sequence - (Ticket + 1));
+      if (Lag == 0) {
+        if (Head.compare_exchange_weak(Ticket, Ticket + 1, std::memory_order_relaxed)) {
+          Value = S.Value;
+          S.Sequence.store(Ticket + Mask + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (Lag < 0) {
+        return false;
+      } else {
+        Ticket = Head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+private:
+  struct alignas(CacheLineSize) Slot {
+    std::atomic<size_t> Sequence;
+    T Value;
+  };
+
+  const size_t Mask;
+  std::unique_ptr<Slot[]> Slots;
+  alignas(CacheLineSize) std::atomic<size_t> Head{0};
+  alignas(CacheLineSize) std::atomic<size_t> Tail{0};
+};
+
+} // namespace llvm
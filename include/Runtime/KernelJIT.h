@@ -0,0 +1,62 @@
+#pragma once
+
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/Passes/OptimizationLevel.h"
+#include "llvm/Support/Error.h"
+
+#include <memory>
+
+namespace llvm {
+
+class WeightContainer;
+
+/// Define in \p JD the runtime entry points that generated kernels call back
+/// into: profile site registration and, on x86, the CPU feature words that
+/// multiversion resolvers dispatch on. The host executable is usually not
+/// linked with -rdynamic, so these are not found among the process symbols.
+/// \param JIT The JIT owning \p JD.
+/// \param JD The dylib that instrumented or multiversioned modules are added to.
+Error defineKernelRuntimeSymbols(orc::LLJIT &JIT, orc::JITDylib &JD);
+
+/// An in-process JIT for generated kernels.
+/// Modules added to the JIT are optimized for the host CPU with a standard
+/// pipeline when they are first looked up. Adding modules and looking up
+/// kernels are safe to do from several threads.
+class KernelJIT {
+public:
+  /// Create a JIT for the host CPU.
+  /// \param Level The optimization level applied to every added module.
+  /// \return The JIT, or an error if the host target is unavailable.
+  static Expected<std::unique_ptr<KernelJIT>> create(OptimizationLevel Level = OptimizationLevel::O3);
+
+  ~KernelJIT();
+
+  /// Add a module whose kernels become available through lookup().
+  /// The module's data layout and triple are set to the JIT's, and its
+  /// constructors run here, compiling the module if it has any; bind the
+  /// weights they read beforehand.
+  Error addModule(orc::ThreadSafeModule TSM);
+
+  /// Resolve the weight globals declared with declareWeightGlobal to the
+  /// mapped tensors of \p Weights, so kernels read them without a copy.
+  /// \p Weights must outlive every kernel that reads them.
+  Error bindWeights(const WeightContainer &Weights);
+
+  /// Return the address of the kernel \p Name, compiling it on first lookup.
+  Expected<void *> lookup(StringRef Name);
+
+  /// Return the data layout used for modules added to this JIT.
+  const DataLayout &getDataLayout() const { return JIT->getDataLayout(); }
+
+  /// Return the triple of the host this JIT compiles for.
+  const Triple &getTargetTriple() const { return JIT->getTargetTriple(); }
+
+private:
+  explicit KernelJIT(std::unique_ptr<orc::LLJIT> JIT) : JIT(std::move(JIT)) {}
+
+  std::unique_ptr<orc::LLJIT> JIT;
+};
+
+} // namespace llvm
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace llvm {
+
+/// Counters of one profiled region, summed over every recorded run.
+struct RegionProfile {
+  uint64_t Calls = 0;
+  uint64_t Cycles = 0;
+  uint64_t Trips = 0;
+
+  /// Header executions per entry into the region. For a loop that checks its
+  /// bound in the header, this is one more than the iterations per entry.
+  double getTripsPerCall() const { return Calls ? static_cast<double>(Trips) / Calls : 0.0; }
+  double getCyclesPerCall() const { return Calls ? static_cast<double>(Cycles) / Calls : 0.0; }
+};
+
+/// A shape a kernel was run with, and how many times.
+struct ShapeCount {
+  std::vector<int64_t> Dims;
+  uint64_t Count;
+};
+
+/// A persistent profile of how kernels behaved at run time, used to drive
+/// specialization on the next compile. It combines the region counters
+/// collected by the kernel profiling pass (see Runtime/KernelProfiler.h) with
+/// the tensor shapes each kernel was looked up for.
+///
+/// The file format is line based text, so profiles from several runs can be
+/// inspected and merged by hand:
+///
+///   region <kernel> <calls> <cycles> <trips> <region name>
+///   shape <kernel> <count> <extent>...
+class KernelProfileData {
+public:
+  /// Add \p Count runs of \p Kernel with extents \p Dims.
+  void recordShape(StringRef Kernel, ArrayRef<int64_t> Dims, uint64_t Count = 1);
+
+  /// Add \p Counters to the region \p Region of \p Kernel.
+  void recordRegion(StringRef Kernel, StringRef Region, const RegionProfile &Counters);
+
+  /// Add the current counters of every profile site registered with the
+  /// runtime by instrumented kernels.
+  void addRuntimeCounters();
+
+  /// Add every count of \p Other to this profile.
+  void merge(const KernelProfileData &Other);
+
+  /// Return the counters of a region, or null if it was never profiled.
+  const RegionProfile *getRegion(StringRef Kernel, StringRef Region) const;
+
+  /// Return the shapes that make up at least \p MinFraction of the recorded
+  /// runs of \p Kernel, most frequent first.
+  std::vector<ShapeCount> getHotShapes(StringRef Kernel, double MinFraction = 0.1) const;
+
+  bool empty() const { return Kernels.empty(); }
+
+  void print(raw_ostream &OS) const;
+  Error writeToFile(StringRef Path) const;
+
+  /// Parse a profile in the format written by print().
+  static Expected<KernelProfileData> parse(StringRef Buffer);
+  static Expected<KernelProfileData> readFromFile(StringRef Path);
+
+private:
+  struct KernelRecord {
+    StringMap<RegionProfile> Regions;
+    std::map<std::vector<int64_t>, uint64_t> Shapes;
+  };
+
+  StringMap<KernelRecord> Kernels;
+};
+
+} // namespace llvm
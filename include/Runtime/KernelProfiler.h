@@ -0,0 +1,42 @@
+#pragma once
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace llvm {
+
+/// Counters for one instrumented region: a whole kernel or one of its
+/// outermost loop nests. Instances are emitted into the module by the kernel
+/// profiling pass, so the layout must match the IR struct it creates.
+struct KernelProfileSite {
+  const char *Kernel;
+  const char *Region;
+  std::atomic<uint64_t> Calls;
+  std::atomic<uint64_t> Cycles;
+  std::atomic<uint64_t> Trips;
+  std::atomic<uint64_t> Bytes;
+  KernelProfileSite *Next;
+};
+
+/// Return every registered profile site, most recently registered first.
+/// A site stays valid until the JIT holding its code is destroyed.
+std::vector<const KernelProfileSite *> getKernelProfileSites();
+
+/// Print a per-kernel and per-loop breakdown of the collected counters.
+void dumpKernelProfile(raw_ostream &OS);
+
+/// Zero the counters of every registered site.
+void resetKernelProfile();
+
+} // namespace llvm
+
+/// Entry point called from the module constructor of instrumented code. Sites
+/// are pushed onto a list guarded by a mutex.
+extern "C" void __dlopt_prof_register(llvm::KernelProfileSite *Site);
+
+/// Entry point called from the module destructor of instrumented code, which
+/// runs when the JIT holding the site is destroyed. Unknown sites are ignored.
+extern "C" void __dlopt_prof_unregister(llvm::KernelProfileSite *Site);
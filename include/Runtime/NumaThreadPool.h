@@ -0,0 +1,136 @@
+#pragma once
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Memory.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+/// The CPUs of each NUMA node of the host.
+struct NumaTopology {
+  std::vector<std::vector<unsigned>> NodeCPUs;
+
+  /// Read the topology from /sys on Linux. Elsewhere, or if /sys is
+  /// unavailable, all hardware threads form a single node.
+  static NumaTopology detect();
+
+  unsigned getNumNodes() const { return NodeCPUs.size(); }
+};
+
+/// Parse a Linux CPU list such as "0-3,8,10-11" into \p CPUs.
+/// \return False if \p List is malformed.
+bool parseCPUList(StringRef List, std::vector<unsigned> &CPUs);
+
+/// Restrict the calling thread to \p CPUs. Best effort: ignored on platforms
+/// other than Linux and for CPUs outside the process's CPU set.
+void setCurrentThreadAffinity(ArrayRef<unsigned> CPUs);
+
+/// Memory taken from the OS without touching it, so each page is placed on
+/// the node of the thread that first writes to it.
+class NumaBuffer {
+public:
+  NumaBuffer() = default;
+  NumaBuffer(NumaBuffer &&Other) : Block(Other.Block), Size(Other.Size) { Other.Block = sys::MemoryBlock(); }
+  NumaBuffer &operator=(NumaBuffer &&Other);
+  NumaBuffer(const NumaBuffer &) = delete;
+  NumaBuffer &operator=(const NumaBuffer &) = delete;
+  ~NumaBuffer();
+
+  /// Map \p Size bytes of page-aligned memory, or return an empty buffer on failure.
+  static NumaBuffer map(size_t Size);
+
+  void *data() const { return Block.base(); }
+  template <typename T> T *getAs() const { return static_cast<T *>(Block.base()); }
+  size_t size() const { return Size; }
+  explicit operator bool() const { return Block.base() != nullptr; }
+
+private:
+  sys::MemoryBlock Block;
+  size_t Size = 0;
+};
+
+/// Options for NumaThreadPool.
+struct NumaPoolOptions {
+  /// Worker threads per node; zero means one per CPU of the node.
+  unsigned ThreadsPerNode = 0;
+  /// Whether replicate() gives every node its own copy of read-only data.
+  /// Replication trades memory for node-local weight reads.
+  bool ReplicateWeights = false;
+};
+
+/// A thread pool with workers pinned to the CPUs of their NUMA node.
+/// parallelFor() always hands a node the same contiguous part of an
+/// iteration space, so buffers that allocateFirstTouch() placed with the
+/// same extent are only ever read and written by threads of the node that
+/// holds them.
+class NumaThreadPool {
+public:
+  explicit NumaThreadPool(NumaTopology Topology = NumaTopology::detect(), NumaPoolOptions Options = {});
+
+  /// Stop and join the workers.
+  ~NumaThreadPool();
+
+  /// Run \p Body over [0, Extent) on every worker and wait for it to finish.
+  /// Each worker gets one contiguous, possibly empty, range of its node's part
+  /// and is passed its node so it can pick node-local data. Calls from several
+  /// threads are serialized; \p Body must not call parallelFor itself.
+  void parallelFor(int64_t Extent, function_ref<void(int64_t Begin, int64_t End, unsigned Node)> Body);
+
+  /// Return the part of [0, Extent) that parallelFor gives the threads of \p Node.
+  std::pair<int64_t, int64_t> getNodeRange(int64_t Extent, unsigned Node) const;
+
+  /// Allocate \p Extent slices of \p SliceSize bytes and zero each slice from
+  /// the node that parallelFor over \p Extent assigns it to, so its pages are
+  /// placed on that node.
+  NumaBuffer allocateFirstTouch(int64_t Extent, size_t SliceSize);
+
+  /// Read-only data with one copy per node, or a single shared copy when
+  /// replication is disabled.
+  class ReplicatedBuffer {
+  public:
+    /// Return the copy to read from threads of \p Node.
+    const void *get(unsigned Node) const { return Copies[Copies.size() == 1 ? 0 : Node].data(); }
+    template <typename T> const T *getAs(unsigned Node) const { return static_cast<const T *>(get(Node)); }
+    unsigned getNumCopies() const { return Copies.size(); }
+
+  private:
+    friend class NumaThreadPool;
+    std::vector<NumaBuffer> Copies;
+  };
+
+  /// Copy \p Size bytes at \p Data to every node, each copy written by a
+  /// thread of its node, or once if NumaPoolOptions::ReplicateWeights is off.
+  ReplicatedBuffer replicate(const void *Data, size_t Size);
+
+  unsigned getNumNodes() const { return NodeFirstThread.size() - 1; }
+  unsigned getNumThreads() const { return Workers.size(); }
+
+private:
+  void runWorker(unsigned Thread, unsigned Node);
+  std::pair<int64_t, int64_t> getThreadRange(int64_t Extent, unsigned Thread) const;
+
+  NumaPoolOptions Options;
+  /// Threads of node N are [NodeFirstThread[N], NodeFirstThread[N + 1]).
+  std::vector<unsigned> NodeFirstThread;
+  std::vector<std::thread> Workers;
+
+  std::mutex SubmitMutex;
+  std::mutex Mutex;
+  std::condition_variable WorkReady;
+  std::condition_variable WorkDone;
+  uint64_t Generation = 0;
+  unsigned Pending = 0;
+  bool ShuttingDown = false;
+  int64_t CurrentExtent = 0;
+  function_ref<void(int64_t, int64_t, unsigned)> CurrentBody;
+};
+
+} // namespace llvm
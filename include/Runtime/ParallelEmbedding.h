@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Runtime/NumaThreadPool.h"
+
+#include <cstdint>
+
+namespace llvm {
+
+/// Signature of the kernels created by createEmbeddingLookupFunction.
+using EmbeddingLookupKernelFn = void(const float *Table, const int64_t *Indices, float *Output, int64_t NumIndices,
+                                     int64_t Dim);
+
+/// Signature of the kernels created by createEmbeddingBagFunction.
+using EmbeddingBagKernelFn = void(const float *Table, const int64_t *Indices, const int64_t *Offsets, float *Output,
+                                  int64_t BagBegin, int64_t BagEnd, int64_t Dim);
+
+/// Run an embedding lookup on every worker of \p Pool, giving each worker a
+/// contiguous range of the indices and the matching output rows.
+void parallelEmbeddingLookup(NumaThreadPool &Pool, EmbeddingLookupKernelFn *Kernel, const float *Table,
+                             const int64_t *Indices, float *Output, int64_t NumIndices, int64_t Dim);
+
+/// Run an embedding bag on every worker of \p Pool. Bags vary in length, so
+/// the work is split by index rather than by bag: each worker takes the bags
+/// that start in its range of [Offsets[0], Offsets[NumBags]). Every bag is
+/// pooled by exactly one worker, which also owns its output row, so no
+/// synchronization is needed beyond parallelFor itself.
+/// \param Pool The threads to run on.
+/// \param Kernel The embedding bag kernel.
+/// \param Table The row-major embedding table.
+/// \param Indices The table rows of all bags, bag after bag.
+/// \param Offsets NumBags + 1 ascending positions in \p Indices where the bags start.
+/// \param Output NumBags rows of Dim floats.
+/// \param NumBags The number of bags.
+/// \param Dim The number of floats per row.
+void parallelEmbeddingBag(NumaThreadPool &Pool, EmbeddingBagKernelFn *Kernel, const float *Table,
+                          const int64_t *Indices, const int64_t *Offsets, float *Output, int64_t NumBags, int64_t Dim);
+
+} // namespace llvm
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Kernels/Reduction.h"
+#include "Runtime/NumaThreadPool.h"
+#include "llvm/ADT/ArrayRef.h"
+
+#include <cstdint>
+
+namespace llvm {
+
+/// Signature of the kernels created by createReductionFunction.
+using ReductionKernelFn = void(const float *Input, float *Output, int64_t *Indices, const int64_t *Shape);
+
+/// Run a reduction on every worker of \p Pool by splitting the outermost axis
+/// of the input. \p Kernel must come from createReductionFunction with
+/// Partial set, for the same \p Kind, rank and \p Axes, and with a dynamic
+/// outermost extent.
+///
+/// When the outermost axis is kept, every worker reduces into its own rows of
+/// \p Output. When it is reduced, every worker writes partial accumulators to
+/// a private slot, and the slots are then merged by output element on the
+/// pool. Workers never write to shared locations, so no locks or atomic
+/// accumulation are needed. Mean and L2Norm are finalized after the merge.
+/// An outermost extent of 0 is valid: every output holds the identity of
+/// \p Kind (0 for Sum, -inf for Max), finalized like any other result.
+/// \param Pool The threads to run on.
+/// \param Kernel The partial reduction kernel.
+/// \param Kind The reduction the kernel performs.
+/// \param Shape The extents of the input.
+/// \param Axes The axes the kernel reduces.
+/// \param Input The row-major input tensor.
+/// \param Output The output tensor with every reduced axis of extent 1.
+/// \param Indices For ArgMax, the positions of the maxima; otherwise unused.
+void parallelReduce(NumaThreadPool &Pool, ReductionKernelFn *Kernel, ReductionKind Kind, ArrayRef<int64_t> Shape,
+                    ArrayRef<unsigned> Axes, const float *Input, float *Output, int64_t *Indices = nullptr);
+
+} // namespace llvm
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Runtime/BoundedQueue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace llvm {
+
+/// A group of consecutive layers of a network, run by its own worker threads.
+struct PipelineStage {
+  /// Runs the stage's layers on one request, typically by calling compiled
+  /// kernels on the activation buffers that \p Request points to.
+  std::function<void(void *Request)> Run;
+  /// Cores to pin the stage's workers to, one core per worker in turn. An
+  /// empty list leaves the workers to the scheduler.
+  std::vector<unsigned> Cores;
+  /// The number of worker threads; zero means one per entry of Cores, or a
+  /// single worker if Cores is empty.
+  unsigned NumWorkers = 0;
+};
+
+/// Runs a network as a pipeline of stages connected by bounded lock-free
+/// queues, so that several requests are in flight at different stages at
+/// once and each stage's weights stay in the caches of the cores it is pinned
+/// to. Stages with a single worker on both sides of a queue are connected by
+/// an SPSC queue, all others by an MPMC queue. Idle workers spin briefly and
+/// then sleep until work arrives.
+class PipelineExecutor {
+public:
+  /// Start the workers of every stage.
+  /// \param Stages The stages in execution order; at least one.
+  /// \param QueueCapacity The number of slots in each queue, a power of two.
+  /// Submitting blocks while the first queue is full.
+  explicit PipelineExecutor(std::vector<PipelineStage> Stages, unsigned QueueCapacity = 64);
+
+  /// Finish every submitted request and stop the workers.
+  ~PipelineExecutor();
+
+  /// Queue \p Request to run through every stage in order. Safe to call from
+  /// several threads. \p Request must stay valid until the future is ready.
+  /// \return A future that becomes ready when the last stage has run.
+  std::future<void> submit(void *Request);
+
+  unsigned getNumStages() const { return Stages.size(); }
+
+private:
+  struct Job {
+    void *Request;
+    std::promise<void> Done;
+  };
+
+  /// A bounded queue of jobs that consumers can block on.
+  class JobQueue {
+  public:
+    JobQueue(bool SingleProducerConsumer, unsigned Capacity);
+
+    /// Append \p J, yielding while the queue is full.
+    void push(Job *J);
+    /// Remove the oldest job, waiting for one if necessary. Returns null once
+    /// the queue is closed and drained.
+    Job *pop();
+    /// Wake all consumers; pop() returns null once the queue is empty.
+    void close();
+
+  private:
+    bool tryPop(Job *&J) { return SPSC ? SPSC->tryPop(J) : MPMC->tryPop(J); }
+
+    std::unique_ptr<SPSCQueue<Job *>> SPSC;
+    std::unique_ptr<MPMCQueue<Job *>> MPMC;
+    std::atomic<bool> Closed{false};
+    std::atomic<unsigned> Sleepers{0};
+    std::mutex Mutex;
+    std::condition_variable NotEmpty;
+  };
+
+  void runWorker(unsigned Stage, unsigned Worker);
+
+  std::vector<PipelineStage> Stages;
+  /// Queues[I] feeds stage I.
+  std::vector<std::unique_ptr<JobQueue>> Queues;
+  std::unique_ptr<std::atomic<unsigned>[]> LiveWorkers;
+  std::vector<std::thread> Workers;
+};
+
+} // namespace llvm
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Runtime/KernelJIT.h"
+#include "Runtime/KernelProfileData.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Error.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+namespace llvm {
+
+class Function;
+class Module;
+
+/// Generates a kernel into \p M with the given extents constant-folded.
+/// Extents equal to DynamicDim must stay runtime arguments, and every variant
+/// must have the same signature so that they can be swapped for each other.
+using ShapedKernelGenerator = std::function<Function *(Module &M, ArrayRef<int64_t> Dims)>;
+
+/// Serves a kernel for arbitrary shapes and specializes it for the hot ones.
+/// Every shape initially runs a shape-generic variant that takes its extents
+/// as arguments. Once a shape has been looked up HotThreshold times, a variant
+/// with all extents constant-folded (so the O3 pipeline can fully unroll the
+/// small inner loops) is compiled on a background thread and returned by later
+/// lookups for that shape.
+class ShapeSpecializationCache {
+public:
+  /// Create a cache and compile the generic variant of the kernel.
+  /// \param Generator Generates the kernel for a given set of extents.
+  /// \param NumDims The number of extents the kernel takes.
+  /// \param HotThreshold Lookups of a shape after which it is specialized; with
+  /// 0 or 1 a shape is specialized on its first lookup.
+  /// \param MaxSpecializations Upper bound on the number of specialized variants.
+  /// \return The cache, or an error if the generic variant fails to compile.
+  static Expected<std::unique_ptr<ShapeSpecializationCache>>
+  create(ShapedKernelGenerator Generator, unsigned NumDims, unsigned HotThreshold = 16,
+         unsigned MaxSpecializations = 64);
+
+  ~ShapeSpecializationCache();
+
+  /// Return the kernel to run for \p Dims: the specialized variant once it is
+  /// ready, otherwise the generic one. Safe to call from several threads.
+  void *lookup(ArrayRef<int64_t> Dims);
+
+  /// Typed convenience wrapper around lookup().
+  template <typename FnT> FnT *lookupAs(ArrayRef<int64_t> Dims) {
+    return reinterpret_cast<FnT *>(lookup(Dims));
+  }
+
+  /// Block until every queued specialization has been compiled.
+  void waitForPendingSpecializations();
+
+  /// Add the number of lookups of every shape seen so far to \p Profile,
+  /// recorded under \p Kernel.
+  void recordShapes(KernelProfileData &Profile, StringRef Kernel);
+
+  /// Compile specialized variants up front for the shapes that make up at
+  /// least \p MinFraction of the runs of \p Kernel in \p Profile, so that a
+  /// model's usual shapes run specialized from their first lookup.
+  /// \return An error if a variant fails to compile.
+  Error specializeHotShapes(const KernelProfileData &Profile, StringRef Kernel, double MinFraction = 0.1);
+
+  /// Return the number of specialized variants that have been swapped in.
+  unsigned getNumSpecializations() const { return NumSpecialized.load(std::memory_order_relaxed); }
+
+private:
+  /// Per-shape state. Entries are never removed, so pointers to them stay valid.
+  struct ShapeEntry {
+    std::vector<int64_t> Dims;
+    std::atomic<void *> Kernel{nullptr};
+    std::atomic<unsigned> Hits{0};
+    /// Set once the shape has been queued or compiled for specialization.
+    std::atomic<bool> Claimed{false};
+  };
+
+  ShapeSpecializationCache(std::unique_ptr<KernelJIT> JIT, ShapedKernelGenerator Generator, unsigned NumDims,
+                           unsigned HotThreshold, unsigned MaxSpecializations);
+
+  ShapeEntry &getEntry(ArrayRef<int64_t> Dims);
+  Expected<void *> compile(ArrayRef<int64_t> Dims);
+  void runWorker();
+
+  std::unique_ptr<KernelJIT> JIT;
+  ShapedKernelGenerator Generator;
+  unsigned NumDims;
+  unsigned HotThreshold;
+  unsigned MaxSpecializations;
+  void *GenericKernel = nullptr;
+
+  std::shared_mutex EntriesMutex;
+  StringMap<std::unique_ptr<ShapeEntry>> Entries;
+  std::atomic<unsigned> NumQueued{0};
+  std::atomic<unsigned> NumSpecialized{0};
+
+  std::mutex QueueMutex;
+  std::condition_variable QueueChanged;
+  std::deque<std::pair<std::vector<int64_t>, ShapeEntry *>> Queue;
+  unsigned InFlight = 0;
+  bool ShuttingDown = false;
+  std::thread Worker;
+};
+
+} // namespace llvm
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/LazyReexports.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/Passes/OptimizationLevel.h"
+#include "llvm/Support/Error.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace llvm {
+
+/// Options for TieredKernelJIT.
+struct TieredJITOptions {
+  /// The pipeline run when a kernel is first called.
+  OptimizationLevel QuickLevel = OptimizationLevel::O1;
+  /// The pipeline run in the background once a kernel has been called.
+  OptimizationLevel OptimizedLevel = OptimizationLevel::O3;
+  /// Whether called kernels are recompiled with OptimizedLevel at all.
+  bool EnableTiering = true;
+  /// Total background compile time after which no more kernels are queued
+  /// for recompilation; zero means no limit. Kernels that miss the budget
+  /// keep running their quick version.
+  std::chrono::milliseconds OptimizationBudget{0};
+};
+
+/// A JIT that compiles a model's kernels only when they are first called.
+/// Adding a module just splits it into one module per kernel and hands out
+/// callable stubs, so kernels that never run for a given input, such as those
+/// of rarely taken model branches, are never compiled. The first call compiles
+/// the kernel with a quick pipeline. The full pipeline then recompiles it on a
+/// background thread, and the stub is switched to the optimized code when that
+/// finishes. Stub addresses never change, so callers may cache them.
+class TieredKernelJIT {
+public:
+  /// Create a JIT for the host CPU.
+  static Expected<std::unique_ptr<TieredKernelJIT>> create(TieredJITOptions Options = {});
+
+  ~TieredKernelJIT();
+
+  /// Add a module whose externally visible functions become lazily compiled
+  /// kernels. Global variables, local ones included, are defined once and
+  /// shared by all of them, and the module's constructors run here.
+  Error addModule(orc::ThreadSafeModule TSM);
+
+  /// Return the stub of the kernel \p Name without compiling it.
+  Expected<void *> lookup(StringRef Name);
+
+  /// Block until every queued background recompilation has finished.
+  void waitForPendingOptimizations();
+
+  /// The tier a kernel is currently running at.
+  enum class Tier { NotCompiled, Quick, Optimized };
+  Tier getTier(StringRef Name);
+
+  unsigned getNumQuickCompiles() const { return NumQuick.load(std::memory_order_relaxed); }
+  unsigned getNumOptimizedCompiles() const { return NumOptimized.load(std::memory_order_relaxed); }
+
+private:
+  struct KernelEntry {
+    std::atomic<Tier> CurrentTier{Tier::NotCompiled};
+    /// Bitcode of the kernel for the background recompile, released once
+    /// the optimized code is installed.
+    SmallVector<char, 0> OptimizedBitcode;
+  };
+
+  TieredKernelJIT(std::unique_ptr<orc::LLJIT> JIT, TieredJITOptions Options);
+
+  Error onFirstCall(StringRef Name, JITTargetAddress QuickAddr);
+  void runWorker();
+
+  std::unique_ptr<orc::LLJIT> JIT;
+  TieredJITOptions Options;
+  orc::JITDylib *QuickJD = nullptr;
+  orc::JITDylib *OptimizedJD = nullptr;
+  std::unique_ptr<orc::LazyCallThroughManager> CallThrough;
+  std::unique_ptr<orc::IndirectStubsManager> Stubs;
+
+  std::mutex EntriesMutex;
+  StringMap<std::unique_ptr<KernelEntry>> Entries;
+  std::atomic<unsigned> NumQuick{0};
+  std::atomic<unsigned> NumOptimized{0};
+  /// Number of modules added, which keeps their externalized names apart.
+  unsigned NumModules = 0;
+
+  std::mutex QueueMutex;
+  std::condition_variable QueueChanged;
+  std::deque<std::string> Queue;
+  unsigned InFlight = 0;
+  bool ShuttingDown = false;
+  std::chrono::nanoseconds OptimizationTime{0};
+  std::thread Worker;
+};
+
+} // namespace llvm
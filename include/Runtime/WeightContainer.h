@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Kernels/ElementType.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+class GlobalVariable;
+class Module;
+
+/// A weight container file holds named tensors at aligned offsets so that a
+/// read-only mapping of the file can be handed to kernels as is. All integers
+/// are little-endian:
+///
+///   header  char Magic[8] = "DLOPTWT1", u32 Version, u32 NumTensors,
+///           u64 TableOffset, u64 TableSize, u32 Alignment, u32 Reserved
+///   table   per tensor: u16 NameSize, Name, u8 ElementType, u8 Rank,
+///           u16 LayoutSize, Layout, i64 Shape[Rank], u64 Offset, u64 Size
+///   data    each tensor at an Offset that is a multiple of Alignment
+///
+/// The layout is a free-form tag such as "kcrs" or "winograd-f2x2-3x3" that
+/// records which packing routine produced the data.
+struct WeightTensor {
+  std::string Name;
+  TensorElementType ElemTy = TensorElementType::F32;
+  SmallVector<int64_t, 4> Shape;
+  std::string Layout;
+  /// Points into the mapped file; valid for the lifetime of the container.
+  const void *Data = nullptr;
+  uint64_t Size = 0;
+
+  int64_t getNumElements() const;
+  template <typename T> const T *getDataAs() const { return static_cast<const T *>(Data); }
+};
+
+/// Builds a weight container file. Tensor data is referenced, not copied, and
+/// must stay alive until write() returns.
+class WeightContainerWriter {
+public:
+  /// \param Alignment The alignment of every tensor in the file; defaults to a cache line.
+  explicit WeightContainerWriter(uint32_t Alignment = 64) : Alignment(Alignment) {}
+
+  void addTensor(StringRef Name, TensorElementType ElemTy, ArrayRef<int64_t> Shape, StringRef Layout,
+                 ArrayRef<char> Data);
+  void addTensor(StringRef Name, ArrayRef<int64_t> Shape, StringRef Layout, ArrayRef<float> Data);
+
+  /// Write the container to \p Path, replacing any existing file.
+  Error write(StringRef Path) const;
+
+private:
+  struct PendingTensor {
+    std::string Name;
+    TensorElementType ElemTy;
+    SmallVector<int64_t, 4> Shape;
+    std::string Layout;
+    ArrayRef<char> Data;
+  };
+
+  uint32_t Alignment;
+  std::vector<PendingTensor> Tensors;
+};
+
+/// A read-only, shared memory mapping of a weight container file. Tensor data
+/// is never copied: pages are faulted in on first use and shared through the
+/// page cache with every other process mapping the same file.
+class WeightContainer {
+public:
+  /// Map the container at \p Path and validate its tensor table.
+  static Expected<std::unique_ptr<WeightContainer>> open(StringRef Path);
+
+  /// Return the tensor called \p Name, or null if there is none.
+  const WeightTensor *lookup(StringRef Name) const;
+
+  /// Return the tensor called \p Name after checking its element type and
+  /// element count, so it can be bound to a kernel argument.
+  Expected<const WeightTensor &> bind(StringRef Name, TensorElementType ElemTy, int64_t NumElements) const;
+
+  ArrayRef<WeightTensor> tensors() const { return Tensors; }
+  uint32_t getAlignment() const { return Alignment; }
+
+private:
+  WeightContainer(sys::fs::mapped_file_region Region) : Region(std::move(Region)) {}
+
+  Error parse();
+
+  sys::fs::mapped_file_region Region;
+  uint32_t Alignment = 0;
+  std::vector<WeightTensor> Tensors;
+  StringMap<size_t> TensorIndex;
+};
+
+/// Return the symbol under which KernelJIT::bindWeights publishes a tensor.
+std::string getWeightSymbolName(StringRef TensorName);
+
+/// Declare an external global for the container tensor \p TensorName that a
+/// kernel generator can read in place of a weight argument, such as the
+/// packed-weight global of createPackedConvolutionFunction. The global is
+/// resolved to the mapped tensor by KernelJIT::bindWeights.
+/// \param M The module in which to declare the global.
+/// \param TensorName The name of the tensor in the container.
+/// \param Alignment The alignment of the container's tensors.
+/// \return The declared global.
+GlobalVariable *declareWeightGlobal(Module &M, StringRef TensorName, uint32_t Alignment = 64);
+
+} // namespace llvm
@@ -1,4 +1,5 @@
 #include "Kernels/Activation.h"
+#include "Kernels/LoopBuilder.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/IRBuilder.h"
@@ -6,7 +7,7 @@
 
 using namespace llvm;
 
-namespace {
+namespace llvm {
 
 Function *createReLUFunction(Module &M, Type *InputTy, Type *OutputTy) {
   auto *FuncTy = FunctionType::get(Type::getVoidTy(M.getContext()), {InputTy, OutputTy}, false);
@@ -17,6 +18,7 @@ Function *createReLUFunction(Module &M, Type *InputTy, Type *OutputTy) {
 
   auto *Input = Func->getArg(0);
   auto *Output = Func->getArg(1);
+  auto *FloatTy = Type::getFloatTy(M.getContext());
 
   // Get the dimensions of the input tensor
   // Placeholder values
@@ -43,15 +45,15 @@ Function *createReLUFunction(Module &M, Type *InputTy, Type *OutputTy) {
   Builder.SetInsertPoint(LoopBody);
 
   // Load the input value
-  auto *InputPtr = Builder.CreateGEP(Input, {Builder.getInt64(0), IndexPhi});
-  auto *InputVal = Builder.CreateLoad(InputPtr);
+  auto *InputPtr = Builder.CreateGEP(FloatTy, Input, IndexPhi);
+  auto *InputVal = Builder.CreateLoad(FloatTy, InputPtr);
 
   // Perform the ReLU activation
   auto *Zero = ConstantFP::get(InputVal->getType(), 0.0);
   auto *ReLUVal = Builder.CreateSelect(Builder.CreateFCmpOGT(InputVal, Zero), InputVal, Zero);
 
   // Store the output value
-  auto *OutputPtr = Builder.CreateGEP(Output, {Builder.getInt64(0), IndexPhi});
+  auto *OutputPtr = Builder.CreateGEP(FloatTy, Output, IndexPhi);
   Builder.CreateStore(ReLUVal, OutputPtr);
 
   // Increment the loop index
@@ -68,4 +70,30 @@ Function *createReLUFunction(Module &M, Type *InputTy, Type *OutputTy) {
   return Func;
 }
 
-} // namespace
+Function *createReLUFunction(Module &M, int64_t Size, const Twine &Name, TensorElementType ElemTy) {
+  LLVMContext &Context = M.getContext();
+  auto *FloatTy = Type::getFloatTy(Context);
+  auto *TensorTy = PointerType::getUnqual(getTensorStorageType(Context, ElemTy));
+  auto *FuncTy = FunctionType::get(Type::getVoidTy(Context), {TensorTy, TensorTy, Type::getInt64Ty(Context)}, false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  auto *Input = Func->getArg(0);
+  auto *Output = Func->getArg(1);
+  auto *InputSize = getDimValue(Builder, Size, Func->getArg(2));
+
+  createLoop(Builder, Builder.getInt64(0), InputSize, "loop", [&](IRBuilder<> &Builder, Value *Index) {
+    auto *InputVal = createTensorLoad(Builder, ElemTy, Input, Index);
+    auto *Zero = ConstantFP::get(FloatTy, 0.0);
+    auto *ReLUVal = Builder.CreateSelect(Builder.CreateFCmpOGT(InputVal, Zero), InputVal, Zero);
+    createTensorStore(Builder, ElemTy, ReLUVal, Output, Index);
+  });
+
+  Builder.CreateRetVoid();
+
+  return Func;
+}
+
+} // namespace llvm
@@ -0,0 +1,196 @@
+#include "Kernels/Attention.h"
+#include "Kernels/LoopBuilder.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Type.h"
+
+#include <cfloat>
+#include <functional>
+
+using namespace llvm;
+
+namespace {
+
+/// Emit \p Body under a branch on \p Cond and continue after it.
+void emitIf(IRBuilder<> &Builder, Value *Cond, const Twine &Name, std::function<void(IRBuilder<> &)> Body) {
+  Function *Func = Builder.GetInsertBlock()->getParent();
+  auto *ThenBB = BasicBlock::Create(Func->getContext(), Name, Func);
+  auto *AfterBB = BasicBlock::Create(Func->getContext(), Name + ".after", Func);
+  Builder.CreateCondBr(Cond, ThenBB, AfterBB);
+  Builder.SetInsertPoint(ThenBB);
+  Body(Builder);
+  Builder.CreateBr(AfterBB);
+  Builder.SetInsertPoint(AfterBB);
+}
+
+/// Emit Row[0..Extent) *= Factor in place.
+void emitScaleRow(IRBuilder<> &Builder, Value *Row, Value *RowOffset, Value *Extent, Value *Factor,
+                  const Twine &Name) {
+  createStripMinedLoop(Builder, Extent, StripWidth, Name, [&](IRBuilder<> &Builder, Value *Col, unsigned Width) {
+    auto *Offset = Builder.CreateAdd(RowOffset, Col);
+    auto *X = createStripLoad(Builder, Row, Offset, Width);
+    createStripStore(Builder, Builder.CreateFMul(X, createStripSplat(Builder, Factor, Width)), Row, Offset, Width);
+  });
+}
+
+} // namespace
+
+namespace llvm {
+
+Function *createAttentionFunction(Module &M, const AttentionDims &Dims, unsigned QueryBlock, unsigned KeyBlock,
+                                  bool Causal, const Twine &Name) {
+  LLVMContext &Context = M.getContext();
+  auto *FloatTy = Type::getFloatTy(Context);
+  auto *TensorTy = PointerType::getUnqual(FloatTy);
+  auto *Int64Ty = Type::getInt64Ty(Context);
+  auto *FuncTy = FunctionType::get(Type::getVoidTy(Context),
+                                   {TensorTy, TensorTy, TensorTy, TensorTy, Int64Ty, Int64Ty, Int64Ty, Int64Ty}, false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  auto *Q = Func->getArg(0);
+  auto *K = Func->getArg(1);
+  auto *V = Func->getArg(2);
+  auto *Out = Func->getArg(3);
+  auto *Batch = getDimValue(Builder, Dims.Batch, Func->getArg(4));
+  auto *SeqQ = getDimValue(Builder, Dims.SeqQ, Func->getArg(5));
+  auto *SeqK = getDimValue(Builder, Dims.SeqK, Func->getArg(6));
+  auto *HeadDim = getDimValue(Builder, Dims.HeadDim, Func->getArg(7));
+
+  // The running maximum and sum of each row of a query tile are separate
+  // scalars, so they are promoted to registers. The scores of one key tile
+  // are the only per-key state.
+  SmallVector<Value *, 8> RowMax, RowSum;
+  for (unsigned I = 0; I < QueryBlock; ++I) {
+    RowMax.push_back(Builder.CreateAlloca(FloatTy, nullptr, "rowMax"));
+    RowSum.push_back(Builder.CreateAlloca(FloatTy, nullptr, "rowSum"));
+  }
+  auto *ScoresTy = ArrayType::get(FloatTy, KeyBlock);
+  auto *Scores = Builder.CreatePointerCast(Builder.CreateAlloca(ScoresTy, nullptr, "scores"), TensorTy);
+  auto *TileMax = Builder.CreateAlloca(FloatTy, nullptr, "tileMax");
+  auto *TileSum = Builder.CreateAlloca(FloatTy, nullptr, "tileSum");
+
+  auto *Zero = Builder.getInt64(0);
+  auto *Lowest = ConstantFP::get(FloatTy, -FLT_MAX);
+  auto *Scale = Builder.CreateFDiv(
+      ConstantFP::get(FloatTy, 1.0),
+      Builder.CreateUnaryIntrinsic(Intrinsic::sqrt, Builder.CreateUIToFP(HeadDim, FloatTy)), "scale");
+  auto *QueryTiles = Builder.CreateUDiv(Builder.CreateAdd(SeqQ, Builder.getInt64(QueryBlock - 1)),
+                                        Builder.getInt64(QueryBlock), "queryTiles");
+  auto *KeyTiles = Builder.CreateUDiv(Builder.CreateAdd(SeqK, Builder.getInt64(KeyBlock - 1)),
+                                      Builder.getInt64(KeyBlock), "keyTiles");
+
+  createLoop(Builder, Zero, Batch, "LoopBatch", [&](IRBuilder<> &Builder, Value *LoopBatch) {
+    auto *QBase = Builder.CreateMul(LoopBatch, Builder.CreateMul(SeqQ, HeadDim));
+    auto *KVBase = Builder.CreateMul(LoopBatch, Builder.CreateMul(SeqK, HeadDim));
+
+    createLoop(Builder, Zero, QueryTiles, "LoopQueryTile", [&](IRBuilder<> &Builder, Value *QueryTile) {
+      auto *FirstRow = Builder.CreateMul(QueryTile, Builder.getInt64(QueryBlock));
+      SmallVector<Value *, 8> Rows;
+      for (unsigned I = 0; I < QueryBlock; ++I)
+        Rows.push_back(Builder.CreateAdd(FirstRow, Builder.getInt64(I)));
+      auto RowOffset = [&](IRBuilder<> &Builder, unsigned I) {
+        return Builder.CreateAdd(QBase, Builder.CreateMul(Rows[I], HeadDim));
+      };
+      // Rows past the end of the last query tile are skipped
+      auto ForEachRow = [&](IRBuilder<> &Builder, const Twine &RowName,
+                            std::function<void(IRBuilder<> &, unsigned)> Body) {
+        for (unsigned I = 0; I < QueryBlock; ++I)
+          emitIf(Builder, Builder.CreateICmpULT(Rows[I], SeqQ), RowName + Twine(I),
+                 [&](IRBuilder<> &Builder) { Body(Builder, I); });
+      };
+
+      // The output rows double as the unnormalized accumulators
+      ForEachRow(Builder, "row.init", [&](IRBuilder<> &Builder, unsigned I) {
+        Builder.CreateStore(Lowest, RowMax[I]);
+        Builder.CreateStore(ConstantFP::get(FloatTy, 0.0), RowSum[I]);
+        auto *Offset = RowOffset(Builder, I);
+        createStripMinedLoop(Builder, HeadDim, StripWidth, "LoopZero",
+                             [&](IRBuilder<> &Builder, Value *Col, unsigned Width) {
+                               createStripStore(Builder, Constant::getNullValue(getStripType(FloatTy, Width)), Out,
+                                                Builder.CreateAdd(Offset, Col), Width);
+                             });
+      });
+
+      createLoop(Builder, Zero, KeyTiles, "LoopKeyTile", [&](IRBuilder<> &Builder, Value *KeyTile) {
+        auto *FirstKey = Builder.CreateMul(KeyTile, Builder.getInt64(KeyBlock));
+
+        ForEachRow(Builder, "row.tile", [&](IRBuilder<> &Builder, unsigned I) {
+          Value *KeyEnd = SeqK;
+          if (Causal)
+            KeyEnd = Builder.CreateBinaryIntrinsic(
+                Intrinsic::umin, SeqK,
+                Builder.CreateSub(Builder.CreateAdd(Rows[I], Builder.CreateAdd(SeqK, Builder.getInt64(1))), SeqQ));
+          auto *TileKeys = Builder.CreateBinaryIntrinsic(
+              Intrinsic::umin, Builder.getInt64(KeyBlock),
+              Builder.CreateSub(KeyEnd, Builder.CreateBinaryIntrinsic(Intrinsic::umin, KeyEnd, FirstKey)));
+          auto *QOffset = RowOffset(Builder, I);
+
+          emitIf(Builder, Builder.CreateICmpNE(TileKeys, Zero), "keys", [&](IRBuilder<> &Builder) {
+            // s_j = q . k_j * scale, tracking the tile maximum
+            Builder.CreateStore(Lowest, TileMax);
+            createLoop(Builder, Zero, TileKeys, "LoopScore", [&](IRBuilder<> &Builder, Value *Key) {
+              auto *KOffset = Builder.CreateAdd(KVBase, Builder.CreateMul(Builder.CreateAdd(FirstKey, Key), HeadDim));
+              auto *Score = Builder.CreateFMul(
+                  createDotProduct(Builder, Q, QOffset, K, KOffset, HeadDim, StripWidth, "LoopDot"), Scale);
+              Builder.CreateStore(Score, Builder.CreateGEP(FloatTy, Scores, Key));
+              Builder.CreateStore(Builder.CreateMaxNum(Builder.CreateLoad(FloatTy, TileMax), Score), TileMax);
+            });
+
+            // p_j = exp(s_j - max'), sum' = sum * exp(max - max') + sum_j p_j
+            auto *Max = Builder.CreateLoad(FloatTy, RowMax[I], "max");
+            auto *NewMax = Builder.CreateMaxNum(Max, Builder.CreateLoad(FloatTy, TileMax), "newMax");
+            auto *Correction =
+                Builder.CreateUnaryIntrinsic(Intrinsic::exp, Builder.CreateFSub(Max, NewMax), nullptr, "correction");
+            Builder.CreateStore(ConstantFP::get(FloatTy, 0.0), TileSum);
+            createLoop(Builder, Zero, TileKeys, "LoopExp", [&](IRBuilder<> &Builder, Value *Key) {
+              auto *ScorePtr = Builder.CreateGEP(FloatTy, Scores, Key);
+              auto *P = Builder.CreateUnaryIntrinsic(
+                  Intrinsic::exp, Builder.CreateFSub(Builder.CreateLoad(FloatTy, ScorePtr), NewMax));
+              Builder.CreateStore(P, ScorePtr);
+              Builder.CreateStore(Builder.CreateFAdd(Builder.CreateLoad(FloatTy, TileSum), P), TileSum);
+            });
+            Builder.CreateStore(Builder.CreateFAdd(Builder.CreateFMul(Builder.CreateLoad(FloatTy, RowSum[I]),
+                                                                      Correction),
+                                                   Builder.CreateLoad(FloatTy, TileSum)),
+                                RowSum[I]);
+            Builder.CreateStore(NewMax, RowMax[I]);
+
+            // out' = out * exp(max - max') + sum_j p_j * v_j
+            emitScaleRow(Builder, Out, QOffset, HeadDim, Correction, "LoopRescale");
+            createLoop(Builder, Zero, TileKeys, "LoopValue", [&](IRBuilder<> &Builder, Value *Key) {
+              auto *P = Builder.CreateLoad(FloatTy, Builder.CreateGEP(FloatTy, Scores, Key));
+              auto *VOffset = Builder.CreateAdd(KVBase, Builder.CreateMul(Builder.CreateAdd(FirstKey, Key), HeadDim));
+              createStripMinedLoop(
+                  Builder, HeadDim, StripWidth, "LoopAccumulate",
+                  [&](IRBuilder<> &Builder, Value *Col, unsigned Width) {
+                    auto *Offset = Builder.CreateAdd(QOffset, Col);
+                    auto *Product = Builder.CreateFMul(
+                        createStripSplat(Builder, P, Width),
+                        createStripLoad(Builder, V, Builder.CreateAdd(VOffset, Col), Width));
+                    createStripStore(Builder, Builder.CreateFAdd(createStripLoad(Builder, Out, Offset, Width), Product),
+                                     Out, Offset, Width);
+                  });
+            });
+          });
+        });
+      });
+
+      ForEachRow(Builder, "row.normalize", [&](IRBuilder<> &Builder, unsigned I) {
+        auto *InvSum = Builder.CreateFDiv(ConstantFP::get(FloatTy, 1.0), Builder.CreateLoad(FloatTy, RowSum[I]),
+                                          "invSum");
+        emitScaleRow(Builder, Out, RowOffset(Builder, I), HeadDim, InvSum, "LoopNormalize");
+      });
+    });
+  });
+
+  Builder.CreateRetVoid();
+
+  return Func;
+}
+
+} // namespace llvm
@@ -1,37 +1,202 @@
 #include "Kernels/Convolution.h"
+#include "Kernels/LoopBuilder.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/Type.h"
 
+#include <cassert>
+#include <cmath>
+
 using namespace llvm;
 
 namespace {
 
-// Helper function to create a loop
-void createLoop(IRBuilder<> &Builder, Value *Start, Value *End, const Twine &Name, std::function<void(IRBuilder<> &, Value *)> Body) {
-  Function *Func = Builder.GetInsertBlock()->getParent();
-  BasicBlock *PreheaderBB = Builder.GetInsertBlock();
-  BasicBlock *LoopBB = BasicBlock::Create(Func->getContext(), Name + ".loop", Func);
-  BasicBlock *AfterBB = BasicBlock::Create(Func->getContext(), Name + ".after", Func);
-  
-  Builder.CreateCondBr(Builder.CreateICmpULT(Start, End), LoopBB, AfterBB);
-  
-  Builder.SetInsertPoint(LoopBB);
-  PHINode *Index = Builder.CreatePHI(Start->getType(), 2, Name + ".index");
-  Index->addIncoming(Start, PreheaderBB);
-  
-  Body(Builder, Index);
-  
-  Value *NextVar = Builder.CreateAdd(Index, ConstantInt::get(Start->getType(), 1), Name + ".nextvar");
-  Index->addIncoming(NextVar, LoopBB);
-  Builder.CreateCondBr(Builder.CreateICmpULT(NextVar, End), LoopBB, AfterBB);
-  
-  Builder.SetInsertPoint(AfterBB);
+// Winograd F(2x2, 3x3) input and output transforms
+const float WinogradBT[4][4] = {{1, 0, -1, 0}, {0, 1, 1, 0}, {0, -1, 1, 0}, {0, 1, 0, -1}};
+const float WinogradAT[2][4] = {{1, 1, 1, 0}, {0, 1, -1, -1}};
+
+/// Emit the sum of Coeffs[i] * Terms[i], skipping zero coefficients and using
+/// plain adds and subtracts for coefficients of one.
+Value *emitLinearCombination(IRBuilder<> &Builder, ArrayRef<float> Coeffs, ArrayRef<Value *> Terms) {
+  Value *Sum = nullptr;
+  for (size_t I = 0; I < Coeffs.size(); ++I) {
+    if (Coeffs[I] == 0.0f)
+      continue;
+    bool Negate = Coeffs[I] < 0.0f;
+    Value *Term = Terms[I];
+    if (Coeffs[I] != 1.0f && Coeffs[I] != -1.0f)
+      Term = Builder.CreateFMul(ConstantFP::get(Term->getType(), std::abs(Coeffs[I])), Term);
+    if (!Sum)
+      Sum = Negate ? Builder.CreateFNeg(Term) : Term;
+    else
+      Sum = Negate ? Builder.CreateFSub(Sum, Term) : Builder.CreateFAdd(Sum, Term);
+  }
+  return Sum ? Sum : ConstantFP::get(Builder.getFloatTy(), 0.0);
+}
+
+/// Emit T * X * T^T for the Rows x 4 constant matrix \p T and the 4x4 tile \p X
+/// given in row-major order.
+template <unsigned Rows>
+SmallVector<Value *, 16> emitTileTransform(IRBuilder<> &Builder, const float (&T)[Rows][4], ArrayRef<Value *> X) {
+  SmallVector<Value *, 16> Left;
+  for (unsigned I = 0; I < Rows; ++I)
+    for (unsigned J = 0; J < 4; ++J)
+      Left.push_back(emitLinearCombination(Builder, T[I], {X[J], X[4 + J], X[8 + J], X[12 + J]}));
+
+  SmallVector<Value *, 16> Result;
+  for (unsigned I = 0; I < Rows; ++I)
+    for (unsigned J = 0; J < Rows; ++J)
+      Result.push_back(emitLinearCombination(Builder, T[J], ArrayRef<Value *>(Left).slice(I * 4, 4)));
+  return Result;
 }
 
+/// Emit a direct NCHW convolution whose filter taps are DilationH rows and
+/// DilationW columns apart.
+Function *emitDirectConvolution(Module &M, const ConvolutionDims &Dims, unsigned StrideH, unsigned StrideW,
+                                unsigned PadH, unsigned PadW, unsigned DilationH, unsigned DilationW,
+                                const Twine &Name, TensorElementType ElemTy) {
+  LLVMContext &Context = M.getContext();
+  auto *FloatTy = Type::getFloatTy(Context);
+  auto *TensorTy = PointerType::getUnqual(getTensorStorageType(Context, ElemTy));
+  auto *Int64Ty = Type::getInt64Ty(Context);
+  auto *FuncTy = FunctionType::get(Type::getVoidTy(Context),
+                                   {TensorTy, TensorTy, TensorTy, Int64Ty, Int64Ty, Int64Ty, Int64Ty, Int64Ty,
+                                    Int64Ty, Int64Ty},
+                                   false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  auto *Input = Func->getArg(0);
+  auto *Weight = Func->getArg(1);
+  auto *Output = Func->getArg(2);
+
+  // Take each extent from the shape when it is known, otherwise from the arguments
+  auto *N = getDimValue(Builder, Dims.N, Func->getArg(3));
+  auto *C = getDimValue(Builder, Dims.C, Func->getArg(4));
+  auto *H = getDimValue(Builder, Dims.H, Func->getArg(5));
+  auto *W = getDimValue(Builder, Dims.W, Func->getArg(6));
+  auto *K = getDimValue(Builder, Dims.K, Func->getArg(7));
+  auto *R = getDimValue(Builder, Dims.R, Func->getArg(8));
+  auto *S = getDimValue(Builder, Dims.S, Func->getArg(9));
+
+  // A dilated filter spans Dilation * (R - 1) + 1 input rows
+  auto Dilate = [](IRBuilder<> &Builder, Value *Tap, unsigned Dilation) {
+    return Dilation == 1 ? Tap : Builder.CreateMul(Tap, Builder.getInt64(Dilation));
+  };
+  auto Span = [&](Value *Taps, unsigned Dilation) {
+    if (Dilation == 1)
+      return Taps;
+    return Builder.CreateAdd(Dilate(Builder, Builder.CreateSub(Taps, Builder.getInt64(1)), Dilation),
+                             Builder.getInt64(1));
+  };
+  auto *SpanH = Span(R, DilationH);
+  auto *SpanW = Span(S, DilationW);
+
+  // OH = (H + 2 * PadH - SpanH) / StrideH + 1, and likewise for OW
+  auto *OutputH = Builder.CreateAdd(
+      Builder.CreateUDiv(Builder.CreateSub(Builder.CreateAdd(H, Builder.getInt64(2 * PadH)), SpanH),
+                         Builder.getInt64(StrideH)),
+      Builder.getInt64(1), "outputH");
+  auto *OutputW = Builder.CreateAdd(
+      Builder.CreateUDiv(Builder.CreateSub(Builder.CreateAdd(W, Builder.getInt64(2 * PadW)), SpanW),
+                         Builder.getInt64(StrideW)),
+      Builder.getInt64(1), "outputW");
+
+  auto *Acc = Builder.CreateAlloca(FloatTy, nullptr, "acc");
+  auto *Zero = Builder.getInt64(0);
+
+  createLoop(Builder, Zero, N, "LoopN", [&](IRBuilder<> &Builder, Value *LoopN) {
+    createLoop(Builder, Zero, K, "LoopK", [&](IRBuilder<> &Builder, Value *LoopK) {
+      createLoop(Builder, Zero, OutputH, "OuterLoopY", [&](IRBuilder<> &Builder, Value *OuterLoopY) {
+        createLoop(Builder, Zero, OutputW, "OuterLoopX", [&](IRBuilder<> &Builder, Value *OuterLoopX) {
+
+          Builder.CreateStore(ConstantFP::get(FloatTy, 0.0), Acc);
+
+          // Reduce over input channels and the filter window
+          createLoop(Builder, Zero, C, "LoopC", [&](IRBuilder<> &Builder, Value *LoopC) {
+            createLoop(Builder, Zero, R, "InnerLoopY", [&](IRBuilder<> &Builder, Value *InnerLoopY) {
+              createLoop(Builder, Zero, S, "InnerLoopX", [&](IRBuilder<> &Builder, Value *InnerLoopX) {
+
+                // Input coordinates may fall into the padding; an unsigned compare
+                // against the extent rejects both negative and overflowing indices
+                auto *InputIdxY = Builder.CreateSub(
+                    Builder.CreateAdd(Builder.CreateMul(OuterLoopY, Builder.getInt64(StrideH)),
+                                      Dilate(Builder, InnerLoopY, DilationH)),
+                    Builder.getInt64(PadH));
+                auto *InputIdxX = Builder.CreateSub(
+                    Builder.CreateAdd(Builder.CreateMul(OuterLoopX, Builder.getInt64(StrideW)),
+                                      Dilate(Builder, InnerLoopX, DilationW)),
+                    Builder.getInt64(PadW));
+
+                BasicBlock *AccumulateBB = nullptr;
+                BasicBlock *ContinueBB = nullptr;
+                if (PadH || PadW) {
+                  AccumulateBB = BasicBlock::Create(Context, "accumulate", Func);
+                  ContinueBB = BasicBlock::Create(Context, "accumulate.after", Func);
+                  auto *InBounds =
+                      Builder.CreateAnd(Builder.CreateICmpULT(InputIdxY, H), Builder.CreateICmpULT(InputIdxX, W));
+                  Builder.CreateCondBr(InBounds, AccumulateBB, ContinueBB);
+                  Builder.SetInsertPoint(AccumulateBB);
+                }
+
+                // input[n][c][iy][ix] and weight[k][c][ky][kx]
+                auto *InputOffset = Builder.CreateAdd(
+                    Builder.CreateMul(
+                        Builder.CreateAdd(Builder.CreateMul(Builder.CreateAdd(Builder.CreateMul(LoopN, C), LoopC), H),
+                                          InputIdxY),
+                        W),
+                    InputIdxX);
+                auto *WeightOffset = Builder.CreateAdd(
+                    Builder.CreateMul(
+                        Builder.CreateAdd(Builder.CreateMul(Builder.CreateAdd(Builder.CreateMul(LoopK, C), LoopC), R),
+                                          InnerLoopY),
+                        S),
+                    InnerLoopX);
+                auto *InputVal = createTensorLoad(Builder, ElemTy, Input, InputOffset);
+                auto *WeightVal = createTensorLoad(Builder, ElemTy, Weight, WeightOffset);
+
+                auto *AccVal = Builder.CreateLoad(FloatTy, Acc);
+                Builder.CreateStore(Builder.CreateFAdd(AccVal, Builder.CreateFMul(InputVal, WeightVal)), Acc);
+
+                if (ContinueBB) {
+                  Builder.CreateBr(ContinueBB);
+                  Builder.SetInsertPoint(ContinueBB);
+                }
+              });
+            });
+          });
+
+          // output[n][k][oy][ox]
+          auto *OutputOffset = Builder.CreateAdd(
+              Builder.CreateMul(
+                  Builder.CreateAdd(
+                      Builder.CreateMul(Builder.CreateAdd(Builder.CreateMul(LoopN, K), LoopK), OutputH), OuterLoopY),
+                  OutputW),
+              OuterLoopX);
+          createTensorStore(Builder, ElemTy, Builder.CreateLoad(FloatTy, Acc), Output, OutputOffset);
+
+        });
+      });
+    });
+  });
+
+  Builder.CreateRetVoid();
+
+  return Func;
+}
+
+} // namespace
+
+namespace llvm {
+
 Function *createConvolutionFunction(Module &M, Type *InputTy, Type *WeightTy, Type *OutputTy,
-                                    unsigned StrideH, unsigned StrideW, unsigned PadH, unsigned PadW) {
+                                    unsigned StrideH, unsigned StrideW, [[maybe_unused]] unsigned PadH,
+                                    [[maybe_unused]] unsigned PadW) {
   auto *FuncTy = FunctionType::get(Type::getVoidTy(M.getContext()), {InputTy, WeightTy, OutputTy}, false);
   auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, "convolution", &M);
 
@@ -41,19 +206,22 @@ Function *createConvolutionFunction(Module &M, Type *InputTy, Type *WeightTy, Ty
   auto *Input = Func->getArg(0);
   auto *Weight = Func->getArg(1);
   auto *Output = Func->getArg(2);
+  auto *FloatTy = Type::getFloatTy(M.getContext());
 
   // Get the dimensions of the input, weight, and output tensors
   // Assume these are defined somewhere appropriately
-  // Placeholder values
-  unsigned InputH = 32, InputW = 32, WeightH = 3, WeightW = 3, OutputH = 30, OutputW = 30;
+  // Placeholder values; this variant does not pad
+  unsigned InputH = 32, InputW = 32, WeightH = 3, WeightW = 3;
+  unsigned OutputH = (InputH - WeightH) / StrideH + 1, OutputW = (InputW - WeightW) / StrideW + 1;
 
   // Create loops for the output tensor dimensions
   createLoop(Builder, Builder.getInt32(0), Builder.getInt32(OutputH), "OuterLoopY", [&](IRBuilder<> &Builder, Value *OuterLoopY) {
     createLoop(Builder, Builder.getInt32(0), Builder.getInt32(OutputW), "OuterLoopX", [&](IRBuilder<> &Builder, Value *OuterLoopX) {
 
       // Initialize the output to zero
-      auto *OutputIdx = Builder.CreateGEP(Output, {OuterLoopY, OuterLoopX});
-      Builder.CreateStore(ConstantFP::get(Type::getFloatTy(M.getContext()), 0.0), OutputIdx);
+      auto *OutputOffset = Builder.CreateAdd(Builder.CreateMul(OuterLoopY, Builder.getInt32(OutputW)), OuterLoopX);
+      auto *OutputIdx = Builder.CreateGEP(FloatTy, Output, OutputOffset);
+      Builder.CreateStore(ConstantFP::get(FloatTy, 0.0), OutputIdx);
 
       // Create loops for the weight tensor dimensions
       createLoop(Builder, Builder.getInt32(0), Builder.getInt32(WeightH), "InnerLoopY", [&](IRBuilder<> &Builder, Value *InnerLoopY) {
@@ -64,13 +232,15 @@ Function *createConvolutionFunction(Module &M, Type *InputTy, Type *WeightTy, Ty
           auto *InputIdxX = Builder.CreateAdd(Builder.CreateMul(OuterLoopX, Builder.getInt32(StrideW)), InnerLoopX);
 
           // Load the input and weight values
-          auto *InputIdx = Builder.CreateGEP(Input, {InputIdxY, InputIdxX});
-          auto *WeightIdx = Builder.CreateGEP(Weight, {InnerLoopY, InnerLoopX});
-          auto *InputVal = Builder.CreateLoad(InputIdx);
-          auto *WeightVal = Builder.CreateLoad(WeightIdx);
+          auto *InputOffset = Builder.CreateAdd(Builder.CreateMul(InputIdxY, Builder.getInt32(InputW)), InputIdxX);
+          auto *WeightOffset = Builder.CreateAdd(Builder.CreateMul(InnerLoopY, Builder.getInt32(WeightW)), InnerLoopX);
+          auto *InputIdx = Builder.CreateGEP(FloatTy, Input, InputOffset);
+          auto *WeightIdx = Builder.CreateGEP(FloatTy, Weight, WeightOffset);
+          auto *InputVal = Builder.CreateLoad(FloatTy, InputIdx);
+          auto *WeightVal = Builder.CreateLoad(FloatTy, WeightIdx);
 
           // Perform the multiplication and accumulate the result in the output
-          auto *OutputVal = Builder.CreateLoad(OutputIdx);
+          auto *OutputVal = Builder.CreateLoad(FloatTy, OutputIdx);
           auto *MulVal = Builder.CreateFMul(InputVal, WeightVal);
           auto *AccVal = Builder.CreateFAdd(OutputVal, MulVal);
           Builder.CreateStore(AccVal, OutputIdx);
@@ -86,4 +256,429 @@ Function *createConvolutionFunction(Module &M, Type *InputTy, Type *WeightTy, Ty
   return Func;
 }
 
-} // namespace
+Function *createConvolutionFunction(Module &M, const ConvolutionDims &Dims, unsigned StrideH, unsigned StrideW,
+                                    unsigned PadH, unsigned PadW, const Twine &Name, TensorElementType ElemTy) {
+  return emitDirectConvolution(M, Dims, StrideH, StrideW, PadH, PadW, 1, 1, Name, ElemTy);
+}
+
+Function *createDilatedConvolutionFunction(Module &M, const ConvolutionDims &Dims, unsigned StrideH,
+                                           unsigned StrideW, unsigned PadH, unsigned PadW, unsigned DilationH,
+                                           unsigned DilationW, const Twine &Name, TensorElementType ElemTy) {
+  assert(DilationH && DilationW && "dilation must be at least one");
+  return emitDirectConvolution(M, Dims, StrideH, StrideW, PadH, PadW, DilationH, DilationW, Name, ElemTy);
+}
+
+Function *createTransposedConvolutionFunction(Module &M, const ConvolutionDims &Dims, unsigned StrideH,
+                                              unsigned StrideW, unsigned PadH, unsigned PadW, const Twine &Name,
+                                              TensorElementType ElemTy) {
+  assert(StrideH && StrideW && "stride must be at least one");
+  LLVMContext &Context = M.getContext();
+  auto *FloatTy = Type::getFloatTy(Context);
+  auto *TensorTy = PointerType::getUnqual(getTensorStorageType(Context, ElemTy));
+  auto *Int64Ty = Type::getInt64Ty(Context);
+  auto *FuncTy = FunctionType::get(Type::getVoidTy(Context),
+                                   {TensorTy, TensorTy, TensorTy, Int64Ty, Int64Ty, Int64Ty, Int64Ty, Int64Ty,
+                                    Int64Ty, Int64Ty},
+                                   false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  auto *Input = Func->getArg(0);
+  auto *Weight = Func->getArg(1);
+  auto *Output = Func->getArg(2);
+
+  auto *N = getDimValue(Builder, Dims.N, Func->getArg(3));
+  auto *C = getDimValue(Builder, Dims.C, Func->getArg(4));
+  auto *H = getDimValue(Builder, Dims.H, Func->getArg(5));
+  auto *W = getDimValue(Builder, Dims.W, Func->getArg(6));
+  auto *K = getDimValue(Builder, Dims.K, Func->getArg(7));
+  auto *R = getDimValue(Builder, Dims.R, Func->getArg(8));
+  auto *S = getDimValue(Builder, Dims.S, Func->getArg(9));
+
+  // OH = (H - 1) * StrideH + R - 2 * PadH, and likewise for OW
+  auto *One = Builder.getInt64(1);
+  auto *OutputH = Builder.CreateSub(
+      Builder.CreateAdd(Builder.CreateMul(Builder.CreateSub(H, One), Builder.getInt64(StrideH)), R),
+      Builder.getInt64(2 * PadH), "outputH");
+  auto *OutputW = Builder.CreateSub(
+      Builder.CreateAdd(Builder.CreateMul(Builder.CreateSub(W, One), Builder.getInt64(StrideW)), S),
+      Builder.getInt64(2 * PadW), "outputW");
+
+  auto *Acc = Builder.CreateAlloca(FloatTy, nullptr, "acc");
+  auto *Zero = Builder.getInt64(0);
+
+  createLoop(Builder, Zero, N, "LoopN", [&](IRBuilder<> &Builder, Value *LoopN) {
+    createLoop(Builder, Zero, K, "LoopK", [&](IRBuilder<> &Builder, Value *LoopK) {
+      // Output row oy = q * StrideH + PhaseY - PadH only meets the taps
+      // ky = PhaseY + j * StrideH, each of which reads input row q - j. Every
+      // phase is therefore a dense stride-1 convolution with a subsampled
+      // filter, and no zero-inserted input is ever read.
+      for (unsigned PhaseY = 0; PhaseY < StrideH; ++PhaseY) {
+        for (unsigned PhaseX = 0; PhaseX < StrideW; ++PhaseX) {
+          auto *TapsY = Builder.CreateUDiv(Builder.CreateAdd(R, Builder.getInt64(StrideH - 1 - PhaseY)),
+                                           Builder.getInt64(StrideH), "tapsY");
+          auto *TapsX = Builder.CreateUDiv(Builder.CreateAdd(S, Builder.getInt64(StrideW - 1 - PhaseX)),
+                                           Builder.getInt64(StrideW), "tapsX");
+          // Rows with q * StrideH + PhaseY < PadH fall into the cropped border
+          auto *BeginY = Builder.getInt64(PadH > PhaseY ? (PadH - PhaseY + StrideH - 1) / StrideH : 0);
+          auto *BeginX = Builder.getInt64(PadW > PhaseX ? (PadW - PhaseX + StrideW - 1) / StrideW : 0);
+          auto *EndY = Builder.CreateUDiv(Builder.CreateAdd(OutputH, Builder.getInt64(PadH + StrideH - 1 - PhaseY)),
+                                          Builder.getInt64(StrideH));
+          auto *EndX = Builder.CreateUDiv(Builder.CreateAdd(OutputW, Builder.getInt64(PadW + StrideW - 1 - PhaseX)),
+                                          Builder.getInt64(StrideW));
+
+          createLoop(Builder, BeginY, EndY, "PhaseLoopY", [&](IRBuilder<> &Builder, Value *PhaseLoopY) {
+            createLoop(Builder, BeginX, EndX, "PhaseLoopX", [&](IRBuilder<> &Builder, Value *PhaseLoopX) {
+
+              Builder.CreateStore(ConstantFP::get(FloatTy, 0.0), Acc);
+
+              createLoop(Builder, Zero, C, "LoopC", [&](IRBuilder<> &Builder, Value *LoopC) {
+                createLoop(Builder, Zero, TapsY, "TapLoopY", [&](IRBuilder<> &Builder, Value *TapLoopY) {
+                  createLoop(Builder, Zero, TapsX, "TapLoopX", [&](IRBuilder<> &Builder, Value *TapLoopX) {
+
+                    // Taps past the input edge are skipped rather than multiplied by zero
+                    auto *InputIdxY = Builder.CreateSub(PhaseLoopY, TapLoopY);
+                    auto *InputIdxX = Builder.CreateSub(PhaseLoopX, TapLoopX);
+                    auto *AccumulateBB = BasicBlock::Create(Context, "accumulate", Func);
+                    auto *ContinueBB = BasicBlock::Create(Context, "accumulate.after", Func);
+                    auto *InBounds =
+                        Builder.CreateAnd(Builder.CreateICmpULT(InputIdxY, H), Builder.CreateICmpULT(InputIdxX, W));
+                    Builder.CreateCondBr(InBounds, AccumulateBB, ContinueBB);
+                    Builder.SetInsertPoint(AccumulateBB);
+
+                    auto *FilterY = Builder.CreateAdd(Builder.CreateMul(TapLoopY, Builder.getInt64(StrideH)),
+                                                      Builder.getInt64(PhaseY));
+                    auto *FilterX = Builder.CreateAdd(Builder.CreateMul(TapLoopX, Builder.getInt64(StrideW)),
+                                                      Builder.getInt64(PhaseX));
+
+                    // input[n][c][iy][ix] and weight[c][k][ky][kx]
+                    auto *InputOffset = Builder.CreateAdd(
+                        Builder.CreateMul(
+                            Builder.CreateAdd(
+                                Builder.CreateMul(Builder.CreateAdd(Builder.CreateMul(LoopN, C), LoopC), H), InputIdxY),
+                            W),
+                        InputIdxX);
+                    auto *WeightOffset = Builder.CreateAdd(
+                        Builder.CreateMul(
+                            Builder.CreateAdd(
+                                Builder.CreateMul(Builder.CreateAdd(Builder.CreateMul(LoopC, K), LoopK), R), FilterY),
+                            S),
+                        FilterX);
+                    auto *InputVal = createTensorLoad(Builder, ElemTy, Input, InputOffset);
+                    auto *WeightVal = createTensorLoad(Builder, ElemTy, Weight, WeightOffset);
+
+                    auto *AccVal = Builder.CreateLoad(FloatTy, Acc);
+                    Builder.CreateStore(Builder.CreateFAdd(AccVal, Builder.CreateFMul(InputVal, WeightVal)), Acc);
+
+                    Builder.CreateBr(ContinueBB);
+                    Builder.SetInsertPoint(ContinueBB);
+                  });
+                });
+              });
+
+              // output[n][k][oy][ox]
+              auto *OutputY = Builder.CreateSub(
+                  Builder.CreateAdd(Builder.CreateMul(PhaseLoopY, Builder.getInt64(StrideH)), Builder.getInt64(PhaseY)),
+                  Builder.getInt64(PadH));
+              auto *OutputX = Builder.CreateSub(
+                  Builder.CreateAdd(Builder.CreateMul(PhaseLoopX, Builder.getInt64(StrideW)), Builder.getInt64(PhaseX)),
+                  Builder.getInt64(PadW));
+              auto *OutputOffset = Builder.CreateAdd(
+                  Builder.CreateMul(
+                      Builder.CreateAdd(
+                          Builder.CreateMul(Builder.CreateAdd(Builder.CreateMul(LoopN, K), LoopK), OutputH), OutputY),
+                      OutputW),
+                  OutputX);
+              createTensorStore(Builder, ElemTy, Builder.CreateLoad(FloatTy, Acc), Output, OutputOffset);
+
+            });
+          });
+        }
+      }
+    });
+  });
+
+  Builder.CreateRetVoid();
+
+  return Func;
+}
+
+Function *createPackedConvolutionFunction(Module &M, const ConvolutionDims &Dims, unsigned KBlock, unsigned StrideH,
+                                          unsigned StrideW, unsigned PadH, unsigned PadW,
+                                          GlobalVariable *PackedWeights, GlobalVariable *Bias, const Twine &Name) {
+  LLVMContext &Context = M.getContext();
+  auto *FloatTy = Type::getFloatTy(Context);
+  auto *VecTy = FixedVectorType::get(FloatTy, KBlock);
+  auto *TensorTy = PointerType::getUnqual(FloatTy);
+  auto *Int64Ty = Type::getInt64Ty(Context);
+  auto *FuncTy = FunctionType::get(Type::getVoidTy(Context),
+                                   {TensorTy, TensorTy, TensorTy, Int64Ty, Int64Ty, Int64Ty, Int64Ty, Int64Ty,
+                                    Int64Ty, Int64Ty},
+                                   false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  auto *Input = Func->getArg(0);
+  auto *Output = Func->getArg(2);
+  Value *Weight = Func->getArg(1);
+  // Blocks of a baked global start on multiples of the block size
+  Align WeightAlign(4);
+  if (PackedWeights) {
+    Weight = Builder.CreatePointerCast(PackedWeights, TensorTy);
+    WeightAlign = commonAlignment(PackedWeights->getAlign().valueOrOne(), KBlock * sizeof(float));
+  }
+
+  auto *N = getDimValue(Builder, Dims.N, Func->getArg(3));
+  auto *C = getDimValue(Builder, Dims.C, Func->getArg(4));
+  auto *H = getDimValue(Builder, Dims.H, Func->getArg(5));
+  auto *W = getDimValue(Builder, Dims.W, Func->getArg(6));
+  auto *K = getDimValue(Builder, Dims.K, Func->getArg(7));
+  auto *R = getDimValue(Builder, Dims.R, Func->getArg(8));
+  auto *S = getDimValue(Builder, Dims.S, Func->getArg(9));
+
+  auto *OutputH = Builder.CreateAdd(
+      Builder.CreateUDiv(Builder.CreateSub(Builder.CreateAdd(H, Builder.getInt64(2 * PadH)), R),
+                         Builder.getInt64(StrideH)),
+      Builder.getInt64(1), "outputH");
+  auto *OutputW = Builder.CreateAdd(
+      Builder.CreateUDiv(Builder.CreateSub(Builder.CreateAdd(W, Builder.getInt64(2 * PadW)), S),
+                         Builder.getInt64(StrideW)),
+      Builder.getInt64(1), "outputW");
+  auto *KBlocks = Builder.CreateUDiv(Builder.CreateAdd(K, Builder.getInt64(KBlock - 1)), Builder.getInt64(KBlock),
+                                     "kBlocks");
+
+  auto *Acc = Builder.CreateAlloca(VecTy, nullptr, "acc");
+  auto *Zero = Builder.getInt64(0);
+
+  createLoop(Builder, Zero, N, "LoopN", [&](IRBuilder<> &Builder, Value *LoopN) {
+    createLoop(Builder, Zero, KBlocks, "LoopKBlock", [&](IRBuilder<> &Builder, Value *LoopKBlock) {
+      createLoop(Builder, Zero, OutputH, "OuterLoopY", [&](IRBuilder<> &Builder, Value *OuterLoopY) {
+        createLoop(Builder, Zero, OutputW, "OuterLoopX", [&](IRBuilder<> &Builder, Value *OuterLoopX) {
+
+          Builder.CreateStore(Constant::getNullValue(VecTy), Acc);
+
+          createLoop(Builder, Zero, C, "LoopC", [&](IRBuilder<> &Builder, Value *LoopC) {
+            createLoop(Builder, Zero, R, "InnerLoopY", [&](IRBuilder<> &Builder, Value *InnerLoopY) {
+              createLoop(Builder, Zero, S, "InnerLoopX", [&](IRBuilder<> &Builder, Value *InnerLoopX) {
+
+                auto *InputIdxY = Builder.CreateSub(
+                    Builder.CreateAdd(Builder.CreateMul(OuterLoopY, Builder.getInt64(StrideH)), InnerLoopY),
+                    Builder.getInt64(PadH));
+                auto *InputIdxX = Builder.CreateSub(
+                    Builder.CreateAdd(Builder.CreateMul(OuterLoopX, Builder.getInt64(StrideW)), InnerLoopX),
+                    Builder.getInt64(PadW));
+
+                BasicBlock *ContinueBB = nullptr;
+                if (PadH || PadW) {
+                  auto *AccumulateBB = BasicBlock::Create(Context, "accumulate", Func);
+                  ContinueBB = BasicBlock::Create(Context, "accumulate.after", Func);
+                  auto *InBounds =
+                      Builder.CreateAnd(Builder.CreateICmpULT(InputIdxY, H), Builder.CreateICmpULT(InputIdxX, W));
+                  Builder.CreateCondBr(InBounds, AccumulateBB, ContinueBB);
+                  Builder.SetInsertPoint(AccumulateBB);
+                }
+
+                // input[n][c][iy][ix] and packed[kb][c][r][s][0..KBlock)
+                auto *InputOffset = Builder.CreateAdd(
+                    Builder.CreateMul(
+                        Builder.CreateAdd(Builder.CreateMul(Builder.CreateAdd(Builder.CreateMul(LoopN, C), LoopC), H),
+                                          InputIdxY),
+                        W),
+                    InputIdxX);
+                auto *WeightOffset = Builder.CreateMul(
+                    Builder.CreateAdd(
+                        Builder.CreateMul(
+                            Builder.CreateAdd(
+                                Builder.CreateMul(Builder.CreateAdd(Builder.CreateMul(LoopKBlock, C), LoopC), R),
+                                InnerLoopY),
+                            S),
+                        InnerLoopX),
+                    Builder.getInt64(KBlock));
+                auto *InputVal = Builder.CreateLoad(FloatTy, Builder.CreateGEP(FloatTy, Input, InputOffset));
+                auto *WeightPtr = Builder.CreateBitCast(Builder.CreateGEP(FloatTy, Weight, WeightOffset),
+                                                        PointerType::getUnqual(VecTy));
+                auto *WeightVec = Builder.CreateAlignedLoad(VecTy, WeightPtr, WeightAlign);
+
+                auto *AccVal = Builder.CreateLoad(VecTy, Acc);
+                auto *Product = Builder.CreateFMul(WeightVec, Builder.CreateVectorSplat(KBlock, InputVal));
+                Builder.CreateStore(Builder.CreateFAdd(AccVal, Product), Acc);
+
+                if (ContinueBB) {
+                  Builder.CreateBr(ContinueBB);
+                  Builder.SetInsertPoint(ContinueBB);
+                }
+              });
+            });
+          });
+
+          // Scatter the valid lanes to output[n][kb * KBlock + lane][oy][ox]
+          auto *FirstK = Builder.CreateMul(LoopKBlock, Builder.getInt64(KBlock));
+          auto *Lanes = Builder.CreateBinaryIntrinsic(Intrinsic::umin, Builder.getInt64(KBlock),
+                                                      Builder.CreateSub(K, FirstK));
+          auto *AccVal = Builder.CreateLoad(VecTy, Acc);
+          createLoop(Builder, Zero, Lanes, "LoopLane", [&](IRBuilder<> &Builder, Value *LoopLane) {
+            Value *Result = Builder.CreateExtractElement(AccVal, LoopLane);
+            if (Bias) {
+              auto *BiasPtr = Builder.CreateGEP(FloatTy, Builder.CreatePointerCast(Bias, TensorTy),
+                                                Builder.CreateAdd(FirstK, LoopLane));
+              Result = Builder.CreateFAdd(Result, Builder.CreateLoad(FloatTy, BiasPtr));
+            }
+            auto *OutputOffset = Builder.CreateAdd(
+                Builder.CreateMul(
+                    Builder.CreateAdd(
+                        Builder.CreateMul(
+                            Builder.CreateAdd(Builder.CreateMul(LoopN, K), Builder.CreateAdd(FirstK, LoopLane)),
+                            OutputH),
+                        OuterLoopY),
+                    OutputW),
+                OuterLoopX);
+            Builder.CreateStore(Result, Builder.CreateGEP(FloatTy, Output, OutputOffset));
+          });
+
+        });
+      });
+    });
+  });
+
+  Builder.CreateRetVoid();
+
+  return Func;
+}
+
+Function *createWinogradConvolutionFunction(Module &M, const ConvolutionDims &Dims, unsigned PadH, unsigned PadW,
+                                            GlobalVariable *TransformedWeights, GlobalVariable *Bias,
+                                            const Twine &Name) {
+  assert((Dims.R == DynamicDim || Dims.R == 3) && (Dims.S == DynamicDim || Dims.S == 3) &&
+         "Winograd F(2x2, 3x3) needs 3x3 filters");
+
+  LLVMContext &Context = M.getContext();
+  auto *FloatTy = Type::getFloatTy(Context);
+  auto *TileTy = FixedVectorType::get(FloatTy, 16);
+  auto *TensorTy = PointerType::getUnqual(FloatTy);
+  auto *Int64Ty = Type::getInt64Ty(Context);
+  auto *FuncTy = FunctionType::get(Type::getVoidTy(Context),
+                                   {TensorTy, TensorTy, TensorTy, Int64Ty, Int64Ty, Int64Ty, Int64Ty, Int64Ty,
+                                    Int64Ty, Int64Ty},
+                                   false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  auto *Input = Func->getArg(0);
+  auto *Output = Func->getArg(2);
+  Value *Weight = Func->getArg(1);
+  Align WeightAlign(4);
+  if (TransformedWeights) {
+    Weight = Builder.CreatePointerCast(TransformedWeights, TensorTy);
+    WeightAlign = commonAlignment(TransformedWeights->getAlign().valueOrOne(), 16 * sizeof(float));
+  }
+
+  auto *N = getDimValue(Builder, Dims.N, Func->getArg(3));
+  auto *C = getDimValue(Builder, Dims.C, Func->getArg(4));
+  auto *H = getDimValue(Builder, Dims.H, Func->getArg(5));
+  auto *W = getDimValue(Builder, Dims.W, Func->getArg(6));
+  auto *K = getDimValue(Builder, Dims.K, Func->getArg(7));
+
+  auto *OutputH = Builder.CreateSub(Builder.CreateAdd(H, Builder.getInt64(2 * PadH)), Builder.getInt64(2), "outputH");
+  auto *OutputW = Builder.CreateSub(Builder.CreateAdd(W, Builder.getInt64(2 * PadW)), Builder.getInt64(2), "outputW");
+  auto *TilesY = Builder.CreateUDiv(Builder.CreateAdd(OutputH, Builder.getInt64(1)), Builder.getInt64(2), "tilesY");
+  auto *TilesX = Builder.CreateUDiv(Builder.CreateAdd(OutputW, Builder.getInt64(1)), Builder.getInt64(2), "tilesX");
+
+  // Transformed input tiles of every channel, reused by all output channels
+  auto *Transformed = Builder.CreateAlloca(TileTy, C, "transformed");
+  auto *Acc = Builder.CreateAlloca(TileTy, nullptr, "acc");
+  auto *Zero = Builder.getInt64(0);
+
+  createLoop(Builder, Zero, N, "LoopN", [&](IRBuilder<> &Builder, Value *LoopN) {
+    createLoop(Builder, Zero, TilesY, "LoopTileY", [&](IRBuilder<> &Builder, Value *LoopTileY) {
+      createLoop(Builder, Zero, TilesX, "LoopTileX", [&](IRBuilder<> &Builder, Value *LoopTileX) {
+        auto *FirstY = Builder.CreateSub(Builder.CreateMul(LoopTileY, Builder.getInt64(2)), Builder.getInt64(PadH));
+        auto *FirstX = Builder.CreateSub(Builder.CreateMul(LoopTileX, Builder.getInt64(2)), Builder.getInt64(PadW));
+
+        // V = B^T d B for the 4x4 input tile d of every channel
+        createLoop(Builder, Zero, C, "LoopInputC", [&](IRBuilder<> &Builder, Value *LoopC) {
+          auto *Plane = Builder.CreateMul(Builder.CreateAdd(Builder.CreateMul(LoopN, C), LoopC), H);
+          SmallVector<Value *, 16> Tile;
+          for (unsigned I = 0; I < 4; ++I) {
+            for (unsigned J = 0; J < 4; ++J) {
+              // Padding reads as zero; out-of-bounds lanes load element 0 instead
+              auto *InputIdxY = Builder.CreateAdd(FirstY, Builder.getInt64(I));
+              auto *InputIdxX = Builder.CreateAdd(FirstX, Builder.getInt64(J));
+              auto *InBounds =
+                  Builder.CreateAnd(Builder.CreateICmpULT(InputIdxY, H), Builder.CreateICmpULT(InputIdxX, W));
+              auto *Offset = Builder.CreateSelect(
+                  InBounds, Builder.CreateAdd(Builder.CreateMul(Builder.CreateAdd(Plane, InputIdxY), W), InputIdxX),
+                  Zero);
+              auto *InputVal = Builder.CreateLoad(FloatTy, Builder.CreateGEP(FloatTy, Input, Offset));
+              Tile.push_back(Builder.CreateSelect(InBounds, InputVal, ConstantFP::get(FloatTy, 0.0)));
+            }
+          }
+
+          Value *TileVec = UndefValue::get(TileTy);
+          SmallVector<Value *, 16> V = emitTileTransform(Builder, WinogradBT, Tile);
+          for (unsigned I = 0; I < 16; ++I)
+            TileVec = Builder.CreateInsertElement(TileVec, V[I], Builder.getInt64(I));
+          Builder.CreateStore(TileVec, Builder.CreateGEP(TileTy, Transformed, LoopC));
+        });
+
+        createLoop(Builder, Zero, K, "LoopK", [&](IRBuilder<> &Builder, Value *LoopK) {
+          // M = sum over c of U[k][c] * V[c], elementwise
+          Builder.CreateStore(Constant::getNullValue(TileTy), Acc);
+          createLoop(Builder, Zero, C, "LoopC", [&](IRBuilder<> &Builder, Value *LoopC) {
+            auto *WeightOffset =
+                Builder.CreateMul(Builder.CreateAdd(Builder.CreateMul(LoopK, C), LoopC), Builder.getInt64(16));
+            auto *WeightPtr = Builder.CreateBitCast(Builder.CreateGEP(FloatTy, Weight, WeightOffset),
+                                                    PointerType::getUnqual(TileTy));
+            auto *U = Builder.CreateAlignedLoad(TileTy, WeightPtr, WeightAlign);
+            auto *V = Builder.CreateLoad(TileTy, Builder.CreateGEP(TileTy, Transformed, LoopC));
+            Builder.CreateStore(Builder.CreateFAdd(Builder.CreateLoad(TileTy, Acc), Builder.CreateFMul(U, V)), Acc);
+          });
+
+          // Y = A^T M A is the 2x2 output tile
+          auto *AccVal = Builder.CreateLoad(TileTy, Acc);
+          SmallVector<Value *, 16> Elements;
+          for (unsigned I = 0; I < 16; ++I)
+            Elements.push_back(Builder.CreateExtractElement(AccVal, Builder.getInt64(I)));
+          SmallVector<Value *, 16> Y = emitTileTransform(Builder, WinogradAT, Elements);
+          if (Bias) {
+            auto *BiasVal = Builder.CreateLoad(
+                FloatTy, Builder.CreateGEP(FloatTy, Builder.CreatePointerCast(Bias, TensorTy), LoopK));
+            for (Value *&Element : Y)
+              Element = Builder.CreateFAdd(Element, BiasVal);
+          }
+
+          auto *OutputPlane = Builder.CreateMul(Builder.CreateAdd(Builder.CreateMul(LoopN, K), LoopK), OutputH);
+          for (unsigned I = 0; I < 2; ++I) {
+            for (unsigned J = 0; J < 2; ++J) {
+              // Odd output extents leave part of the last tile row or column unused
+              auto *OutputIdxY = Builder.CreateAdd(Builder.CreateMul(LoopTileY, Builder.getInt64(2)), Builder.getInt64(I));
+              auto *OutputIdxX = Builder.CreateAdd(Builder.CreateMul(LoopTileX, Builder.getInt64(2)), Builder.getInt64(J));
+              auto *StoreBB = BasicBlock::Create(Context, "store", Func);
+              auto *AfterBB = BasicBlock::Create(Context, "store.after", Func);
+              Builder.CreateCondBr(Builder.CreateAnd(Builder.CreateICmpULT(OutputIdxY, OutputH),
+                                                     Builder.CreateICmpULT(OutputIdxX, OutputW)),
+                                   StoreBB, AfterBB);
+              Builder.SetInsertPoint(StoreBB);
+              auto *OutputOffset =
+                  Builder.CreateAdd(Builder.CreateMul(Builder.CreateAdd(OutputPlane, OutputIdxY), OutputW), OutputIdxX);
+              Builder.CreateStore(Y[I * 2 + J], Builder.CreateGEP(FloatTy, Output, OutputOffset));
+              Builder.CreateBr(AfterBB);
+              Builder.SetInsertPoint(AfterBB);
+            }
+          }
+        });
+      });
+    });
+  });
+
+  Builder.CreateRetVoid();
+
+  return Func;
+}
+
+} // namespace llvm
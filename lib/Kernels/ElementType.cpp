@@ -0,0 +1,73 @@
+#include "Kernels/ElementType.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/IR/Type.h"
+
+using namespace llvm;
+
+namespace llvm {
+
+StringRef getTensorElementTypeName(TensorElementType ElemTy) {
+  switch (ElemTy) {
+  case TensorElementType::F32: return "f32";
+  case TensorElementType::F16: return "f16";
+  case TensorElementType::BF16: return "bf16";
+  }
+  llvm_unreachable("unknown tensor element type");
+}
+
+Optional<TensorElementType> parseTensorElementType(StringRef Name) {
+  return StringSwitch<Optional<TensorElementType>>(Name)
+      .Case("f32", TensorElementType::F32)
+      .Case("f16", TensorElementType::F16)
+      .Case("bf16", TensorElementType::BF16)
+      .Default(None);
+}
+
+Type *getTensorStorageType(LLVMContext &Context, TensorElementType ElemTy) {
+  switch (ElemTy) {
+  case TensorElementType::F32: return Type::getFloatTy(Context);
+  case TensorElementType::F16: return Type::getHalfTy(Context);
+  case TensorElementType::BF16: return Type::getInt16Ty(Context);
+  }
+  llvm_unreachable("unknown tensor element type");
+}
+
+Value *createTensorLoad(IRBuilder<> &Builder, TensorElementType ElemTy, Value *Base, Value *Index,
+                        const Twine &Name) {
+  Type *StorageTy = getTensorStorageType(Builder.getContext(), ElemTy);
+  Value *Element = Builder.CreateLoad(StorageTy, Builder.CreateGEP(StorageTy, Base, Index), Name);
+
+  switch (ElemTy) {
+  case TensorElementType::F32:
+    return Element;
+  case TensorElementType::F16:
+    return Builder.CreateFPExt(Element, Builder.getFloatTy());
+  case TensorElementType::BF16:
+    // bf16 is the upper half of an fp32 bit pattern
+    return Builder.CreateBitCast(Builder.CreateShl(Builder.CreateZExt(Element, Builder.getInt32Ty()), 16),
+                                 Builder.getFloatTy());
+  }
+  llvm_unreachable("unknown tensor element type");
+}
+
+void createTensorStore(IRBuilder<> &Builder, TensorElementType ElemTy, Value *Val, Value *Base, Value *Index) {
+  Type *StorageTy = getTensorStorageType(Builder.getContext(), ElemTy);
+
+  Value *Element = Val;
+  if (ElemTy == TensorElementType::F16) {
+    Element = Builder.CreateFPTrunc(Val, StorageTy);
+  } else if (ElemTy == TensorElementType::BF16) {
+    // Round to nearest even by adding 0x7fff plus the lowest kept bit. NaNs
+    // could round up into infinity, so they keep their top bits with the quiet bit set.
+    Value *Bits = Builder.CreateBitCast(Val, Builder.getInt32Ty());
+    Value *LowestKept = Builder.CreateAnd(Builder.CreateLShr(Bits, 16), 1);
+    Value *Rounded = Builder.CreateLShr(Builder.CreateAdd(Bits, Builder.CreateAdd(LowestKept, Builder.getInt32(0x7fff))), 16);
+    Value *QuietNaN = Builder.CreateOr(Builder.CreateLShr(Bits, 16), 0x40);
+    Value *IsNaN = Builder.CreateFCmpUNO(Val, Val);
+    Element = Builder.CreateTrunc(Builder.CreateSelect(IsNaN, QuietNaN, Rounded), StorageTy);
+  }
+
+  Builder.CreateStore(Element, Builder.CreateGEP(StorageTy, Base, Index));
+}
+
+} // namespace llvm
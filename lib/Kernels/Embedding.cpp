@@ -0,0 +1,153 @@
+#include "Kernels/Embedding.h"
+#include "Kernels/LoopBuilder.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Type.h"
+
+using namespace llvm;
+
+namespace {
+
+/// Floats per 64-byte cache line, the granularity of row prefetches.
+const unsigned CacheLineFloats = 16;
+
+/// Prefetch every cache line of the table row named by the index Distance
+/// positions after \p Position, or by the last index before \p Limit when
+/// fewer remain. Clamping keeps the index load in bounds without a branch;
+/// re-prefetching a row that is already cached is harmless.
+void emitRowPrefetch(IRBuilder<> &Builder, Value *Table, Value *Indices, Value *Position, Value *Limit,
+                     Value *Dim, unsigned Distance) {
+  if (!Distance)
+    return;
+  auto *Int64Ty = Builder.getInt64Ty();
+  auto *Ahead = Builder.CreateBinaryIntrinsic(Intrinsic::umin, Builder.CreateAdd(Position, Builder.getInt64(Distance)),
+                                              Builder.CreateSub(Limit, Builder.getInt64(1)));
+  auto *Row = Builder.CreateLoad(Int64Ty, Builder.CreateGEP(Int64Ty, Indices, Ahead), "aheadRow");
+  auto *RowOffset = Builder.CreateMul(Row, Dim);
+  auto *Lines = Builder.CreateUDiv(Builder.CreateAdd(Dim, Builder.getInt64(CacheLineFloats - 1)),
+                                   Builder.getInt64(CacheLineFloats));
+  createLoop(Builder, Builder.getInt64(0), Lines, "LoopPrefetch", [&](IRBuilder<> &Builder, Value *Line) {
+    auto *Offset = Builder.CreateAdd(RowOffset, Builder.CreateMul(Line, Builder.getInt64(CacheLineFloats)));
+    auto *Address = Builder.CreateBitCast(Builder.CreateGEP(Builder.getFloatTy(), Table, Offset),
+                                          Builder.getInt8PtrTy());
+    // Read prefetch with full temporal locality into the data cache
+    Builder.CreateIntrinsic(Intrinsic::prefetch, {Address->getType()},
+                            {Address, Builder.getInt32(0), Builder.getInt32(3), Builder.getInt32(1)});
+  });
+}
+
+} // namespace
+
+namespace llvm {
+
+Function *createEmbeddingLookupFunction(Module &M, int64_t Dim, unsigned PrefetchDistance, const Twine &Name) {
+  LLVMContext &Context = M.getContext();
+  auto *FloatTy = Type::getFloatTy(Context);
+  auto *Int64Ty = Type::getInt64Ty(Context);
+  auto *TensorTy = PointerType::getUnqual(FloatTy);
+  auto *IndexTy = PointerType::getUnqual(Int64Ty);
+  auto *FuncTy = FunctionType::get(Type::getVoidTy(Context), {TensorTy, IndexTy, TensorTy, Int64Ty, Int64Ty}, false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  auto *Table = Func->getArg(0);
+  auto *Indices = Func->getArg(1);
+  auto *Output = Func->getArg(2);
+  auto *NumIndices = Func->getArg(3);
+  auto *RowSize = getDimValue(Builder, Dim, Func->getArg(4));
+
+  createLoop(Builder, Builder.getInt64(0), NumIndices, "LoopIndex", [&](IRBuilder<> &Builder, Value *Position) {
+    auto *Row = Builder.CreateLoad(Int64Ty, Builder.CreateGEP(Int64Ty, Indices, Position), "row");
+    auto *RowOffset = Builder.CreateMul(Row, RowSize);
+    auto *OutOffset = Builder.CreateMul(Position, RowSize);
+    emitRowPrefetch(Builder, Table, Indices, Position, NumIndices, RowSize, PrefetchDistance);
+    createStripMinedLoop(Builder, RowSize, StripWidth, "LoopCopy",
+                         [&](IRBuilder<> &Builder, Value *Col, unsigned Width) {
+                           auto *X = createStripLoad(Builder, Table, Builder.CreateAdd(RowOffset, Col), Width);
+                           createStripStore(Builder, X, Output, Builder.CreateAdd(OutOffset, Col), Width);
+                         });
+  });
+
+  Builder.CreateRetVoid();
+
+  return Func;
+}
+
+Function *createEmbeddingBagFunction(Module &M, EmbeddingBagMode Mode, int64_t Dim, unsigned PrefetchDistance,
+                                     const Twine &Name) {
+  LLVMContext &Context = M.getContext();
+  auto *FloatTy = Type::getFloatTy(Context);
+  auto *Int64Ty = Type::getInt64Ty(Context);
+  auto *TensorTy = PointerType::getUnqual(FloatTy);
+  auto *IndexTy = PointerType::getUnqual(Int64Ty);
+  auto *FuncTy = FunctionType::get(Type::getVoidTy(Context),
+                                   {TensorTy, IndexTy, IndexTy, TensorTy, Int64Ty, Int64Ty, Int64Ty}, false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  auto *Table = Func->getArg(0);
+  auto *Indices = Func->getArg(1);
+  auto *Offsets = Func->getArg(2);
+  auto *Output = Func->getArg(3);
+  auto *BagBegin = Func->getArg(4);
+  auto *BagEnd = Func->getArg(5);
+  auto *RowSize = getDimValue(Builder, Dim, Func->getArg(6));
+
+  auto LoadOffset = [&](IRBuilder<> &Builder, Value *Bag, const Twine &Name) {
+    return Builder.CreateLoad(Int64Ty, Builder.CreateGEP(Int64Ty, Offsets, Bag), Name);
+  };
+  // Prefetches look ahead into later bags but not past this range's indices
+  auto *IndexEnd = LoadOffset(Builder, BagEnd, "indexEnd");
+
+  createLoop(Builder, BagBegin, BagEnd, "LoopBag", [&](IRBuilder<> &Builder, Value *Bag) {
+    auto *First = LoadOffset(Builder, Bag, "first");
+    auto *Last = LoadOffset(Builder, Builder.CreateAdd(Bag, Builder.getInt64(1)), "last");
+    auto *OutOffset = Builder.CreateMul(Bag, RowSize);
+
+    // The output row stays in L1 while the bag's rows are streamed into it
+    createStripMinedLoop(Builder, RowSize, StripWidth, "LoopZero",
+                         [&](IRBuilder<> &Builder, Value *Col, unsigned Width) {
+                           createStripStore(Builder, Constant::getNullValue(getStripType(FloatTy, Width)), Output,
+                                            Builder.CreateAdd(OutOffset, Col), Width);
+                         });
+
+    createLoop(Builder, First, Last, "LoopIndex", [&](IRBuilder<> &Builder, Value *Position) {
+      auto *Row = Builder.CreateLoad(Int64Ty, Builder.CreateGEP(Int64Ty, Indices, Position), "row");
+      auto *RowOffset = Builder.CreateMul(Row, RowSize);
+      emitRowPrefetch(Builder, Table, Indices, Position, IndexEnd, RowSize, PrefetchDistance);
+      createStripMinedLoop(Builder, RowSize, StripWidth, "LoopAccumulate",
+                           [&](IRBuilder<> &Builder, Value *Col, unsigned Width) {
+                             auto *Offset = Builder.CreateAdd(OutOffset, Col);
+                             auto *X = createStripLoad(Builder, Table, Builder.CreateAdd(RowOffset, Col), Width);
+                             auto *Acc = createStripLoad(Builder, Output, Offset, Width);
+                             createStripStore(Builder, Builder.CreateFAdd(Acc, X), Output, Offset, Width);
+                           });
+    });
+
+    if (Mode == EmbeddingBagMode::Mean) {
+      // Empty bags are already zero, so dividing by at least one is enough
+      auto *Count = Builder.CreateBinaryIntrinsic(Intrinsic::umax, Builder.CreateSub(Last, First),
+                                                  Builder.getInt64(1));
+      auto *Scale = Builder.CreateFDiv(ConstantFP::get(FloatTy, 1.0), Builder.CreateUIToFP(Count, FloatTy), "scale");
+      createStripMinedLoop(Builder, RowSize, StripWidth, "LoopScale",
+                           [&](IRBuilder<> &Builder, Value *Col, unsigned Width) {
+                             auto *Offset = Builder.CreateAdd(OutOffset, Col);
+                             auto *Acc = createStripLoad(Builder, Output, Offset, Width);
+                             createStripStore(Builder, Builder.CreateFMul(Acc, createStripSplat(Builder, Scale, Width)),
+                                              Output, Offset, Width);
+                           });
+    }
+  });
+
+  Builder.CreateRetVoid();
+
+  return Func;
+}
+
+} // namespace llvm
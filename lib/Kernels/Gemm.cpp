@@ -0,0 +1,162 @@
+#include "Kernels/Gemm.h"
+#include "Kernels/LoopBuilder.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Type.h"
+
+using namespace llvm;
+
+namespace llvm {
+
+Function *createPackedGemmFunction(Module &M, const GemmDims &Dims, unsigned NBlock, GlobalVariable *PackedB,
+                                   const Twine &Name) {
+  LLVMContext &Context = M.getContext();
+  auto *FloatTy = Type::getFloatTy(Context);
+  auto *VecTy = FixedVectorType::get(FloatTy, NBlock);
+  auto *TensorTy = PointerType::getUnqual(FloatTy);
+  auto *Int64Ty = Type::getInt64Ty(Context);
+  auto *FuncTy = FunctionType::get(Type::getVoidTy(Context),
+                                   {TensorTy, TensorTy, TensorTy, Int64Ty, Int64Ty, Int64Ty}, false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  auto *A = Func->getArg(0);
+  auto *C = Func->getArg(2);
+  Value *B = Func->getArg(1);
+  // Panel rows of a baked global start on multiples of the panel width
+  Align BAlign(4);
+  if (PackedB) {
+    B = Builder.CreatePointerCast(PackedB, TensorTy);
+    BAlign = commonAlignment(PackedB->getAlign().valueOrOne(), NBlock * sizeof(float));
+  }
+
+  auto *Rows = getDimValue(Builder, Dims.M, Func->getArg(3));
+  auto *K = getDimValue(Builder, Dims.K, Func->getArg(4));
+  auto *N = getDimValue(Builder, Dims.N, Func->getArg(5));
+  auto *Panels =
+      Builder.CreateUDiv(Builder.CreateAdd(N, Builder.getInt64(NBlock - 1)), Builder.getInt64(NBlock), "panels");
+
+  auto *Acc = Builder.CreateAlloca(VecTy, nullptr, "acc");
+  auto *Zero = Builder.getInt64(0);
+
+  createLoop(Builder, Zero, Rows, "LoopM", [&](IRBuilder<> &Builder, Value *LoopM) {
+    createLoop(Builder, Zero, Panels, "LoopPanel", [&](IRBuilder<> &Builder, Value *LoopPanel) {
+      Builder.CreateStore(Constant::getNullValue(VecTy), Acc);
+
+      createLoop(Builder, Zero, K, "LoopK", [&](IRBuilder<> &Builder, Value *LoopK) {
+        // A[m][k] times packed[panel][k][0..NBlock)
+        auto *AVal = Builder.CreateLoad(
+            FloatTy, Builder.CreateGEP(FloatTy, A, Builder.CreateAdd(Builder.CreateMul(LoopM, K), LoopK)));
+        auto *BOffset = Builder.CreateMul(Builder.CreateAdd(Builder.CreateMul(LoopPanel, K), LoopK),
+                                          Builder.getInt64(NBlock));
+        auto *BPtr = Builder.CreateBitCast(Builder.CreateGEP(FloatTy, B, BOffset), PointerType::getUnqual(VecTy));
+        auto *BVec = Builder.CreateAlignedLoad(VecTy, BPtr, BAlign);
+        auto *Product = Builder.CreateFMul(Builder.CreateVectorSplat(NBlock, AVal), BVec);
+        Builder.CreateStore(Builder.CreateFAdd(Builder.CreateLoad(VecTy, Acc), Product), Acc);
+      });
+
+      // Full panels are stored as one vector, the last one lane by lane
+      auto *FirstCol = Builder.CreateMul(LoopPanel, Builder.getInt64(NBlock));
+      auto *Lanes = Builder.CreateBinaryIntrinsic(Intrinsic::umin, Builder.getInt64(NBlock),
+                                                  Builder.CreateSub(N, FirstCol));
+      auto *AccVal = Builder.CreateLoad(VecTy, Acc);
+      auto *RowStart = Builder.CreateAdd(Builder.CreateMul(LoopM, N), FirstCol);
+
+      auto *FullBB = BasicBlock::Create(Context, "store.full", Func);
+      auto *PartialBB = BasicBlock::Create(Context, "store.partial", Func);
+      auto *AfterBB = BasicBlock::Create(Context, "store.after", Func);
+      Builder.CreateCondBr(Builder.CreateICmpEQ(Lanes, Builder.getInt64(NBlock)), FullBB, PartialBB);
+
+      Builder.SetInsertPoint(FullBB);
+      Builder.CreateAlignedStore(
+          AccVal, Builder.CreateBitCast(Builder.CreateGEP(FloatTy, C, RowStart), PointerType::getUnqual(VecTy)),
+          Align(4));
+      Builder.CreateBr(AfterBB);
+
+      Builder.SetInsertPoint(PartialBB);
+      createLoop(Builder, Zero, Lanes, "LoopLane", [&](IRBuilder<> &Builder, Value *LoopLane) {
+        Builder.CreateStore(Builder.CreateExtractElement(AccVal, LoopLane),
+                            Builder.CreateGEP(FloatTy, C, Builder.CreateAdd(RowStart, LoopLane)));
+      });
+      Builder.CreateBr(AfterBB);
+
+      Builder.SetInsertPoint(AfterBB);
+    });
+  });
+
+  Builder.CreateRetVoid();
+
+  return Func;
+}
+
+Function *createBatchedGemmFunction(Module &M, const GemmDims &Dims, int64_t Batch, bool TransposeB, bool SharedB,
+                                    const Twine &Name) {
+  LLVMContext &Context = M.getContext();
+  auto *FloatTy = Type::getFloatTy(Context);
+  auto *TensorTy = PointerType::getUnqual(FloatTy);
+  auto *Int64Ty = Type::getInt64Ty(Context);
+  auto *FuncTy = FunctionType::get(Type::getVoidTy(Context),
+                                   {TensorTy, TensorTy, TensorTy, Int64Ty, Int64Ty, Int64Ty, Int64Ty}, false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  auto *A = Func->getArg(0);
+  auto *B = Func->getArg(1);
+  auto *C = Func->getArg(2);
+  auto *NumBatches = getDimValue(Builder, Batch, Func->getArg(3));
+  auto *Rows = getDimValue(Builder, Dims.M, Func->getArg(4));
+  auto *K = getDimValue(Builder, Dims.K, Func->getArg(5));
+  auto *N = getDimValue(Builder, Dims.N, Func->getArg(6));
+  auto *Zero = Builder.getInt64(0);
+
+  createLoop(Builder, Zero, NumBatches, "LoopBatch", [&](IRBuilder<> &Builder, Value *LoopBatch) {
+    auto *ABase = Builder.CreateMul(LoopBatch, Builder.CreateMul(Rows, K));
+    auto *BBase = SharedB ? Zero : Builder.CreateMul(LoopBatch, Builder.CreateMul(K, N));
+    auto *CBase = Builder.CreateMul(LoopBatch, Builder.CreateMul(Rows, N));
+
+    createLoop(Builder, Zero, Rows, "LoopM", [&](IRBuilder<> &Builder, Value *LoopM) {
+      auto *ARow = Builder.CreateAdd(ABase, Builder.CreateMul(LoopM, K));
+      auto *CRow = Builder.CreateAdd(CBase, Builder.CreateMul(LoopM, N));
+
+      if (TransposeB) {
+        // C[m][n] is the dot product of row m of A and row n of B
+        createLoop(Builder, Zero, N, "LoopN", [&](IRBuilder<> &Builder, Value *LoopN) {
+          auto *BRow = Builder.CreateAdd(BBase, Builder.CreateMul(LoopN, K));
+          auto *Dot = createDotProduct(Builder, A, ARow, B, BRow, K, StripWidth, "LoopK");
+          Builder.CreateStore(Dot, Builder.CreateGEP(FloatTy, C, Builder.CreateAdd(CRow, LoopN)));
+        });
+        return;
+      }
+
+      // C[m][0..N) = sum over k of A[m][k] * B[k][0..N)
+      createStripMinedLoop(Builder, N, StripWidth, "LoopZero", [&](IRBuilder<> &Builder, Value *Col, unsigned Width) {
+        createStripStore(Builder, Constant::getNullValue(getStripType(FloatTy, Width)), C,
+                         Builder.CreateAdd(CRow, Col), Width);
+      });
+      createLoop(Builder, Zero, K, "LoopK", [&](IRBuilder<> &Builder, Value *LoopK) {
+        auto *AVal = Builder.CreateLoad(FloatTy, Builder.CreateGEP(FloatTy, A, Builder.CreateAdd(ARow, LoopK)));
+        auto *BRow = Builder.CreateAdd(BBase, Builder.CreateMul(LoopK, N));
+        createStripMinedLoop(Builder, N, StripWidth, "LoopN", [&](IRBuilder<> &Builder, Value *Col, unsigned Width) {
+          auto *COffset = Builder.CreateAdd(CRow, Col);
+          auto *Product = Builder.CreateFMul(createStripSplat(Builder, AVal, Width),
+                                             createStripLoad(Builder, B, Builder.CreateAdd(BRow, Col), Width));
+          createStripStore(Builder, Builder.CreateFAdd(createStripLoad(Builder, C, COffset, Width), Product), C,
+                           COffset, Width);
+        });
+      });
+    });
+  });
+
+  Builder.CreateRetVoid();
+
+  return Func;
+}
+
+} // namespace llvm
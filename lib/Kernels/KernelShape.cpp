@@ -0,0 +1,26 @@
+#include "Kernels/KernelShape.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+namespace llvm {
+
+Value *getDimValue(IRBuilder<> &Builder, int64_t Extent, Value *Arg) {
+  if (Extent == DynamicDim)
+    return Arg;
+  return Builder.getInt64(Extent);
+}
+
+void getShapeSuffix(ArrayRef<int64_t> Dims, SmallVectorImpl<char> &Out) {
+  raw_svector_ostream OS(Out);
+  for (size_t I = 0; I < Dims.size(); ++I) {
+    if (I)
+      OS << 'x';
+    if (Dims[I] == DynamicDim)
+      OS << 'D';
+    else
+      OS << Dims[I];
+  }
+}
+
+} // namespace llvm
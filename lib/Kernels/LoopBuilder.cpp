@@ -0,0 +1,100 @@
+#include "Kernels/LoopBuilder.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+
+using namespace llvm;
+
+namespace llvm {
+
+void createLoop(IRBuilder<> &Builder, Value *Start, Value *End, const Twine &Name,
+                std::function<void(IRBuilder<> &, Value *)> Body) {
+  Function *Func = Builder.GetInsertBlock()->getParent();
+  BasicBlock *PreheaderBB = Builder.GetInsertBlock();
+  BasicBlock *LoopBB = BasicBlock::Create(Func->getContext(), Name + ".loop", Func);
+  BasicBlock *AfterBB = BasicBlock::Create(Func->getContext(), Name + ".after", Func);
+
+  Builder.CreateCondBr(Builder.CreateICmpULT(Start, End), LoopBB, AfterBB);
+
+  Builder.SetInsertPoint(LoopBB);
+  PHINode *Index = Builder.CreatePHI(Start->getType(), 2, Name + ".index");
+  Index->addIncoming(Start, PreheaderBB);
+
+  Body(Builder, Index);
+
+  // The body may have emitted nested loops, so the latch is wherever the
+  // builder ended up rather than the loop header.
+  BasicBlock *LatchBB = Builder.GetInsertBlock();
+  Value *NextVar = Builder.CreateAdd(Index, ConstantInt::get(Start->getType(), 1), Name + ".nextvar");
+  Index->addIncoming(NextVar, LatchBB);
+  Builder.CreateCondBr(Builder.CreateICmpULT(NextVar, End), LoopBB, AfterBB);
+
+  Builder.SetInsertPoint(AfterBB);
+}
+
+void createStripMinedLoop(IRBuilder<> &Builder, Value *Extent, unsigned Width, const Twine &Name, StripBody Body,
+                          std::function<void(IRBuilder<> &)> BetweenLoops) {
+  auto *Strips = Builder.CreateUDiv(Extent, Builder.getInt64(Width));
+  createLoop(Builder, Builder.getInt64(0), Strips, Name + ".vector", [&](IRBuilder<> &Builder, Value *Strip) {
+    Body(Builder, Builder.CreateMul(Strip, Builder.getInt64(Width)), Width);
+  });
+  if (BetweenLoops)
+    BetweenLoops(Builder);
+  auto *RemainderStart = Builder.CreateMul(Strips, Builder.getInt64(Width));
+  createLoop(Builder, RemainderStart, Extent, Name + ".remainder",
+             [&](IRBuilder<> &Builder, Value *Index) { Body(Builder, Index, 1); });
+}
+
+Type *getStripType(Type *FloatTy, unsigned Width) {
+  return Width == 1 ? FloatTy : FixedVectorType::get(FloatTy, Width);
+}
+
+Value *createStripSplat(IRBuilder<> &Builder, Value *V, unsigned Width) {
+  return Width == 1 ? V : Builder.CreateVectorSplat(Width, V);
+}
+
+Value *createStripLoad(IRBuilder<> &Builder, Value *Base, Value *Offset, unsigned Width) {
+  auto *FloatTy = Builder.getFloatTy();
+  auto *Ptr = Builder.CreateGEP(FloatTy, Base, Offset);
+  if (Width == 1)
+    return Builder.CreateLoad(FloatTy, Ptr);
+  auto *StripTy = getStripType(FloatTy, Width);
+  return Builder.CreateAlignedLoad(StripTy, Builder.CreateBitCast(Ptr, PointerType::getUnqual(StripTy)), Align(4));
+}
+
+void createStripStore(IRBuilder<> &Builder, Value *V, Value *Base, Value *Offset, unsigned Width) {
+  auto *FloatTy = Builder.getFloatTy();
+  auto *Ptr = Builder.CreateGEP(FloatTy, Base, Offset);
+  if (Width == 1) {
+    Builder.CreateStore(V, Ptr);
+    return;
+  }
+  Builder.CreateAlignedStore(V, Builder.CreateBitCast(Ptr, PointerType::getUnqual(V->getType())), Align(4));
+}
+
+Value *createDotProduct(IRBuilder<> &Builder, Value *A, Value *AOffset, Value *B, Value *BOffset, Value *Extent,
+                        unsigned Width, const Twine &Name) {
+  auto *FloatTy = Builder.getFloatTy();
+  auto *VecTy = FixedVectorType::get(FloatTy, Width);
+  Function *Func = Builder.GetInsertBlock()->getParent();
+  IRBuilder<> EntryBuilder(&Func->getEntryBlock(), Func->getEntryBlock().begin());
+  auto *LaneSum = EntryBuilder.CreateAlloca(VecTy, nullptr, Name + ".laneSum");
+  auto *Sum = EntryBuilder.CreateAlloca(FloatTy, nullptr, Name + ".sum");
+
+  Builder.CreateStore(Constant::getNullValue(VecTy), LaneSum);
+  createStripMinedLoop(
+      Builder, Extent, Width, Name,
+      [&](IRBuilder<> &Builder, Value *Index, unsigned StripWidth) {
+        Value *SumPtr = StripWidth == 1 ? Sum : LaneSum;
+        auto *X = createStripLoad(Builder, A, Builder.CreateAdd(AOffset, Index), StripWidth);
+        auto *Y = createStripLoad(Builder, B, Builder.CreateAdd(BOffset, Index), StripWidth);
+        auto *Partial = Builder.CreateLoad(getStripType(FloatTy, StripWidth), SumPtr);
+        Builder.CreateStore(Builder.CreateFAdd(Partial, Builder.CreateFMul(X, Y)), SumPtr);
+      },
+      [&](IRBuilder<> &Builder) {
+        Builder.CreateStore(
+            Builder.CreateFAddReduce(ConstantFP::get(FloatTy, 0.0), Builder.CreateLoad(VecTy, LaneSum)), Sum);
+      });
+  return Builder.CreateLoad(FloatTy, Sum, Name + ".value");
+}
+
+} // namespace llvm
@@ -0,0 +1,194 @@
+#include "Kernels/Multiversion.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalIFunc.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/X86TargetParser.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+using namespace llvm;
+
+namespace {
+
+/// Bit mask over __cpu_model.__cpu_features[0] that must be fully set before the
+/// variant for \p ISA may run. A mask of zero means the variant needs no check.
+uint32_t getRequiredX86Features(KernelISA ISA) {
+  auto Bit = [](X86::ProcessorFeatures Feature) { return 1u << Feature; };
+  switch (ISA) {
+  case KernelISA::SSE42:
+    return Bit(X86::FEATURE_SSE4_2) | Bit(X86::FEATURE_POPCNT);
+  case KernelISA::AVX2:
+    return Bit(X86::FEATURE_AVX2) | Bit(X86::FEATURE_FMA);
+  case KernelISA::AVX512:
+    return Bit(X86::FEATURE_AVX512F) | Bit(X86::FEATURE_AVX512VL) | Bit(X86::FEATURE_AVX512BW) |
+           Bit(X86::FEATURE_AVX512DQ) | Bit(X86::FEATURE_AVX2) | Bit(X86::FEATURE_FMA);
+  case KernelISA::Generic:
+  case KernelISA::NEON:
+    return 0;
+  }
+  llvm_unreachable("unknown kernel ISA");
+}
+
+/// Fill in the body of a resolver that returns the first variant whose features
+/// are supported by the running CPU, falling back to \p Default.
+void emitResolverBody(Module &M, Function &Resolver, ArrayRef<std::pair<KernelISA, Function *>> Variants,
+                      Function *Default) {
+  LLVMContext &Context = M.getContext();
+  auto *EntryBB = BasicBlock::Create(Context, "entry", &Resolver);
+  IRBuilder<> Builder(EntryBB);
+  Type *ResultTy = Resolver.getReturnType();
+
+  bool IsX86 = Triple(M.getTargetTriple()).isX86();
+  Value *Features = nullptr;
+  if (IsX86) {
+    // Same runtime interface as clang's target_clones: libgcc and compiler-rt both
+    // provide __cpu_indicator_init and the __cpu_model feature words.
+    auto *Int32Ty = Builder.getInt32Ty();
+    auto *CPUModelTy = StructType::get(Int32Ty, Int32Ty, Int32Ty, ArrayType::get(Int32Ty, 1));
+    auto *CPUModel = M.getOrInsertGlobal("__cpu_model", CPUModelTy);
+    FunctionCallee Init = M.getOrInsertFunction("__cpu_indicator_init", Builder.getVoidTy());
+    Builder.CreateCall(Init);
+    Value *FeaturesPtr = Builder.CreateInBoundsGEP(
+        CPUModelTy, CPUModel, {Builder.getInt32(0), Builder.getInt32(3), Builder.getInt32(0)});
+    Features = Builder.CreateLoad(Int32Ty, FeaturesPtr, "features");
+  }
+
+  for (const auto &Variant : Variants) {
+    uint32_t Mask = IsX86 ? getRequiredX86Features(Variant.first) : 0;
+    if (!Mask) {
+      Builder.CreateRet(Builder.CreateBitCast(Variant.second, ResultTy));
+      return;
+    }
+
+    auto *ReturnBB = BasicBlock::Create(Context, Variant.second->getName() + ".select", &Resolver);
+    auto *NextBB = BasicBlock::Create(Context, "next", &Resolver);
+    Value *Supported = Builder.CreateICmpEQ(Builder.CreateAnd(Features, Mask), Builder.getInt32(Mask));
+    Builder.CreateCondBr(Supported, ReturnBB, NextBB);
+
+    Builder.SetInsertPoint(ReturnBB);
+    Builder.CreateRet(Builder.CreateBitCast(Variant.second, ResultTy));
+    Builder.SetInsertPoint(NextBB);
+  }
+
+  Builder.CreateRet(Builder.CreateBitCast(Default, ResultTy));
+}
+
+/// Create a thunk named \p Name that resolves the variant on first call, caches
+/// it and forwards every call to it. Used where ifuncs are not available.
+Function *createDispatchThunk(Module &M, Function &Kernel, Function &Resolver, const Twine &Name) {
+  LLVMContext &Context = M.getContext();
+  FunctionType *FuncTy = Kernel.getFunctionType();
+  PointerType *FuncPtrTy = Kernel.getType();
+
+  auto *Cache = new GlobalVariable(M, FuncPtrTy, false, GlobalValue::InternalLinkage,
+                                   ConstantPointerNull::get(FuncPtrTy), Name + ".ptr");
+  auto *Thunk = Function::Create(FuncTy, Kernel.getLinkage(), Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Thunk);
+  auto *ResolveBB = BasicBlock::Create(Context, "resolve", Thunk);
+  auto *CallBB = BasicBlock::Create(Context, "call", Thunk);
+  IRBuilder<> Builder(EntryBB);
+
+  // Resolution is idempotent, so racing first calls may both resolve and store.
+  LoadInst *Cached = Builder.CreateAlignedLoad(FuncPtrTy, Cache, Cache->getAlign(), "cached");
+  Cached->setAtomic(AtomicOrdering::Monotonic);
+  Builder.CreateCondBr(Builder.CreateIsNull(Cached), ResolveBB, CallBB);
+
+  Builder.SetInsertPoint(ResolveBB);
+  Value *Resolved = Builder.CreateBitCast(Builder.CreateCall(&Resolver), FuncPtrTy, "resolved");
+  StoreInst *Store = Builder.CreateAlignedStore(Resolved, Cache, Cache->getAlign());
+  Store->setAtomic(AtomicOrdering::Monotonic);
+  Builder.CreateBr(CallBB);
+
+  Builder.SetInsertPoint(CallBB);
+  PHINode *Target = Builder.CreatePHI(FuncPtrTy, 2, "target");
+  Target->addIncoming(Cached, EntryBB);
+  Target->addIncoming(Resolved, ResolveBB);
+
+  SmallVector<Value *, 8> Args;
+  for (Argument &Arg : Thunk->args())
+    Args.push_back(&Arg);
+  CallInst *Call = Builder.CreateCall(FuncTy, Target, Args);
+  Call->setTailCall();
+  if (FuncTy->getReturnType()->isVoidTy())
+    Builder.CreateRetVoid();
+  else
+    Builder.CreateRet(Call);
+
+  return Thunk;
+}
+
+} // namespace
+
+namespace llvm {
+
+StringRef getKernelISASuffix(KernelISA ISA) {
+  switch (ISA) {
+  case KernelISA::Generic: return "default";
+  case KernelISA::SSE42: return "sse4.2";
+  case KernelISA::AVX2: return "avx2";
+  case KernelISA::AVX512: return "avx512";
+  case KernelISA::NEON: return "neon";
+  }
+  llvm_unreachable("unknown kernel ISA");
+}
+
+StringRef getKernelISAFeatures(KernelISA ISA) {
+  switch (ISA) {
+  case KernelISA::Generic: return "";
+  case KernelISA::SSE42: return "+sse4.2,+popcnt";
+  case KernelISA::AVX2: return "+avx2,+fma";
+  case KernelISA::AVX512: return "+avx512f,+avx512vl,+avx512bw,+avx512dq,+avx2,+fma";
+  case KernelISA::NEON: return "+neon";
+  }
+  llvm_unreachable("unknown kernel ISA");
+}
+
+SmallVector<KernelISA, 4> getMultiversionISAs(const Triple &TT) {
+  if (TT.isX86())
+    return {KernelISA::AVX512, KernelISA::AVX2, KernelISA::SSE42};
+  if (TT.isAArch64())
+    return {KernelISA::NEON};
+  return {};
+}
+
+GlobalValue *createMultiversionedKernel(Module &M, Function &Kernel, ArrayRef<KernelISA> ISAs) {
+  std::string Name = Kernel.getName().str();
+
+  SmallVector<std::pair<KernelISA, Function *>, 4> Variants;
+  for (KernelISA ISA : ISAs) {
+    if (ISA == KernelISA::Generic)
+      continue;
+
+    ValueToValueMapTy VMap;
+    Function *Clone = CloneFunction(&Kernel, VMap);
+    Clone->setName(Name + "." + getKernelISASuffix(ISA));
+
+    std::string Features = getKernelISAFeatures(ISA).str();
+    Attribute Existing = Kernel.getFnAttribute("target-features");
+    if (Existing.isValid() && !Existing.getValueAsString().empty())
+      Features = Existing.getValueAsString().str() + "," + Features;
+    Clone->addFnAttr("target-features", Features);
+    Variants.push_back({ISA, Clone});
+  }
+
+  Kernel.setName(Name + "." + getKernelISASuffix(KernelISA::Generic));
+
+  auto *ResolverTy = FunctionType::get(Kernel.getType(), false);
+  auto *Resolver = Function::Create(ResolverTy, Function::InternalLinkage, Name + ".resolver", &M);
+
+  GlobalValue *Dispatcher;
+  if (Triple(M.getTargetTriple()).isOSBinFormatELF())
+    Dispatcher = GlobalIFunc::create(Kernel.getFunctionType(), Kernel.getAddressSpace(), Kernel.getLinkage(), Name,
+                                     Resolver, &M);
+  else
+    Dispatcher = createDispatchThunk(M, Kernel, *Resolver, Name);
+
+  // Redirect callers before the resolver body takes its own reference to the kernel.
+  Kernel.replaceAllUsesWith(Dispatcher);
+  emitResolverBody(M, *Resolver, Variants, &Kernel);
+
+  return Dispatcher;
+}
+
+} // namespace llvm
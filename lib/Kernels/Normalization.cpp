@@ -0,0 +1,189 @@
+#include "Kernels/Normalization.h"
+#include "Kernels/LoopBuilder.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Type.h"
+
+#include <cfloat>
+#include <functional>
+
+using namespace llvm;
+
+namespace llvm {
+
+Function *createSoftmaxFunction(Module &M, int64_t Rows, int64_t Cols, const Twine &Name) {
+  LLVMContext &Context = M.getContext();
+  auto *FloatTy = Type::getFloatTy(Context);
+  auto *VecTy = FixedVectorType::get(FloatTy, StripWidth);
+  auto *TensorTy = PointerType::getUnqual(FloatTy);
+  auto *Int64Ty = Type::getInt64Ty(Context);
+  auto *FuncTy = FunctionType::get(Type::getVoidTy(Context), {TensorTy, TensorTy, Int64Ty, Int64Ty}, false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  auto *Input = Func->getArg(0);
+  auto *Output = Func->getArg(1);
+  auto *NumRows = getDimValue(Builder, Rows, Func->getArg(2));
+  auto *NumCols = getDimValue(Builder, Cols, Func->getArg(3));
+
+  // Running maximum and rescaled sum per lane, then for the whole row. The
+  // maximum starts at the lowest finite value so that rescaling an empty sum
+  // multiplies zero by exp(0) rather than by exp(-inf + inf).
+  auto *LaneMax = Builder.CreateAlloca(VecTy, nullptr, "laneMax");
+  auto *LaneSum = Builder.CreateAlloca(VecTy, nullptr, "laneSum");
+  auto *RowMax = Builder.CreateAlloca(FloatTy, nullptr, "rowMax");
+  auto *RowSum = Builder.CreateAlloca(FloatTy, nullptr, "rowSum");
+  auto *Lowest = ConstantFP::get(FloatTy, -FLT_MAX);
+
+  createLoop(Builder, Builder.getInt64(0), NumRows, "LoopRow", [&](IRBuilder<> &Builder, Value *Row) {
+    auto *RowOffset = Builder.CreateMul(Row, NumCols);
+    Builder.CreateStore(ConstantVector::getSplat(ElementCount::getFixed(StripWidth), Lowest), LaneMax);
+    Builder.CreateStore(Constant::getNullValue(VecTy), LaneSum);
+
+    // sum' = sum * exp(max - max') + exp(x - max') with max' = max(max, x)
+    createStripMinedLoop(
+        Builder, NumCols, StripWidth, "LoopReduce",
+        [&](IRBuilder<> &Builder, Value *Col, unsigned Width) {
+          Value *MaxPtr = Width == 1 ? RowMax : LaneMax;
+          Value *SumPtr = Width == 1 ? RowSum : LaneSum;
+          Type *StripTy = getStripType(FloatTy, Width);
+          auto *X = createStripLoad(Builder, Input, Builder.CreateAdd(RowOffset, Col), Width);
+          auto *Max = Builder.CreateLoad(StripTy, MaxPtr);
+          auto *NewMax = Builder.CreateBinaryIntrinsic(Intrinsic::maxnum, Max, X);
+          auto *Rescaled = Builder.CreateFMul(Builder.CreateLoad(StripTy, SumPtr),
+                                              Builder.CreateUnaryIntrinsic(Intrinsic::exp,
+                                                                           Builder.CreateFSub(Max, NewMax)));
+          auto *Term = Builder.CreateUnaryIntrinsic(Intrinsic::exp, Builder.CreateFSub(X, NewMax));
+          Builder.CreateStore(NewMax, MaxPtr);
+          Builder.CreateStore(Builder.CreateFAdd(Rescaled, Term), SumPtr);
+        },
+        [&](IRBuilder<> &Builder) {
+          // Bring every lane's sum to the common maximum before the remainder
+          auto *Max = Builder.CreateLoad(VecTy, LaneMax);
+          auto *Total = Builder.CreateFPMaxReduce(Max);
+          auto *Scale = Builder.CreateUnaryIntrinsic(
+              Intrinsic::exp, Builder.CreateFSub(Max, Builder.CreateVectorSplat(StripWidth, Total)));
+          auto *Sum = Builder.CreateFMul(Builder.CreateLoad(VecTy, LaneSum), Scale);
+          Builder.CreateStore(Total, RowMax);
+          Builder.CreateStore(Builder.CreateFAddReduce(ConstantFP::get(FloatTy, 0.0), Sum), RowSum);
+        });
+
+    auto *Max = Builder.CreateLoad(FloatTy, RowMax, "max");
+    auto *InvSum = Builder.CreateFDiv(ConstantFP::get(FloatTy, 1.0), Builder.CreateLoad(FloatTy, RowSum), "invSum");
+    createStripMinedLoop(
+        Builder, NumCols, StripWidth, "LoopNormalize", [&](IRBuilder<> &Builder, Value *Col, unsigned Width) {
+          auto *Offset = Builder.CreateAdd(RowOffset, Col);
+          auto *X = createStripLoad(Builder, Input, Offset, Width);
+          auto *E = Builder.CreateUnaryIntrinsic(Intrinsic::exp,
+                                                 Builder.CreateFSub(X, createStripSplat(Builder, Max, Width)));
+          createStripStore(Builder, Builder.CreateFMul(E, createStripSplat(Builder, InvSum, Width)), Output, Offset,
+                           Width);
+        });
+  });
+
+  Builder.CreateRetVoid();
+
+  return Func;
+}
+
+Function *createLayerNormFunction(Module &M, int64_t Rows, int64_t Cols, float Epsilon, const Twine &Name) {
+  LLVMContext &Context = M.getContext();
+  auto *FloatTy = Type::getFloatTy(Context);
+  auto *VecTy = FixedVectorType::get(FloatTy, StripWidth);
+  auto *TensorTy = PointerType::getUnqual(FloatTy);
+  auto *Int64Ty = Type::getInt64Ty(Context);
+  auto *FuncTy =
+      FunctionType::get(Type::getVoidTy(Context), {TensorTy, TensorTy, TensorTy, TensorTy, Int64Ty, Int64Ty}, false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  auto *Input = Func->getArg(0);
+  auto *Gamma = Func->getArg(1);
+  auto *Beta = Func->getArg(2);
+  auto *Output = Func->getArg(3);
+  auto *NumRows = getDimValue(Builder, Rows, Func->getArg(4));
+  auto *NumCols = getDimValue(Builder, Cols, Func->getArg(5));
+
+  // Welford state per lane, then for the whole row
+  auto *LaneMean = Builder.CreateAlloca(VecTy, nullptr, "laneMean");
+  auto *LaneM2 = Builder.CreateAlloca(VecTy, nullptr, "laneM2");
+  auto *RowMean = Builder.CreateAlloca(FloatTy, nullptr, "rowMean");
+  auto *RowM2 = Builder.CreateAlloca(FloatTy, nullptr, "rowM2");
+  auto *One = ConstantFP::get(FloatTy, 1.0);
+
+  createLoop(Builder, Builder.getInt64(0), NumRows, "LoopRow", [&](IRBuilder<> &Builder, Value *Row) {
+    auto *RowOffset = Builder.CreateMul(Row, NumCols);
+    Builder.CreateStore(Constant::getNullValue(VecTy), LaneMean);
+    Builder.CreateStore(Constant::getNullValue(VecTy), LaneM2);
+
+    // After the n-th element: mean += (x - mean) / n, M2 += (x - mean_old) * (x - mean)
+    createStripMinedLoop(
+        Builder, NumCols, StripWidth, "LoopMoments",
+        [&](IRBuilder<> &Builder, Value *Col, unsigned Width) {
+          Value *MeanPtr = Width == 1 ? RowMean : LaneMean;
+          Value *M2Ptr = Width == 1 ? RowM2 : LaneM2;
+          Type *StripTy = getStripType(FloatTy, Width);
+          // Every lane of a strip has seen Col / Width + 1 elements
+          auto *Count = Builder.CreateAdd(Builder.CreateUDiv(Col, Builder.getInt64(Width)), Builder.getInt64(1));
+          auto *InvCount = Builder.CreateFDiv(One, Builder.CreateUIToFP(Count, FloatTy));
+          auto *X = createStripLoad(Builder, Input, Builder.CreateAdd(RowOffset, Col), Width);
+          auto *Mean = Builder.CreateLoad(StripTy, MeanPtr);
+          auto *Delta = Builder.CreateFSub(X, Mean);
+          auto *NewMean =
+              Builder.CreateFAdd(Mean, Builder.CreateFMul(Delta, createStripSplat(Builder, InvCount, Width)));
+          auto *M2 = Builder.CreateLoad(StripTy, M2Ptr);
+          Builder.CreateStore(NewMean, MeanPtr);
+          Builder.CreateStore(Builder.CreateFAdd(M2, Builder.CreateFMul(Delta, Builder.CreateFSub(X, NewMean))),
+                              M2Ptr);
+        },
+        [&](IRBuilder<> &Builder) {
+          // Merge lanes of n elements each: merging lane l into the first l
+          // gives mean += delta / (l + 1) and M2 += M2_l + delta^2 * n * l / (l + 1).
+          // Lanes that saw no elements have zero state, so n = 0 needs no guard.
+          auto *LaneCount = Builder.CreateUIToFP(Builder.CreateUDiv(NumCols, Builder.getInt64(StripWidth)), FloatTy);
+          auto *MeanVec = Builder.CreateLoad(VecTy, LaneMean);
+          auto *M2Vec = Builder.CreateLoad(VecTy, LaneM2);
+          Value *Mean = Builder.CreateExtractElement(MeanVec, Builder.getInt64(0));
+          Value *M2 = Builder.CreateExtractElement(M2Vec, Builder.getInt64(0));
+          for (unsigned Lane = 1; Lane < StripWidth; ++Lane) {
+            auto *Delta = Builder.CreateFSub(Builder.CreateExtractElement(MeanVec, Builder.getInt64(Lane)), Mean);
+            Mean = Builder.CreateFAdd(Mean, Builder.CreateFMul(Delta, ConstantFP::get(FloatTy, 1.0 / (Lane + 1))));
+            auto *Weight = Builder.CreateFMul(LaneCount, ConstantFP::get(FloatTy, double(Lane) / (Lane + 1)));
+            M2 = Builder.CreateFAdd(
+                Builder.CreateFAdd(M2, Builder.CreateExtractElement(M2Vec, Builder.getInt64(Lane))),
+                Builder.CreateFMul(Builder.CreateFMul(Delta, Delta), Weight));
+          }
+          Builder.CreateStore(Mean, RowMean);
+          Builder.CreateStore(M2, RowM2);
+        });
+
+    auto *Mean = Builder.CreateLoad(FloatTy, RowMean, "mean");
+    auto *Variance = Builder.CreateFDiv(Builder.CreateLoad(FloatTy, RowM2), Builder.CreateUIToFP(NumCols, FloatTy));
+    auto *InvStdDev = Builder.CreateFDiv(
+        One, Builder.CreateUnaryIntrinsic(Intrinsic::sqrt,
+                                          Builder.CreateFAdd(Variance, ConstantFP::get(FloatTy, Epsilon))),
+        "invStdDev");
+    createStripMinedLoop(
+        Builder, NumCols, StripWidth, "LoopNormalize", [&](IRBuilder<> &Builder, Value *Col, unsigned Width) {
+          auto *Offset = Builder.CreateAdd(RowOffset, Col);
+          auto *X = createStripLoad(Builder, Input, Offset, Width);
+          auto *Normalized = Builder.CreateFMul(Builder.CreateFSub(X, createStripSplat(Builder, Mean, Width)),
+                                                createStripSplat(Builder, InvStdDev, Width));
+          auto *Scaled = Builder.CreateFMul(Normalized, createStripLoad(Builder, Gamma, Col, Width));
+          createStripStore(Builder, Builder.CreateFAdd(Scaled, createStripLoad(Builder, Beta, Col, Width)), Output,
+                           Offset, Width);
+        });
+  });
+
+  Builder.CreateRetVoid();
+
+  return Func;
+}
+
+} // namespace llvm
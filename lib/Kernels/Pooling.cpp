@@ -1,34 +1,15 @@
 #include "Kernels/Pooling.h"
+#include "Kernels/LoopBuilder.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Type.h"
 
-using namespace llvm;
-
-namespace {
-
-// Helper function to create a loop
-void createLoop(IRBuilder<> &Builder, Value *Start, Value *End, const Twine &Name, std::function<void(IRBuilder<> &, Value *)> Body) {
-  Function *Func = Builder.GetInsertBlock()->getParent();
-  BasicBlock *PreheaderBB = Builder.GetInsertBlock();
-  BasicBlock *LoopBB = BasicBlock::Create(Func->getContext(), Name + ".loop", Func);
-  BasicBlock *AfterBB = BasicBlock::Create(Func->getContext(), Name + ".after", Func);
-
-  Builder.CreateCondBr(Builder.CreateICmpULT(Start, End), LoopBB, AfterBB);
-
-  Builder.SetInsertPoint(LoopBB);
-  PHINode *Index = Builder.CreatePHI(Start->getType(), 2, Name + ".index");
-  Index->addIncoming(Start, PreheaderBB);
+#include <limits>
 
-  Body(Builder, Index);
-
-  Value *NextVar = Builder.CreateAdd(Index, ConstantInt::get(Start->getType(), 1), Name + ".nextvar");
-  Index->addIncoming(NextVar, LoopBB);
-  Builder.CreateCondBr(Builder.CreateICmpULT(NextVar, End), LoopBB, AfterBB);
+using namespace llvm;
 
-  Builder.SetInsertPoint(AfterBB);
-}
+namespace llvm {
 
 Function *createMaxPoolingFunction(Module &M, Type *InputTy, Type *OutputTy,
                                    unsigned KernelH, unsigned KernelW, unsigned StrideH, unsigned StrideW) {
@@ -40,20 +21,23 @@ Function *createMaxPoolingFunction(Module &M, Type *InputTy, Type *OutputTy,
 
   auto *Input = Func->getArg(0);
   auto *Output = Func->getArg(1);
+  auto *FloatTy = Type::getFloatTy(M.getContext());
 
   // Get the dimensions of the input and output tensors
   // Assume these are defined somewhere appropriately
   // Placeholder values
-  unsigned InputH = 32, InputW = 32, OutputH = 30, OutputW = 30;
+  unsigned InputH = 32, InputW = 32;
+  unsigned OutputH = (InputH - KernelH) / StrideH + 1, OutputW = (InputW - KernelW) / StrideW + 1;
 
   // Create loops for the output tensor dimensions
   createLoop(Builder, Builder.getInt32(0), Builder.getInt32(OutputH), "OuterLoopY", [&](IRBuilder<> &Builder, Value *OuterLoopY) {
     createLoop(Builder, Builder.getInt32(0), Builder.getInt32(OutputW), "OuterLoopX", [&](IRBuilder<> &Builder, Value *OuterLoopX) {
 
       // Initialize the maximum value to a very small number
-      auto *OutputIdx = Builder.CreateGEP(Output, {OuterLoopY, OuterLoopX});
-      auto *MaxVal = Builder.CreateAlloca(Type::getFloatTy(M.getContext()), nullptr, "maxVal");
-      Builder.CreateStore(ConstantFP::get(Type::getFloatTy(M.getContext()), -std::numeric_limits<float>::infinity()), MaxVal);
+      auto *OutputOffset = Builder.CreateAdd(Builder.CreateMul(OuterLoopY, Builder.getInt32(OutputW)), OuterLoopX);
+      auto *OutputIdx = Builder.CreateGEP(FloatTy, Output, OutputOffset);
+      auto *MaxVal = Builder.CreateAlloca(FloatTy, nullptr, "maxVal");
+      Builder.CreateStore(ConstantFP::get(FloatTy, -std::numeric_limits<float>::infinity()), MaxVal);
 
       // Create loops for the kernel dimensions
       createLoop(Builder, Builder.getInt32(0), Builder.getInt32(KernelH), "InnerLoopY", [&](IRBuilder<> &Builder, Value *InnerLoopY) {
@@ -64,11 +48,12 @@ Function *createMaxPoolingFunction(Module &M, Type *InputTy, Type *OutputTy,
           auto *InputIdxX = Builder.CreateAdd(Builder.CreateMul(OuterLoopX, Builder.getInt32(StrideW)), InnerLoopX);
 
           // Load the input value
-          auto *InputIdx = Builder.CreateGEP(Input, {InputIdxY, InputIdxX});
-          auto *InputVal = Builder.CreateLoad(InputIdx);
+          auto *InputOffset = Builder.CreateAdd(Builder.CreateMul(InputIdxY, Builder.getInt32(InputW)), InputIdxX);
+          auto *InputIdx = Builder.CreateGEP(FloatTy, Input, InputOffset);
+          auto *InputVal = Builder.CreateLoad(FloatTy, InputIdx);
 
           // Update the maximum value
-          auto *CurrentMax = Builder.CreateLoad(MaxVal);
+          auto *CurrentMax = Builder.CreateLoad(FloatTy, MaxVal);
           auto *NewMax = Builder.CreateSelect(Builder.CreateFCmpOGT(InputVal, CurrentMax), InputVal, CurrentMax);
           Builder.CreateStore(NewMax, MaxVal);
 
@@ -76,7 +61,7 @@ Function *createMaxPoolingFunction(Module &M, Type *InputTy, Type *OutputTy,
       });
 
       // Store the maximum value in the output
-      auto *FinalMax = Builder.CreateLoad(MaxVal);
+      auto *FinalMax = Builder.CreateLoad(FloatTy, MaxVal);
       Builder.CreateStore(FinalMax, OutputIdx);
 
     });
@@ -87,4 +72,74 @@ Function *createMaxPoolingFunction(Module &M, Type *InputTy, Type *OutputTy,
   return Func;
 }
 
-} // namespace
+Function *createMaxPoolingFunction(Module &M, const PoolingDims &Dims, unsigned KernelH, unsigned KernelW,
+                                   unsigned StrideH, unsigned StrideW, const Twine &Name, TensorElementType ElemTy) {
+  LLVMContext &Context = M.getContext();
+  auto *FloatTy = Type::getFloatTy(Context);
+  auto *TensorTy = PointerType::getUnqual(getTensorStorageType(Context, ElemTy));
+  auto *Int64Ty = Type::getInt64Ty(Context);
+  auto *FuncTy = FunctionType::get(Type::getVoidTy(Context),
+                                   {TensorTy, TensorTy, Int64Ty, Int64Ty, Int64Ty, Int64Ty}, false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  auto *Input = Func->getArg(0);
+  auto *Output = Func->getArg(1);
+
+  // Take each extent from the shape when it is known, otherwise from the arguments
+  auto *N = getDimValue(Builder, Dims.N, Func->getArg(2));
+  auto *C = getDimValue(Builder, Dims.C, Func->getArg(3));
+  auto *H = getDimValue(Builder, Dims.H, Func->getArg(4));
+  auto *W = getDimValue(Builder, Dims.W, Func->getArg(5));
+
+  auto *OutputH = Builder.CreateAdd(
+      Builder.CreateUDiv(Builder.CreateSub(H, Builder.getInt64(KernelH)), Builder.getInt64(StrideH)),
+      Builder.getInt64(1), "outputH");
+  auto *OutputW = Builder.CreateAdd(
+      Builder.CreateUDiv(Builder.CreateSub(W, Builder.getInt64(KernelW)), Builder.getInt64(StrideW)),
+      Builder.getInt64(1), "outputW");
+
+  auto *MaxVal = Builder.CreateAlloca(FloatTy, nullptr, "maxVal");
+  auto *Zero = Builder.getInt64(0);
+
+  // Every (n, c) plane is pooled independently
+  auto *Planes = Builder.CreateMul(N, C, "planes");
+  createLoop(Builder, Zero, Planes, "LoopPlane", [&](IRBuilder<> &Builder, Value *LoopPlane) {
+    createLoop(Builder, Zero, OutputH, "OuterLoopY", [&](IRBuilder<> &Builder, Value *OuterLoopY) {
+      createLoop(Builder, Zero, OutputW, "OuterLoopX", [&](IRBuilder<> &Builder, Value *OuterLoopX) {
+
+        Builder.CreateStore(ConstantFP::get(FloatTy, -std::numeric_limits<float>::infinity()), MaxVal);
+
+        createLoop(Builder, Zero, Builder.getInt64(KernelH), "InnerLoopY", [&](IRBuilder<> &Builder, Value *InnerLoopY) {
+          createLoop(Builder, Zero, Builder.getInt64(KernelW), "InnerLoopX", [&](IRBuilder<> &Builder, Value *InnerLoopX) {
+
+            auto *InputIdxY = Builder.CreateAdd(Builder.CreateMul(OuterLoopY, Builder.getInt64(StrideH)), InnerLoopY);
+            auto *InputIdxX = Builder.CreateAdd(Builder.CreateMul(OuterLoopX, Builder.getInt64(StrideW)), InnerLoopX);
+            auto *InputOffset = Builder.CreateAdd(
+                Builder.CreateMul(Builder.CreateAdd(Builder.CreateMul(LoopPlane, H), InputIdxY), W), InputIdxX);
+            auto *InputVal = createTensorLoad(Builder, ElemTy, Input, InputOffset);
+
+            auto *CurrentMax = Builder.CreateLoad(FloatTy, MaxVal);
+            auto *NewMax = Builder.CreateSelect(Builder.CreateFCmpOGT(InputVal, CurrentMax), InputVal, CurrentMax);
+            Builder.CreateStore(NewMax, MaxVal);
+
+          });
+        });
+
+        auto *OutputOffset = Builder.CreateAdd(
+            Builder.CreateMul(Builder.CreateAdd(Builder.CreateMul(LoopPlane, OutputH), OuterLoopY), OutputW),
+            OuterLoopX);
+        createTensorStore(Builder, ElemTy, Builder.CreateLoad(FloatTy, MaxVal), Output, OutputOffset);
+
+      });
+    });
+  });
+
+  Builder.CreateRetVoid();
+
+  return Func;
+}
+
+} // namespace llvm
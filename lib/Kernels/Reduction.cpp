@@ -0,0 +1,303 @@
+#include "Kernels/Reduction.h"
+#include "Kernels/LoopBuilder.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Type.h"
+
+#include <functional>
+
+using namespace llvm;
+
+namespace {
+
+/// Offsets into the input, the output and the reduced positions of one
+/// iteration of an axis loop nest.
+struct NestOffsets {
+  Value *In, *Out, *Reduced;
+};
+
+/// Extent and strides of one input axis. OutStride is null for reduced axes
+/// and ReducedStride is null for kept axes.
+struct AxisInfo {
+  Value *Extent, *InStride, *OutStride, *ReducedStride;
+};
+
+/// Emit one loop per axis of \p LoopAxes, outermost first, and call \p Body
+/// with the offsets of the innermost iteration.
+void emitAxisLoops(IRBuilder<> &Builder, ArrayRef<AxisInfo> Info, ArrayRef<unsigned> LoopAxes, NestOffsets Base,
+                   std::function<void(IRBuilder<> &, NestOffsets)> Body) {
+  if (LoopAxes.empty()) {
+    Body(Builder, Base);
+    return;
+  }
+  const AxisInfo &Axis = Info[LoopAxes.front()];
+  createLoop(Builder, Builder.getInt64(0), Axis.Extent, "LoopAxis" + Twine(LoopAxes.front()),
+             [&](IRBuilder<> &Builder, Value *Index) {
+               auto Advance = [&](Value *Offset, Value *Stride) {
+                 return Stride ? Builder.CreateAdd(Offset, Builder.CreateMul(Index, Stride)) : Offset;
+               };
+               NestOffsets Inner{Advance(Base.In, Axis.InStride), Advance(Base.Out, Axis.OutStride),
+                                 Advance(Base.Reduced, Axis.ReducedStride)};
+               emitAxisLoops(Builder, Info, LoopAxes.drop_front(), Inner, Body);
+             });
+}
+
+Value *getIdentity(ReductionKind Kind, Type *StripTy) {
+  switch (Kind) {
+  case ReductionKind::Max:
+  case ReductionKind::ArgMax: return ConstantFP::getInfinity(StripTy, true);
+  case ReductionKind::Min: return ConstantFP::getInfinity(StripTy, false);
+  default: return ConstantFP::get(StripTy, 0.0);
+  }
+}
+
+/// Combine two partial accumulators of the same width.
+Value *emitMerge(IRBuilder<> &Builder, ReductionKind Kind, Value *A, Value *B) {
+  switch (Kind) {
+  case ReductionKind::Max:
+  case ReductionKind::ArgMax: return Builder.CreateMaxNum(A, B);
+  case ReductionKind::Min: return Builder.CreateMinNum(A, B);
+  default: return Builder.CreateFAdd(A, B);
+  }
+}
+
+/// Fold the input strip \p X into the accumulator strip \p Acc.
+Value *emitAccumulate(IRBuilder<> &Builder, ReductionKind Kind, Value *Acc, Value *X) {
+  if (Kind == ReductionKind::L2Norm)
+    return Builder.CreateFAdd(Acc, Builder.CreateFMul(X, X));
+  return emitMerge(Builder, Kind, Acc, X);
+}
+
+/// Combine argmax candidates, preferring the earlier position on ties so the
+/// result is the first occurrence of the maximum.
+std::pair<Value *, Value *> emitArgMaxMerge(IRBuilder<> &Builder, Value *A, Value *AIndex, Value *B,
+                                            Value *BIndex) {
+  auto *Greater = Builder.CreateFCmpOGT(B, A);
+  auto *Earlier = Builder.CreateAnd(Builder.CreateFCmpOEQ(B, A), Builder.CreateICmpSLT(BIndex, AIndex));
+  auto *TakeB = Builder.CreateOr(Greater, Earlier);
+  return {Builder.CreateSelect(TakeB, B, A), Builder.CreateSelect(TakeB, BIndex, AIndex)};
+}
+
+/// Reduce the lanes of \p Vec, and of \p Index for ArgMax, to one element by
+/// repeatedly merging the lower and upper halves.
+std::pair<Value *, Value *> emitTreeReduce(IRBuilder<> &Builder, ReductionKind Kind, Value *Vec, Value *Index) {
+  unsigned Width = cast<FixedVectorType>(Vec->getType())->getNumElements();
+  for (; Width > 1; Width /= 2) {
+    SmallVector<int, 8> Low, High;
+    for (unsigned Lane = 0; Lane < Width / 2; ++Lane) {
+      Low.push_back(Lane);
+      High.push_back(Lane + Width / 2);
+    }
+    auto *VecLow = Builder.CreateShuffleVector(Vec, Low);
+    auto *VecHigh = Builder.CreateShuffleVector(Vec, High);
+    if (Kind == ReductionKind::ArgMax) {
+      std::tie(Vec, Index) = emitArgMaxMerge(Builder, VecLow, Builder.CreateShuffleVector(Index, Low), VecHigh,
+                                             Builder.CreateShuffleVector(Index, High));
+    } else {
+      Vec = emitMerge(Builder, Kind, VecLow, VecHigh);
+    }
+  }
+  return {Builder.CreateExtractElement(Vec, uint64_t(0)),
+          Index ? Builder.CreateExtractElement(Index, uint64_t(0)) : nullptr};
+}
+
+/// \return The positions Base, Base + 1, ... of a Width-lane strip.
+Value *getStripIndices(IRBuilder<> &Builder, Value *Base, unsigned Width) {
+  if (Width == 1)
+    return Base;
+  SmallVector<Constant *, 8> Steps;
+  for (unsigned Lane = 0; Lane < Width; ++Lane)
+    Steps.push_back(Builder.getInt64(Lane));
+  return Builder.CreateAdd(Builder.CreateVectorSplat(Width, Base), ConstantVector::get(Steps));
+}
+
+void storeIndexStrip(IRBuilder<> &Builder, Value *V, Value *Base, Value *Offset, unsigned Width) {
+  auto *Ptr = Builder.CreateGEP(Builder.getInt64Ty(), Base, Offset);
+  if (Width == 1) {
+    Builder.CreateStore(V, Ptr);
+    return;
+  }
+  Builder.CreateAlignedStore(V, Builder.CreateBitCast(Ptr, PointerType::getUnqual(V->getType())), Align(8));
+}
+
+} // namespace
+
+namespace llvm {
+
+StringRef getReductionKindName(ReductionKind Kind) {
+  switch (Kind) {
+  case ReductionKind::Sum: return "sum";
+  case ReductionKind::Mean: return "mean";
+  case ReductionKind::Max: return "max";
+  case ReductionKind::Min: return "min";
+  case ReductionKind::ArgMax: return "argmax";
+  case ReductionKind::L2Norm: return "l2";
+  }
+  llvm_unreachable("unknown reduction kind");
+}
+
+Optional<ReductionKind> parseReductionKind(StringRef Name) {
+  return StringSwitch<Optional<ReductionKind>>(Name)
+      .Case("sum", ReductionKind::Sum)
+      .Case("mean", ReductionKind::Mean)
+      .Case("max", ReductionKind::Max)
+      .Case("min", ReductionKind::Min)
+      .Case("argmax", ReductionKind::ArgMax)
+      .Case("l2", ReductionKind::L2Norm)
+      .Default(None);
+}
+
+Function *createReductionFunction(Module &M, ReductionKind Kind, ArrayRef<int64_t> Shape, ArrayRef<unsigned> Axes,
+                                  bool Partial, const Twine &Name) {
+  assert(!Shape.empty() && !Axes.empty() && "reduction needs a tensor and at least one axis");
+  LLVMContext &Context = M.getContext();
+  auto *FloatTy = Type::getFloatTy(Context);
+  auto *Int64Ty = Type::getInt64Ty(Context);
+  auto *TensorTy = PointerType::getUnqual(FloatTy);
+  auto *IndexTensorTy = PointerType::getUnqual(Int64Ty);
+  auto *FuncTy =
+      FunctionType::get(Type::getVoidTy(Context), {TensorTy, TensorTy, IndexTensorTy, IndexTensorTy}, false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  auto *Input = Func->getArg(0);
+  auto *Output = Func->getArg(1);
+  auto *Indices = Func->getArg(2);
+  auto *ShapeArg = Func->getArg(3);
+  bool IsArgMax = Kind == ReductionKind::ArgMax;
+  unsigned Rank = Shape.size();
+  SmallVector<bool, 8> IsReduced(Rank, false);
+  for (unsigned Axis : Axes) {
+    assert(Axis < Rank && !IsReduced[Axis] && "reduction axes must be distinct and in range");
+    IsReduced[Axis] = true;
+  }
+
+  // Strides of each axis in the input, the output and the reduced positions
+  SmallVector<AxisInfo, 8> Info(Rank);
+  Value *InStride = Builder.getInt64(1), *OutStride = Builder.getInt64(1), *ReducedStride = Builder.getInt64(1);
+  for (unsigned Axis = Rank; Axis-- > 0;) {
+    Value *Extent = Builder.getInt64(Shape[Axis]);
+    if (Shape[Axis] == DynamicDim)
+      Extent = Builder.CreateLoad(Int64Ty, Builder.CreateGEP(Int64Ty, ShapeArg, Builder.getInt64(Axis)));
+    Info[Axis].Extent = Extent;
+    Info[Axis].InStride = InStride;
+    InStride = Builder.CreateMul(InStride, Extent);
+    if (IsReduced[Axis]) {
+      Info[Axis].ReducedStride = ReducedStride;
+      ReducedStride = Builder.CreateMul(ReducedStride, Extent);
+    } else {
+      Info[Axis].OutStride = OutStride;
+      OutStride = Builder.CreateMul(OutStride, Extent);
+    }
+  }
+  auto *InvCount = Builder.CreateFDiv(ConstantFP::get(FloatTy, 1.0), Builder.CreateUIToFP(ReducedStride, FloatTy),
+                                      "invCount");
+
+  SmallVector<unsigned, 8> KeptAxes, ReducedAxes;
+  for (unsigned Axis = 0; Axis < Rank; ++Axis)
+    (IsReduced[Axis] ? ReducedAxes : KeptAxes).push_back(Axis);
+
+  // One accumulator, and one position for ArgMax, per strip width
+  auto *VecTy = FixedVectorType::get(FloatTy, StripWidth);
+  auto *IndexVecTy = FixedVectorType::get(Int64Ty, StripWidth);
+  auto *VecAcc = Builder.CreateAlloca(VecTy, nullptr, "laneAcc");
+  auto *ScalarAcc = Builder.CreateAlloca(FloatTy, nullptr, "acc");
+  auto *VecIndex = Builder.CreateAlloca(IndexVecTy, nullptr, "laneIndex");
+  auto *ScalarIndex = Builder.CreateAlloca(Int64Ty, nullptr, "index");
+  auto InitAccumulator = [&](IRBuilder<> &Builder, unsigned Width) {
+    Builder.CreateStore(getIdentity(Kind, getStripType(FloatTy, Width)), Width == 1 ? ScalarAcc : VecAcc);
+    if (IsArgMax)
+      Builder.CreateStore(Constant::getNullValue(Width == 1 ? Int64Ty : static_cast<Type *>(IndexVecTy)),
+                          Width == 1 ? ScalarIndex : VecIndex);
+  };
+  auto Accumulate = [&](IRBuilder<> &Builder, Value *X, Value *Position, unsigned Width) {
+    Value *AccPtr = Width == 1 ? ScalarAcc : VecAcc;
+    auto *Acc = Builder.CreateLoad(X->getType(), AccPtr);
+    if (!IsArgMax) {
+      Builder.CreateStore(emitAccumulate(Builder, Kind, Acc, X), AccPtr);
+      return;
+    }
+    // Within a lane positions only grow, so a strict compare keeps the first maximum
+    Value *IndexPtr = Width == 1 ? ScalarIndex : VecIndex;
+    auto *Greater = Builder.CreateFCmpOGT(X, Acc);
+    Builder.CreateStore(Builder.CreateSelect(Greater, X, Acc), AccPtr);
+    Builder.CreateStore(
+        Builder.CreateSelect(Greater, Position, Builder.CreateLoad(Position->getType(), IndexPtr)), IndexPtr);
+  };
+  auto Finalize = [&](IRBuilder<> &Builder, Value *Result, Value *Position, Value *OutOffset, unsigned Width) {
+    if (!Partial && Kind == ReductionKind::Mean)
+      Result = Builder.CreateFMul(Result, createStripSplat(Builder, InvCount, Width));
+    else if (!Partial && Kind == ReductionKind::L2Norm)
+      Result = Builder.CreateUnaryIntrinsic(Intrinsic::sqrt, Result);
+    createStripStore(Builder, Result, Output, OutOffset, Width);
+    if (IsArgMax)
+      storeIndexStrip(Builder, Position, Indices, OutOffset, Width);
+  };
+
+  auto *Zero = Builder.getInt64(0);
+  NestOffsets Origin{Zero, Zero, Zero};
+  unsigned Innermost = Rank - 1;
+  const AxisInfo &Inner = Info[Innermost];
+
+  if (IsReduced[Innermost]) {
+    // Each output accumulates the innermost axis in vector lanes, then
+    // combines the lanes and the scalar remainder once at the end
+    emitAxisLoops(Builder, Info, KeptAxes, Origin, [&](IRBuilder<> &Builder, NestOffsets Out) {
+      InitAccumulator(Builder, StripWidth);
+      InitAccumulator(Builder, 1);
+      emitAxisLoops(Builder, Info, makeArrayRef(ReducedAxes).drop_back(), Out,
+                    [&](IRBuilder<> &Builder, NestOffsets Row) {
+                      createStripMinedLoop(
+                          Builder, Inner.Extent, StripWidth, "LoopReduce",
+                          [&](IRBuilder<> &Builder, Value *Col, unsigned Width) {
+                            auto *X = createStripLoad(Builder, Input, Builder.CreateAdd(Row.In, Col), Width);
+                            Accumulate(Builder, X, getStripIndices(Builder, Builder.CreateAdd(Row.Reduced, Col), Width),
+                                       Width);
+                          });
+                    });
+
+      Value *Result, *Position;
+      std::tie(Result, Position) = emitTreeReduce(Builder, Kind, Builder.CreateLoad(VecTy, VecAcc),
+                                                   IsArgMax ? Builder.CreateLoad(IndexVecTy, VecIndex) : nullptr);
+      auto *Remainder = Builder.CreateLoad(FloatTy, ScalarAcc);
+      if (IsArgMax)
+        std::tie(Result, Position) =
+            emitArgMaxMerge(Builder, Result, Position, Remainder, Builder.CreateLoad(Int64Ty, ScalarIndex));
+      else
+        Result = emitMerge(Builder, Kind, Result, Remainder);
+      Finalize(Builder, Result, Position, Out.Out, 1);
+    });
+  } else {
+    // A strip of adjacent outputs along the kept innermost axis shares every
+    // load, so the accumulators need no horizontal combine
+    emitAxisLoops(Builder, Info, makeArrayRef(KeptAxes).drop_back(), Origin, [&](IRBuilder<> &Builder,
+                                                                               NestOffsets Out) {
+      createStripMinedLoop(
+          Builder, Inner.Extent, StripWidth, "LoopOutput", [&](IRBuilder<> &Builder, Value *Col, unsigned Width) {
+            InitAccumulator(Builder, Width);
+            NestOffsets Strip{Builder.CreateAdd(Out.In, Col), Builder.CreateAdd(Out.Out, Col), Out.Reduced};
+            emitAxisLoops(Builder, Info, ReducedAxes, Strip, [&](IRBuilder<> &Builder, NestOffsets Element) {
+              auto *X = createStripLoad(Builder, Input, Element.In, Width);
+              Accumulate(Builder, X, createStripSplat(Builder, Element.Reduced, Width), Width);
+            });
+            Type *IndexTy = Width == 1 ? Int64Ty : static_cast<Type *>(IndexVecTy);
+            Finalize(Builder, Builder.CreateLoad(getStripType(FloatTy, Width), Width == 1 ? ScalarAcc : VecAcc),
+                     IsArgMax ? Builder.CreateLoad(IndexTy, Width == 1 ? ScalarIndex : VecIndex) : nullptr,
+                     Strip.Out, Width);
+          });
+    });
+  }
+
+  Builder.CreateRetVoid();
+
+  return Func;
+}
+
+} // namespace llvm
@@ -0,0 +1,403 @@
+#include "Kernels/Sparse.h"
+#include "Kernels/LoopBuilder.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Type.h"
+
+#include <cassert>
+#include <tuple>
+
+using namespace llvm;
+
+namespace {
+
+/// Values shared by every column update of a sparse convolution.
+struct SparseConvState {
+  Value *Input, *Output;
+  Value *C, *H, *W, *K, *OutputH, *OutputW;
+  unsigned StrideH, StrideW, PadH, PadW;
+};
+
+Value *loadIndex(IRBuilder<> &Builder, Value *Array, Value *Index) {
+  auto *Int32Ty = Builder.getInt32Ty();
+  return Builder.CreateSExt(Builder.CreateLoad(Int32Ty, Builder.CreateGEP(Int32Ty, Array, Index)),
+                            Builder.getInt64Ty());
+}
+
+/// Output coordinates [Lo, Hi) whose input coordinate Out * Stride + Tap - Pad
+/// falls inside [0, Extent). Clipping the loop bounds replaces a bounds check
+/// per element and leaves the inner loop free to vectorize.
+std::pair<Value *, Value *> getValidOutputRange(IRBuilder<> &Builder, Value *Extent, Value *OutputExtent,
+                                                Value *Tap, unsigned Stride, unsigned Pad) {
+  auto *Zero = Builder.getInt64(0);
+  auto CeilDiv = [&](Value *Numerator) {
+    return Builder.CreateUDiv(Builder.CreateAdd(Numerator, Builder.getInt64(Stride - 1)), Builder.getInt64(Stride));
+  };
+  Value *Lo = CeilDiv(Builder.CreateBinaryIntrinsic(Intrinsic::smax, Zero,
+                                                    Builder.CreateSub(Builder.getInt64(Pad), Tap)));
+  Value *Hi = CeilDiv(Builder.CreateBinaryIntrinsic(
+      Intrinsic::smax, Zero, Builder.CreateSub(Builder.CreateAdd(Extent, Builder.getInt64(Pad)), Tap)));
+  return {Lo, Builder.CreateBinaryIntrinsic(Intrinsic::smin, Hi, OutputExtent)};
+}
+
+/// Zero \p Count consecutive output planes starting at channel \p FirstK.
+void zeroOutputPlanes(IRBuilder<> &Builder, const SparseConvState &State, Value *LoopN, Value *FirstK,
+                      unsigned Count) {
+  auto *FloatTy = Builder.getFloatTy();
+  auto *PlaneSize = Builder.CreateMul(State.OutputH, State.OutputW);
+  auto *Offset = Builder.CreateMul(Builder.CreateAdd(Builder.CreateMul(LoopN, State.K), FirstK), PlaneSize);
+  auto *Bytes = Builder.CreateMul(PlaneSize, Builder.getInt64(Count * sizeof(float)));
+  Builder.CreateMemSet(Builder.CreateGEP(FloatTy, State.Output, Offset), Builder.getInt8(0), Bytes, Align(4));
+}
+
+/// Accumulate input plane \p Channel, shifted by the filter tap (TapY, TapX),
+/// into output channels FirstK + i scaled by Weights[i]. Null weights are zero
+/// and skipped.
+void emitColumnUpdate(IRBuilder<> &Builder, const SparseConvState &State, Value *LoopN, Value *Channel,
+                      Value *TapY, Value *TapX, Value *FirstK, ArrayRef<Value *> Weights) {
+  auto *FloatTy = Builder.getFloatTy();
+  Value *LoY, *HiY, *LoX, *HiX;
+  std::tie(LoY, HiY) = getValidOutputRange(Builder, State.H, State.OutputH, TapY, State.StrideH, State.PadH);
+  std::tie(LoX, HiX) = getValidOutputRange(Builder, State.W, State.OutputW, TapX, State.StrideW, State.PadW);
+
+  createLoop(Builder, LoY, HiY, "LoopY", [&](IRBuilder<> &Builder, Value *LoopY) {
+    auto *InputIdxY = Builder.CreateSub(Builder.CreateAdd(Builder.CreateMul(LoopY, Builder.getInt64(State.StrideH)),
+                                                          TapY),
+                                        Builder.getInt64(State.PadH));
+    auto *InputRow = Builder.CreateMul(
+        Builder.CreateAdd(Builder.CreateMul(Builder.CreateAdd(Builder.CreateMul(LoopN, State.C), Channel), State.H),
+                          InputIdxY),
+        State.W);
+
+    createLoop(Builder, LoX, HiX, "LoopX", [&](IRBuilder<> &Builder, Value *LoopX) {
+      auto *InputIdxX = Builder.CreateSub(
+          Builder.CreateAdd(Builder.CreateMul(LoopX, Builder.getInt64(State.StrideW)), TapX),
+          Builder.getInt64(State.PadW));
+      auto *InputVal =
+          Builder.CreateLoad(FloatTy, Builder.CreateGEP(FloatTy, State.Input, Builder.CreateAdd(InputRow, InputIdxX)));
+
+      for (unsigned I = 0; I < Weights.size(); ++I) {
+        if (!Weights[I])
+          continue;
+        // output[n][FirstK + i][oy][ox]
+        auto *OutputOffset = Builder.CreateAdd(
+            Builder.CreateMul(
+                Builder.CreateAdd(
+                    Builder.CreateMul(
+                        Builder.CreateAdd(Builder.CreateMul(LoopN, State.K),
+                                          Builder.CreateAdd(FirstK, Builder.getInt64(I))),
+                        State.OutputH),
+                    LoopY),
+                State.OutputW),
+            LoopX);
+        auto *OutputPtr = Builder.CreateGEP(FloatTy, State.Output, OutputOffset);
+        auto *OutputVal = Builder.CreateLoad(FloatTy, OutputPtr);
+        Builder.CreateStore(Builder.CreateFAdd(OutputVal, Builder.CreateFMul(Weights[I], InputVal)), OutputPtr);
+      }
+    });
+  });
+}
+
+/// Compute the output extents of a convolution the way the dense kernel does.
+void setOutputExtents(IRBuilder<> &Builder, SparseConvState &State, Value *R, Value *S) {
+  State.OutputH = Builder.CreateAdd(
+      Builder.CreateUDiv(Builder.CreateSub(Builder.CreateAdd(State.H, Builder.getInt64(2 * State.PadH)), R),
+                         Builder.getInt64(State.StrideH)),
+      Builder.getInt64(1), "outputH");
+  State.OutputW = Builder.CreateAdd(
+      Builder.CreateUDiv(Builder.CreateSub(Builder.CreateAdd(State.W, Builder.getInt64(2 * State.PadW)), S),
+                         Builder.getInt64(State.StrideW)),
+      Builder.getInt64(1), "outputW");
+}
+
+} // namespace
+
+namespace llvm {
+
+SparseMatrix SparseMatrix::fromDense(ArrayRef<float> Dense, int64_t Rows, int64_t Cols, unsigned BlockH,
+                                     unsigned BlockW) {
+  assert(Rows % BlockH == 0 && Cols % BlockW == 0 && "matrix must tile into whole blocks");
+  assert(static_cast<int64_t>(Dense.size()) == Rows * Cols && "dense matrix has the wrong size");
+
+  SparseMatrix Sparse;
+  Sparse.Rows = Rows;
+  Sparse.Cols = Cols;
+  Sparse.BlockH = BlockH;
+  Sparse.BlockW = BlockW;
+  Sparse.RowOffsets.push_back(0);
+
+  for (int64_t BlockRow = 0; BlockRow < Rows / BlockH; ++BlockRow) {
+    for (int64_t BlockCol = 0; BlockCol < Cols / BlockW; ++BlockCol) {
+      auto Element = [&](unsigned I, unsigned J) {
+        return Dense[(BlockRow * BlockH + I) * Cols + BlockCol * BlockW + J];
+      };
+      bool NonZero = false;
+      for (unsigned I = 0; I < BlockH && !NonZero; ++I)
+        for (unsigned J = 0; J < BlockW && !NonZero; ++J)
+          NonZero = Element(I, J) != 0.0f;
+      if (!NonZero)
+        continue;
+
+      Sparse.ColIndices.push_back(BlockCol);
+      for (unsigned I = 0; I < BlockH; ++I)
+        for (unsigned J = 0; J < BlockW; ++J)
+          Sparse.Values.push_back(Element(I, J));
+    }
+    Sparse.RowOffsets.push_back(Sparse.ColIndices.size());
+  }
+
+  return Sparse;
+}
+
+Function *createSparseGemmFunction(Module &M, unsigned BlockH, unsigned BlockW, int64_t N, const Twine &Name) {
+  LLVMContext &Context = M.getContext();
+  auto *FloatTy = Type::getFloatTy(Context);
+  auto *IndexPtrTy = PointerType::getUnqual(Type::getInt32Ty(Context));
+  auto *TensorTy = PointerType::getUnqual(FloatTy);
+  auto *Int64Ty = Type::getInt64Ty(Context);
+  auto *FuncTy = FunctionType::get(Type::getVoidTy(Context),
+                                   {IndexPtrTy, IndexPtrTy, TensorTy, TensorTy, TensorTy, Int64Ty, Int64Ty}, false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  auto *RowOffsets = Func->getArg(0);
+  auto *ColIndices = Func->getArg(1);
+  auto *Values = Func->getArg(2);
+  auto *B = Func->getArg(3);
+  auto *C = Func->getArg(4);
+  auto *BlockRows = Func->getArg(5);
+  auto *Cols = getDimValue(Builder, N, Func->getArg(6));
+  auto *Zero = Builder.getInt64(0);
+
+  createLoop(Builder, Zero, BlockRows, "LoopBlockRow", [&](IRBuilder<> &Builder, Value *LoopBlockRow) {
+    auto *FirstRow = Builder.CreateMul(LoopBlockRow, Builder.getInt64(BlockH));
+    auto *RowBytes = Builder.CreateMul(Cols, Builder.getInt64(BlockH * sizeof(float)));
+    Builder.CreateMemSet(Builder.CreateGEP(FloatTy, C, Builder.CreateMul(FirstRow, Cols)), Builder.getInt8(0),
+                         RowBytes, Align(4));
+
+    auto *Begin = loadIndex(Builder, RowOffsets, LoopBlockRow);
+    auto *End = loadIndex(Builder, RowOffsets, Builder.CreateAdd(LoopBlockRow, Builder.getInt64(1)));
+    createLoop(Builder, Begin, End, "LoopBlock", [&](IRBuilder<> &Builder, Value *LoopBlock) {
+      auto *FirstCol = Builder.CreateMul(loadIndex(Builder, ColIndices, LoopBlock), Builder.getInt64(BlockW));
+
+      // The block's weights stay in registers for the whole row of B
+      SmallVector<Value *, 16> Weights;
+      auto *FirstValue = Builder.CreateMul(LoopBlock, Builder.getInt64(BlockH * BlockW));
+      for (unsigned I = 0; I < BlockH * BlockW; ++I)
+        Weights.push_back(Builder.CreateLoad(
+            FloatTy, Builder.CreateGEP(FloatTy, Values, Builder.CreateAdd(FirstValue, Builder.getInt64(I)))));
+
+      createLoop(Builder, Zero, Cols, "LoopN", [&](IRBuilder<> &Builder, Value *LoopN) {
+        SmallVector<Value *, 4> BVals;
+        for (unsigned J = 0; J < BlockW; ++J) {
+          auto *BOffset = Builder.CreateAdd(Builder.CreateMul(Builder.CreateAdd(FirstCol, Builder.getInt64(J)), Cols),
+                                            LoopN);
+          BVals.push_back(Builder.CreateLoad(FloatTy, Builder.CreateGEP(FloatTy, B, BOffset)));
+        }
+        for (unsigned I = 0; I < BlockH; ++I) {
+          auto *COffset = Builder.CreateAdd(Builder.CreateMul(Builder.CreateAdd(FirstRow, Builder.getInt64(I)), Cols),
+                                            LoopN);
+          auto *CPtr = Builder.CreateGEP(FloatTy, C, COffset);
+          Value *Acc = Builder.CreateLoad(FloatTy, CPtr);
+          for (unsigned J = 0; J < BlockW; ++J)
+            Acc = Builder.CreateFAdd(Acc, Builder.CreateFMul(Weights[I * BlockW + J], BVals[J]));
+          Builder.CreateStore(Acc, CPtr);
+        }
+      });
+    });
+  });
+
+  Builder.CreateRetVoid();
+
+  return Func;
+}
+
+Function *createSparseGemmFunction(Module &M, const SparseMatrix &A, int64_t N, const Twine &Name) {
+  LLVMContext &Context = M.getContext();
+  auto *FloatTy = Type::getFloatTy(Context);
+  auto *TensorTy = PointerType::getUnqual(FloatTy);
+  auto *FuncTy = FunctionType::get(Type::getVoidTy(Context), {TensorTy, TensorTy, Type::getInt64Ty(Context)}, false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  auto *B = Func->getArg(0);
+  auto *C = Func->getArg(1);
+  auto *Cols = getDimValue(Builder, N, Func->getArg(2));
+  auto *Zero = Builder.getInt64(0);
+
+  for (int64_t BlockRow = 0; BlockRow < A.getNumBlockRows(); ++BlockRow) {
+    createLoop(Builder, Zero, Cols, "LoopRow", [&](IRBuilder<> &Builder, Value *LoopN) {
+      SmallVector<Value *, 4> Acc(A.BlockH, ConstantFP::get(FloatTy, 0.0));
+
+      for (int32_t Block = A.RowOffsets[BlockRow]; Block < A.RowOffsets[BlockRow + 1]; ++Block) {
+        const float *BlockValues = &A.Values[Block * A.BlockH * A.BlockW];
+        for (unsigned J = 0; J < A.BlockW; ++J) {
+          int64_t Col = static_cast<int64_t>(A.ColIndices[Block]) * A.BlockW + J;
+          Value *BVal = nullptr;
+          for (unsigned I = 0; I < A.BlockH; ++I) {
+            float Weight = BlockValues[I * A.BlockW + J];
+            if (Weight == 0.0f)
+              continue;
+            if (!BVal)
+              BVal = Builder.CreateLoad(
+                  FloatTy, Builder.CreateGEP(FloatTy, B, Builder.CreateAdd(Builder.CreateMul(Builder.getInt64(Col), Cols),
+                                                                           LoopN)));
+            Acc[I] = Builder.CreateFAdd(Acc[I], Builder.CreateFMul(ConstantFP::get(FloatTy, Weight), BVal));
+          }
+        }
+      }
+
+      for (unsigned I = 0; I < A.BlockH; ++I) {
+        auto *Row = Builder.getInt64(BlockRow * A.BlockH + I);
+        Builder.CreateStore(Acc[I], Builder.CreateGEP(FloatTy, C, Builder.CreateAdd(Builder.CreateMul(Row, Cols), LoopN)));
+      }
+    });
+  }
+
+  Builder.CreateRetVoid();
+
+  return Func;
+}
+
+Function *createSparseConvolutionFunction(Module &M, const ConvolutionDims &Dims, unsigned BlockH, unsigned BlockW,
+                                          unsigned StrideH, unsigned StrideW, unsigned PadH, unsigned PadW,
+                                          const Twine &Name) {
+  LLVMContext &Context = M.getContext();
+  auto *FloatTy = Type::getFloatTy(Context);
+  auto *IndexPtrTy = PointerType::getUnqual(Type::getInt32Ty(Context));
+  auto *TensorTy = PointerType::getUnqual(FloatTy);
+  auto *Int64Ty = Type::getInt64Ty(Context);
+  auto *FuncTy = FunctionType::get(Type::getVoidTy(Context),
+                                   {TensorTy, IndexPtrTy, IndexPtrTy, TensorTy, TensorTy, Int64Ty, Int64Ty, Int64Ty,
+                                    Int64Ty, Int64Ty, Int64Ty, Int64Ty},
+                                   false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  auto *RowOffsets = Func->getArg(1);
+  auto *ColIndices = Func->getArg(2);
+  auto *Values = Func->getArg(3);
+
+  SparseConvState State;
+  State.Input = Func->getArg(0);
+  State.Output = Func->getArg(4);
+  State.StrideH = StrideH, State.StrideW = StrideW, State.PadH = PadH, State.PadW = PadW;
+  auto *N = getDimValue(Builder, Dims.N, Func->getArg(5));
+  State.C = getDimValue(Builder, Dims.C, Func->getArg(6));
+  State.H = getDimValue(Builder, Dims.H, Func->getArg(7));
+  State.W = getDimValue(Builder, Dims.W, Func->getArg(8));
+  State.K = getDimValue(Builder, Dims.K, Func->getArg(9));
+  auto *R = getDimValue(Builder, Dims.R, Func->getArg(10));
+  auto *S = getDimValue(Builder, Dims.S, Func->getArg(11));
+  setOutputExtents(Builder, State, R, S);
+
+  auto *Zero = Builder.getInt64(0);
+  auto *BlockRows = Builder.CreateUDiv(State.K, Builder.getInt64(BlockH), "blockRows");
+
+  createLoop(Builder, Zero, N, "LoopN", [&](IRBuilder<> &Builder, Value *LoopN) {
+    createLoop(Builder, Zero, BlockRows, "LoopBlockRow", [&](IRBuilder<> &Builder, Value *LoopBlockRow) {
+      auto *FirstK = Builder.CreateMul(LoopBlockRow, Builder.getInt64(BlockH));
+      zeroOutputPlanes(Builder, State, LoopN, FirstK, BlockH);
+
+      auto *Begin = loadIndex(Builder, RowOffsets, LoopBlockRow);
+      auto *End = loadIndex(Builder, RowOffsets, Builder.CreateAdd(LoopBlockRow, Builder.getInt64(1)));
+      createLoop(Builder, Begin, End, "LoopBlock", [&](IRBuilder<> &Builder, Value *LoopBlock) {
+        auto *FirstCol = Builder.CreateMul(loadIndex(Builder, ColIndices, LoopBlock), Builder.getInt64(BlockW));
+        auto *FirstValue = Builder.CreateMul(LoopBlock, Builder.getInt64(BlockH * BlockW));
+
+        for (unsigned J = 0; J < BlockW; ++J) {
+          // Column (c * R + r) * S + s holds weight[k][c][r][s]
+          auto *Col = Builder.CreateAdd(FirstCol, Builder.getInt64(J));
+          auto *Channel = Builder.CreateUDiv(Col, Builder.CreateMul(R, S));
+          auto *TapY = Builder.CreateURem(Builder.CreateUDiv(Col, S), R);
+          auto *TapX = Builder.CreateURem(Col, S);
+
+          SmallVector<Value *, 4> Weights;
+          for (unsigned I = 0; I < BlockH; ++I) {
+            auto *Offset = Builder.CreateAdd(FirstValue, Builder.getInt64(I * BlockW + J));
+            Weights.push_back(Builder.CreateLoad(FloatTy, Builder.CreateGEP(FloatTy, Values, Offset)));
+          }
+          emitColumnUpdate(Builder, State, LoopN, Channel, TapY, TapX, FirstK, Weights);
+        }
+      });
+    });
+  });
+
+  Builder.CreateRetVoid();
+
+  return Func;
+}
+
+Function *createSparseConvolutionFunction(Module &M, const ConvolutionDims &Dims, const SparseMatrix &Weights,
+                                          unsigned StrideH, unsigned StrideW, unsigned PadH, unsigned PadW,
+                                          const Twine &Name) {
+  assert(Dims.C != DynamicDim && Dims.R != DynamicDim && Dims.S != DynamicDim &&
+         "weight columns can only be decoded with a known filter shape");
+  assert(Weights.Cols == Dims.C * Dims.R * Dims.S && "weights do not match the filter shape");
+  assert((Dims.K == DynamicDim || Dims.K == Weights.Rows) && "weights do not match the output channels");
+
+  LLVMContext &Context = M.getContext();
+  auto *FloatTy = Type::getFloatTy(Context);
+  auto *TensorTy = PointerType::getUnqual(FloatTy);
+  auto *Int64Ty = Type::getInt64Ty(Context);
+  auto *FuncTy = FunctionType::get(Type::getVoidTy(Context),
+                                   {TensorTy, TensorTy, Int64Ty, Int64Ty, Int64Ty, Int64Ty, Int64Ty, Int64Ty, Int64Ty},
+                                   false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  SparseConvState State;
+  State.Input = Func->getArg(0);
+  State.Output = Func->getArg(1);
+  State.StrideH = StrideH, State.StrideW = StrideW, State.PadH = PadH, State.PadW = PadW;
+  auto *N = getDimValue(Builder, Dims.N, Func->getArg(2));
+  State.C = Builder.getInt64(Dims.C);
+  State.H = getDimValue(Builder, Dims.H, Func->getArg(4));
+  State.W = getDimValue(Builder, Dims.W, Func->getArg(5));
+  State.K = Builder.getInt64(Weights.Rows);
+  setOutputExtents(Builder, State, Builder.getInt64(Dims.R), Builder.getInt64(Dims.S));
+
+  createLoop(Builder, Builder.getInt64(0), N, "LoopN", [&](IRBuilder<> &Builder, Value *LoopN) {
+    for (int64_t BlockRow = 0; BlockRow < Weights.getNumBlockRows(); ++BlockRow) {
+      auto *FirstK = Builder.getInt64(BlockRow * Weights.BlockH);
+      zeroOutputPlanes(Builder, State, LoopN, FirstK, Weights.BlockH);
+
+      for (int32_t Block = Weights.RowOffsets[BlockRow]; Block < Weights.RowOffsets[BlockRow + 1]; ++Block) {
+        const float *BlockValues = &Weights.Values[Block * Weights.BlockH * Weights.BlockW];
+        for (unsigned J = 0; J < Weights.BlockW; ++J) {
+          int64_t Col = static_cast<int64_t>(Weights.ColIndices[Block]) * Weights.BlockW + J;
+
+          SmallVector<Value *, 4> ColumnWeights;
+          bool NonZero = false;
+          for (unsigned I = 0; I < Weights.BlockH; ++I) {
+            float Weight = BlockValues[I * Weights.BlockW + J];
+            ColumnWeights.push_back(Weight == 0.0f ? nullptr : ConstantFP::get(FloatTy, Weight));
+            NonZero |= Weight != 0.0f;
+          }
+          if (!NonZero)
+            continue;
+
+          emitColumnUpdate(Builder, State, LoopN, Builder.getInt64(Col / (Dims.R * Dims.S)),
+                           Builder.getInt64(Col / Dims.S % Dims.R), Builder.getInt64(Col % Dims.S), FirstK,
+                           ColumnWeights);
+        }
+      }
+    }
+  });
+
+  Builder.CreateRetVoid();
+
+  return Func;
+}
+
+} // namespace llvm
@@ -0,0 +1,159 @@
+#include "Kernels/TensorDescriptor.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+
+using namespace llvm;
+
+namespace {
+
+/// Field indices of the TensorDescriptor IR type.
+enum DescriptorField { DataField, RankField, DimsField, StridesField, ElementTypeField };
+
+} // namespace
+
+namespace llvm {
+
+TensorDescriptor TensorDescriptor::getContiguous(void *Data, ArrayRef<int64_t> Dims, TensorElementType ElemTy) {
+  assert(Dims.size() <= MaxTensorRank && "rank too large for a tensor descriptor");
+  TensorDescriptor Desc;
+  Desc.Data = Data;
+  Desc.Rank = Dims.size();
+  Desc.ElementType = static_cast<int64_t>(ElemTy);
+  int64_t Stride = 1;
+  for (unsigned Dim = Dims.size(); Dim-- > 0;) {
+    Desc.Dims[Dim] = Dims[Dim];
+    Desc.Strides[Dim] = Stride;
+    Stride *= Dims[Dim];
+  }
+  return Desc;
+}
+
+StructType *getTensorDescriptorType(LLVMContext &Context) {
+  if (StructType *Existing = StructType::getTypeByName(Context, "TensorDescriptor"))
+    return Existing;
+  auto *Int64Ty = Type::getInt64Ty(Context);
+  auto *ExtentsTy = ArrayType::get(Int64Ty, MaxTensorRank);
+  return StructType::create(Context, {Type::getInt8PtrTy(Context), Int64Ty, ExtentsTy, ExtentsTy, Int64Ty},
+                            "TensorDescriptor");
+}
+
+void addTensorArgumentGuarantees(Function &Kernel, ArrayRef<TensorArgInfo> Tensors) {
+  LLVMContext &Context = Kernel.getContext();
+  const DataLayout &DL = Kernel.getParent()->getDataLayout();
+  IRBuilder<> Builder(&Kernel.getEntryBlock(), Kernel.getEntryBlock().begin());
+
+  for (const TensorArgInfo &Tensor : Tensors) {
+    Argument *Arg = Kernel.getArg(Tensor.ArgNo);
+    assert(Arg->getType()->isPointerTy() && "tensor argument must be a pointer");
+    Kernel.addParamAttr(Tensor.ArgNo, Attribute::NonNull);
+    Kernel.addParamAttr(Tensor.ArgNo, Attribute::NoCapture);
+    Kernel.addParamAttr(Tensor.ArgNo, Attribute::getWithAlignment(Context, Align(Tensor.Alignment)));
+    if (Tensor.NoAlias)
+      Kernel.addParamAttr(Tensor.ArgNo, Attribute::NoAlias);
+    if (Tensor.ReadOnly)
+      Kernel.addParamAttr(Tensor.ArgNo, Attribute::ReadOnly);
+
+    if (!is_contained(Tensor.Dims, DynamicDim)) {
+      uint64_t Bytes = getTensorStorageType(Context, Tensor.ElemTy)->getPrimitiveSizeInBits() / 8;
+      for (int64_t Extent : Tensor.Dims)
+        Bytes *= Extent;
+      Kernel.addDereferenceableParamAttr(Tensor.ArgNo, Bytes);
+    }
+
+    Builder.CreateAlignmentAssumption(DL, Arg, Tensor.Alignment);
+  }
+}
+
+Function *createTensorDescriptorEntry(Module &M, Function &Kernel, ArrayRef<TensorArgInfo> Tensors,
+                                      ArrayRef<ExtentSource> Extents, const Twine &Name) {
+  LLVMContext &Context = M.getContext();
+  auto *DescTy = getTensorDescriptorType(Context);
+  auto *Int32Ty = Type::getInt32Ty(Context);
+  auto *Int64Ty = Type::getInt64Ty(Context);
+  auto *FuncTy = FunctionType::get(Int32Ty, {PointerType::getUnqual(DescTy)}, false);
+  auto *Func = Function::Create(FuncTy, Function::ExternalLinkage, Name, &M);
+  Func->addParamAttr(0, Attribute::NonNull);
+  Func->addParamAttr(0, Attribute::ReadOnly);
+
+  auto *EntryBB = BasicBlock::Create(Context, "entry", Func);
+  IRBuilder<> Builder(EntryBB);
+
+  auto GetField = [&](unsigned Tensor, DescriptorField Field, unsigned Dim = 0) -> Value * {
+    SmallVector<Value *, 4> Indices = {Builder.getInt64(Tensor), Builder.getInt32(Field)};
+    Type *FieldTy = Int64Ty;
+    if (Field == DimsField || Field == StridesField)
+      Indices.push_back(Builder.getInt64(Dim));
+    else if (Field == DataField)
+      FieldTy = Type::getInt8PtrTy(Context);
+    return Builder.CreateLoad(FieldTy, Builder.CreateGEP(DescTy, Func->getArg(0), Indices));
+  };
+
+  SmallVector<Value *, 4> Data, Begins, Ends;
+  for (unsigned I = 0; I < Tensors.size(); ++I) {
+    const TensorArgInfo &Tensor = Tensors[I];
+    assert(Tensor.Dims.size() <= MaxTensorRank && "rank too large for a tensor descriptor");
+    Value *Base = GetField(I, DataField);
+    Value *Address = Builder.CreatePtrToInt(Base, Int64Ty);
+    Value *Valid = Builder.CreateAnd(
+        Builder.CreateICmpEQ(GetField(I, RankField), Builder.getInt64(Tensor.Dims.size())),
+        Builder.CreateICmpEQ(GetField(I, ElementTypeField), Builder.getInt64(static_cast<int64_t>(Tensor.ElemTy))));
+    Valid = Builder.CreateAnd(Valid, Builder.CreateICmpNE(Address, Builder.getInt64(0)));
+    Valid = Builder.CreateAnd(Valid, Builder.CreateICmpEQ(Builder.CreateAnd(Address, Tensor.Alignment - 1),
+                                                          Builder.getInt64(0)));
+
+    // Row-major contiguity: each stride is the product of the inner extents
+    Value *Expected = Builder.getInt64(1);
+    for (unsigned Dim = Tensor.Dims.size(); Dim-- > 0;) {
+      Value *Extent = GetField(I, DimsField, Dim);
+      if (Tensor.Dims[Dim] != DynamicDim)
+        Valid = Builder.CreateAnd(Valid, Builder.CreateICmpEQ(Extent, Builder.getInt64(Tensor.Dims[Dim])));
+      Valid = Builder.CreateAnd(Valid, Builder.CreateICmpEQ(GetField(I, StridesField, Dim), Expected));
+      Expected = Builder.CreateMul(Expected, Extent);
+    }
+
+    // noalias only holds if the byte range of the tensor is disjoint from
+    // every other tensor's; empty ranges never overlap
+    uint64_t ElemBytes = getTensorStorageType(Context, Tensor.ElemTy)->getPrimitiveSizeInBits() / 8;
+    Value *End = Builder.CreateAdd(Address, Builder.CreateMul(Expected, Builder.getInt64(ElemBytes)));
+    for (unsigned J = 0; J < I; ++J) {
+      if (!Tensor.NoAlias && !Tensors[J].NoAlias)
+        continue;
+      Value *Overlaps =
+          Builder.CreateAnd(Builder.CreateICmpULT(Address, Ends[J]), Builder.CreateICmpULT(Begins[J], End));
+      Valid = Builder.CreateAnd(Valid, Builder.CreateNot(Overlaps));
+    }
+    Begins.push_back(Address);
+    Ends.push_back(End);
+
+    auto *MismatchBB = BasicBlock::Create(Context, "mismatch", Func);
+    auto *NextBB = BasicBlock::Create(Context, "valid", Func);
+    Builder.CreateCondBr(Valid, NextBB, MismatchBB);
+    Builder.SetInsertPoint(MismatchBB);
+    Builder.CreateRet(Builder.getInt32(I + 1));
+    Builder.SetInsertPoint(NextBB);
+    Data.push_back(Base);
+  }
+
+  SmallVector<Value *, 8> Args;
+  const ExtentSource *NextExtent = Extents.begin();
+  for (Argument &Param : Kernel.args()) {
+    if (Param.getType()->isPointerTy()) {
+      const auto *Tensor = find_if(Tensors, [&](const TensorArgInfo &T) { return T.ArgNo == Param.getArgNo(); });
+      assert(Tensor != Tensors.end() && "kernel pointer parameter without a tensor");
+      Args.push_back(Builder.CreatePointerCast(Data[Tensor - Tensors.begin()], Param.getType()));
+      continue;
+    }
+    assert(NextExtent != Extents.end() && "kernel extent parameter without a source");
+    Args.push_back(GetField(NextExtent->Tensor, DimsField, NextExtent->Dim));
+    ++NextExtent;
+  }
+  Builder.CreateCall(&Kernel, Args);
+  Builder.CreateRet(Builder.getInt32(0));
+
+  return Func;
+}
+
+} // namespace llvm
@@ -0,0 +1,87 @@
+#include "Kernels/WeightPacking.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
+
+#include <cassert>
+#include <cmath>
+
+using namespace llvm;
+
+namespace llvm {
+
+std::vector<float> packConvolutionWeights(ArrayRef<float> Weights, const ConvolutionDims &Dims, unsigned KBlock) {
+  assert(Dims.K != DynamicDim && Dims.C != DynamicDim && Dims.R != DynamicDim && Dims.S != DynamicDim &&
+         "packing needs the full filter shape");
+  const int64_t K = Dims.K, C = Dims.C, R = Dims.R, S = Dims.S;
+  assert(static_cast<int64_t>(Weights.size()) == K * C * R * S && "weights do not match the filter shape");
+
+  const int64_t Blocks = (K + KBlock - 1) / KBlock;
+  std::vector<float> Packed(Blocks * C * R * S * KBlock, 0.0f);
+  for (int64_t k = 0; k < K; ++k)
+    for (int64_t c = 0; c < C; ++c)
+      for (int64_t r = 0; r < R; ++r)
+        for (int64_t s = 0; s < S; ++s)
+          Packed[(((k / KBlock * C + c) * R + r) * S + s) * KBlock + k % KBlock] = Weights[((k * C + c) * R + r) * S + s];
+  return Packed;
+}
+
+std::vector<float> packGemmWeights(ArrayRef<float> B, int64_t K, int64_t N, unsigned NBlock) {
+  assert(static_cast<int64_t>(B.size()) == K * N && "matrix has the wrong size");
+
+  const int64_t Panels = (N + NBlock - 1) / NBlock;
+  std::vector<float> Packed(Panels * K * NBlock, 0.0f);
+  for (int64_t k = 0; k < K; ++k)
+    for (int64_t n = 0; n < N; ++n)
+      Packed[(n / NBlock * K + k) * NBlock + n % NBlock] = B[k * N + n];
+  return Packed;
+}
+
+std::vector<float> transformWinogradWeights(ArrayRef<float> Weights, int64_t K, int64_t C) {
+  assert(static_cast<int64_t>(Weights.size()) == K * C * 9 && "weights must be KxCx3x3");
+  static const double G[4][3] = {{1.0, 0.0, 0.0}, {0.5, 0.5, 0.5}, {0.5, -0.5, 0.5}, {0.0, 0.0, 1.0}};
+
+  std::vector<float> Transformed(K * C * 16);
+  for (int64_t Filter = 0; Filter < K * C; ++Filter) {
+    const float *g = &Weights[Filter * 9];
+    // U = G g G^T, computed in double so the packed tile rounds only once
+    double Gg[4][3];
+    for (int I = 0; I < 4; ++I)
+      for (int J = 0; J < 3; ++J)
+        Gg[I][J] = G[I][0] * g[J] + G[I][1] * g[3 + J] + G[I][2] * g[6 + J];
+    for (int I = 0; I < 4; ++I)
+      for (int J = 0; J < 4; ++J)
+        Transformed[Filter * 16 + I * 4 + J] = Gg[I][0] * G[J][0] + Gg[I][1] * G[J][1] + Gg[I][2] * G[J][2];
+  }
+  return Transformed;
+}
+
+bool isWinogradEligible(const ConvolutionDims &Dims, unsigned StrideH, unsigned StrideW) {
+  return Dims.R == 3 && Dims.S == 3 && StrideH == 1 && StrideW == 1;
+}
+
+void foldBatchNorm(std::vector<float> &Weights, std::vector<float> &Bias, const BatchNormParams &BatchNorm) {
+  const size_t K = BatchNorm.Gamma.size();
+  assert(BatchNorm.Beta.size() == K && BatchNorm.Mean.size() == K && BatchNorm.Variance.size() == K &&
+         "batch norm parameters differ in size");
+  assert(K && Weights.size() % K == 0 && "weights do not match the channel count");
+  assert((Bias.empty() || Bias.size() == K) && "bias does not match the channel count");
+  Bias.resize(K, 0.0f);
+
+  const size_t FilterSize = Weights.size() / K;
+  for (size_t k = 0; k < K; ++k) {
+    double Scale = BatchNorm.Gamma[k] / std::sqrt(static_cast<double>(BatchNorm.Variance[k]) + BatchNorm.Epsilon);
+    for (size_t I = 0; I < FilterSize; ++I)
+      Weights[k * FilterSize + I] = Weights[k * FilterSize + I] * Scale;
+    Bias[k] = (static_cast<double>(Bias[k]) - BatchNorm.Mean[k]) * Scale + BatchNorm.Beta[k];
+  }
+}
+
+GlobalVariable *createPackedWeightGlobal(Module &M, ArrayRef<float> Packed, const Twine &Name, Align Alignment) {
+  auto *Init = ConstantDataArray::get(M.getContext(), Packed);
+  auto *GV = new GlobalVariable(M, Init->getType(), true, GlobalValue::InternalLinkage, Init, Name);
+  GV->setAlignment(Alignment);
+  GV->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+  return GV;
+}
+
+} // namespace llvm
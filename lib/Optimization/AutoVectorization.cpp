@@ -1,7 +1,17 @@
 #include "Optimization/AutoVectorization.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/DemandedBits.h"
+#include "llvm/Analysis/LoopAccessAnalysis.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
 #include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/LegacyPassManager.h"
@@ -23,22 +33,17 @@ struct AutoVectorizationPass : public FunctionPass {
 
     LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
     ScalarEvolution &SE = getAnalysis<ScalarEvolutionWrapperPass>().getSE();
-    TargetTransformInfo &TTI = getAnalysis<TargetTransformInfoWrapperPass>().getTTI(F);
-    DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
 
-    bool Changed = false;
-
-    for (auto *Loop : LI) {
-      if (!Loop->getSubLoops().empty() || !Loop->isLoopSimplifyForm())
-        continue;
-
-      if (canVectorizeLoop(Loop, SE, TTI, DT)) {
-        vectorizeLoop(Loop, SE, TTI, DT);
-        Changed = true;
-      }
-    }
+    // The vectorizer walks every loop of the function itself, so run it once
+    // if any loop qualifies rather than once per loop: a run restructures the
+    // CFG and leaves LI stale.
+    bool HasCandidate = any_of(LI, [&](Loop *L) {
+      return L->getSubLoops().empty() && L->isLoopSimplifyForm() && canVectorizeLoop(L, SE);
+    });
+    if (!HasCandidate)
+      return false;
 
-    return Changed;
+    return vectorizeLoops(F, LI, SE);
   }
 
   void getAnalysisUsage(AnalysisUsage &AU) const override {
@@ -46,13 +51,17 @@ struct AutoVectorizationPass : public FunctionPass {
     AU.addRequired<ScalarEvolutionWrapperPass>();
     AU.addRequired<TargetTransformInfoWrapperPass>();
     AU.addRequired<DominatorTreeWrapperPass>();
-    AU.addPreserved<LoopInfoWrapperPass>();
-    AU.addPreserved<ScalarEvolutionWrapperPass>();
-    AU.addPreserved<DominatorTreeWrapperPass>();
+    AU.addRequired<BlockFrequencyInfoWrapperPass>();
+    AU.addRequired<AAResultsWrapperPass>();
+    AU.addRequired<AssumptionCacheTracker>();
+    AU.addRequired<LoopAccessLegacyAnalysis>();
+    AU.addRequired<DemandedBitsWrapperPass>();
+    AU.addRequired<OptimizationRemarkEmitterWrapperPass>();
+    AU.addRequired<ProfileSummaryInfoWrapperPass>();
   }
 
 private:
-  bool canVectorizeLoop(Loop *L, ScalarEvolution &SE, TargetTransformInfo &TTI, DominatorTree &DT) {
+  bool canVectorizeLoop(Loop *L, ScalarEvolution &SE) {
     // Check if the loop has a single block and a single backedge
     if (!L->getExitingBlock() || !L->getLoopLatch())
       return false;
@@ -75,22 +84,27 @@ private:
     return true;
   }
 
-  void vectorizeLoop(Loop *L, ScalarEvolution &SE, TargetTransformInfo &TTI, DominatorTree &DT) {
-    // Setup the LoopVectorizePass
-    LoopVectorizePass LVP;
-
-    // Create a dummy FunctionAnalysisManager
-    FunctionAnalysisManager FAM;
+  bool vectorizeLoops(Function &F, LoopInfo &LI, ScalarEvolution &SE) {
+    // Drive the LoopVectorizePass implementation with this pass manager's
+    // analyses, so it sees the target's TTI rather than a generic one.
+    auto &TTI = getAnalysis<TargetTransformInfoWrapperPass>().getTTI(F);
+    auto &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+    auto &BFI = getAnalysis<BlockFrequencyInfoWrapperPass>().getBFI();
+    auto *TLIP = getAnalysisIfAvailable<TargetLibraryInfoWrapperPass>();
+    auto *TLI = TLIP ? &TLIP->getTLI(F) : nullptr;
+    auto &AA = getAnalysis<AAResultsWrapperPass>().getAAResults();
+    auto &AC = getAnalysis<AssumptionCacheTracker>().getAssumptionCache(F);
+    auto &LAA = getAnalysis<LoopAccessLegacyAnalysis>();
+    auto &DB = getAnalysis<DemandedBitsWrapperPass>().getDemandedBits();
+    auto &ORE = getAnalysis<OptimizationRemarkEmitterWrapperPass>().getORE();
+    auto *PSI = &getAnalysis<ProfileSummaryInfoWrapperPass>().getPSI();
+
+    std::function<const LoopAccessInfo &(Loop &)> GetLAA = [&](Loop &L) -> const LoopAccessInfo & {
+      return LAA.getInfo(&L);
+    };
 
-    // Register required analyses
-    FAM.registerPass([&] { return LoopAnalysis(); });
-    FAM.registerPass([&] { return ScalarEvolutionAnalysis(); });
-    FAM.registerPass([&] { return TargetIRAnalysis(); });
-    FAM.registerPass([&] { return DominatorTreeAnalysis(); });
-
-    // Run the LoopVectorizePass on the function containing the loop
-    Function &F = *L->getHeader()->getParent();
-    LVP.run(F, FAM);
+    LoopVectorizePass LVP;
+    return LVP.runImpl(F, SE, LI, TTI, DT, BFI, TLI, DB, AA, AC, GetLAA, ORE, PSI).MadeAnyChange;
   }
 };
 
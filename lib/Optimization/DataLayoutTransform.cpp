@@ -1,4 +1,5 @@
 #include "Optimization/DataLayoutTransform.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/LegacyPassManager.h"
@@ -18,21 +19,19 @@ struct DataLayoutTransformPass : public FunctionPass {
     if (F.isDeclaration())
       return false;
 
-    bool Changed = false;
+    // Collect the allocas first: rewriting one erases it from its block,
+    // which would invalidate an iterator over that block.
+    SmallVector<AllocaInst *, 8> Worklist;
+    for (auto &BB : F)
+      for (auto &I : BB)
+        if (auto *Alloca = dyn_cast<AllocaInst>(&I))
+          if (!Alloca->isArrayAllocation() && isPaddingRequired(Alloca->getAllocatedType()))
+            Worklist.push_back(Alloca);
 
-    for (auto &BB : F) {
-      for (auto &I : BB) {
-        if (auto *Alloca = dyn_cast<AllocaInst>(&I)) {
-          Type *AllocatedType = Alloca->getAllocatedType();
-          if (isPaddingRequired(AllocatedType)) {
-            transformAllocaWithPadding(Alloca);
-            Changed = true;
-          }
-        }
-      }
-    }
+    for (auto *Alloca : Worklist)
+      transformAllocaWithPadding(Alloca);
 
-    return Changed;
+    return !Worklist.empty();
   }
 
 private:
@@ -50,6 +49,7 @@ private:
     // Create a new alloca with the padded size
     Type *PaddedType = ArrayType::get(Builder.getInt8Ty(), PaddedSize);
     AllocaInst *PaddedAlloca = Builder.CreateAlloca(PaddedType, nullptr, Alloca->getName() + ".padded");
+    PaddedAlloca->setAlignment(std::max(Alloca->getAlign(), Align(8)));
 
     // Replace all uses of the original alloca with the padded alloca
     Alloca->replaceAllUsesWith(Builder.CreateBitCast(PaddedAlloca, Alloca->getType()));
@@ -0,0 +1,234 @@
+#include "Optimization/KernelProfiling.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+using namespace llvm;
+
+namespace {
+
+// Field indices of the KernelProfileSite struct in Runtime/KernelProfiler.h
+enum SiteField { SiteKernel, SiteRegion, SiteCalls, SiteCycles, SiteTrips, SiteBytes, SiteNext };
+
+struct KernelProfilingPass : public ModulePass {
+  static char ID;
+  KernelProfilingPass() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override {
+    SmallVector<Function *, 8> Kernels;
+    for (auto &F : M)
+      if (!F.isDeclaration() && !F.hasLocalLinkage())
+        Kernels.push_back(&F);
+    if (Kernels.empty())
+      return false;
+
+    LLVMContext &Context = M.getContext();
+    auto *Int8PtrTy = Type::getInt8PtrTy(Context);
+    auto *Int64Ty = Type::getInt64Ty(Context);
+    SiteTy = StructType::get(Context, {Int8PtrTy, Int8PtrTy, Int64Ty, Int64Ty, Int64Ty, Int64Ty, Int8PtrTy});
+    Sites.clear();
+
+    for (auto *F : Kernels) {
+      DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>(*F).getDomTree();
+      LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>(*F).getLoopInfo();
+      instrumentKernel(M, *F, DT, LI);
+    }
+
+    emitRegistration(M);
+    return true;
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<LoopInfoWrapperPass>();
+  }
+
+private:
+  StructType *SiteTy = nullptr;
+  SmallVector<GlobalVariable *, 16> Sites;
+
+  /// Whether \p Ptr addresses a stack slot, such as an accumulator, which
+  /// lives in registers or L1 after promotion and never reaches memory.
+  static bool isStackAccess(const Value *Ptr) { return isa<AllocaInst>(getUnderlyingObject(Ptr)); }
+
+  /// Bytes loaded or stored by one execution of \p BB, excluding stack slots.
+  uint64_t getBytesTouched(BasicBlock &BB, const DataLayout &DL) {
+    uint64_t Bytes = 0;
+    for (auto &I : BB) {
+      if (auto *Load = dyn_cast<LoadInst>(&I)) {
+        if (!isStackAccess(Load->getPointerOperand()))
+          Bytes += DL.getTypeStoreSize(Load->getType());
+      } else if (auto *Store = dyn_cast<StoreInst>(&I)) {
+        if (!isStackAccess(Store->getPointerOperand()))
+          Bytes += DL.getTypeStoreSize(Store->getValueOperand()->getType());
+      } else if (auto *Transfer = dyn_cast<MemTransferInst>(&I)) {
+        if (auto *Length = dyn_cast<ConstantInt>(Transfer->getLength()))
+          Bytes += (!isStackAccess(Transfer->getSource()) + !isStackAccess(Transfer->getDest())) *
+                   Length->getZExtValue();
+      } else if (auto *Set = dyn_cast<MemSetInst>(&I)) {
+        if (auto *Length = dyn_cast<ConstantInt>(Set->getLength()))
+          if (!isStackAccess(Set->getDest()))
+            Bytes += Length->getZExtValue();
+      }
+    }
+    return Bytes;
+  }
+
+  Constant *createString(Module &M, StringRef Str) {
+    auto *Init = ConstantDataArray::getString(M.getContext(), Str);
+    auto *GV = new GlobalVariable(M, Init->getType(), true, GlobalValue::PrivateLinkage, Init, "__dlopt_prof_name");
+    GV->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+    return ConstantExpr::getPointerCast(GV, Type::getInt8PtrTy(M.getContext()));
+  }
+
+  GlobalVariable *createSite(Module &M, StringRef Kernel, StringRef Region) {
+    auto *Int64Ty = Type::getInt64Ty(M.getContext());
+    auto *Zero = ConstantInt::get(Int64Ty, 0);
+    auto *Init = ConstantStruct::get(SiteTy, {createString(M, Kernel), createString(M, Region), Zero, Zero, Zero, Zero,
+                                              ConstantPointerNull::get(Type::getInt8PtrTy(M.getContext()))});
+    auto *Site = new GlobalVariable(M, SiteTy, false, GlobalValue::PrivateLinkage, Init, "__dlopt_prof_site");
+    Site->setAlignment(Align(8));
+    Sites.push_back(Site);
+    return Site;
+  }
+
+  /// Add \p Amount to a local counter. Locals are promoted to registers by mem2reg.
+  void incrementLocal(IRBuilder<> &Builder, AllocaInst *Counter, uint64_t Amount) {
+    auto *Int64Ty = Builder.getInt64Ty();
+    Builder.CreateStore(Builder.CreateAdd(Builder.CreateLoad(Int64Ty, Counter), Builder.getInt64(Amount)), Counter);
+  }
+
+  /// Atomically publish a region's counters into its site.
+  void flushSite(IRBuilder<> &Builder, GlobalVariable *Site, Value *StartCycles, AllocaInst *Trips,
+                 AllocaInst *Bytes) {
+    auto *Int64Ty = Builder.getInt64Ty();
+    Function *ReadCycles = Intrinsic::getDeclaration(Builder.GetInsertBlock()->getModule(), Intrinsic::readcyclecounter);
+    Value *Cycles = Builder.CreateSub(Builder.CreateCall(ReadCycles), StartCycles);
+
+    auto AddField = [&](SiteField Field, Value *Amount) {
+      Builder.CreateAtomicRMW(AtomicRMWInst::Add, Builder.CreateStructGEP(SiteTy, Site, Field), Amount, MaybeAlign(8),
+                              AtomicOrdering::Monotonic);
+    };
+    AddField(SiteCalls, Builder.getInt64(1));
+    AddField(SiteCycles, Cycles);
+    if (Trips)
+      AddField(SiteTrips, Builder.CreateLoad(Int64Ty, Trips));
+    AddField(SiteBytes, Builder.CreateLoad(Int64Ty, Bytes));
+  }
+
+  void instrumentKernel(Module &M, Function &F, DominatorTree &DT, LoopInfo &LI) {
+    const DataLayout &DL = M.getDataLayout();
+    Function *ReadCycles = Intrinsic::getDeclaration(&M, Intrinsic::readcyclecounter);
+
+    // Measure memory traffic before any instrumentation is added
+    DenseMap<BasicBlock *, uint64_t> BlockBytes;
+    for (auto &BB : F)
+      if (uint64_t Bytes = getBytesTouched(BB, DL))
+        BlockBytes[&BB] = Bytes;
+
+    SmallVector<Loop *, 4> TopLevelLoops(LI.begin(), LI.end());
+    for (auto *L : TopLevelLoops) {
+      if (!L->getLoopPreheader())
+        InsertPreheaderForLoop(L, &DT, &LI, nullptr, false);
+      formDedicatedExitBlocks(L, &DT, &LI, nullptr, false);
+    }
+
+    IRBuilder<> Builder(&*F.getEntryBlock().getFirstInsertionPt());
+    auto *Int64Ty = Builder.getInt64Ty();
+    Value *KernelStart = Builder.CreateCall(ReadCycles, {}, "prof.start");
+    AllocaInst *KernelBytes = Builder.CreateAlloca(Int64Ty, nullptr, "prof.bytes");
+    Builder.CreateStore(Builder.getInt64(0), KernelBytes);
+    GlobalVariable *KernelSite = createSite(M, F.getName(), "kernel");
+
+    // Counters are bumped right before each terminator so that the entry block's
+    // own traffic is counted after the counters are initialized
+    for (auto &Entry : BlockBytes) {
+      Builder.SetInsertPoint(Entry.first->getTerminator());
+      incrementLocal(Builder, KernelBytes, Entry.second);
+    }
+
+    unsigned LoopIndex = 0;
+    for (auto *L : TopLevelLoops) {
+      std::string Region = ("loop." + Twine(LoopIndex++) + " " + L->getHeader()->getName()).str();
+      GlobalVariable *LoopSite = createSite(M, F.getName(), Region);
+
+      Builder.SetInsertPoint(&*F.getEntryBlock().getFirstInsertionPt());
+      AllocaInst *LoopTrips = Builder.CreateAlloca(Int64Ty, nullptr, "prof.trips");
+      AllocaInst *LoopBytes = Builder.CreateAlloca(Int64Ty, nullptr, "prof.loop.bytes");
+
+      Builder.SetInsertPoint(L->getLoopPreheader()->getTerminator());
+      Builder.CreateStore(Builder.getInt64(0), LoopTrips);
+      Builder.CreateStore(Builder.getInt64(0), LoopBytes);
+      Value *LoopStart = Builder.CreateCall(ReadCycles, {}, "prof.loop.start");
+
+      Builder.SetInsertPoint(L->getHeader()->getTerminator());
+      incrementLocal(Builder, LoopTrips, 1);
+      for (auto *BB : L->blocks()) {
+        auto It = BlockBytes.find(BB);
+        if (It == BlockBytes.end())
+          continue;
+        Builder.SetInsertPoint(BB->getTerminator());
+        incrementLocal(Builder, LoopBytes, It->second);
+      }
+
+      SmallVector<BasicBlock *, 4> ExitBlocks;
+      L->getExitBlocks(ExitBlocks);
+      for (auto *Exit : ExitBlocks) {
+        Builder.SetInsertPoint(&*Exit->getFirstInsertionPt());
+        flushSite(Builder, LoopSite, LoopStart, LoopTrips, LoopBytes);
+      }
+    }
+
+    for (auto &BB : F) {
+      if (auto *Ret = dyn_cast<ReturnInst>(BB.getTerminator())) {
+        Builder.SetInsertPoint(Ret);
+        flushSite(Builder, KernelSite, KernelStart, nullptr, KernelBytes);
+      }
+    }
+  }
+
+  /// Create an internal function \p Name that passes every site to the runtime
+  /// entry point \p Callee.
+  Function *createSiteVisitor(Module &M, StringRef Name, StringRef Callee) {
+    LLVMContext &Context = M.getContext();
+    auto *Int8PtrTy = Type::getInt8PtrTy(Context);
+    FunctionCallee Visit = M.getOrInsertFunction(Callee, Type::getVoidTy(Context), Int8PtrTy);
+
+    auto *F = Function::Create(FunctionType::get(Type::getVoidTy(Context), false), GlobalValue::InternalLinkage,
+                               Name, &M);
+    IRBuilder<> Builder(BasicBlock::Create(Context, "entry", F));
+    for (auto *Site : Sites)
+      Builder.CreateCall(Visit, {Builder.CreatePointerCast(Site, Int8PtrTy)});
+    Builder.CreateRetVoid();
+    return F;
+  }
+
+  /// Register every site with the runtime from a module constructor, and
+  /// unregister it from a destructor before the code holding it is freed.
+  void emitRegistration(Module &M) {
+    appendToGlobalCtors(M, createSiteVisitor(M, "__dlopt_prof_init", "__dlopt_prof_register"), 0);
+    appendToGlobalDtors(M, createSiteVisitor(M, "__dlopt_prof_fini", "__dlopt_prof_unregister"), 0);
+  }
+};
+
+} // end anonymous namespace
+
+char KernelProfilingPass::ID = 0;
+static RegisterPass<KernelProfilingPass> X("kernel-profiling", "Kernel Profiling Instrumentation Pass",
+                                           false /* Only looks at CFG */,
+                                           false /* Analysis Pass */);
+
+namespace llvm {
+ModulePass *createKernelProfilingPass() { return new KernelProfilingPass(); }
+} // namespace llvm
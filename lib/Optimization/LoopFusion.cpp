@@ -22,7 +22,7 @@ struct LoopFusionPass : public FunctionPass {
     bool Changed = false;
 
     for (auto &L : LI) {
-      if (L->empty() || L->getSubLoops().size() != 1)
+      if (L->isInnermost() || L->getSubLoops().size() != 1)
         continue;
 
       Loop *InnerLoop = L->getSubLoops()[0];
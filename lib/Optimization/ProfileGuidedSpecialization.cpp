@@ -0,0 +1,142 @@
+#include "Optimization/ProfileGuidedSpecialization.h"
+#include "Kernels/WeightPacking.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace llvm;
+
+namespace {
+
+struct ProfileGuidedSpecializationPass : public ModulePass {
+  static char ID;
+  ProfileGuidedSpecializationPass(const KernelProfileData &Profile = KernelProfileData(),
+                                  const ProfileGuidedConfig &Config = ProfileGuidedConfig())
+      : ModulePass(ID), Profile(Profile), Config(Config) {}
+
+  bool runOnModule(Module &M) override {
+    bool Changed = false;
+    for (auto &F : M) {
+      if (F.isDeclaration() || F.hasLocalLinkage())
+        continue;
+      LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>(F).getLoopInfo();
+      // Same numbering as the profiling pass, which names regions in LoopInfo order
+      unsigned LoopIndex = 0;
+      for (Loop *L : SmallVector<Loop *, 4>(LI.begin(), LI.end())) {
+        std::string Region = ("loop." + Twine(LoopIndex++) + " " + L->getHeader()->getName()).str();
+        if (const RegionProfile *Counters = Profile.getRegion(F.getName(), Region))
+          Changed |= applyProfile(L, *Counters);
+      }
+    }
+    return Changed;
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+private:
+  KernelProfileData Profile;
+  ProfileGuidedConfig Config;
+
+  bool applyProfile(Loop *L, const RegionProfile &Counters) {
+    if (!Counters.Calls || Counters.Trips < Counters.Calls)
+      return false;
+
+    // Trips counts header executions. A header that tests the bound runs once
+    // more than the body on every entry.
+    BasicBlock *Header = L->getHeader();
+    bool HeaderTested = L->isLoopExiting(Header) && L->getLoopLatch() != Header;
+    double Iterations = Counters.getTripsPerCall() - (HeaderTested ? 1.0 : 0.0);
+
+    if (BasicBlock *Exiting = L->getExitingBlock())
+      setExitWeights(L, Exiting, Counters.Trips - Counters.Calls, Counters.Calls);
+
+    ProfiledLoopHints Hints = getProfiledLoopHints(Iterations, L->isInnermost(), Config);
+    if (Hints.UnrollCount)
+      addStringMetadataToLoop(L, "llvm.loop.unroll.count", Hints.UnrollCount);
+    if (Hints.VectorWidth) {
+      addStringMetadataToLoop(L, "llvm.loop.vectorize.width", Hints.VectorWidth);
+      addStringMetadataToLoop(L, "llvm.loop.vectorize.enable", Hints.VectorWidth > 1);
+    }
+    if (Hints.InterleaveCount)
+      addStringMetadataToLoop(L, "llvm.loop.interleave.count", Hints.InterleaveCount);
+    return true;
+  }
+
+  /// Weight the branch leaving \p L from \p Exiting by the profiled counts.
+  void setExitWeights(Loop *L, BasicBlock *Exiting, uint64_t Stay, uint64_t Leave) {
+    auto *Branch = dyn_cast<BranchInst>(Exiting->getTerminator());
+    if (!Branch || !Branch->isConditional())
+      return;
+    while (std::max(Stay, Leave) > UINT32_MAX) {
+      Stay >>= 1;
+      Leave = std::max<uint64_t>(Leave >> 1, 1);
+    }
+    bool StayOnTrue = L->contains(Branch->getSuccessor(0));
+    MDBuilder MDB(Branch->getContext());
+    Branch->setMetadata(LLVMContext::MD_prof, StayOnTrue ? MDB.createBranchWeights(Stay, Leave)
+                                                         : MDB.createBranchWeights(Leave, Stay));
+  }
+};
+
+} // end anonymous namespace
+
+char ProfileGuidedSpecializationPass::ID = 0;
+static RegisterPass<ProfileGuidedSpecializationPass> X("profile-guided", "Profile-Guided Specialization Pass",
+                                                       false /* Only looks at CFG */,
+                                                       false /* Analysis Pass */);
+
+namespace llvm {
+
+ProfiledLoopHints getProfiledLoopHints(double Iterations, bool Innermost, const ProfileGuidedConfig &Config) {
+  ProfiledLoopHints Hints;
+  if (Iterations < 1.0)
+    return Hints;
+
+  // Short loops gain nothing from vector code and its remainder loop
+  if (Iterations <= Config.SmallLoopIterations) {
+    Hints.UnrollCount = std::max(1u, static_cast<unsigned>(std::lround(Iterations)));
+    if (Innermost)
+      Hints.VectorWidth = Hints.InterleaveCount = 1;
+    return Hints;
+  }
+
+  if (Innermost) {
+    Hints.VectorWidth = PowerOf2Floor(std::min<uint64_t>(Iterations, std::max(1u, Config.MaxVectorWidth)));
+    // Interleave only when each interleaved copy still runs several vector iterations
+    uint64_t Copies = static_cast<uint64_t>(Iterations / (Hints.VectorWidth * 8.0));
+    Hints.InterleaveCount = std::min<uint64_t>(std::max<uint64_t>(PowerOf2Floor(Copies), 1), Config.MaxInterleave);
+  }
+  return Hints;
+}
+
+ConvolutionAlgorithm selectConvolutionAlgorithm(const KernelProfileData &Profile, StringRef DirectKernel,
+                                                StringRef WinogradKernel, const ConvolutionDims &Dims,
+                                                unsigned StrideH, unsigned StrideW) {
+  if (!isWinogradEligible(Dims, StrideH, StrideW))
+    return ConvolutionAlgorithm::Direct;
+  const RegionProfile *Direct = Profile.getRegion(DirectKernel, "kernel");
+  const RegionProfile *Winograd = Profile.getRegion(WinogradKernel, "kernel");
+  if (Direct && Winograd && Direct->Calls && Winograd->Calls)
+    return Direct->getCyclesPerCall() < Winograd->getCyclesPerCall() ? ConvolutionAlgorithm::Direct
+                                                                     : ConvolutionAlgorithm::Winograd;
+  return ConvolutionAlgorithm::Winograd;
+}
+
+ModulePass *createProfileGuidedSpecializationPass(const KernelProfileData &Profile,
+                                                  const ProfileGuidedConfig &Config) {
+  return new ProfileGuidedSpecializationPass(Profile, Config);
+}
+
+} // namespace llvm
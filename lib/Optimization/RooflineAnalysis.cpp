@@ -0,0 +1,279 @@
+#include "Optimization/RooflineAnalysis.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+using namespace llvm;
+
+namespace {
+
+/// Floating-point operations performed by one execution of \p I.
+double getFlops(const Instruction &I) {
+  Type *Ty = I.getType();
+  double Lanes = 1.0;
+  if (auto *VecTy = dyn_cast<FixedVectorType>(Ty))
+    Lanes = VecTy->getNumElements();
+  else if (auto *Cmp = dyn_cast<FCmpInst>(&I))
+    if (auto *VecTy = dyn_cast<FixedVectorType>(Cmp->getOperand(0)->getType()))
+      Lanes = VecTy->getNumElements();
+
+  switch (I.getOpcode()) {
+  case Instruction::FAdd:
+  case Instruction::FSub:
+  case Instruction::FMul:
+  case Instruction::FDiv:
+  case Instruction::FRem:
+  case Instruction::FNeg:
+  case Instruction::FCmp:
+    return Lanes;
+  default:
+    break;
+  }
+
+  if (auto *Intrinsic = dyn_cast<IntrinsicInst>(&I)) {
+    switch (Intrinsic->getIntrinsicID()) {
+    case Intrinsic::fma:
+    case Intrinsic::fmuladd:
+      return 2 * Lanes;
+    case Intrinsic::minnum:
+    case Intrinsic::maxnum:
+    case Intrinsic::minimum:
+    case Intrinsic::maximum:
+    case Intrinsic::sqrt:
+    case Intrinsic::exp:
+    case Intrinsic::log:
+      return Lanes;
+    case Intrinsic::vector_reduce_fadd:
+    case Intrinsic::vector_reduce_fmul:
+    case Intrinsic::vector_reduce_fmax:
+    case Intrinsic::vector_reduce_fmin:
+      if (auto *VecTy = dyn_cast<FixedVectorType>(Intrinsic->getArgOperand(Intrinsic->arg_size() - 1)->getType()))
+        return VecTy->getNumElements();
+      return 1;
+    default:
+      break;
+    }
+  }
+  return 0;
+}
+
+class RooflineEstimator {
+public:
+  RooflineEstimator(LoopInfo &LI, ScalarEvolution &SE, const RooflineConfig &Config)
+      : LI(LI), SE(SE), Config(Config), DL(nullptr) {}
+
+  SmallVector<RooflineEstimate, 4> run(Function &F) {
+    DL = &F.getParent()->getDataLayout();
+    SmallVector<RooflineEstimate, 4> Estimates;
+
+    RooflineEstimate StraightLine;
+    StraightLine.Region = "straight-line";
+    SmallVector<BasicBlock *, 8> StraightLineBlocks;
+    for (auto &BB : F)
+      if (!LI.getLoopFor(&BB))
+        StraightLineBlocks.push_back(&BB);
+    accumulateRegion(StraightLineBlocks, StraightLine);
+    if (StraightLine.Flops || StraightLine.Bytes)
+      Estimates.push_back(StraightLine);
+
+    unsigned LoopIndex = 0;
+    for (auto *L : LI) {
+      RooflineEstimate Nest;
+      Nest.Region = ("loop." + Twine(LoopIndex++) + " " + L->getHeader()->getName()).str();
+      accumulateRegion(L->getBlocks(), Nest);
+      Estimates.push_back(Nest);
+    }
+
+    return Estimates;
+  }
+
+private:
+  LoopInfo &LI;
+  ScalarEvolution &SE;
+  const RooflineConfig &Config;
+  const DataLayout *DL;
+
+  /// Accesses to one object that advance by the same stride in the same loop.
+  /// Interleaved copies left by unrolling or vectorization together cover the
+  /// gaps between them, so their sizes are summed before the stride is applied.
+  struct AccessGroup {
+    double Distinct = 0;
+    uint64_t Bytes = 0;
+    uint64_t Stride = 0;
+  };
+  using GroupKey = std::tuple<const Value *, const Loop *, uint64_t>;
+
+  double getTripCount(Loop *L, bool &Exact) {
+    if (unsigned TripCount = SE.getSmallConstantTripCount(L))
+      return TripCount;
+    Exact = false;
+    if (unsigned MaxTripCount = SE.getSmallConstantMaxTripCount(L))
+      return MaxTripCount;
+    return Config.DefaultTripCount;
+  }
+
+  /// Whether \p S advances with the induction of \p L, as opposed to merely being
+  /// recomputed inside it. Values SCEV cannot see through are assumed to vary.
+  bool variesIn(const SCEV *S, const Loop *L) {
+    return SCEVExprContains(S, [L](const SCEV *Sub) {
+      if (const auto *AddRec = dyn_cast<SCEVAddRecExpr>(Sub))
+        return AddRec->getLoop() == L;
+      if (const auto *Unknown = dyn_cast<SCEVUnknown>(Sub))
+        if (const auto *Inst = dyn_cast<Instruction>(Unknown->getValue()))
+          return L->contains(Inst);
+      return false;
+    });
+  }
+
+  /// Constant byte stride of \p Ptr in \p L, or zero if it has none.
+  uint64_t getStride(Value *Ptr, Loop *L) {
+    const auto *AddRec = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(Ptr));
+    if (!AddRec || AddRec->getLoop() != L)
+      return 0;
+    const auto *Step = dyn_cast<SCEVConstant>(AddRec->getStepRecurrence(SE));
+    return Step ? Step->getAPInt().abs().getLimitedValue() : 0;
+  }
+
+  void accumulateAccess(Instruction &I, Value *Ptr, Type *AccessTy, RooflineEstimate &Estimate,
+                        MapVector<GroupKey, AccessGroup> &Groups) {
+    // Stack slots live in registers or L1 after promotion and never reach memory
+    const Value *Object = getUnderlyingObject(Ptr);
+    if (isa<AllocaInst>(Object))
+      return;
+
+    uint64_t Size = DL->getTypeStoreSize(AccessTy);
+    const SCEV *PtrSCEV = SE.getSCEV(Ptr);
+    double Distinct = 1.0;
+    Loop *InnermostVarying = nullptr;
+    for (Loop *L = LI.getLoopFor(I.getParent()); L; L = L->getParentLoop()) {
+      if (!variesIn(PtrSCEV, L))
+        continue;
+      Distinct *= getTripCount(L, Estimate.Exact);
+      if (!InnermostVarying)
+        InnermostVarying = L;
+    }
+
+    uint64_t Stride = InnermostVarying ? getStride(Ptr, InnermostVarying) : 0;
+    if (!Stride) {
+      Estimate.Bytes += Distinct * Size;
+      return;
+    }
+    AccessGroup &Group = Groups[GroupKey(Object, InnermostVarying, Stride)];
+    Group.Distinct = std::max(Group.Distinct, Distinct);
+    Group.Bytes += Size;
+    Group.Stride = Stride;
+  }
+
+  void accumulateRegion(ArrayRef<BasicBlock *> Blocks, RooflineEstimate &Estimate) {
+    MapVector<GroupKey, AccessGroup> Groups;
+    for (BasicBlock *BB : Blocks) {
+      double Executions = 1.0;
+      for (Loop *L = LI.getLoopFor(BB); L; L = L->getParentLoop())
+        Executions *= getTripCount(L, Estimate.Exact);
+
+      for (auto &I : *BB) {
+        Estimate.Flops += Executions * getFlops(I);
+        if (auto *Load = dyn_cast<LoadInst>(&I))
+          accumulateAccess(I, Load->getPointerOperand(), Load->getType(), Estimate, Groups);
+        else if (auto *Store = dyn_cast<StoreInst>(&I))
+          accumulateAccess(I, Store->getPointerOperand(), Store->getValueOperand()->getType(), Estimate, Groups);
+      }
+    }
+
+    // Accesses further apart than their combined size drag in (part of) a line each
+    for (auto &Entry : Groups) {
+      const AccessGroup &Group = Entry.second;
+      Estimate.Bytes +=
+          Group.Distinct * std::max<double>(Group.Bytes, std::min<uint64_t>(Group.Stride, Config.CacheLineBytes));
+    }
+  }
+};
+
+struct RooflineAnalysisPass : public FunctionPass {
+  static char ID;
+  RooflineAnalysisPass(const RooflineConfig &Config = RooflineConfig()) : FunctionPass(ID), Config(Config) {}
+
+  bool runOnFunction(Function &F) override {
+    Estimates.clear();
+    if (F.isDeclaration())
+      return false;
+
+    LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+    ScalarEvolution &SE = getAnalysis<ScalarEvolutionWrapperPass>().getSE();
+    Estimates = estimateRoofline(F, LI, SE, Config);
+    Kernel = F.getName().str();
+    print(errs(), F.getParent());
+
+    return false;
+  }
+
+  void print(raw_ostream &OS, const Module *) const override {
+    if (!Kernel.empty())
+      printRoofline(OS, Kernel, Estimates, Config);
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.addRequired<ScalarEvolutionWrapperPass>();
+    AU.setPreservesAll();
+  }
+
+private:
+  RooflineConfig Config;
+  std::string Kernel;
+  SmallVector<RooflineEstimate, 4> Estimates;
+};
+
+} // end anonymous namespace
+
+char RooflineAnalysisPass::ID = 0;
+static RegisterPass<RooflineAnalysisPass> X("roofline", "Roofline Analysis Pass",
+                                            true /* Only looks at CFG */,
+                                            true /* Analysis Pass */);
+
+namespace llvm {
+
+SmallVector<RooflineEstimate, 4> estimateRoofline(Function &F, LoopInfo &LI, ScalarEvolution &SE,
+                                                  const RooflineConfig &Config) {
+  return RooflineEstimator(LI, SE, Config).run(F);
+}
+
+void printRoofline(raw_ostream &OS, StringRef Kernel, ArrayRef<RooflineEstimate> Estimates,
+                   const RooflineConfig &Config) {
+  OS << "Roofline for '" << Kernel << "' "
+     << format("(peak %.1f GFLOP/s, %.1f GB/s, ridge %.2f FLOP/B)\n", Config.PeakGFlops, Config.PeakGBps,
+               Config.PeakGFlops / Config.PeakGBps);
+  OS << "  Region                              FLOPs          Bytes   FLOP/B   Bound      Time (us)\n";
+
+  RooflineEstimate Total;
+  Total.Region = "total";
+  auto PrintRow = [&](const RooflineEstimate &Estimate) {
+    OS << format("  %-28s %12.0f %14.0f %8.3f   %-7s %12.3f%s\n", Estimate.Region.c_str(), Estimate.Flops,
+                 Estimate.Bytes, Estimate.getArithmeticIntensity(),
+                 Estimate.isComputeBound(Config) ? "compute" : "memory",
+                 Estimate.getPredictedSeconds(Config) * 1e6, Estimate.Exact ? "" : "  (estimated trip counts)");
+  };
+  for (const RooflineEstimate &Estimate : Estimates) {
+    PrintRow(Estimate);
+    Total.Flops += Estimate.Flops;
+    Total.Bytes += Estimate.Bytes;
+    Total.Exact &= Estimate.Exact;
+  }
+  PrintRow(Total);
+}
+
+FunctionPass *createRooflineAnalysisPass(const RooflineConfig &Config) { return new RooflineAnalysisPass(Config); }
+
+} // namespace llvm
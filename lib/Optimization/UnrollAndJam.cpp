@@ -0,0 +1,211 @@
+#include "Optimization/UnrollAndJam.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/DomTreeUpdater.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Transforms/Utils/LoopSimplify.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
+#include "llvm/Transforms/Utils/UnrollLoop.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+namespace {
+
+struct UnrollAndJamPass : public FunctionPass {
+  static char ID;
+  UnrollAndJamPass(const UnrollAndJamConfig &Config = UnrollAndJamConfig()) : FunctionPass(ID), Config(Config) {}
+
+  bool runOnFunction(Function &F) override {
+    if (F.isDeclaration())
+      return false;
+
+    LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+    ScalarEvolution &SE = getAnalysis<ScalarEvolutionWrapperPass>().getSE();
+    DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+    AssumptionCache &AC = getAnalysis<AssumptionCacheTracker>().getAssumptionCache(F);
+    TargetTransformInfo &TTI = getAnalysis<TargetTransformInfoWrapperPass>().getTTI(F);
+    DependenceInfo &DI = getAnalysis<DependenceAnalysisWrapperPass>().getDI();
+    OptimizationRemarkEmitter ORE(&F);
+
+    // Generated kernels guard every loop and carry their accumulators in
+    // allocas; both hide the nest structure the jam needs
+    bool Changed = foldConstantGuards(F, LI, DT);
+    Changed |= promoteAllocas(F, DT, AC);
+    for (Loop *L : LI) {
+      Changed |= simplifyLoop(L, &DT, &LI, &SE, &AC, nullptr, /*PreserveLCSSA=*/false);
+      Changed |= formLCSSARecursively(*L, DT, &LI, &SE);
+    }
+    Changed |= unrollSmallInnerLoops(LI, SE, DT, AC, TTI, ORE);
+
+    unsigned Registers = TTI.getNumberOfRegisters(TTI.getRegisterClassForType(/*Vector=*/true));
+
+    SmallVector<Loop *, 8> Candidates;
+    for (Loop *L : LI.getLoopsInPreorder())
+      if (L->getSubLoops().size() == 1 && L->getSubLoops()[0]->isInnermost())
+        Candidates.push_back(L);
+    for (Loop *Outer : Candidates)
+      Changed |= unrollAndJam(Outer, Registers, LI, SE, DT, AC, TTI, DI, ORE);
+    return Changed;
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.addRequired<ScalarEvolutionWrapperPass>();
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<AssumptionCacheTracker>();
+    AU.addRequired<TargetTransformInfoWrapperPass>();
+    AU.addRequired<DependenceAnalysisWrapperPass>();
+  }
+
+private:
+  UnrollAndJamConfig Config;
+
+  /// Fold loop guards on constant extents, which createLoop emits as
+  /// `br i1 true`. An edge is only removed when its target stays reachable
+  /// from inside the same loop and is not that loop's header, so LoopInfo is
+  /// unchanged and only the dominator tree needs updating.
+  bool foldConstantGuards(Function &F, LoopInfo &LI, DominatorTree &DT) {
+    DomTreeUpdater DTU(DT, DomTreeUpdater::UpdateStrategy::Eager);
+    bool Changed = false;
+    for (BasicBlock &BB : F) {
+      auto *Branch = dyn_cast<BranchInst>(BB.getTerminator());
+      if (!Branch || !Branch->isConditional() || !isa<ConstantInt>(Branch->getCondition()))
+        continue;
+      bool Taken = cast<ConstantInt>(Branch->getCondition())->isOne();
+      BasicBlock *Live = Branch->getSuccessor(Taken ? 0 : 1);
+      BasicBlock *Dead = Branch->getSuccessor(Taken ? 1 : 0);
+      Loop *L = LI.getLoopFor(&BB);
+      if (Live == Dead || !Dead->hasNPredecessorsOrMore(2) || LI.getLoopFor(Dead) != L || (L && !L->contains(Live)))
+        continue;
+      if (L && (Dead == L->getHeader() ||
+                any_of(predecessors(Dead), [&](BasicBlock *Pred) { return Pred != &BB && !L->contains(Pred); })))
+        continue;
+      Dead->removePredecessor(&BB);
+      BranchInst::Create(Live, Branch);
+      Branch->eraseFromParent();
+      DTU.applyUpdates({{DominatorTree::Delete, &BB, Dead}});
+      Changed = true;
+    }
+    return Changed;
+  }
+
+  bool promoteAllocas(Function &F, DominatorTree &DT, AssumptionCache &AC) {
+    SmallVector<AllocaInst *, 16> Allocas;
+    for (Instruction &I : F.getEntryBlock())
+      if (auto *Alloca = dyn_cast<AllocaInst>(&I))
+        if (isAllocaPromotable(Alloca))
+          Allocas.push_back(Alloca);
+    if (Allocas.empty())
+      return false;
+    PromoteMemToReg(Allocas, DT, &AC);
+    return true;
+  }
+
+  /// Fully unroll innermost loops with a small constant trip count until none
+  /// is left, so that a convolution's filter-tap loops dissolve into the
+  /// channel loop around them. \p Copies tracks how many copies of the
+  /// original innermost body a loop holds, which keeps the channel loop
+  /// itself from being unrolled away.
+  bool unrollSmallInnerLoops(LoopInfo &LI, ScalarEvolution &SE, DominatorTree &DT, AssumptionCache &AC,
+                             TargetTransformInfo &TTI, OptimizationRemarkEmitter &ORE) {
+    DenseMap<Loop *, unsigned> Copies;
+    bool Changed = false, Unrolled = true;
+    while (Unrolled) {
+      Unrolled = false;
+      for (Loop *L : LI.getLoopsInPreorder()) {
+        if (!L->isInnermost())
+          continue;
+        unsigned TripCount = SE.getSmallConstantTripCount(L);
+        unsigned Bodies = std::max(1u, Copies.lookup(L)) * TripCount;
+        if (!TripCount || Bodies > Config.FullUnrollCopies)
+          continue;
+        Loop *Parent = L->getParentLoop();
+        UnrollLoopOptions Options{TripCount, /*Force=*/false, /*Runtime=*/false, /*AllowExpensiveTripCount=*/false,
+                                  /*UnrollRemainder=*/false, /*ForgetAllSCEV=*/false};
+        if (UnrollLoop(L, Options, &LI, &SE, &DT, &AC, &TTI, &ORE, /*PreserveLCSSA=*/true) ==
+            LoopUnrollResult::FullyUnrolled) {
+          Copies.erase(L);
+          if (Parent)
+            Copies[Parent] = std::max(Copies.lookup(Parent), Bodies);
+          // LoopInfo no longer holds L, so restart the walk
+          Changed = Unrolled = true;
+          break;
+        }
+      }
+    }
+    return Changed;
+  }
+
+  bool unrollAndJam(Loop *Outer, unsigned Registers, LoopInfo &LI, ScalarEvolution &SE, DominatorTree &DT,
+                    AssumptionCache &AC, TargetTransformInfo &TTI, DependenceInfo &DI,
+                    OptimizationRemarkEmitter &ORE) {
+    Loop *Inner = Outer->getSubLoops()[0];
+
+    // Loads that only move with the inner loop are what the copies share
+    unsigned SharedLoads = 0, PerCopy = 1;
+    for (BasicBlock *BB : Inner->blocks())
+      for (Instruction &I : *BB)
+        if (auto *Load = dyn_cast<LoadInst>(&I)) {
+          const SCEV *Address = SE.getSCEV(Load->getPointerOperand());
+          bool StepsWithOuter = SCEVExprContains(Address, [Outer](const SCEV *S) {
+            auto *Rec = dyn_cast<SCEVAddRecExpr>(S);
+            return Rec && Rec->getLoop() == Outer;
+          });
+          if (!StepsWithOuter && !SE.isLoopInvariant(Address, Inner))
+            ++SharedLoads;
+        }
+    // Every loop-carried value but the induction variable is a per-copy accumulator
+    for (PHINode &Phi : Inner->getHeader()->phis())
+      if (&Phi != Inner->getInductionVariable(SE))
+        ++PerCopy;
+    if (!SharedLoads)
+      return false;
+
+    unsigned Count = getUnrollAndJamCount(Registers, SharedLoads, PerCopy, Config);
+    unsigned TripCount = SE.getSmallConstantTripCount(Outer);
+    if (TripCount)
+      Count = std::min<unsigned>(Count, PowerOf2Floor(TripCount));
+    if (Count < 2 || !isSafeToUnrollAndJam(Outer, SE, DT, DI, LI))
+      return false;
+
+    unsigned TripMultiple = SE.getSmallConstantTripMultiple(Outer);
+    return UnrollAndJamLoop(Outer, Count, TripCount, TripMultiple, /*UnrollRemainder=*/false, &LI, &SE, &DT, &AC,
+                            &TTI, &ORE) != LoopUnrollResult::Unmodified;
+  }
+};
+
+} // end anonymous namespace
+
+char UnrollAndJamPass::ID = 0;
+static RegisterPass<UnrollAndJamPass> X("unroll-and-jam", "Unroll-and-Jam Pass", false /* Only looks at CFG */,
+                                        false /* Analysis Pass */);
+
+namespace llvm {
+
+unsigned getUnrollAndJamCount(unsigned NumRegisters, unsigned SharedValues, unsigned ValuesPerCopy,
+                              const UnrollAndJamConfig &Config) {
+  if (NumRegisters <= SharedValues)
+    return 1;
+  unsigned Copies = (NumRegisters - SharedValues) / std::max(1u, ValuesPerCopy);
+  return std::max<unsigned>(1, PowerOf2Floor(std::min(Copies, Config.MaxCount)));
+}
+
+FunctionPass *createUnrollAndJamPass(const UnrollAndJamConfig &Config) { return new UnrollAndJamPass(Config); }
+
+} // namespace llvm
@@ -0,0 +1,93 @@
+#include "Runtime/BatchedDispatcher.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace llvm {
+
+BatchedDispatcher::BatchedDispatcher(BatchKernel Kernel, size_t InputSampleSize, size_t OutputSampleSize,
+                                     BatchingOptions Options)
+    : Kernel(std::move(Kernel)), InputSampleSize(InputSampleSize), OutputSampleSize(OutputSampleSize),
+      Options(Options), StagedInput(Options.MaxBatchSize * InputSampleSize),
+      StagedOutput(Options.MaxBatchSize * OutputSampleSize) {
+  assert(Options.MaxBatchSize && "batches need at least one request");
+  Worker = std::thread([this] { runWorker(); });
+}
+
+BatchedDispatcher::~BatchedDispatcher() {
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    ShuttingDown = true;
+  }
+  Arrived.notify_one();
+  Worker.join();
+}
+
+std::future<void> BatchedDispatcher::submit(const void *Input, void *Output) {
+  std::future<void> Done;
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Queue.push_back({{Input, Output}, std::promise<void>(), std::chrono::steady_clock::now()});
+    Done = Queue.back().Done.get_future();
+  }
+  // Wakes the worker to start a batch's delay or to cut it short once full
+  Arrived.notify_one();
+  return Done;
+}
+
+void BatchedDispatcher::runBatched(ArrayRef<InferenceRequest> Requests) {
+  while (!Requests.empty()) {
+    size_t Count = std::min<size_t>(Requests.size(), Options.MaxBatchSize);
+    runBatch(Requests.take_front(Count));
+    Requests = Requests.drop_front(Count);
+  }
+}
+
+void BatchedDispatcher::runWorker() {
+  std::unique_lock<std::mutex> Lock(Mutex);
+  for (;;) {
+    Arrived.wait(Lock, [this] { return ShuttingDown || !Queue.empty(); });
+    if (Queue.empty())
+      return;
+
+    // Hold the batch open until it is full or its oldest request is due.
+    // Shutting down flushes without waiting.
+    auto Deadline = Queue.front().Arrival + Options.MaxQueueDelay;
+    Arrived.wait_until(Lock, Deadline, [this] { return ShuttingDown || Queue.size() >= Options.MaxBatchSize; });
+
+    size_t Count = std::min<size_t>(Queue.size(), Options.MaxBatchSize);
+    std::vector<Pending> Batch(std::make_move_iterator(Queue.begin()),
+                               std::make_move_iterator(Queue.begin() + Count));
+    Queue.erase(Queue.begin(), Queue.begin() + Count);
+    Lock.unlock();
+
+    SmallVector<InferenceRequest, 32> Requests;
+    for (Pending &P : Batch)
+      Requests.push_back(P.Request);
+    runBatch(Requests);
+    for (Pending &P : Batch)
+      P.Done.set_value();
+
+    Lock.lock();
+  }
+}
+
+void BatchedDispatcher::runBatch(ArrayRef<InferenceRequest> Batch) {
+  assert(!Batch.empty() && Batch.size() <= Options.MaxBatchSize && "batch out of range");
+  NumBatches.fetch_add(1, std::memory_order_relaxed);
+  if (Batch.size() == 1) {
+    Kernel(Batch[0].Input, Batch[0].Output, 1);
+    return;
+  }
+
+  std::lock_guard<std::mutex> Lock(StagingMutex);
+  for (size_t I = 0; I < Batch.size(); ++I)
+    std::memcpy(&StagedInput[I * InputSampleSize], Batch[I].Input, InputSampleSize);
+  Kernel(StagedInput.data(), StagedOutput.data(), Batch.size());
+  for (size_t I = 0; I < Batch.size(); ++I)
+    std::memcpy(Batch[I].Output, &StagedOutput[I * OutputSampleSize], OutputSampleSize);
+}
+
+} // namespace llvm
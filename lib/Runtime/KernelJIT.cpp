@@ -0,0 +1,105 @@
+#include "Runtime/KernelJIT.h"
+#include "Optimization/StandardPipeline.h"
+#include "Runtime/KernelProfiler.h"
+#include "Runtime/WeightContainer.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/Mangling.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetMachine.h"
+
+using namespace llvm;
+using namespace llvm::orc;
+
+#if defined(__x86_64__) || defined(__i386__)
+// CPU feature words from libgcc or compiler-rt, read by multiversion resolvers
+extern "C" {
+extern char __cpu_model[];
+void __cpu_indicator_init();
+}
+#endif
+
+namespace llvm {
+
+Error defineKernelRuntimeSymbols(LLJIT &JIT, JITDylib &JD) {
+  MangleAndInterner Mangle(JIT.getExecutionSession(), JIT.getDataLayout());
+  SymbolMap Symbols;
+  Symbols[Mangle("__dlopt_prof_register")] = JITEvaluatedSymbol::fromPointer(&__dlopt_prof_register);
+  Symbols[Mangle("__dlopt_prof_unregister")] = JITEvaluatedSymbol::fromPointer(&__dlopt_prof_unregister);
+#if defined(__x86_64__) || defined(__i386__)
+  Symbols[Mangle("__cpu_model")] = JITEvaluatedSymbol::fromPointer(__cpu_model);
+  Symbols[Mangle("__cpu_indicator_init")] = JITEvaluatedSymbol::fromPointer(&__cpu_indicator_init);
+#endif
+  return JD.define(absoluteSymbols(std::move(Symbols)));
+}
+
+Expected<std::unique_ptr<KernelJIT>> KernelJIT::create(OptimizationLevel Level) {
+  InitializeNativeTarget();
+  InitializeNativeTargetAsmPrinter();
+
+  auto JTMB = JITTargetMachineBuilder::detectHost();
+  if (!JTMB)
+    return JTMB.takeError();
+
+  auto JIT = LLJITBuilder().setJITTargetMachineBuilder(*JTMB).create();
+  if (!JIT)
+    return JIT.takeError();
+
+  // Optimize each module right before it is compiled. Transforms may run on
+  // whichever thread triggers materialization, so each gets its own target machine.
+  (*JIT)->getIRTransformLayer().setTransform(
+      [JTMB = *JTMB, Level](ThreadSafeModule TSM,
+                            const MaterializationResponsibility &) mutable -> Expected<ThreadSafeModule> {
+        auto TM = JTMB.createTargetMachine();
+        if (!TM)
+          return TM.takeError();
+        TSM.withModuleDo([&](Module &M) { runStandardPipeline(M, TM->get(), Level); });
+        return std::move(TSM);
+      });
+
+  // Let kernels call into libm and other symbols of the host process
+  auto ProcessSymbols = DynamicLibrarySearchGenerator::GetForCurrentProcess((*JIT)->getDataLayout().getGlobalPrefix());
+  if (!ProcessSymbols)
+    return ProcessSymbols.takeError();
+  (*JIT)->getMainJITDylib().addGenerator(std::move(*ProcessSymbols));
+
+  if (Error Err = defineKernelRuntimeSymbols(**JIT, (*JIT)->getMainJITDylib()))
+    return std::move(Err);
+
+  return std::unique_ptr<KernelJIT>(new KernelJIT(std::move(*JIT)));
+}
+
+KernelJIT::~KernelJIT() {
+  // Run module destructors, such as profile site unregistration, before the
+  // code and data they refer to are freed
+  if (Error Err = JIT->deinitialize(JIT->getMainJITDylib()))
+    logAllUnhandledErrors(std::move(Err), errs(), "kernel JIT deinitialization failed: ");
+}
+
+Error KernelJIT::addModule(ThreadSafeModule TSM) {
+  TSM.withModuleDo([&](Module &M) {
+    M.setDataLayout(JIT->getDataLayout());
+    M.setTargetTriple(JIT->getTargetTriple().str());
+  });
+  if (Error Err = JIT->addIRModule(std::move(TSM)))
+    return Err;
+  // Run the module's constructors, such as profile site registration, once
+  return JIT->initialize(JIT->getMainJITDylib());
+}
+
+Error KernelJIT::bindWeights(const WeightContainer &Weights) {
+  MangleAndInterner Mangle(JIT->getExecutionSession(), JIT->getDataLayout());
+  SymbolMap Symbols;
+  for (const WeightTensor &Tensor : Weights.tensors())
+    Symbols[Mangle(getWeightSymbolName(Tensor.Name))] =
+        JITEvaluatedSymbol::fromPointer(Tensor.Data, JITSymbolFlags::Exported);
+  return JIT->getMainJITDylib().define(absoluteSymbols(std::move(Symbols)));
+}
+
+Expected<void *> KernelJIT::lookup(StringRef Name) {
+  auto Symbol = JIT->lookup(Name);
+  if (!Symbol)
+    return Symbol.takeError();
+  return reinterpret_cast<void *>(static_cast<uintptr_t>(Symbol->getAddress()));
+}
+
+} // namespace llvm
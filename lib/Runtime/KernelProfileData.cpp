@@ -0,0 +1,161 @@
+#include "Runtime/KernelProfileData.h"
+#include "Runtime/KernelProfiler.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+namespace {
+
+Error makeParseError(unsigned Line, const Twine &Message) {
+  return createStringError(inconvertibleErrorCode(), "invalid kernel profile at line " + Twine(Line) + ": " + Message);
+}
+
+} // namespace
+
+namespace llvm {
+
+void KernelProfileData::recordShape(StringRef Kernel, ArrayRef<int64_t> Dims, uint64_t Count) {
+  Kernels[Kernel].Shapes[std::vector<int64_t>(Dims.begin(), Dims.end())] += Count;
+}
+
+void KernelProfileData::recordRegion(StringRef Kernel, StringRef Region, const RegionProfile &Counters) {
+  RegionProfile &Existing = Kernels[Kernel].Regions[Region];
+  Existing.Calls += Counters.Calls;
+  Existing.Cycles += Counters.Cycles;
+  Existing.Trips += Counters.Trips;
+}
+
+void KernelProfileData::addRuntimeCounters() {
+  for (const KernelProfileSite *Site : getKernelProfileSites()) {
+    RegionProfile Counters;
+    Counters.Calls = Site->Calls.load(std::memory_order_relaxed);
+    Counters.Cycles = Site->Cycles.load(std::memory_order_relaxed);
+    Counters.Trips = Site->Trips.load(std::memory_order_relaxed);
+    if (Counters.Calls)
+      recordRegion(Site->Kernel, Site->Region, Counters);
+  }
+}
+
+void KernelProfileData::merge(const KernelProfileData &Other) {
+  for (const auto &Kernel : Other.Kernels) {
+    for (const auto &Region : Kernel.second.Regions)
+      recordRegion(Kernel.first(), Region.first(), Region.second);
+    for (const auto &Shape : Kernel.second.Shapes)
+      recordShape(Kernel.first(), Shape.first, Shape.second);
+  }
+}
+
+const RegionProfile *KernelProfileData::getRegion(StringRef Kernel, StringRef Region) const {
+  auto KernelIt = Kernels.find(Kernel);
+  if (KernelIt == Kernels.end())
+    return nullptr;
+  auto RegionIt = KernelIt->second.Regions.find(Region);
+  return RegionIt == KernelIt->second.Regions.end() ? nullptr : &RegionIt->second;
+}
+
+std::vector<ShapeCount> KernelProfileData::getHotShapes(StringRef Kernel, double MinFraction) const {
+  std::vector<ShapeCount> Hot;
+  auto It = Kernels.find(Kernel);
+  if (It == Kernels.end())
+    return Hot;
+
+  uint64_t Total = 0;
+  for (const auto &Shape : It->second.Shapes)
+    Total += Shape.second;
+  for (const auto &Shape : It->second.Shapes)
+    if (Shape.second && Shape.second >= MinFraction * Total)
+      Hot.push_back({Shape.first, Shape.second});
+  std::stable_sort(Hot.begin(), Hot.end(), [](const ShapeCount &A, const ShapeCount &B) { return A.Count > B.Count; });
+  return Hot;
+}
+
+void KernelProfileData::print(raw_ostream &OS) const {
+  // Sort by kernel so that the file does not depend on hash order
+  std::vector<StringRef> Names;
+  for (const auto &Kernel : Kernels)
+    Names.push_back(Kernel.first());
+  llvm::sort(Names);
+
+  for (StringRef Name : Names) {
+    const KernelRecord &Record = Kernels.find(Name)->second;
+    std::vector<StringRef> Regions;
+    for (const auto &Region : Record.Regions)
+      Regions.push_back(Region.first());
+    llvm::sort(Regions);
+    for (StringRef Region : Regions) {
+      const RegionProfile &Counters = Record.Regions.find(Region)->second;
+      OS << "region " << Name << ' ' << Counters.Calls << ' ' << Counters.Cycles << ' ' << Counters.Trips << ' '
+         << Region << '\n';
+    }
+    for (const auto &Shape : Record.Shapes) {
+      OS << "shape " << Name << ' ' << Shape.second;
+      for (int64_t Extent : Shape.first)
+        OS << ' ' << Extent;
+      OS << '\n';
+    }
+  }
+}
+
+Error KernelProfileData::writeToFile(StringRef Path) const {
+  std::error_code EC;
+  raw_fd_ostream OS(Path, EC, sys::fs::OF_Text);
+  if (EC)
+    return createFileError(Path, EC);
+  print(OS);
+  OS.close();
+  if (OS.has_error())
+    return createFileError(Path, OS.error());
+  return Error::success();
+}
+
+Expected<KernelProfileData> KernelProfileData::parse(StringRef Buffer) {
+  KernelProfileData Profile;
+  SmallVector<StringRef, 16> Lines;
+  Buffer.split(Lines, '\n');
+  for (unsigned LineNo = 1; LineNo <= Lines.size(); ++LineNo) {
+    StringRef Line = Lines[LineNo - 1].trim();
+    if (Line.empty() || Line.startswith("#"))
+      continue;
+
+    SmallVector<StringRef, 8> Fields;
+    Line.split(Fields, ' ', -1, /*KeepEmpty=*/false);
+    if (Fields[0] == "region") {
+      // The region name is the rest of the line and may contain spaces
+      RegionProfile Counters;
+      if (Fields.size() < 6 || Fields[2].getAsInteger(10, Counters.Calls) ||
+          Fields[3].getAsInteger(10, Counters.Cycles) || Fields[4].getAsInteger(10, Counters.Trips))
+        return makeParseError(LineNo, "expected 'region <kernel> <calls> <cycles> <trips> <name>'");
+      StringRef Region = Line.substr(Fields[5].data() - Line.data());
+      Profile.recordRegion(Fields[1], Region, Counters);
+    } else if (Fields[0] == "shape") {
+      uint64_t Count;
+      if (Fields.size() < 3 || Fields[2].getAsInteger(10, Count))
+        return makeParseError(LineNo, "expected 'shape <kernel> <count> <extent>...'");
+      std::vector<int64_t> Dims;
+      for (StringRef Field : drop_begin(Fields, 3)) {
+        int64_t Extent;
+        if (Field.getAsInteger(10, Extent))
+          return makeParseError(LineNo, "invalid extent '" + Field + "'");
+        Dims.push_back(Extent);
+      }
+      Profile.recordShape(Fields[1], Dims, Count);
+    } else {
+      return makeParseError(LineNo, "unknown record '" + Fields[0] + "'");
+    }
+  }
+  return std::move(Profile);
+}
+
+Expected<KernelProfileData> KernelProfileData::readFromFile(StringRef Path) {
+  auto Buffer = MemoryBuffer::getFile(Path, /*IsText=*/true);
+  if (!Buffer)
+    return createFileError(Path, Buffer.getError());
+  return parse((*Buffer)->getBuffer());
+}
+
+} // namespace llvm
@@ -0,0 +1,99 @@
+#include "Runtime/KernelProfiler.h"
+#include "llvm/Support/Format.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+using namespace llvm;
+
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+              "profile counters must match the i64 fields emitted by the profiling pass");
+
+namespace {
+
+/// Guards the site list, which JIT constructors and destructors change while
+/// other threads may be reading it.
+std::mutex SiteListMutex;
+KernelProfileSite *SiteListHead = nullptr;
+
+/// Collect the registered sites; the caller holds SiteListMutex.
+std::vector<const KernelProfileSite *> collectSites() {
+  std::vector<const KernelProfileSite *> Sites;
+  for (KernelProfileSite *Site = SiteListHead; Site; Site = Site->Next)
+    Sites.push_back(Site);
+  return Sites;
+}
+
+} // namespace
+
+extern "C" void __dlopt_prof_register(KernelProfileSite *Site) {
+  std::lock_guard<std::mutex> Lock(SiteListMutex);
+  Site->Next = SiteListHead;
+  SiteListHead = Site;
+}
+
+extern "C" void __dlopt_prof_unregister(KernelProfileSite *Site) {
+  std::lock_guard<std::mutex> Lock(SiteListMutex);
+  for (KernelProfileSite **Link = &SiteListHead; *Link; Link = &(*Link)->Next) {
+    if (*Link == Site) {
+      *Link = Site->Next;
+      return;
+    }
+  }
+}
+
+namespace llvm {
+
+std::vector<const KernelProfileSite *> getKernelProfileSites() {
+  std::lock_guard<std::mutex> Lock(SiteListMutex);
+  return collectSites();
+}
+
+void dumpKernelProfile(raw_ostream &OS) {
+  // Hold the lock throughout so that no site is unregistered while printing
+  std::lock_guard<std::mutex> Lock(SiteListMutex);
+  std::vector<const KernelProfileSite *> Sites = collectSites();
+
+  // Group by kernel with the whole-kernel region first, then loops in order
+  std::stable_sort(Sites.begin(), Sites.end(), [](const KernelProfileSite *A, const KernelProfileSite *B) {
+    if (int Cmp = std::strcmp(A->Kernel, B->Kernel))
+      return Cmp < 0;
+    bool AIsKernel = !std::strcmp(A->Region, "kernel"), BIsKernel = !std::strcmp(B->Region, "kernel");
+    if (AIsKernel != BIsKernel)
+      return AIsKernel;
+    return std::strcmp(A->Region, B->Region) < 0;
+  });
+
+  OS << "===" << std::string(100, '-') << "===\n"
+     << "                                         Kernel profile\n"
+     << "===" << std::string(100, '-') << "===\n";
+  OS << "  Kernel               Region                            Calls         Cycles %Kernel        Trips"
+        "          Bytes  B/cycle\n";
+
+  uint64_t KernelCycles = 0;
+  for (const KernelProfileSite *Site : Sites) {
+    uint64_t Cycles = Site->Cycles.load(std::memory_order_relaxed);
+    uint64_t Bytes = Site->Bytes.load(std::memory_order_relaxed);
+    if (!std::strcmp(Site->Region, "kernel"))
+      KernelCycles = Cycles;
+    double Share = KernelCycles ? 100.0 * Cycles / KernelCycles : 0.0;
+    double BytesPerCycle = Cycles ? static_cast<double>(Bytes) / Cycles : 0.0;
+    OS << format("  %-20s %-28s %10llu %14llu %6.1f%% %12llu %14llu %8.2f\n", Site->Kernel, Site->Region,
+                 (unsigned long long)Site->Calls.load(std::memory_order_relaxed), (unsigned long long)Cycles, Share,
+                 (unsigned long long)Site->Trips.load(std::memory_order_relaxed), (unsigned long long)Bytes,
+                 BytesPerCycle);
+  }
+}
+
+void resetKernelProfile() {
+  std::lock_guard<std::mutex> Lock(SiteListMutex);
+  for (KernelProfileSite *Site = SiteListHead; Site; Site = Site->Next) {
+    Site->Calls.store(0, std::memory_order_relaxed);
+    Site->Cycles.store(0, std::memory_order_relaxed);
+    Site->Trips.store(0, std::memory_order_relaxed);
+    Site->Bytes.store(0, std::memory_order_relaxed);
+  }
+}
+
+} // namespace llvm
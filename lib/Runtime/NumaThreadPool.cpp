@@ -0,0 +1,210 @@
+#include "Runtime/NumaThreadPool.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <cassert>
+#include <cstring>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace llvm;
+
+namespace {
+
+/// Read a short /sys file, or return an empty string if it is missing.
+std::string readSysFile(const Twine &Path) {
+  auto Buffer = MemoryBuffer::getFileAsStream(Path);
+  return Buffer ? (*Buffer)->getBuffer().trim().str() : std::string();
+}
+
+} // namespace
+
+namespace llvm {
+
+NumaTopology NumaTopology::detect() {
+  NumaTopology Topology;
+#if defined(__linux__)
+  std::vector<unsigned> Nodes;
+  if (parseCPUList(readSysFile("/sys/devices/system/node/online"), Nodes)) {
+    for (unsigned Node : Nodes) {
+      std::vector<unsigned> CPUs;
+      if (parseCPUList(readSysFile("/sys/devices/system/node/node" + Twine(Node) + "/cpulist"), CPUs) &&
+          !CPUs.empty())
+        Topology.NodeCPUs.push_back(std::move(CPUs));
+    }
+  }
+#endif
+  if (Topology.NodeCPUs.empty()) {
+    Topology.NodeCPUs.emplace_back();
+    for (unsigned CPU = 0, E = std::max(1u, std::thread::hardware_concurrency()); CPU < E; ++CPU)
+      Topology.NodeCPUs.back().push_back(CPU);
+  }
+  return Topology;
+}
+
+bool parseCPUList(StringRef List, std::vector<unsigned> &CPUs) {
+  CPUs.clear();
+  SmallVector<StringRef, 8> Ranges;
+  List.trim().split(Ranges, ',', -1, /*KeepEmpty=*/false);
+  for (StringRef Range : Ranges) {
+    StringRef First, Last;
+    std::tie(First, Last) = Range.split('-');
+    unsigned Begin, End;
+    if (First.getAsInteger(10, Begin))
+      return false;
+    End = Begin;
+    if (!Last.empty() && (Last.getAsInteger(10, End) || End < Begin))
+      return false;
+    for (unsigned CPU = Begin; CPU <= End; ++CPU)
+      CPUs.push_back(CPU);
+  }
+  return !CPUs.empty();
+}
+
+void setCurrentThreadAffinity(ArrayRef<unsigned> CPUs) {
+#if defined(__linux__)
+  cpu_set_t Set;
+  CPU_ZERO(&Set);
+  for (unsigned CPU : CPUs)
+    if (CPU < CPU_SETSIZE)
+      CPU_SET(CPU, &Set);
+  pthread_setaffinity_np(pthread_self(), sizeof(Set), &Set);
+#else
+  (void)CPUs;
+#endif
+}
+
+NumaBuffer &NumaBuffer::operator=(NumaBuffer &&Other) {
+  if (this != &Other) {
+    this->~NumaBuffer();
+    Block = Other.Block;
+    Size = Other.Size;
+    Other.Block = sys::MemoryBlock();
+  }
+  return *this;
+}
+
+NumaBuffer::~NumaBuffer() {
+  if (Block.base())
+    sys::Memory::releaseMappedMemory(Block);
+}
+
+NumaBuffer NumaBuffer::map(size_t Size) {
+  NumaBuffer Buffer;
+  std::error_code EC;
+  Buffer.Block = sys::Memory::allocateMappedMemory(std::max<size_t>(Size, 1), nullptr,
+                                                   sys::Memory::MF_READ | sys::Memory::MF_WRITE, EC);
+  if (EC)
+    Buffer.Block = sys::MemoryBlock();
+  else
+    Buffer.Size = Size;
+  return Buffer;
+}
+
+NumaThreadPool::NumaThreadPool(NumaTopology Topology, NumaPoolOptions Options) : Options(Options) {
+  assert(Topology.getNumNodes() && "topology has no nodes");
+  NodeFirstThread.push_back(0);
+  for (unsigned Node = 0; Node < Topology.getNumNodes(); ++Node) {
+    const std::vector<unsigned> &CPUs = Topology.NodeCPUs[Node];
+    unsigned Threads = Options.ThreadsPerNode ? Options.ThreadsPerNode : std::max<size_t>(CPUs.size(), 1);
+    for (unsigned I = 0; I < Threads; ++I) {
+      unsigned Thread = Workers.size();
+      Workers.emplace_back([this, Thread, Node, CPUs] {
+        // Pin to the whole node so the scheduler can still balance within it
+        setCurrentThreadAffinity(CPUs);
+        runWorker(Thread, Node);
+      });
+    }
+    NodeFirstThread.push_back(Workers.size());
+  }
+}
+
+NumaThreadPool::~NumaThreadPool() {
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    ShuttingDown = true;
+  }
+  WorkReady.notify_all();
+  for (std::thread &Worker : Workers)
+    Worker.join();
+}
+
+std::pair<int64_t, int64_t> NumaThreadPool::getThreadRange(int64_t Extent, unsigned Thread) const {
+  // Thread T owns [Extent * T / Threads, Extent * (T + 1) / Threads), so a
+  // node's threads own one contiguous block
+  const int64_t Threads = Workers.size();
+  auto Boundary = [&](int64_t T) { return Extent / Threads * T + Extent % Threads * T / Threads; };
+  return {Boundary(Thread), Boundary(Thread + 1)};
+}
+
+std::pair<int64_t, int64_t> NumaThreadPool::getNodeRange(int64_t Extent, unsigned Node) const {
+  return {getThreadRange(Extent, NodeFirstThread[Node]).first,
+          getThreadRange(Extent, NodeFirstThread[Node + 1] - 1).second};
+}
+
+void NumaThreadPool::parallelFor(int64_t Extent, function_ref<void(int64_t, int64_t, unsigned)> Body) {
+  std::lock_guard<std::mutex> Submit(SubmitMutex);
+  std::unique_lock<std::mutex> Lock(Mutex);
+  CurrentExtent = Extent;
+  CurrentBody = Body;
+  Pending = Workers.size();
+  ++Generation;
+  WorkReady.notify_all();
+  WorkDone.wait(Lock, [&] { return Pending == 0; });
+}
+
+void NumaThreadPool::runWorker(unsigned Thread, unsigned Node) {
+  uint64_t Seen = 0;
+  for (;;) {
+    int64_t Extent;
+    function_ref<void(int64_t, int64_t, unsigned)> Body;
+    {
+      std::unique_lock<std::mutex> Lock(Mutex);
+      WorkReady.wait(Lock, [&] { return ShuttingDown || Generation != Seen; });
+      if (ShuttingDown)
+        return;
+      Seen = Generation;
+      Extent = CurrentExtent;
+      Body = CurrentBody;
+    }
+
+    std::pair<int64_t, int64_t> Range = getThreadRange(Extent, Thread);
+    if (Range.first < Range.second)
+      Body(Range.first, Range.second, Node);
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+    if (--Pending == 0)
+      WorkDone.notify_one();
+  }
+}
+
+NumaBuffer NumaThreadPool::allocateFirstTouch(int64_t Extent, size_t SliceSize) {
+  NumaBuffer Buffer = NumaBuffer::map(Extent * SliceSize);
+  if (!Buffer)
+    return Buffer;
+  char *Base = Buffer.getAs<char>();
+  parallelFor(Extent, [&](int64_t Begin, int64_t End, unsigned) {
+    std::memset(Base + Begin * SliceSize, 0, (End - Begin) * SliceSize);
+  });
+  return Buffer;
+}
+
+NumaThreadPool::ReplicatedBuffer NumaThreadPool::replicate(const void *Data, size_t Size) {
+  ReplicatedBuffer Result;
+  unsigned NumCopies = Options.ReplicateWeights ? getNumNodes() : 1;
+  for (unsigned Copy = 0; Copy < NumCopies; ++Copy)
+    Result.Copies.push_back(NumaBuffer::map(Size));
+
+  // Each node's first thread writes that node's copy
+  parallelFor(Workers.size(), [&](int64_t Begin, int64_t, unsigned Node) {
+    if (static_cast<unsigned>(Begin) == NodeFirstThread[Node] && Node < NumCopies && Result.Copies[Node])
+      std::memcpy(Result.Copies[Node].data(), Data, Size);
+  });
+  return Result;
+}
+
+} // namespace llvm
@@ -0,0 +1,41 @@
+#include "Runtime/ParallelEmbedding.h"
+
+#include <algorithm>
+
+namespace llvm {
+
+void parallelEmbeddingLookup(NumaThreadPool &Pool, EmbeddingLookupKernelFn *Kernel, const float *Table,
+                             const int64_t *Indices, float *Output, int64_t NumIndices, int64_t Dim) {
+  Pool.parallelFor(NumIndices, [&](int64_t Begin, int64_t End, unsigned) {
+    if (Begin != End)
+      Kernel(Table, Indices + Begin, Output + Begin * Dim, End - Begin, Dim);
+  });
+}
+
+void parallelEmbeddingBag(NumaThreadPool &Pool, EmbeddingBagKernelFn *Kernel, const float *Table,
+                          const int64_t *Indices, const int64_t *Offsets, float *Output, int64_t NumBags,
+                          int64_t Dim) {
+  int64_t Base = Offsets[0], Total = Offsets[NumBags] - Base;
+  if (Total == 0) {
+    // Only empty bags, which the kernel zeroes without reading any row
+    Kernel(Table, Indices, Offsets, Output, 0, NumBags, Dim);
+    return;
+  }
+
+  // The first bag starting at or after Position; the range ending at Total
+  // also takes the trailing empty bags
+  auto FindBag = [&](int64_t Position) -> int64_t {
+    if (Position == Total)
+      return NumBags;
+    return std::lower_bound(Offsets, Offsets + NumBags, Base + Position) - Offsets;
+  };
+  Pool.parallelFor(Total, [&](int64_t Begin, int64_t End, unsigned) {
+    if (Begin == End)
+      return;
+    int64_t BagBegin = FindBag(Begin), BagEnd = FindBag(End);
+    if (BagBegin != BagEnd)
+      Kernel(Table, Indices, Offsets, Output, BagBegin, BagEnd, Dim);
+  });
+}
+
+} // namespace llvm
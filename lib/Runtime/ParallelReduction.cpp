@@ -0,0 +1,117 @@
+#include "Runtime/ParallelReduction.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+/// Fold the partial \p Value at \p Index into \p Acc and \p AccIndex. ArgMax
+/// prefers the earlier position on ties, like the generated kernels.
+void mergePartial(ReductionKind Kind, float &Acc, int64_t &AccIndex, float Value, int64_t Index) {
+  switch (Kind) {
+  case ReductionKind::Max: Acc = std::fmax(Acc, Value); break;
+  case ReductionKind::Min: Acc = std::fmin(Acc, Value); break;
+  case ReductionKind::ArgMax:
+    if (Value > Acc || (Value == Acc && Index < AccIndex)) {
+      Acc = Value;
+      AccIndex = Index;
+    }
+    break;
+  default: Acc += Value; break;
+  }
+}
+
+/// Turn the merged accumulators in [Begin, End) into final results.
+void finalize(ReductionKind Kind, float *Values, int64_t Begin, int64_t End, int64_t ReducedCount) {
+  if (Kind == ReductionKind::Mean)
+    for (int64_t I = Begin; I < End; ++I)
+      Values[I] /= static_cast<float>(ReducedCount);
+  else if (Kind == ReductionKind::L2Norm)
+    for (int64_t I = Begin; I < End; ++I)
+      Values[I] = std::sqrt(Values[I]);
+}
+
+} // namespace
+
+namespace llvm {
+
+void parallelReduce(NumaThreadPool &Pool, ReductionKernelFn *Kernel, ReductionKind Kind, ArrayRef<int64_t> Shape,
+                    ArrayRef<unsigned> Axes, const float *Input, float *Output, int64_t *Indices) {
+  assert(!Shape.empty() && "reduction needs a tensor");
+  assert((Kind != ReductionKind::ArgMax || Indices) && "argmax needs an index tensor");
+  bool OuterReduced = is_contained(Axes, 0u);
+  int64_t RowSize = 1, OutputSize = 1, ReducedCount = 1;
+  for (unsigned Axis = 0; Axis < Shape.size(); ++Axis) {
+    if (Axis > 0)
+      RowSize *= Shape[Axis];
+    (is_contained(Axes, Axis) ? ReducedCount : OutputSize) *= Shape[Axis];
+  }
+
+  // An empty outermost axis leaves no rows to split. When it is kept there is
+  // no output either; when it is reduced the kernel writes the identity.
+  if (Shape[0] == 0) {
+    if (OuterReduced) {
+      Kernel(Input, Output, Indices, Shape.data());
+      finalize(Kind, Output, 0, OutputSize, ReducedCount);
+    }
+    return;
+  }
+
+  if (!OuterReduced) {
+    // Output rows follow input rows, so every worker finishes its own rows
+    int64_t OutRowSize = OutputSize / Shape[0];
+    Pool.parallelFor(Shape[0], [&](int64_t Begin, int64_t End, unsigned) {
+      if (Begin == End)
+        return;
+      SmallVector<int64_t, 8> Part(Shape.begin(), Shape.end());
+      Part[0] = End - Begin;
+      Kernel(Input + Begin * RowSize, Output + Begin * OutRowSize, Indices ? Indices + Begin * OutRowSize : nullptr,
+             Part.data());
+      finalize(Kind, Output, Begin * OutRowSize, End * OutRowSize, ReducedCount);
+    });
+    return;
+  }
+
+  // Each non-empty range reduces into the next free slot. Positions are
+  // relative to the range, so ArgMax shifts them by the rows skipped.
+  bool IsArgMax = Kind == ReductionKind::ArgMax;
+  int64_t PositionsPerRow = ReducedCount / Shape[0];
+  std::vector<float> Partials(Pool.getNumThreads() * OutputSize);
+  std::vector<int64_t> PartialIndices(IsArgMax ? Partials.size() : 0);
+  std::atomic<unsigned> NumSlots{0};
+  Pool.parallelFor(Shape[0], [&](int64_t Begin, int64_t End, unsigned) {
+    if (Begin == End)
+      return;
+    unsigned Slot = NumSlots.fetch_add(1, std::memory_order_relaxed);
+    SmallVector<int64_t, 8> Part(Shape.begin(), Shape.end());
+    Part[0] = End - Begin;
+    int64_t *SlotIndices = IsArgMax ? &PartialIndices[Slot * OutputSize] : nullptr;
+    Kernel(Input + Begin * RowSize, &Partials[Slot * OutputSize], SlotIndices, Part.data());
+    for (int64_t I = 0; IsArgMax && I < OutputSize; ++I)
+      SlotIndices[I] += Begin * PositionsPerRow;
+  });
+
+  // parallelFor returning orders every slot write before the merge
+  unsigned Slots = NumSlots.load(std::memory_order_relaxed);
+  Pool.parallelFor(OutputSize, [&](int64_t Begin, int64_t End, unsigned) {
+    for (int64_t I = Begin; I < End; ++I) {
+      float Acc = Partials[I];
+      int64_t AccIndex = IsArgMax ? PartialIndices[I] : 0;
+      for (unsigned Slot = 1; Slot < Slots; ++Slot)
+        mergePartial(Kind, Acc, AccIndex, Partials[Slot * OutputSize + I],
+                     IsArgMax ? PartialIndices[Slot * OutputSize + I] : 0);
+      Output[I] = Acc;
+      if (IsArgMax)
+        Indices[I] = AccIndex;
+    }
+    finalize(Kind, Output, Begin, End, ReducedCount);
+  });
+}
+
+} // namespace llvm
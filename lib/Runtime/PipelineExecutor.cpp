@@ -0,0 +1,120 @@
+#include "Runtime/PipelineExecutor.h"
+#include "Runtime/NumaThreadPool.h"
+
+#include <cassert>
+
+using namespace llvm;
+
+namespace {
+
+/// Failed pops before an idle worker goes to sleep.
+const unsigned SpinLimit = 1024;
+
+unsigned getNumWorkers(const PipelineStage &Stage) {
+  if (Stage.NumWorkers)
+    return Stage.NumWorkers;
+  return Stage.Cores.empty() ? 1 : Stage.Cores.size();
+}
+
+} // namespace
+
+namespace llvm {
+
+PipelineExecutor::JobQueue::JobQueue(bool SingleProducerConsumer, unsigned Capacity) {
+  if (SingleProducerConsumer)
+    SPSC = std::make_unique<SPSCQueue<Job *>>(Capacity);
+  else
+    MPMC = std::make_unique<MPMCQueue<Job *>>(Capacity);
+}
+
+void PipelineExecutor::JobQueue::push(Job *J) {
+  while (!(SPSC ? SPSC->tryPush(J) : MPMC->tryPush(J)))
+    std::this_thread::yield();
+
+  // Pairs with the fence in pop(): either the sleeper sees the job or we see the sleeper
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (Sleepers.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    NotEmpty.notify_one();
+  }
+}
+
+PipelineExecutor::Job *PipelineExecutor::JobQueue::pop() {
+  Job *J = nullptr;
+  for (unsigned Spin = 0; Spin < SpinLimit; ++Spin)
+    if (tryPop(J))
+      return J;
+
+  std::unique_lock<std::mutex> Lock(Mutex);
+  Sleepers.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  bool Popped = false;
+  NotEmpty.wait(Lock, [&] {
+    Popped = tryPop(J);
+    return Popped || Closed.load(std::memory_order_acquire);
+  });
+  Sleepers.fetch_sub(1, std::memory_order_relaxed);
+  if (Popped)
+    return J;
+  // Closed: producers have finished, so anything still queued is visible now
+  return tryPop(J) ? J : nullptr;
+}
+
+void PipelineExecutor::JobQueue::close() {
+  Closed.store(true, std::memory_order_release);
+  std::lock_guard<std::mutex> Lock(Mutex);
+  NotEmpty.notify_all();
+}
+
+PipelineExecutor::PipelineExecutor(std::vector<PipelineStage> StageList, unsigned QueueCapacity)
+    : Stages(std::move(StageList)), LiveWorkers(new std::atomic<unsigned>[Stages.size()]) {
+  assert(!Stages.empty() && "a pipeline needs at least one stage");
+
+  // Any thread may submit, so the first queue always takes several producers
+  for (unsigned I = 0; I < Stages.size(); ++I) {
+    bool SingleProducerConsumer = I > 0 && getNumWorkers(Stages[I - 1]) == 1 && getNumWorkers(Stages[I]) == 1;
+    Queues.push_back(std::make_unique<JobQueue>(SingleProducerConsumer, QueueCapacity));
+    LiveWorkers[I].store(getNumWorkers(Stages[I]), std::memory_order_relaxed);
+  }
+
+  for (unsigned I = 0; I < Stages.size(); ++I)
+    for (unsigned Worker = 0; Worker < getNumWorkers(Stages[I]); ++Worker)
+      Workers.emplace_back([this, I, Worker] { runWorker(I, Worker); });
+}
+
+PipelineExecutor::~PipelineExecutor() {
+  // Closing the first queue drains the pipeline stage by stage
+  Queues.front()->close();
+  for (std::thread &Worker : Workers)
+    Worker.join();
+}
+
+std::future<void> PipelineExecutor::submit(void *Request) {
+  auto *J = new Job{Request, {}};
+  std::future<void> Result = J->Done.get_future();
+  Queues.front()->push(J);
+  return Result;
+}
+
+void PipelineExecutor::runWorker(unsigned Stage, unsigned Worker) {
+  const PipelineStage &S = Stages[Stage];
+  if (!S.Cores.empty())
+    setCurrentThreadAffinity(S.Cores[Worker % S.Cores.size()]);
+
+  bool IsLast = Stage + 1 == Stages.size();
+  while (Job *J = Queues[Stage]->pop()) {
+    S.Run(J->Request);
+    if (IsLast) {
+      J->Done.set_value();
+      delete J;
+    } else {
+      Queues[Stage + 1]->push(J);
+    }
+  }
+
+  // The last worker of a stage to finish closes the next stage's queue
+  if (!IsLast && LiveWorkers[Stage].fetch_sub(1, std::memory_order_acq_rel) == 1)
+    Queues[Stage + 1]->close();
+}
+
+} // namespace llvm
@@ -0,0 +1,175 @@
+#include "Runtime/ShapeSpecializationCache.h"
+#include "Kernels/KernelShape.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace llvm::orc;
+
+namespace llvm {
+
+Expected<std::unique_ptr<ShapeSpecializationCache>>
+ShapeSpecializationCache::create(ShapedKernelGenerator Generator, unsigned NumDims, unsigned HotThreshold,
+                                 unsigned MaxSpecializations) {
+  auto JIT = KernelJIT::create();
+  if (!JIT)
+    return JIT.takeError();
+
+  std::unique_ptr<ShapeSpecializationCache> Cache(new ShapeSpecializationCache(
+      std::move(*JIT), std::move(Generator), NumDims, HotThreshold, MaxSpecializations));
+
+  std::vector<int64_t> GenericDims(NumDims, DynamicDim);
+  auto Generic = Cache->compile(GenericDims);
+  if (!Generic)
+    return Generic.takeError();
+  Cache->GenericKernel = *Generic;
+
+  Cache->Worker = std::thread([Ptr = Cache.get()] { Ptr->runWorker(); });
+  return std::move(Cache);
+}
+
+ShapeSpecializationCache::ShapeSpecializationCache(std::unique_ptr<KernelJIT> JIT, ShapedKernelGenerator Generator,
+                                                   unsigned NumDims, unsigned HotThreshold,
+                                                   unsigned MaxSpecializations)
+    : JIT(std::move(JIT)), Generator(std::move(Generator)), NumDims(NumDims), HotThreshold(HotThreshold),
+      MaxSpecializations(MaxSpecializations) {}
+
+ShapeSpecializationCache::~ShapeSpecializationCache() {
+  {
+    std::lock_guard<std::mutex> Lock(QueueMutex);
+    ShuttingDown = true;
+  }
+  QueueChanged.notify_all();
+  if (Worker.joinable())
+    Worker.join();
+}
+
+ShapeSpecializationCache::ShapeEntry &ShapeSpecializationCache::getEntry(ArrayRef<int64_t> Dims) {
+  SmallString<64> Key;
+  getShapeSuffix(Dims, Key);
+
+  {
+    std::shared_lock<std::shared_mutex> Lock(EntriesMutex);
+    auto It = Entries.find(Key);
+    if (It != Entries.end())
+      return *It->second;
+  }
+  std::unique_lock<std::shared_mutex> Lock(EntriesMutex);
+  auto &Slot = Entries[Key];
+  if (!Slot) {
+    Slot = std::make_unique<ShapeEntry>();
+    Slot->Dims.assign(Dims.begin(), Dims.end());
+  }
+  return *Slot;
+}
+
+void *ShapeSpecializationCache::lookup(ArrayRef<int64_t> Dims) {
+  assert(Dims.size() == NumDims && "wrong number of extents");
+  ShapeEntry *Entry = &getEntry(Dims);
+
+  // Hits keep counting after specialization so that recordShapes() sees every run
+  unsigned Hits = Entry->Hits.fetch_add(1, std::memory_order_relaxed) + 1;
+  if (void *Kernel = Entry->Kernel.load(std::memory_order_acquire))
+    return Kernel;
+
+  // Exactly one caller claims a hot shape and queues it
+  if (Hits >= HotThreshold && !Entry->Claimed.exchange(true, std::memory_order_relaxed) &&
+      NumQueued.fetch_add(1, std::memory_order_relaxed) < MaxSpecializations) {
+    {
+      std::lock_guard<std::mutex> Lock(QueueMutex);
+      Queue.emplace_back(std::vector<int64_t>(Dims.begin(), Dims.end()), Entry);
+    }
+    QueueChanged.notify_all();
+  }
+
+  return GenericKernel;
+}
+
+void ShapeSpecializationCache::recordShapes(KernelProfileData &Profile, StringRef Kernel) {
+  std::shared_lock<std::shared_mutex> Lock(EntriesMutex);
+  for (const auto &Entry : Entries)
+    if (unsigned Hits = Entry.second->Hits.load(std::memory_order_relaxed))
+      Profile.recordShape(Kernel, Entry.second->Dims, Hits);
+}
+
+Error ShapeSpecializationCache::specializeHotShapes(const KernelProfileData &Profile, StringRef Kernel,
+                                                    double MinFraction) {
+  for (const ShapeCount &Shape : Profile.getHotShapes(Kernel, MinFraction)) {
+    if (Shape.Dims.size() != NumDims)
+      continue;
+    ShapeEntry &Entry = getEntry(Shape.Dims);
+    // Claim the shape so that lookups crossing the threshold do not queue it again
+    if (Entry.Claimed.exchange(true, std::memory_order_relaxed))
+      continue;
+    if (NumQueued.fetch_add(1, std::memory_order_relaxed) >= MaxSpecializations)
+      break;
+    auto Compiled = compile(Shape.Dims);
+    if (!Compiled)
+      return Compiled.takeError();
+    Entry.Kernel.store(*Compiled, std::memory_order_release);
+    NumSpecialized.fetch_add(1, std::memory_order_relaxed);
+  }
+  return Error::success();
+}
+
+void ShapeSpecializationCache::waitForPendingSpecializations() {
+  std::unique_lock<std::mutex> Lock(QueueMutex);
+  QueueChanged.wait(Lock, [&] { return Queue.empty() && !InFlight; });
+}
+
+Expected<void *> ShapeSpecializationCache::compile(ArrayRef<int64_t> Dims) {
+  auto Context = std::make_unique<LLVMContext>();
+  auto M = std::make_unique<Module>("shape-specialization", *Context);
+
+  Function *Kernel = Generator(*M, Dims);
+  if (!Kernel)
+    return createStringError(inconvertibleErrorCode(), "kernel generator failed");
+
+  // Every variant lives in the same JIT dylib, so give each a unique symbol
+  SmallString<64> Name(Kernel->getName());
+  Name += ".";
+  getShapeSuffix(Dims, Name);
+  Kernel->setName(Name);
+
+  std::string ErrorMessage;
+  raw_string_ostream ErrorStream(ErrorMessage);
+  if (verifyModule(*M, &ErrorStream))
+    return createStringError(inconvertibleErrorCode(), "generated kernel is broken: " + ErrorStream.str());
+
+  if (Error Err = JIT->addModule(ThreadSafeModule(std::move(M), std::move(Context))))
+    return std::move(Err);
+  return JIT->lookup(Name);
+}
+
+void ShapeSpecializationCache::runWorker() {
+  std::unique_lock<std::mutex> Lock(QueueMutex);
+  while (true) {
+    QueueChanged.wait(Lock, [&] { return ShuttingDown || !Queue.empty(); });
+    if (ShuttingDown)
+      return;
+
+    auto Request = std::move(Queue.front());
+    Queue.pop_front();
+    ++InFlight;
+    Lock.unlock();
+
+    // On failure the shape keeps running the generic variant
+    auto Kernel = compile(Request.first);
+    if (Kernel) {
+      Request.second->Kernel.store(*Kernel, std::memory_order_release);
+      NumSpecialized.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      logAllUnhandledErrors(Kernel.takeError(), errs(), "shape specialization failed: ");
+    }
+
+    Lock.lock();
+    --InFlight;
+    QueueChanged.notify_all();
+  }
+}
+
+} // namespace llvm
@@ -0,0 +1,328 @@
+#include "Runtime/TieredKernelJIT.h"
+#include "Optimization/StandardPipeline.h"
+#include "Runtime/KernelJIT.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/Mangling.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+using namespace llvm;
+using namespace llvm::orc;
+
+namespace {
+
+/// Where a stub lands when its kernel fails to compile on first call.
+void reportLazyCompileFailure() { report_fatal_error("lazy kernel compilation failed"); }
+
+/// Give the local global variables of \p M external linkage under names unique
+/// to the module numbered \p ModuleID. They are then defined once, in the
+/// shared data module, instead of in every kernel that uses them: mutable
+/// globals such as profiling counters must stay a single object, and packed
+/// weights are too large to copy.
+void externalizeLocalData(Module &M, unsigned ModuleID) {
+  for (GlobalVariable &GV : M.globals()) {
+    if (!GV.hasLocalLinkage())
+      continue;
+    GV.setName("__dlopt." + Twine(ModuleID) + "." + GV.getName());
+    GV.setLinkage(GlobalValue::ExternalLinkage);
+    GV.setVisibility(GlobalValue::DefaultVisibility);
+  }
+}
+
+/// Collect the functions among \p Roots and the local functions they
+/// reference, directly or through other local functions.
+SmallPtrSet<const Function *, 8> collectLocalFunctions(ArrayRef<const Value *> Roots) {
+  SmallPtrSet<const Function *, 8> Functions;
+  SmallPtrSet<const Constant *, 16> VisitedConstants;
+  SmallVector<const Value *, 32> Worklist(Roots.begin(), Roots.end());
+  auto Push = [&](const Value *V) {
+    const auto *F = dyn_cast<Function>(V);
+    if (!F || F->hasLocalLinkage())
+      Worklist.push_back(V);
+  };
+  while (!Worklist.empty()) {
+    const Value *V = Worklist.pop_back_val();
+    if (const auto *F = dyn_cast<Function>(V)) {
+      if (F->isDeclaration() || !Functions.insert(F).second)
+        continue;
+      for (const Instruction &I : instructions(*F))
+        for (const Value *Op : I.operand_values())
+          Push(Op);
+    } else if (const auto *C = dyn_cast<Constant>(V)) {
+      if (isa<GlobalValue>(C) || !VisitedConstants.insert(C).second)
+        continue;
+      for (const Value *Op : C->operand_values())
+        Push(Op);
+    }
+  }
+  return Functions;
+}
+
+/// Clone the global variables of \p M, including its static constructors and
+/// destructors, together with the functions those run.
+std::unique_ptr<Module> cloneData(const Module &M) {
+  SmallVector<const Value *, 2> Roots;
+  for (StringRef Name : {"llvm.global_ctors", "llvm.global_dtors"})
+    if (const GlobalVariable *GV = M.getNamedGlobal(Name))
+      Roots.push_back(GV->getInitializer());
+  SmallPtrSet<const Function *, 8> Functions = collectLocalFunctions(Roots);
+  ValueToValueMapTy VMap;
+  return CloneModule(M, VMap, [&](const GlobalValue *GV) {
+    const auto *F = dyn_cast<Function>(GV);
+    return !F || Functions.count(F);
+  });
+}
+
+/// Clone the kernel \p Kernel out of \p M together with the local functions
+/// it uses. Global variables become declarations of the shared data, and
+/// static constructors are left to the data module.
+std::unique_ptr<Module> cloneKernel(const Module &M, const Function &Kernel) {
+  SmallPtrSet<const Function *, 8> Functions = collectLocalFunctions({&Kernel});
+  ValueToValueMapTy VMap;
+  auto Clone = CloneModule(M, VMap, [&](const GlobalValue *GV) {
+    const auto *F = dyn_cast<Function>(GV);
+    return F && Functions.count(F);
+  });
+  for (StringRef Name : {"llvm.global_ctors", "llvm.global_dtors"})
+    if (GlobalVariable *GV = Clone->getNamedGlobal(Name))
+      GV->eraseFromParent();
+  return Clone;
+}
+
+} // namespace
+
+namespace llvm {
+
+Expected<std::unique_ptr<TieredKernelJIT>> TieredKernelJIT::create(TieredJITOptions Options) {
+  InitializeNativeTarget();
+  InitializeNativeTargetAsmPrinter();
+
+  auto JTMB = JITTargetMachineBuilder::detectHost();
+  if (!JTMB)
+    return JTMB.takeError();
+
+  auto JIT = LLJITBuilder().setJITTargetMachineBuilder(*JTMB).create();
+  if (!JIT)
+    return JIT.takeError();
+
+  std::unique_ptr<TieredKernelJIT> Tiered(new TieredKernelJIT(std::move(*JIT), Options));
+  LLJIT &L = *Tiered->JIT;
+
+  // Quick and optimized code live in separate dylibs so that one kernel can
+  // have both. Optimized code falls back to quick code for symbols it lacks.
+  auto QuickJD = L.createJITDylib("kernels.quick");
+  if (!QuickJD)
+    return QuickJD.takeError();
+  auto OptimizedJD = L.createJITDylib("kernels.optimized");
+  if (!OptimizedJD)
+    return OptimizedJD.takeError();
+  Tiered->QuickJD = &*QuickJD;
+  Tiered->OptimizedJD = &*OptimizedJD;
+  OptimizedJD->addToLinkOrder(*QuickJD);
+  // The main dylib holds the platform support that runs module constructors
+  // and destructors
+  for (JITDylib *JD : {&*QuickJD, &*OptimizedJD})
+    JD->addToLinkOrder(L.getMainJITDylib());
+
+  // The pipeline depends on which dylib the module is being compiled for
+  L.getIRTransformLayer().setTransform(
+      [JTMB = *JTMB, Options, Optimized = &*OptimizedJD](
+          ThreadSafeModule TSM, const MaterializationResponsibility &R) mutable -> Expected<ThreadSafeModule> {
+        auto TM = JTMB.createTargetMachine();
+        if (!TM)
+          return TM.takeError();
+        OptimizationLevel Level =
+            &R.getTargetJITDylib() == Optimized ? Options.OptimizedLevel : Options.QuickLevel;
+        TSM.withModuleDo([&](Module &M) { runStandardPipeline(M, TM->get(), Level); });
+        return std::move(TSM);
+      });
+
+  for (JITDylib *JD : {&*QuickJD, &*OptimizedJD}) {
+    auto ProcessSymbols = DynamicLibrarySearchGenerator::GetForCurrentProcess(L.getDataLayout().getGlobalPrefix());
+    if (!ProcessSymbols)
+      return ProcessSymbols.takeError();
+    JD->addGenerator(std::move(*ProcessSymbols));
+  }
+  if (Error Err = defineKernelRuntimeSymbols(L, *QuickJD))
+    return std::move(Err);
+
+  auto CallThrough = createLocalLazyCallThroughManager(L.getTargetTriple(), L.getExecutionSession(),
+                                                       pointerToJITTargetAddress(&reportLazyCompileFailure));
+  if (!CallThrough)
+    return CallThrough.takeError();
+  Tiered->CallThrough = std::move(*CallThrough);
+  Tiered->Stubs = createLocalIndirectStubsManagerBuilder(L.getTargetTriple())();
+  if (!Tiered->Stubs)
+    return createStringError(inconvertibleErrorCode(), "no indirect stubs for " + L.getTargetTriple().str());
+
+  Tiered->Worker = std::thread([Ptr = Tiered.get()] { Ptr->runWorker(); });
+  return std::move(Tiered);
+}
+
+TieredKernelJIT::TieredKernelJIT(std::unique_ptr<LLJIT> JIT, TieredJITOptions Options)
+    : JIT(std::move(JIT)), Options(Options) {}
+
+TieredKernelJIT::~TieredKernelJIT() {
+  {
+    std::lock_guard<std::mutex> Lock(QueueMutex);
+    ShuttingDown = true;
+  }
+  QueueChanged.notify_all();
+  if (Worker.joinable())
+    Worker.join();
+  // Unregister profile sites and run other module destructors before the
+  // shared data is freed
+  if (QuickJD)
+    if (Error Err = JIT->deinitialize(*QuickJD))
+      logAllUnhandledErrors(std::move(Err), errs(), "kernel JIT deinitialization failed: ");
+}
+
+Error TieredKernelJIT::addModule(ThreadSafeModule TSM) {
+  return TSM.withModuleDo([&](Module &M) -> Error {
+    M.setDataLayout(JIT->getDataLayout());
+    M.setTargetTriple(JIT->getTargetTriple().str());
+
+    // Shared data such as weight globals and profiling sites is defined once,
+    // in its own module, whose constructors run as soon as it is added
+    externalizeLocalData(M, NumModules++);
+    bool HasSharedData = any_of(M.globals(), [](const GlobalVariable &GV) { return !GV.isDeclaration(); });
+    if (HasSharedData) {
+      if (Error Err = JIT->addIRModule(*QuickJD, ThreadSafeModule(cloneData(M), TSM.getContext())))
+        return Err;
+      if (Error Err = JIT->initialize(*QuickJD))
+        return Err;
+    }
+
+    MangleAndInterner Mangle(JIT->getExecutionSession(), JIT->getDataLayout());
+    for (Function &F : M) {
+      if (F.isDeclaration() || F.hasLocalLinkage())
+        continue;
+      std::string Name = F.getName().str();
+
+      // Adding the quick module compiles nothing until its symbol is looked up
+      if (Error Err = JIT->addIRModule(*QuickJD, ThreadSafeModule(cloneKernel(M, F), TSM.getContext())))
+        return Err;
+
+      auto Entry = std::make_unique<KernelEntry>();
+      if (Options.EnableTiering) {
+        // The background compile gets its own context so that it never holds
+        // the lock a first-call compile is waiting for
+        raw_svector_ostream OS(Entry->OptimizedBitcode);
+        WriteBitcodeToFile(*cloneKernel(M, F), OS);
+      }
+      {
+        std::lock_guard<std::mutex> Lock(EntriesMutex);
+        if (!Entries.try_emplace(Name, std::move(Entry)).second)
+          return createStringError(inconvertibleErrorCode(), "duplicate kernel '" + Name + "'");
+      }
+
+      auto Trampoline = CallThrough->getCallThroughTrampoline(
+          *QuickJD, Mangle(Name), [this, Name](JITTargetAddress Addr) { return onFirstCall(Name, Addr); });
+      if (!Trampoline)
+        return Trampoline.takeError();
+      if (Error Err = Stubs->createStub(Name, *Trampoline, JITSymbolFlags::Exported))
+        return Err;
+    }
+    return Error::success();
+  });
+}
+
+Expected<void *> TieredKernelJIT::lookup(StringRef Name) {
+  JITEvaluatedSymbol Stub = Stubs->findStub(Name, true);
+  if (!Stub)
+    return createStringError(inconvertibleErrorCode(), "no kernel '" + Name + "'");
+  return jitTargetAddressToPointer<void *>(Stub.getAddress());
+}
+
+Error TieredKernelJIT::onFirstCall(StringRef Name, JITTargetAddress QuickAddr) {
+  if (Error Err = Stubs->updatePointer(Name, QuickAddr))
+    return Err;
+  NumQuick.fetch_add(1, std::memory_order_relaxed);
+
+  KernelEntry *Entry;
+  {
+    std::lock_guard<std::mutex> Lock(EntriesMutex);
+    Entry = Entries[Name].get();
+  }
+  Entry->CurrentTier.store(Tier::Quick, std::memory_order_release);
+
+  if (Options.EnableTiering) {
+    std::lock_guard<std::mutex> Lock(QueueMutex);
+    Queue.push_back(Name.str());
+    QueueChanged.notify_all();
+  }
+  return Error::success();
+}
+
+TieredKernelJIT::Tier TieredKernelJIT::getTier(StringRef Name) {
+  std::lock_guard<std::mutex> Lock(EntriesMutex);
+  auto It = Entries.find(Name);
+  return It == Entries.end() ? Tier::NotCompiled : It->second->CurrentTier.load(std::memory_order_acquire);
+}
+
+void TieredKernelJIT::waitForPendingOptimizations() {
+  std::unique_lock<std::mutex> Lock(QueueMutex);
+  QueueChanged.wait(Lock, [&] { return Queue.empty() && !InFlight; });
+}
+
+void TieredKernelJIT::runWorker() {
+  std::unique_lock<std::mutex> Lock(QueueMutex);
+  while (true) {
+    QueueChanged.wait(Lock, [&] { return ShuttingDown || !Queue.empty(); });
+    if (ShuttingDown)
+      return;
+
+    std::string Name = std::move(Queue.front());
+    Queue.pop_front();
+    // Once the budget is spent, the remaining kernels keep their quick code
+    if (Options.OptimizationBudget.count() && OptimizationTime >= Options.OptimizationBudget) {
+      QueueChanged.notify_all();
+      continue;
+    }
+    ++InFlight;
+    Lock.unlock();
+
+    KernelEntry *Entry;
+    {
+      std::lock_guard<std::mutex> EntriesLock(EntriesMutex);
+      Entry = Entries[Name].get();
+    }
+
+    auto Start = std::chrono::steady_clock::now();
+    auto Context = std::make_unique<LLVMContext>();
+    auto M = parseBitcodeFile(MemoryBufferRef(StringRef(Entry->OptimizedBitcode.data(),
+                                                        Entry->OptimizedBitcode.size()),
+                                              Name),
+                              *Context);
+    Error Err = M ? JIT->addIRModule(*OptimizedJD, ThreadSafeModule(std::move(*M), std::move(Context)))
+                  : M.takeError();
+    if (!Err) {
+      auto Symbol = JIT->lookup(*OptimizedJD, Name);
+      Err = Symbol ? Stubs->updatePointer(Name, Symbol->getAddress()) : Symbol.takeError();
+    }
+    // On failure the kernel keeps running its quick code
+    if (Err) {
+      logAllUnhandledErrors(std::move(Err), errs(), "kernel re-optimization failed: ");
+    } else {
+      Entry->CurrentTier.store(Tier::Optimized, std::memory_order_release);
+      Entry->OptimizedBitcode = {};
+      NumOptimized.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Lock.lock();
+    OptimizationTime += std::chrono::steady_clock::now() - Start;
+    --InFlight;
+    QueueChanged.notify_all();
+  }
+}
+
+} // namespace llvm
@@ -0,0 +1,235 @@
+#include "Runtime/WeightContainer.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+namespace {
+
+const char Magic[8] = {'D', 'L', 'O', 'P', 'T', 'W', 'T', '1'};
+const uint32_t Version = 1;
+const uint64_t HeaderSize = 40;
+
+uint64_t getElementSize(TensorElementType ElemTy) { return ElemTy == TensorElementType::F32 ? 4 : 2; }
+
+/// Bounds-checked little-endian reader over the mapped table.
+class TableReader {
+public:
+  TableReader(StringRef Buffer, uint64_t Offset) : Buffer(Buffer), Offset(Offset) {}
+
+  template <typename T> bool read(T &Value) {
+    if (Offset + sizeof(T) > Buffer.size())
+      return false;
+    Value = support::endian::read<T, support::little, support::unaligned>(Buffer.data() + Offset);
+    Offset += sizeof(T);
+    return true;
+  }
+
+  bool readString(uint64_t Size, std::string &Value) {
+    if (Offset + Size > Buffer.size())
+      return false;
+    Value = Buffer.substr(Offset, Size).str();
+    Offset += Size;
+    return true;
+  }
+
+private:
+  StringRef Buffer;
+  uint64_t Offset;
+};
+
+Error makeFormatError(const Twine &Message) {
+  return createStringError(inconvertibleErrorCode(), "invalid weight container: " + Message);
+}
+
+} // namespace
+
+namespace llvm {
+
+int64_t WeightTensor::getNumElements() const {
+  int64_t Elements = 1;
+  for (int64_t Extent : Shape)
+    Elements *= Extent;
+  return Elements;
+}
+
+void WeightContainerWriter::addTensor(StringRef Name, TensorElementType ElemTy, ArrayRef<int64_t> Shape,
+                                      StringRef Layout, ArrayRef<char> Data) {
+  Tensors.push_back({Name.str(), ElemTy, SmallVector<int64_t, 4>(Shape.begin(), Shape.end()), Layout.str(), Data});
+}
+
+void WeightContainerWriter::addTensor(StringRef Name, ArrayRef<int64_t> Shape, StringRef Layout,
+                                      ArrayRef<float> Data) {
+  addTensor(Name, TensorElementType::F32, Shape, Layout,
+            ArrayRef<char>(reinterpret_cast<const char *>(Data.data()), Data.size() * sizeof(float)));
+}
+
+Error WeightContainerWriter::write(StringRef Path) const {
+  // Lay the table out first so that every tensor offset is known up front
+  std::string Table;
+  raw_string_ostream TableStream(Table);
+  support::endian::Writer TableWriter(TableStream, support::little);
+  uint64_t TableSize = 0;
+  for (const PendingTensor &Tensor : Tensors)
+    TableSize += 2 + Tensor.Name.size() + 2 + 2 + Tensor.Layout.size() + 8 * Tensor.Shape.size() + 16;
+
+  uint64_t Offset = alignTo(HeaderSize + TableSize, Alignment);
+  std::vector<uint64_t> Offsets;
+  for (const PendingTensor &Tensor : Tensors) {
+    TableWriter.write<uint16_t>(Tensor.Name.size());
+    TableStream << Tensor.Name;
+    TableWriter.write<uint8_t>(static_cast<uint8_t>(Tensor.ElemTy));
+    TableWriter.write<uint8_t>(Tensor.Shape.size());
+    TableWriter.write<uint16_t>(Tensor.Layout.size());
+    TableStream << Tensor.Layout;
+    for (int64_t Extent : Tensor.Shape)
+      TableWriter.write<int64_t>(Extent);
+    TableWriter.write<uint64_t>(Offset);
+    TableWriter.write<uint64_t>(Tensor.Data.size());
+    Offsets.push_back(Offset);
+    Offset = alignTo(Offset + Tensor.Data.size(), Alignment);
+  }
+  TableStream.flush();
+  assert(Table.size() == TableSize && "table size miscomputed");
+
+  std::error_code EC;
+  raw_fd_ostream OS(Path, EC, sys::fs::OF_None);
+  if (EC)
+    return createFileError(Path, EC);
+
+  support::endian::Writer Header(OS, support::little);
+  OS.write(Magic, sizeof(Magic));
+  Header.write<uint32_t>(Version);
+  Header.write<uint32_t>(Tensors.size());
+  Header.write<uint64_t>(HeaderSize);
+  Header.write<uint64_t>(TableSize);
+  Header.write<uint32_t>(Alignment);
+  Header.write<uint32_t>(0);
+  OS << Table;
+
+  for (size_t I = 0; I < Tensors.size(); ++I) {
+    OS.write_zeros(Offsets[I] - OS.tell());
+    OS.write(Tensors[I].Data.data(), Tensors[I].Data.size());
+  }
+
+  OS.close();
+  if (OS.has_error())
+    return createFileError(Path, OS.error());
+  return Error::success();
+}
+
+Expected<std::unique_ptr<WeightContainer>> WeightContainer::open(StringRef Path) {
+  auto FD = sys::fs::openNativeFileForRead(Path);
+  if (!FD)
+    return createFileError(Path, FD.takeError());
+
+  sys::fs::file_status Status;
+  std::error_code EC = sys::fs::status(*FD, Status);
+  if (!EC && Status.getSize() < HeaderSize)
+    EC = std::make_error_code(std::errc::invalid_argument);
+  std::unique_ptr<WeightContainer> Container;
+  if (!EC) {
+    // A read-only mapping is shared through the page cache with other processes
+    sys::fs::mapped_file_region Region(*FD, sys::fs::mapped_file_region::readonly, Status.getSize(), 0, EC);
+    if (!EC)
+      Container.reset(new WeightContainer(std::move(Region)));
+  }
+  sys::fs::closeFile(*FD);
+  if (EC)
+    return createFileError(Path, EC);
+
+  if (Error Err = Container->parse())
+    return createFileError(Path, std::move(Err));
+  return std::move(Container);
+}
+
+Error WeightContainer::parse() {
+  StringRef Buffer(Region.const_data(), Region.size());
+  if (!Buffer.startswith(StringRef(Magic, sizeof(Magic))))
+    return makeFormatError("bad magic");
+
+  TableReader Header(Buffer, sizeof(Magic));
+  uint32_t FileVersion, NumTensors, Reserved;
+  uint64_t TableOffset, TableSize;
+  Header.read(FileVersion);
+  Header.read(NumTensors);
+  Header.read(TableOffset);
+  Header.read(TableSize);
+  Header.read(Alignment);
+  Header.read(Reserved);
+  if (FileVersion != Version)
+    return makeFormatError("unsupported version " + Twine(FileVersion));
+  if (!Alignment || !isPowerOf2_32(Alignment))
+    return makeFormatError("alignment " + Twine(Alignment) + " is not a power of two");
+  if (TableOffset + TableSize > Buffer.size())
+    return makeFormatError("tensor table is truncated");
+
+  TableReader Table(Buffer.substr(0, TableOffset + TableSize), TableOffset);
+  for (uint32_t I = 0; I < NumTensors; ++I) {
+    WeightTensor Tensor;
+    uint16_t NameSize, LayoutSize;
+    uint8_t ElemTy, Rank;
+    uint64_t Offset;
+    bool Complete = Table.read(NameSize) && Table.readString(NameSize, Tensor.Name) && Table.read(ElemTy) &&
+                    Table.read(Rank) && Table.read(LayoutSize) && Table.readString(LayoutSize, Tensor.Layout);
+    for (uint8_t Dim = 0; Complete && Dim < Rank; ++Dim) {
+      int64_t Extent;
+      Complete = Table.read(Extent);
+      Tensor.Shape.push_back(Extent);
+    }
+    Complete = Complete && Table.read(Offset) && Table.read(Tensor.Size);
+    if (!Complete)
+      return makeFormatError("tensor table is truncated");
+
+    if (ElemTy > static_cast<uint8_t>(TensorElementType::BF16))
+      return makeFormatError("tensor '" + Tensor.Name + "' has unknown element type " + Twine(ElemTy));
+    Tensor.ElemTy = static_cast<TensorElementType>(ElemTy);
+    if (Offset % Alignment || Offset + Tensor.Size > Buffer.size() || Offset + Tensor.Size < Offset)
+      return makeFormatError("tensor '" + Tensor.Name + "' is misaligned or out of bounds");
+    if (Tensor.getNumElements() * getElementSize(Tensor.ElemTy) != Tensor.Size)
+      return makeFormatError("tensor '" + Tensor.Name + "' size does not match its shape");
+    if (!TensorIndex.try_emplace(Tensor.Name, Tensors.size()).second)
+      return makeFormatError("duplicate tensor '" + Tensor.Name + "'");
+
+    Tensor.Data = Buffer.data() + Offset;
+    Tensors.push_back(std::move(Tensor));
+  }
+
+  return Error::success();
+}
+
+const WeightTensor *WeightContainer::lookup(StringRef Name) const {
+  auto It = TensorIndex.find(Name);
+  return It == TensorIndex.end() ? nullptr : &Tensors[It->second];
+}
+
+Expected<const WeightTensor &> WeightContainer::bind(StringRef Name, TensorElementType ElemTy,
+                                                     int64_t NumElements) const {
+  const WeightTensor *Tensor = lookup(Name);
+  if (!Tensor)
+    return createStringError(inconvertibleErrorCode(), "no tensor '" + Name + "' in weight container");
+  if (Tensor->ElemTy != ElemTy || Tensor->getNumElements() != NumElements)
+    return createStringError(inconvertibleErrorCode(),
+                             "tensor '" + Name + "' is " + getTensorElementTypeName(Tensor->ElemTy) + " with " +
+                                 Twine(Tensor->getNumElements()) + " elements, kernel expects " +
+                                 getTensorElementTypeName(ElemTy) + " with " + Twine(NumElements));
+  return *Tensor;
+}
+
+std::string getWeightSymbolName(StringRef TensorName) { return ("__dlopt_weight." + TensorName).str(); }
+
+GlobalVariable *declareWeightGlobal(Module &M, StringRef TensorName, uint32_t Alignment) {
+  std::string Symbol = getWeightSymbolName(TensorName);
+  if (GlobalVariable *Existing = M.getNamedGlobal(Symbol))
+    return Existing;
+
+  auto *GV = new GlobalVariable(M, Type::getInt8Ty(M.getContext()), true, GlobalValue::ExternalLinkage, nullptr,
+                                Symbol);
+  GV->setAlignment(Align(Alignment));
+  return GV;
+}
+
+} // namespace llvm
@@ -1,6 +1,595 @@
-#include <iostream>
+#include "Kernels/Activation.h"
+#include "Kernels/Attention.h"
+#include "Kernels/Convolution.h"
+#include "Kernels/Embedding.h"
+#include "Kernels/Multiversion.h"
+#include "Kernels/Normalization.h"
+#include "Kernels/Pooling.h"
+#include "Kernels/Reduction.h"
+#include "Kernels/Sparse.h"
+#include "Kernels/TensorDescriptor.h"
+#include "Optimization/AutoVectorization.h"
+#include "Optimization/DataLayoutTransform.h"
+#include "Optimization/KernelProfiling.h"
+#include "Optimization/LoopFusion.h"
+#include "Optimization/ProfileGuidedSpecialization.h"
+#include "Optimization/RooflineAnalysis.h"
+#include "Optimization/StandardPipeline.h"
+#include "Optimization/UnrollAndJam.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/WithColor.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
 
-int main() {
-    std::cout << "Hello, LLVM-DL Optimizer!" << std::endl;
-    return 0;
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+enum class EmitKind { LLVM, Bitcode, Assembly, Object };
+
+cl::OptionCategory DriverCategory("LLVM-DL Optimizer options");
+
+cl::opt<std::string> InputFilename(cl::Positional, cl::desc("[input .ll/.bc file]"), cl::init(""),
+                                   cl::cat(DriverCategory));
+
+cl::list<std::string> KernelSpecs("kernel",
+                                  cl::desc("Generate a kernel from a shape spec instead of reading input, e.g. "
+                                           "conv:input=1x3x?x?:filter=8x3x3:pad=1x1, conv:filter=8x3x3:dilation=2x2, "
+                                           "deconv:filter=8x4x4:stride=2x2:pad=1x1, "
+                                           "maxpool:kernel=2x2:stride=2x2, relu:size=1024:dtype=bf16, "
+                                           "spgemm:block=4x4:size=256, softmax:matrix=?x1000, "
+                                           "attention:input=?x128x128x64:block=4x64, reduce:op=mean:axes=2x3, "
+                                           "embedding:size=64, embedding-bag:size=?:op=mean"),
+                                  cl::value_desc("spec"), cl::cat(DriverCategory));
+
+cl::list<std::string> Pipeline("passes",
+                               cl::desc("Comma separated pipeline of project passes (loop-fusion, "
+                                        "data-layout-transform, auto-vectorization, kernel-profiling, profile-guided, "
+                                        "unroll-and-jam, roofline) and standard levels (O0-O3, Os, Oz)"),
+                               cl::CommaSeparated, cl::value_desc("pass,..."), cl::cat(DriverCategory));
+
+cl::opt<EmitKind> Emit("emit", cl::desc("Kind of output to produce"), cl::init(EmitKind::LLVM),
+                       cl::values(clEnumValN(EmitKind::LLVM, "llvm", "Textual LLVM IR"),
+                                  clEnumValN(EmitKind::Bitcode, "bc", "LLVM bitcode"),
+                                  clEnumValN(EmitKind::Assembly, "asm", "Target assembly"),
+                                  clEnumValN(EmitKind::Object, "obj", "Native object file")),
+                       cl::cat(DriverCategory));
+
+cl::opt<std::string> OutputFilename("o", cl::desc("Output filename"), cl::value_desc("filename"), cl::init("-"),
+                                    cl::cat(DriverCategory));
+
+cl::opt<std::string> TargetTriple("mtriple", cl::desc("Target triple (defaults to the host)"),
+                                  cl::cat(DriverCategory));
+
+cl::opt<std::string> TargetCPU("mcpu", cl::desc("Target CPU, or 'native' for the host CPU"), cl::init("generic"),
+                               cl::cat(DriverCategory));
+
+cl::opt<std::string> TargetFeatures("mattr", cl::desc("Target features, e.g. +avx2,+fma"), cl::init(""),
+                                    cl::cat(DriverCategory));
+
+cl::opt<char> CodeGenOptLevel("O", cl::desc("Code generation optimization level [0-3]"), cl::Prefix, cl::init('2'),
+                              cl::cat(DriverCategory));
+
+cl::opt<bool> Multiversion("multiversion",
+                           cl::desc("Emit SSE4.2/AVX2/AVX-512 (or NEON) variants of every kernel with a "
+                                    "runtime resolver that binds the best one for the host CPU"),
+                           cl::init(false), cl::cat(DriverCategory));
+
+cl::opt<unsigned> TensorAlign("tensor-align",
+                              cl::desc("Mark the tensor arguments of --kernel kernels nonnull and aligned to this "
+                                       "many bytes, with llvm.assume alignment facts, and noalias unless "
+                                       "the kernel may run in place (0 disables)"),
+                              cl::value_desc("bytes"), cl::init(0), cl::cat(DriverCategory));
+
+cl::opt<bool> PrintStats("report", cl::desc("Report per-pass timing and IR size statistics"), cl::init(false),
+                         cl::cat(DriverCategory));
+
+cl::opt<double> PeakGFlops("peak-gflops", cl::desc("Peak compute throughput assumed by the roofline pass"),
+                           cl::init(RooflineConfig().PeakGFlops), cl::cat(DriverCategory));
+
+cl::opt<double> PeakGBps("peak-gbps", cl::desc("Peak memory bandwidth assumed by the roofline pass"),
+                         cl::init(RooflineConfig().PeakGBps), cl::cat(DriverCategory));
+
+cl::opt<std::string> ProfileUse("profile-use",
+                               cl::desc("Kernel profile read by the profile-guided pass, as written by "
+                                        "KernelProfileData::writeToFile"),
+                               cl::value_desc("filename"), cl::init(""), cl::cat(DriverCategory));
+
+/// The profile loaded from --profile-use.
+KernelProfileData LoadedProfile;
+
+/// A project pass that can be named in the --passes pipeline.
+struct ProjectPass {
+  const char *Name;
+  Pass *(*Create)();
+};
+
+const ProjectPass ProjectPasses[] = {
+    {"loop-fusion", []() -> Pass * { return createLoopFusionPass(); }},
+    {"data-layout-transform", []() -> Pass * { return createDataLayoutTransformPass(); }},
+    {"auto-vectorization", []() -> Pass * { return createAutoVectorizationPass(); }},
+    {"kernel-profiling", []() -> Pass * { return createKernelProfilingPass(); }},
+    {"profile-guided", []() -> Pass * { return createProfileGuidedSpecializationPass(LoadedProfile); }},
+    {"unroll-and-jam", []() -> Pass * { return createUnrollAndJamPass(); }},
+    {"roofline",
+     []() -> Pass * {
+       RooflineConfig Config;
+       Config.PeakGFlops = PeakGFlops;
+       Config.PeakGBps = PeakGBps;
+       return createRooflineAnalysisPass(Config);
+     }},
+};
+
+/// A kernel generated from a --kernel spec, with the pointer parameters whose
+/// role as a tensor is known. Nullable and index parameters are left out.
+struct GeneratedKernel {
+  Function *Kernel;
+  SmallVector<TensorArgInfo, 4> Tensors;
+};
+
+/// The kernels generated from --kernel specs.
+std::vector<GeneratedKernel> GeneratedKernels;
+
+/// Size of the module at a point in the pipeline.
+struct IRSize {
+  unsigned Functions = 0;
+  unsigned BasicBlocks = 0;
+  unsigned Instructions = 0;
+};
+
+/// Timing and size statistics for one pipeline stage.
+struct StageStats {
+  std::string Name;
+  double Seconds;
+  IRSize Before;
+  IRSize After;
+};
+
+IRSize measureModule(const Module &M) {
+  IRSize Size;
+  for (const Function &F : M) {
+    if (F.isDeclaration())
+      continue;
+    ++Size.Functions;
+    Size.BasicBlocks += F.size();
+    Size.Instructions += F.getInstructionCount();
+  }
+  return Size;
+}
+
+/// Parse an "HxW" pair such as "2x2".
+bool parsePair(StringRef Value, unsigned &H, unsigned &W) {
+  StringRef HStr, WStr;
+  std::tie(HStr, WStr) = Value.split('x');
+  return !HStr.getAsInteger(10, H) && !WStr.getAsInteger(10, W);
+}
+
+/// Parse \p Count 'x'-separated extents such as "1x3x?x?", where '?' leaves
+/// the extent as a runtime argument.
+bool parseDims(StringRef Value, unsigned Count, SmallVectorImpl<int64_t> &Dims) {
+  SmallVector<StringRef, 4> Parts;
+  Value.split(Parts, 'x');
+  if (Parts.size() != Count)
+    return false;
+  Dims.clear();
+  for (StringRef Part : Parts) {
+    int64_t Extent;
+    if (Part == "?")
+      Extent = DynamicDim;
+    else if (Part.getAsInteger(10, Extent) || Extent <= 0)
+      return false;
+    Dims.push_back(Extent);
+  }
+  return true;
+}
+
+/// Describe tensor parameter \p ArgNo of a generated kernel. A parameter that
+/// may share storage with another one, as the input and output of an in-place
+/// activation do, is not noalias.
+TensorArgInfo describeTensor(unsigned ArgNo, bool ReadOnly, bool InPlace = false) {
+  TensorArgInfo Tensor;
+  Tensor.ArgNo = ArgNo;
+  Tensor.Dims = {DynamicDim};
+  Tensor.NoAlias = !InPlace;
+  Tensor.ReadOnly = ReadOnly;
+  return Tensor;
+}
+
+/// Generate the kernel described by \p Spec into \p M.
+/// A spec is a kernel name followed by ':'-separated key=value parameters.
+/// Extents that are not given stay runtime arguments of the kernel.
+bool generateKernel(Module &M, StringRef Spec) {
+  SmallVector<StringRef, 4> Parts;
+  Spec.split(Parts, ':');
+  StringRef Kind = Parts.front();
+
+  unsigned StrideH = 1, StrideW = 1, PadH = 0, PadW = 0, KernelH = 2, KernelW = 2, BlockH = 1, BlockW = 1,
+           DilationH = 1, DilationW = 1;
+  SmallVector<int64_t, 4> Input(4, DynamicDim), Filter(3, DynamicDim), Size(1, DynamicDim),
+      Matrix(2, DynamicDim);
+  TensorElementType ElemTy = TensorElementType::F32;
+  bool HasBlock = false;
+  ReductionKind Reduction = ReductionKind::Sum;
+  SmallVector<unsigned, 4> Axes;
+  for (StringRef Param : drop_begin(Parts)) {
+    StringRef Key, Value;
+    std::tie(Key, Value) = Param.split('=');
+    bool Parsed = false;
+    if (Key == "stride")
+      Parsed = parsePair(Value, StrideH, StrideW);
+    else if (Key == "pad")
+      Parsed = parsePair(Value, PadH, PadW);
+    else if (Key == "kernel")
+      Parsed = parsePair(Value, KernelH, KernelW);
+    else if (Key == "dilation")
+      Parsed = parsePair(Value, DilationH, DilationW) && DilationH && DilationW;
+    else if (Key == "block")
+      Parsed = HasBlock = parsePair(Value, BlockH, BlockW) && BlockH && BlockW;
+    else if (Key == "input")
+      Parsed = parseDims(Value, 4, Input);
+    else if (Key == "filter")
+      Parsed = parseDims(Value, 3, Filter);
+    else if (Key == "size")
+      Parsed = parseDims(Value, 1, Size);
+    else if (Key == "matrix")
+      Parsed = parseDims(Value, 2, Matrix);
+    else if (Key == "op") {
+      Optional<ReductionKind> Op = parseReductionKind(Value);
+      Parsed = Op.hasValue();
+      Reduction = Op.getValueOr(Reduction);
+    } else if (Key == "axes") {
+      // Distinct axes of the 4-D input, such as 2x3
+      SmallVector<StringRef, 4> AxisNames;
+      Value.split(AxisNames, 'x');
+      Axes.clear();
+      Parsed = true;
+      for (StringRef AxisName : AxisNames) {
+        unsigned Axis;
+        Parsed &= !AxisName.getAsInteger(10, Axis) && Axis < 4 && !is_contained(Axes, Axis);
+        Axes.push_back(Axis);
+      }
+    } else if (Key == "dtype") {
+      Optional<TensorElementType> Element = parseTensorElementType(Value);
+      Parsed = Element.hasValue();
+      ElemTy = Element.getValueOr(ElemTy);
+    }
+    if (!Parsed) {
+      WithColor::error() << "invalid parameter '" << Param << "' in kernel spec '" << Spec << "'\n";
+      return false;
+    }
+  }
+
+  Function *F;
+  SmallVector<TensorArgInfo, 4> Tensors;
+  if (Kind == "conv") {
+    ConvolutionDims Dims;
+    Dims.N = Input[0], Dims.C = Input[1], Dims.H = Input[2], Dims.W = Input[3];
+    Dims.K = Filter[0], Dims.R = Filter[1], Dims.S = Filter[2];
+    if (DilationH == 1 && DilationW == 1)
+      F = createConvolutionFunction(M, Dims, StrideH, StrideW, PadH, PadW, "convolution", ElemTy);
+    else
+      F = createDilatedConvolutionFunction(M, Dims, StrideH, StrideW, PadH, PadW, DilationH, DilationW,
+                                           "convolution", ElemTy);
+    Tensors = {describeTensor(0, true), describeTensor(1, true), describeTensor(2, false)};
+  } else if (Kind == "deconv") {
+    ConvolutionDims Dims;
+    Dims.N = Input[0], Dims.C = Input[1], Dims.H = Input[2], Dims.W = Input[3];
+    Dims.K = Filter[0], Dims.R = Filter[1], Dims.S = Filter[2];
+    F = createTransposedConvolutionFunction(M, Dims, StrideH, StrideW, PadH, PadW, "transposedConvolution", ElemTy);
+    Tensors = {describeTensor(0, true), describeTensor(1, true), describeTensor(2, false)};
+  } else if (Kind == "maxpool") {
+    PoolingDims Dims;
+    Dims.N = Input[0], Dims.C = Input[1], Dims.H = Input[2], Dims.W = Input[3];
+    F = createMaxPoolingFunction(M, Dims, KernelH, KernelW, StrideH, StrideW, "maxPooling", ElemTy);
+    Tensors = {describeTensor(0, true), describeTensor(1, false)};
+  } else if (Kind == "relu") {
+    F = createReLUFunction(M, Size[0], "ReLU", ElemTy);
+    Tensors = {describeTensor(0, true, true), describeTensor(1, false, true)};
+  } else if (Kind == "spgemm") {
+    // The block offsets and column indices are index arrays, not tensors
+    F = createSparseGemmFunction(M, BlockH, BlockW, Size[0]);
+    Tensors = {describeTensor(2, true), describeTensor(3, true), describeTensor(4, false)};
+  } else if (Kind == "softmax") {
+    F = createSoftmaxFunction(M, Matrix[0], Matrix[1]);
+    Tensors = {describeTensor(0, true, true), describeTensor(1, false, true)};
+  } else if (Kind == "layernorm") {
+    F = createLayerNormFunction(M, Matrix[0], Matrix[1]);
+    Tensors = {describeTensor(0, true, true), describeTensor(1, true), describeTensor(2, true),
+               describeTensor(3, false, true)};
+  } else if (Kind == "attention") {
+    // input=BxSqxSkxD gives batch, query length, key length and head size
+    AttentionDims Dims;
+    Dims.Batch = Input[0], Dims.SeqQ = Input[1], Dims.SeqK = Input[2], Dims.HeadDim = Input[3];
+    if (HasBlock)
+      F = createAttentionFunction(M, Dims, BlockH, BlockW);
+    else
+      F = createAttentionFunction(M, Dims);
+    Tensors = {describeTensor(0, true), describeTensor(1, true), describeTensor(2, true), describeTensor(3, false)};
+  } else if (Kind == "reduce") {
+    if (Axes.empty())
+      Axes.push_back(3);
+    // indices may be null and shape is an extent array
+    F = createReductionFunction(M, Reduction, Input, Axes);
+    Tensors = {describeTensor(0, true), describeTensor(1, false)};
+  } else if (Kind == "embedding") {
+    F = createEmbeddingLookupFunction(M, Size[0]);
+    Tensors = {describeTensor(0, true), describeTensor(2, false)};
+  } else if (Kind == "embedding-bag") {
+    if (Reduction != ReductionKind::Sum && Reduction != ReductionKind::Mean) {
+      WithColor::error() << "embedding bags only pool with op=sum or op=mean\n";
+      return false;
+    }
+    F = createEmbeddingBagFunction(M, Reduction == ReductionKind::Mean ? EmbeddingBagMode::Mean : EmbeddingBagMode::Sum,
+                                   Size[0]);
+    Tensors = {describeTensor(0, true), describeTensor(3, false)};
+  } else if (Kind == "spconv") {
+    ConvolutionDims Dims;
+    Dims.N = Input[0], Dims.C = Input[1], Dims.H = Input[2], Dims.W = Input[3];
+    Dims.K = Filter[0], Dims.R = Filter[1], Dims.S = Filter[2];
+    F = createSparseConvolutionFunction(M, Dims, BlockH, BlockW, StrideH, StrideW, PadH, PadW);
+    Tensors = {describeTensor(0, true), describeTensor(3, true), describeTensor(4, false)};
+  } else {
+    WithColor::error() << "unknown kernel '" << Kind << "'\n";
+    return false;
+  }
+  GeneratedKernels.push_back({F, std::move(Tensors)});
+  return true;
+}
+
+/// Run a single project pass over the module.
+void runProjectPass(Module &M, TargetMachine &TM, const ProjectPass &Pass) {
+  legacy::PassManager PM;
+  PM.add(createTargetTransformInfoWrapperPass(TM.getTargetIRAnalysis()));
+  PM.add(Pass.Create());
+  PM.run(M);
+}
+
+/// Run the --passes pipeline, recording statistics for each stage.
+bool runPipeline(Module &M, TargetMachine &TM, std::vector<StageStats> &Stats) {
+  for (const std::string &Name : Pipeline) {
+    Optional<OptimizationLevel> Level = StringSwitch<Optional<OptimizationLevel>>(Name)
+                                            .Case("O0", OptimizationLevel::O0)
+                                            .Case("O1", OptimizationLevel::O1)
+                                            .Case("O2", OptimizationLevel::O2)
+                                            .Case("O3", OptimizationLevel::O3)
+                                            .Case("Os", OptimizationLevel::Os)
+                                            .Case("Oz", OptimizationLevel::Oz)
+                                            .Default(None);
+    const auto *Pass = find_if(ProjectPasses, [&](const ProjectPass &P) { return Name == P.Name; });
+    if (!Level && Pass == std::end(ProjectPasses)) {
+      WithColor::error() << "unknown pass '" << Name << "' in pipeline\n";
+      return false;
+    }
+
+    StageStats Stage{Name, 0.0, measureModule(M), {}};
+    auto Start = std::chrono::steady_clock::now();
+    if (Level)
+      runStandardPipeline(M, &TM, *Level);
+    else
+      runProjectPass(M, TM, *Pass);
+    Stage.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+    Stage.After = measureModule(M);
+    Stats.push_back(Stage);
+
+    std::string Error;
+    raw_string_ostream ErrorStream(Error);
+    if (verifyModule(M, &ErrorStream)) {
+      WithColor::error() << "module is broken after '" << Name << "': " << ErrorStream.str() << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+void printStats(const std::vector<StageStats> &Stats) {
+  double Total = 0.0;
+  errs() << "===" << std::string(73, '-') << "===\n"
+         << "                      LLVM-DL Optimizer pipeline report\n"
+         << "===" << std::string(73, '-') << "===\n";
+  errs() << "  Pass                      Time (ms)    Functions       Blocks   Instructions\n";
+  for (const StageStats &Stage : Stats) {
+    errs() << format("  %-24s %10.3f %5u -> %-4u %5u -> %-4u %6u -> %-6u\n", Stage.Name.c_str(),
+                     Stage.Seconds * 1000.0, Stage.Before.Functions, Stage.After.Functions,
+                     Stage.Before.BasicBlocks, Stage.After.BasicBlocks, Stage.Before.Instructions,
+                     Stage.After.Instructions);
+    Total += Stage.Seconds;
+  }
+  errs() << format("  Total                    %10.3f\n", Total * 1000.0);
+}
+
+std::unique_ptr<TargetMachine> createTargetMachine(Module &M) {
+  std::string Triple = TargetTriple.empty() ? sys::getDefaultTargetTriple() : TargetTriple;
+  std::string Error;
+  const Target *TheTarget = TargetRegistry::lookupTarget(Triple, Error);
+  if (!TheTarget) {
+    WithColor::error() << Error << "\n";
+    return nullptr;
+  }
+
+  std::string CPU = TargetCPU == "native" ? sys::getHostCPUName().str() : TargetCPU.getValue();
+  std::string Features = TargetFeatures;
+  if (TargetCPU == "native" && Features.empty()) {
+    StringMap<bool> HostFeatures;
+    if (sys::getHostCPUFeatures(HostFeatures)) {
+      SubtargetFeatures SF;
+      for (auto &Feature : HostFeatures)
+        SF.AddFeature(Feature.first(), Feature.second);
+      Features = SF.getString();
+    }
+  }
+
+  CodeGenOpt::Level OptLevel = CodeGenOpt::Default;
+  switch (CodeGenOptLevel) {
+  case '0': OptLevel = CodeGenOpt::None; break;
+  case '1': OptLevel = CodeGenOpt::Less; break;
+  case '2': OptLevel = CodeGenOpt::Default; break;
+  case '3': OptLevel = CodeGenOpt::Aggressive; break;
+  default:
+    WithColor::error() << "invalid optimization level -O" << CodeGenOptLevel << "\n";
+    return nullptr;
+  }
+
+  std::unique_ptr<TargetMachine> TM(TheTarget->createTargetMachine(Triple, CPU, Features, TargetOptions(),
+                                                                   Reloc::PIC_, None, OptLevel));
+  M.setTargetTriple(Triple);
+  M.setDataLayout(TM->createDataLayout());
+  return TM;
+}
+
+bool emitOutput(Module &M, TargetMachine &TM) {
+  bool IsText = Emit == EmitKind::LLVM || Emit == EmitKind::Assembly;
+  std::error_code EC;
+  ToolOutputFile Out(OutputFilename, EC, IsText ? sys::fs::OF_Text : sys::fs::OF_None);
+  if (EC) {
+    WithColor::error() << EC.message() << "\n";
+    return false;
+  }
+
+  switch (Emit) {
+  case EmitKind::LLVM:
+    M.print(Out.os(), nullptr);
+    break;
+  case EmitKind::Bitcode:
+    WriteBitcodeToFile(M, Out.os());
+    break;
+  case EmitKind::Assembly:
+  case EmitKind::Object: {
+    legacy::PassManager CodeGenPM;
+    CodeGenFileType FileType = Emit == EmitKind::Assembly ? CGFT_AssemblyFile : CGFT_ObjectFile;
+    if (TM.addPassesToEmitFile(CodeGenPM, Out.os(), nullptr, FileType)) {
+      WithColor::error() << "target does not support emitting this file type\n";
+      return false;
+    }
+    CodeGenPM.run(M);
+    break;
+  }
+  }
+
+  Out.keep();
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  InitLLVM X(argc, argv);
+
+  InitializeAllTargetInfos();
+  InitializeAllTargets();
+  InitializeAllTargetMCs();
+  InitializeAllAsmPrinters();
+  InitializeAllAsmParsers();
+
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  initializeCore(Registry);
+  initializeAnalysis(Registry);
+  initializeTransformUtils(Registry);
+  initializeVectorization(Registry);
+  initializeTarget(Registry);
+
+  cl::HideUnrelatedOptions(DriverCategory);
+  cl::ParseCommandLineOptions(argc, argv, "LLVM-DL Optimizer\n");
+
+  LLVMContext Context;
+  std::unique_ptr<Module> M;
+  if (!InputFilename.empty()) {
+    if (!KernelSpecs.empty()) {
+      WithColor::error() << "cannot combine an input file with --kernel\n";
+      return 1;
+    }
+    SMDiagnostic Err;
+    M = parseIRFile(InputFilename, Err, Context);
+    if (!M) {
+      Err.print(argv[0], errs());
+      return 1;
+    }
+  } else {
+    if (KernelSpecs.empty()) {
+      WithColor::error() << "no input file or --kernel spec given\n";
+      return 1;
+    }
+    M = std::make_unique<Module>("llvm-dl-kernels", Context);
+    for (const std::string &Spec : KernelSpecs)
+      if (!generateKernel(*M, Spec))
+        return 1;
+  }
+
+  std::string Error;
+  raw_string_ostream ErrorStream(Error);
+  if (verifyModule(*M, &ErrorStream)) {
+    WithColor::error() << "input module is broken: " << ErrorStream.str() << "\n";
+    return 1;
+  }
+
+  if (!ProfileUse.empty()) {
+    auto Profile = KernelProfileData::readFromFile(ProfileUse);
+    if (!Profile) {
+      WithColor::error() << toString(Profile.takeError()) << "\n";
+      return 1;
+    }
+    LoadedProfile = std::move(*Profile);
+  }
+
+  std::unique_ptr<TargetMachine> TM = createTargetMachine(*M);
+  if (!TM)
+    return 1;
+
+  if (TensorAlign) {
+    if (!isPowerOf2_32(TensorAlign)) {
+      WithColor::error() << "--tensor-align must be a power of two\n";
+      return 1;
+    }
+    // The roles of the parameters of an input module are unknown
+    if (GeneratedKernels.empty())
+      WithColor::warning() << "--tensor-align only applies to --kernel kernels\n";
+    // Extents are unknown here, so no dereferenceable bytes are claimed
+    for (GeneratedKernel &Generated : GeneratedKernels) {
+      for (TensorArgInfo &Tensor : Generated.Tensors)
+        Tensor.Alignment = TensorAlign;
+      addTensorArgumentGuarantees(*Generated.Kernel, Generated.Tensors);
+    }
+  }
+
+  if (Multiversion) {
+    SmallVector<KernelISA, 4> ISAs = getMultiversionISAs(TM->getTargetTriple());
+    SmallVector<Function *, 8> Kernels;
+    for (Function &F : *M)
+      if (!F.isDeclaration() && !F.hasLocalLinkage())
+        Kernels.push_back(&F);
+    for (Function *Kernel : Kernels)
+      createMultiversionedKernel(*M, *Kernel, ISAs);
+  }
+
+  std::vector<StageStats> Stats;
+  if (!runPipeline(*M, *TM, Stats))
+    return 1;
+  if (PrintStats)
+    printStats(Stats);
+
+  return emitOutput(*M, *TM) ? 0 : 1;
 }
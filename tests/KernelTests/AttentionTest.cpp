@@ -0,0 +1,117 @@
+#include "Kernels/Attention.h"
+#include "Kernels/Gemm.h"
+#include "Runtime/KernelJIT.h"
+#include "TestUtils.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <functional>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+using AttentionFn = void(const float *, const float *, const float *, float *, int64_t, int64_t, int64_t, int64_t);
+using BatchedGemmFn = void(const float *, const float *, float *, int64_t, int64_t, int64_t, int64_t);
+
+/// Attention computed with the full score matrix of each batch entry.
+std::vector<float> referenceAttention(const std::vector<float> &Q, const std::vector<float> &K,
+                                      const std::vector<float> &V, int64_t Batch, int64_t SeqQ, int64_t SeqK,
+                                      int64_t HeadDim, bool Causal) {
+  std::vector<float> Out(Batch * SeqQ * HeadDim, 0.0f);
+  for (int64_t B = 0; B < Batch; ++B)
+    for (int64_t I = 0; I < SeqQ; ++I) {
+      int64_t Keys = Causal ? I + SeqK - SeqQ + 1 : SeqK;
+      std::vector<double> Scores(Keys);
+      double Max = -INFINITY, Sum = 0.0;
+      for (int64_t J = 0; J < Keys; ++J) {
+        double Dot = 0.0;
+        for (int64_t D = 0; D < HeadDim; ++D)
+          Dot += Q[(B * SeqQ + I) * HeadDim + D] * K[(B * SeqK + J) * HeadDim + D];
+        Scores[J] = Dot / std::sqrt(static_cast<double>(HeadDim));
+        Max = std::max(Max, Scores[J]);
+      }
+      for (int64_t J = 0; J < Keys; ++J)
+        Sum += Scores[J] = std::exp(Scores[J] - Max);
+      for (int64_t D = 0; D < HeadDim; ++D) {
+        double Acc = 0.0;
+        for (int64_t J = 0; J < Keys; ++J)
+          Acc += Scores[J] * V[(B * SeqK + J) * HeadDim + D];
+        Out[(B * SeqQ + I) * HeadDim + D] = Acc / Sum;
+      }
+    }
+  return Out;
+}
+
+TEST(AttentionTest, MatchesReference) {
+  std::unique_ptr<KernelJIT> JIT;
+  auto *Attention = compile<AttentionFn>(JIT, [](Module &M) { return createAttentionFunction(M, {}, 4, 16); });
+
+  // Partial query and key tiles, and a head dimension with a scalar remainder
+  const int64_t Batch = 2, SeqQ = 7, SeqK = 37, HeadDim = 13;
+  auto Q = makeData(Batch * SeqQ * HeadDim, 1);
+  auto K = makeData(Batch * SeqK * HeadDim, 2);
+  auto V = makeData(Batch * SeqK * HeadDim, 3);
+  std::vector<float> Out(Q.size(), -1.0f);
+  Attention(Q.data(), K.data(), V.data(), Out.data(), Batch, SeqQ, SeqK, HeadDim);
+
+  auto Expected = referenceAttention(Q, K, V, Batch, SeqQ, SeqK, HeadDim, false);
+  for (size_t I = 0; I < Out.size(); ++I)
+    EXPECT_NEAR(Out[I], Expected[I], 1e-4f) << "at " << I;
+}
+
+TEST(AttentionTest, CausalMasksLaterKeys) {
+  std::unique_ptr<KernelJIT> JIT;
+  AttentionDims Dims;
+  Dims.HeadDim = 16;
+  auto *Attention =
+      compile<AttentionFn>(JIT, [&](Module &M) { return createAttentionFunction(M, Dims, 3, 8, true); });
+
+  // Query i sees keys up to i + 5, so the first rows skip the later key tiles
+  const int64_t Batch = 1, SeqQ = 10, SeqK = 15, HeadDim = 16;
+  auto Q = makeData(Batch * SeqQ * HeadDim, 4);
+  auto K = makeData(Batch * SeqK * HeadDim, 5);
+  auto V = makeData(Batch * SeqK * HeadDim, 6);
+  std::vector<float> Out(Q.size(), -1.0f);
+  Attention(Q.data(), K.data(), V.data(), Out.data(), Batch, SeqQ, SeqK, 0);
+
+  auto Expected = referenceAttention(Q, K, V, Batch, SeqQ, SeqK, HeadDim, true);
+  for (size_t I = 0; I < Out.size(); ++I)
+    EXPECT_NEAR(Out[I], Expected[I], 1e-4f) << "at " << I;
+}
+
+TEST(AttentionTest, BatchedGemmProjections) {
+  std::unique_ptr<KernelJIT> PlainJIT, TransposedJIT;
+  auto *Project = compile<BatchedGemmFn>(
+      PlainJIT, [](Module &M) { return createBatchedGemmFunction(M, {}, DynamicDim, false, true); });
+  auto *ProjectT = compile<BatchedGemmFn>(
+      TransposedJIT, [](Module &M) { return createBatchedGemmFunction(M, {}, DynamicDim, true, false); });
+
+  // X[b] (MxK) times a shared weight W (KxN), and per-batch X[b] times Y[b]^T
+  const int64_t Batch = 3, M = 5, K = 11, N = 10;
+  auto X = makeData(Batch * M * K, 7);
+  auto W = makeData(K * N, 8);
+  auto Y = makeData(Batch * N * K, 9);
+  std::vector<float> C(Batch * M * N, -1.0f), CT(Batch * M * N, -1.0f);
+  Project(X.data(), W.data(), C.data(), Batch, M, K, N);
+  ProjectT(X.data(), Y.data(), CT.data(), Batch, M, K, N);
+
+  for (int64_t B = 0; B < Batch; ++B)
+    for (int64_t Row = 0; Row < M; ++Row)
+      for (int64_t Col = 0; Col < N; ++Col) {
+        float Expected = 0.0f, ExpectedT = 0.0f;
+        for (int64_t I = 0; I < K; ++I) {
+          Expected += X[(B * M + Row) * K + I] * W[I * N + Col];
+          ExpectedT += X[(B * M + Row) * K + I] * Y[(B * N + Col) * K + I];
+        }
+        EXPECT_NEAR(C[(B * M + Row) * N + Col], Expected, 1e-3f);
+        EXPECT_NEAR(CT[(B * M + Row) * N + Col], ExpectedT, 1e-3f);
+      }
+}
+
+} // namespace
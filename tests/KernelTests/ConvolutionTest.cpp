@@ -1,63 +1,122 @@
 #include "Kernels/Convolution.h"
+#include "Runtime/KernelJIT.h"
+#include "TestUtils.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
-#include "llvm/IR/Function.h"
 #include "llvm/IR/Type.h"
-#include "llvm/IR/Constants.h"
-#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
 
+#include <functional>
+#include <vector>
+
 using namespace llvm;
 
 namespace {
 
+using FixedConvFn = void(const float *, const float *, float *);
+using ConvFn = void(const float *, const float *, float *, int64_t, int64_t, int64_t, int64_t, int64_t, int64_t,
+                    int64_t);
+
 TEST(ConvolutionTest, SimpleConvolution) {
-  LLVMContext Context;
-  Module M("ConvolutionTestModule", Context);
-
-  Type *FloatTy = Type::getFloatTy(Context);
-  Type *InputTy = PointerType::get(FloatTy, 0);
-  Type *WeightTy = PointerType::get(FloatTy, 0);
-  Type *OutputTy = PointerType::get(FloatTy, 0);
-
-  Function *ConvFunc = createConvolutionFunction(M, InputTy, WeightTy, OutputTy, 1, 1, 0, 0);
-  ASSERT_TRUE(ConvFunc != nullptr);
-
-  // Create input and weight tensors
-  std::vector<float> InputData = {1.0f, 2.0f, 3.0f, 4.0f};
-  std::vector<float> WeightData = {0.5f, 0.5f, 0.5f, 0.5f};
-  Constant *InputTensor = ConstantDataArray::get(Context, InputData);
-  Constant *WeightTensor = ConstantDataArray::get(Context, WeightData);
-
-  // Create output tensor
-  std::vector<float> OutputData(4, 0.0f);
-  GlobalVariable *OutputTensor = new GlobalVariable(M, ArrayType::get(FloatTy, 4), false,
-                                                    GlobalValue::ExternalLinkage, nullptr, "output");
-  OutputTensor->setInitializer(ConstantDataArray::get(Context, OutputData));
-
-  // Create and run the test function
-  Function *TestFunc = Function::Create(FunctionType::get(Type::getVoidTy(Context), false),
-                                        GlobalValue::ExternalLinkage, "testConvolution", &M);
-  BasicBlock *BB = BasicBlock::Create(Context, "entry", TestFunc);
-  IRBuilder<> Builder(BB);
-
-  Value *InputPtr = Builder.CreatePointerCast(InputTensor, InputTy);
-  Value *WeightPtr = Builder.CreatePointerCast(WeightTensor, WeightTy);
-  Value *OutputPtr = Builder.CreatePointerCast(OutputTensor, OutputTy);
-  Builder.CreateCall(ConvFunc, {InputPtr, WeightPtr, OutputPtr});
-  Builder.CreateRetVoid();
-
-  // Verify the module
-  std::string ErrorMessage;
-  raw_string_ostream ErrorStream(ErrorMessage);
-  if (verifyModule(M, &ErrorStream)) {
-    FAIL() << "Module verification failed: " << ErrorMessage;
+  std::unique_ptr<KernelJIT> JIT;
+  auto *Conv = compile<FixedConvFn>(JIT, [](Module &M) {
+    Type *TensorTy = PointerType::get(Type::getFloatTy(M.getContext()), 0);
+    return createConvolutionFunction(M, TensorTy, TensorTy, TensorTy, 1, 1, 0, 0);
+  });
+
+  // The fixed-size variant convolves a 32x32 input with a 3x3 filter
+  auto Input = makeData(32 * 32, 1, 0.125f), Weight = makeData(3 * 3, 5, 0.125f);
+  std::vector<float> Output(30 * 30, -1.0f);
+  Conv(Input.data(), Weight.data(), Output.data());
+
+  for (int64_t y = 0; y < 30; ++y)
+    for (int64_t x = 0; x < 30; ++x) {
+      float Expected = 0.0f;
+      for (int64_t r = 0; r < 3; ++r)
+        for (int64_t s = 0; s < 3; ++s)
+          Expected += Input[(y + r) * 32 + x + s] * Weight[r * 3 + s];
+      EXPECT_NEAR(Output[y * 30 + x], Expected, 1e-4f) << "output " << y << "," << x;
+    }
+}
+
+TEST(ConvolutionTest, DilatedConvolution) {
+  const ConvolutionDims D{1, 2, 9, 8, 3, 3, 3};
+  const unsigned Stride = 1, Pad = 2, Dilation = 2;
+  const int64_t OH = (D.H + 2 * Pad - Dilation * (D.R - 1) - 1) / Stride + 1;
+  const int64_t OW = (D.W + 2 * Pad - Dilation * (D.S - 1) - 1) / Stride + 1;
+  auto Input = makeData(D.N * D.C * D.H * D.W, 1, 0.125f), Weight = makeData(D.K * D.C * D.R * D.S, 5, 0.125f);
+
+  std::vector<float> Expected(D.N * D.K * OH * OW, 0.0f);
+  for (int64_t k = 0; k < D.K; ++k)
+    for (int64_t y = 0; y < OH; ++y)
+      for (int64_t x = 0; x < OW; ++x)
+        for (int64_t c = 0; c < D.C; ++c)
+          for (int64_t r = 0; r < D.R; ++r)
+            for (int64_t s = 0; s < D.S; ++s) {
+              int64_t iy = y * Stride + r * Dilation - Pad, ix = x * Stride + s * Dilation - Pad;
+              if (iy >= 0 && iy < D.H && ix >= 0 && ix < D.W)
+                Expected[(k * OH + y) * OW + x] +=
+                    Input[(c * D.H + iy) * D.W + ix] * Weight[((k * D.C + c) * D.R + r) * D.S + s];
+            }
+
+  // Both the shape-generic and the fully specialized variants
+  for (const ConvolutionDims &Dims : {ConvolutionDims(), D}) {
+    std::unique_ptr<KernelJIT> JIT;
+    auto *Conv = compile<ConvFn>(JIT, [&](Module &M) {
+      return createDilatedConvolutionFunction(M, Dims, Stride, Stride, Pad, Pad, Dilation, Dilation);
+    });
+    std::vector<float> Output(Expected.size(), -7.0f);
+    Conv(Input.data(), Weight.data(), Output.data(), D.N, D.C, D.H, D.W, D.K, D.R, D.S);
+    for (size_t I = 0; I < Expected.size(); ++I)
+      ASSERT_NEAR(Output[I], Expected[I], 1e-4f) << I;
   }
+}
 
-  // Compare the output tensor with the expected result
-  std::vector<float> ExpectedOutput = {2.5f, 3.5f, 4.5f, 5.5f};
-  Constant *ExpectedTensor = ConstantDataArray::get(Context, ExpectedOutput);
-  EXPECT_TRUE(OutputTensor->getInitializer()->isElementWiseEqual(ExpectedTensor));
+TEST(ConvolutionTest, TransposedConvolutionMatchesZeroInsertion) {
+  struct Case {
+    ConvolutionDims Dims;
+    unsigned Stride, Pad;
+  };
+  // Upsampling by 2 with a 4x4 or 3x3 filter, by 3 with a filter smaller than the stride
+  const Case Cases[] = {{{2, 3, 4, 5, 2, 4, 4}, 2, 1}, {{1, 2, 3, 3, 3, 3, 3}, 2, 0}, {{1, 2, 3, 4, 2, 2, 2}, 3, 0}};
+  for (const Case &T : Cases) {
+    const ConvolutionDims &D = T.Dims;
+    const int64_t OH = (D.H - 1) * T.Stride + D.R - 2 * T.Pad, OW = (D.W - 1) * T.Stride + D.S - 2 * T.Pad;
+    auto Input = makeData(D.N * D.C * D.H * D.W, 2, 0.125f), Weight = makeData(D.C * D.K * D.R * D.S, 3, 0.125f);
+
+    // Reference: insert Stride - 1 zeros between input pixels, pad by R - 1 - Pad
+    // and run a stride-1 convolution with the flipped, transposed filter
+    const int64_t UH = (D.H - 1) * T.Stride + 1, UW = (D.W - 1) * T.Stride + 1;
+    const int64_t PH = D.R - 1 - T.Pad, PW = D.S - 1 - T.Pad;
+    std::vector<float> Expected(D.N * D.K * OH * OW, 0.0f);
+    for (int64_t n = 0; n < D.N; ++n)
+      for (int64_t k = 0; k < D.K; ++k)
+        for (int64_t y = 0; y < OH; ++y)
+          for (int64_t x = 0; x < OW; ++x)
+            for (int64_t c = 0; c < D.C; ++c)
+              for (int64_t r = 0; r < D.R; ++r)
+                for (int64_t s = 0; s < D.S; ++s) {
+                  int64_t uy = y + r - PH, ux = x + s - PW;
+                  if (uy < 0 || uy >= UH || ux < 0 || ux >= UW || uy % T.Stride || ux % T.Stride)
+                    continue;
+                  float In = Input[((n * D.C + c) * D.H + uy / T.Stride) * D.W + ux / T.Stride];
+                  float Wt = Weight[((c * D.K + k) * D.R + (D.R - 1 - r)) * D.S + (D.S - 1 - s)];
+                  Expected[((n * D.K + k) * OH + y) * OW + x] += In * Wt;
+                }
+
+    for (const ConvolutionDims &Dims : {ConvolutionDims(), D}) {
+      std::unique_ptr<KernelJIT> JIT;
+      auto *Deconv = compile<ConvFn>(JIT, [&](Module &M) {
+        return createTransposedConvolutionFunction(M, Dims, T.Stride, T.Stride, T.Pad, T.Pad);
+      });
+      std::vector<float> Output(Expected.size(), -7.0f);
+      Deconv(Input.data(), Weight.data(), Output.data(), D.N, D.C, D.H, D.W, D.K, D.R, D.S);
+      for (size_t I = 0; I < Expected.size(); ++I)
+        ASSERT_NEAR(Output[I], Expected[I], 1e-4f) << "stride " << T.Stride << " index " << I;
+    }
+  }
 }
 
-} // namespace
\ No newline at end of file
+} // namespace
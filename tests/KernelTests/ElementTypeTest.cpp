@@ -0,0 +1,127 @@
+#include "Kernels/Activation.h"
+#include "Kernels/Convolution.h"
+#include "Kernels/ElementType.h"
+#include "Kernels/Pooling.h"
+#include "Runtime/KernelJIT.h"
+#include "TestUtils.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+float fromBF16(uint16_t Bits) {
+  uint32_t Wide = static_cast<uint32_t>(Bits) << 16;
+  float Val;
+  std::memcpy(&Val, &Wide, sizeof(Val));
+  return Val;
+}
+
+uint16_t toBF16(float Val) {
+  uint32_t Bits;
+  std::memcpy(&Bits, &Val, sizeof(Bits));
+  return static_cast<uint16_t>((Bits + 0x7fff + ((Bits >> 16) & 1)) >> 16);
+}
+
+TEST(ElementTypeTest, ParseNames) {
+  for (auto ElemTy : {TensorElementType::F32, TensorElementType::F16, TensorElementType::BF16})
+    EXPECT_EQ(parseTensorElementType(getTensorElementTypeName(ElemTy)), ElemTy);
+  EXPECT_FALSE(parseTensorElementType("f64").hasValue());
+}
+
+TEST(ElementTypeTest, BF16ReLU) {
+  std::unique_ptr<KernelJIT> JIT;
+  auto *ReLU = compile<void(uint16_t *, uint16_t *, int64_t)>(
+      JIT, [](Module &M) { return createReLUFunction(M, DynamicDim, "ReLU", TensorElementType::BF16); });
+
+  std::vector<float> Values = {-2.5f, -0.0f, 0.0f, 1.5f, 3.140625f, -1e30f, 1e30f,
+                               std::numeric_limits<float>::infinity()};
+  std::vector<uint16_t> Input, Output(Values.size(), 0xffff);
+  for (float Val : Values)
+    Input.push_back(toBF16(Val));
+  ReLU(Input.data(), Output.data(), Input.size());
+
+  for (size_t I = 0; I < Values.size(); ++I)
+    EXPECT_EQ(fromBF16(Output[I]), std::max(fromBF16(Input[I]), 0.0f)) << "element " << I;
+}
+
+TEST(ElementTypeTest, BF16ConvolutionAccumulatesInFP32) {
+  std::unique_ptr<KernelJIT> JIT;
+  auto *Conv = compile<void(uint16_t *, uint16_t *, uint16_t *, int64_t, int64_t, int64_t, int64_t, int64_t,
+                            int64_t, int64_t)>(JIT, [](Module &M) {
+    ConvolutionDims Dims{1, 4, 5, 5, 2, 3, 3};
+    return createConvolutionFunction(M, Dims, 1, 1, 1, 1, "convolution", TensorElementType::BF16);
+  });
+
+  const int64_t C = 4, H = 5, W = 5, K = 2, R = 3, S = 3;
+  std::vector<uint16_t> Input(C * H * W), Weight(K * C * R * S), Output(K * H * W);
+  for (size_t I = 0; I < Input.size(); ++I)
+    Input[I] = toBF16(std::sin(static_cast<float>(I)) * 3.0f);
+  for (size_t I = 0; I < Weight.size(); ++I)
+    Weight[I] = toBF16(std::cos(static_cast<float>(I)) * 0.7f);
+  Conv(Input.data(), Weight.data(), Output.data(), 1, C, H, W, K, R, S);
+
+  // Products of widened elements summed in fp32, rounded once on store
+  for (int64_t k = 0; k < K; ++k)
+    for (int64_t y = 0; y < H; ++y)
+      for (int64_t x = 0; x < W; ++x) {
+        float Acc = 0.0f;
+        for (int64_t c = 0; c < C; ++c)
+          for (int64_t r = 0; r < R; ++r)
+            for (int64_t s = 0; s < S; ++s) {
+              int64_t iy = y + r - 1, ix = x + s - 1;
+              if (iy < 0 || iy >= H || ix < 0 || ix >= W)
+                continue;
+              Acc += fromBF16(Input[(c * H + iy) * W + ix]) * fromBF16(Weight[((k * C + c) * R + r) * S + s]);
+            }
+        EXPECT_EQ(Output[(k * H + y) * W + x], toBF16(Acc)) << "output " << k << "," << y << "," << x;
+      }
+}
+
+TEST(ElementTypeTest, BF16NarrowingRoundsToNearestEven) {
+  std::unique_ptr<KernelJIT> JIT;
+  // A two-channel 1x1 convolution with unit weights adds its inputs in fp32,
+  // so the stored sum can fall between two bf16 values
+  auto *Conv = compile<void(uint16_t *, uint16_t *, uint16_t *, int64_t, int64_t, int64_t, int64_t, int64_t,
+                            int64_t, int64_t)>(JIT, [](Module &M) {
+    ConvolutionDims Dims{1, 2, 1, 1, 1, 1, 1};
+    return createConvolutionFunction(M, Dims, 1, 1, 0, 0, "convolution", TensorElementType::BF16);
+  });
+
+  // 1 + 2^-8 is exactly halfway between two bf16 values and rounds down to
+  // even; 1 + 3 * 2^-8 is halfway and rounds up to even
+  uint16_t One = toBF16(1.0f), Weight[2] = {One, One}, Output = 0;
+  uint16_t Halfway[2] = {One, toBF16(1.0f / 256)};
+  Conv(Halfway, Weight, &Output, 1, 2, 1, 1, 1, 1, 1);
+  EXPECT_EQ(fromBF16(Output), 1.0f);
+
+  uint16_t HalfwayUp[2] = {toBF16(1.0f + 1.0f / 128), toBF16(1.0f / 256)};
+  Conv(HalfwayUp, Weight, &Output, 1, 2, 1, 1, 1, 1, 1);
+  EXPECT_EQ(fromBF16(Output), 1.0f + 2.0f / 128);
+}
+
+TEST(ElementTypeTest, F16MaxPooling) {
+  std::unique_ptr<KernelJIT> JIT;
+  auto *Pool = compile<void(uint16_t *, uint16_t *, int64_t, int64_t, int64_t, int64_t)>(JIT, [](Module &M) {
+    PoolingDims Dims{1, 1, 2, 4};
+    return createMaxPoolingFunction(M, Dims, 2, 2, 2, 2, "maxPooling", TensorElementType::F16);
+  });
+
+  // 1.0, -2.0, 0.5, 3.0 / -1.0, 0.25, -0.5, 2.0 as IEEE half bit patterns
+  uint16_t Input[8] = {0x3c00, 0xc000, 0x3800, 0x4200, 0xbc00, 0x3400, 0xb800, 0x4000};
+  uint16_t Output[2] = {0, 0};
+  Pool(Input, Output, 1, 1, 2, 4);
+  EXPECT_EQ(Output[0], 0x3c00);
+  EXPECT_EQ(Output[1], 0x4200);
+}
+
+} // namespace
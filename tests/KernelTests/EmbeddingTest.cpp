@@ -0,0 +1,85 @@
+#include "Kernels/Embedding.h"
+#include "Runtime/KernelJIT.h"
+#include "Runtime/ParallelEmbedding.h"
+#include "TestUtils.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <functional>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+TEST(EmbeddingTest, LooksUpRows) {
+  // 19 floats per row exercise both the vector strips and the remainder
+  const int64_t Rows = 50, Dim = 19;
+  auto Table = makeData(Rows * Dim, 1);
+  const std::vector<int64_t> Indices = {7, 0, 49, 7, 23, 3};
+
+  for (int64_t StaticDim : {DynamicDim, Dim}) {
+    std::unique_ptr<KernelJIT> JIT;
+    auto *Lookup = compile<EmbeddingLookupKernelFn>(
+        JIT, [&](Module &M) { return createEmbeddingLookupFunction(M, StaticDim); });
+    std::vector<float> Output(Indices.size() * Dim, -1.0f);
+    Lookup(Table.data(), Indices.data(), Output.data(), Indices.size(), Dim);
+
+    for (size_t I = 0; I < Indices.size(); ++I)
+      for (int64_t D = 0; D < Dim; ++D)
+        EXPECT_EQ(Output[I * Dim + D], Table[Indices[I] * Dim + D]) << "index " << I << " column " << D;
+  }
+}
+
+TEST(EmbeddingTest, PoolsBags) {
+  const int64_t Rows = 40, Dim = 35;
+  auto Table = makeData(Rows * Dim, 3);
+  // Bags of 3, 0, 1 and 5 rows, with a row repeated inside the last bag
+  const std::vector<int64_t> Indices = {4, 39, 12, 0, 8, 8, 31, 17, 2};
+  const std::vector<int64_t> Offsets = {0, 3, 3, 4, 9};
+  const int64_t NumBags = Offsets.size() - 1;
+
+  for (EmbeddingBagMode Mode : {EmbeddingBagMode::Sum, EmbeddingBagMode::Mean})
+    for (unsigned Distance : {0u, 2u, 16u}) {
+      std::unique_ptr<KernelJIT> JIT;
+      auto *Bag = compile<EmbeddingBagKernelFn>(
+          JIT, [&](Module &M) { return createEmbeddingBagFunction(M, Mode, DynamicDim, Distance); });
+      std::vector<float> Output(NumBags * Dim, -1.0f);
+      Bag(Table.data(), Indices.data(), Offsets.data(), Output.data(), 0, NumBags, Dim);
+
+      for (int64_t B = 0; B < NumBags; ++B)
+        for (int64_t D = 0; D < Dim; ++D) {
+          float Expected = 0.0f;
+          for (int64_t I = Offsets[B]; I < Offsets[B + 1]; ++I)
+            Expected += Table[Indices[I] * Dim + D];
+          if (Mode == EmbeddingBagMode::Mean && Offsets[B + 1] > Offsets[B])
+            Expected /= Offsets[B + 1] - Offsets[B];
+          EXPECT_NEAR(Output[B * Dim + D], Expected, 1e-5f) << "bag " << B << " column " << D;
+        }
+    }
+}
+
+TEST(EmbeddingTest, FillsOnlyItsBagRange) {
+  const int64_t Dim = 8;
+  auto Table = makeData(10 * Dim, 5);
+  const std::vector<int64_t> Indices = {1, 2, 3, 4};
+  const std::vector<int64_t> Offsets = {0, 1, 2, 3, 4};
+
+  std::unique_ptr<KernelJIT> JIT;
+  auto *Bag = compile<EmbeddingBagKernelFn>(
+      JIT, [](Module &M) { return createEmbeddingBagFunction(M, EmbeddingBagMode::Sum, 8); });
+  std::vector<float> Output(4 * Dim, -1.0f);
+  Bag(Table.data(), Indices.data(), Offsets.data(), Output.data(), 1, 3, Dim);
+
+  for (int64_t D = 0; D < Dim; ++D) {
+    EXPECT_EQ(Output[D], -1.0f);
+    EXPECT_EQ(Output[Dim + D], Table[2 * Dim + D]);
+    EXPECT_EQ(Output[2 * Dim + D], Table[3 * Dim + D]);
+    EXPECT_EQ(Output[3 * Dim + D], -1.0f);
+  }
+}
+
+} // namespace
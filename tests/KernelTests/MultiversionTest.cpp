@@ -0,0 +1,100 @@
+#include "Kernels/Activation.h"
+#include "Kernels/Multiversion.h"
+#include "TestUtils.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalIFunc.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Type.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+TEST(MultiversionTest, ELFKernelGetsIFunc) {
+  LLVMContext Context;
+  Module M("MultiversionTestModule", Context);
+  M.setTargetTriple("x86_64-unknown-linux-gnu");
+
+  Type *TensorTy = PointerType::get(Type::getFloatTy(Context), 0);
+  Function *ReLUFunc = createReLUFunction(M, TensorTy, TensorTy);
+  ASSERT_TRUE(ReLUFunc != nullptr);
+
+  GlobalValue *Dispatcher = createMultiversionedKernel(M, *ReLUFunc, getMultiversionISAs(Triple(M.getTargetTriple())));
+  ASSERT_TRUE(isa<GlobalIFunc>(Dispatcher));
+  EXPECT_EQ(Dispatcher->getName(), "ReLU");
+  EXPECT_EQ(ReLUFunc->getName(), "ReLU.default");
+
+  Function *AVX2 = M.getFunction("ReLU.avx2");
+  ASSERT_TRUE(AVX2 != nullptr);
+  EXPECT_EQ(AVX2->getFnAttribute("target-features").getValueAsString(), "+avx2,+fma");
+  EXPECT_TRUE(M.getFunction("ReLU.avx512") != nullptr);
+  EXPECT_TRUE(M.getFunction("ReLU.sse4.2") != nullptr);
+
+  std::string ErrorMessage;
+  raw_string_ostream ErrorStream(ErrorMessage);
+  if (verifyModule(M, &ErrorStream)) {
+    FAIL() << "Module verification failed: " << ErrorMessage;
+  }
+}
+
+TEST(MultiversionTest, MachOKernelGetsThunk) {
+  LLVMContext Context;
+  Module M("MultiversionTestModule", Context);
+  M.setTargetTriple("x86_64-apple-macosx");
+
+  Type *TensorTy = PointerType::get(Type::getFloatTy(Context), 0);
+  Function *ReLUFunc = createReLUFunction(M, TensorTy, TensorTy);
+
+  GlobalValue *Dispatcher = createMultiversionedKernel(M, *ReLUFunc, {KernelISA::AVX2});
+  auto *Thunk = dyn_cast<Function>(Dispatcher);
+  ASSERT_TRUE(Thunk != nullptr);
+  EXPECT_FALSE(Thunk->isDeclaration());
+  EXPECT_TRUE(M.getNamedGlobal("ReLU.ptr") != nullptr);
+  EXPECT_TRUE(M.getFunction("ReLU.sse4.2") == nullptr);
+
+  EXPECT_FALSE(verifyModule(M, &errs()));
+}
+
+#if defined(__x86_64__)
+TEST(MultiversionTest, ThunkBindsHostVariant) {
+  using ReLUFn = void(const float *, float *, int64_t);
+  std::unique_ptr<KernelJIT> JIT;
+  auto *ReLU = compile<ReLUFn>(JIT, [](Module &M) {
+    // The thunk is built for a non-ELF target and then run on the host
+    M.setTargetTriple("x86_64-apple-macosx");
+    Function *Kernel = createReLUFunction(M, DynamicDim);
+    auto *Thunk =
+        cast<Function>(createMultiversionedKernel(M, *Kernel, getMultiversionISAs(Triple(M.getTargetTriple()))));
+    // Expose the cached pointer so the test can see which variant was bound
+    M.getNamedGlobal("ReLU.ptr")->setLinkage(GlobalValue::ExternalLinkage);
+    return Thunk;
+  });
+
+  std::vector<float> Input = makeData(37, 3), Output(37, -1.0f);
+  ReLU(Input.data(), Output.data(), Input.size());
+  for (size_t I = 0; I < Input.size(); ++I)
+    EXPECT_EQ(Output[I], std::max(Input[I], 0.0f)) << I;
+
+  // The resolver must agree with the compiler's own reading of __cpu_model
+  const char *Expected = "ReLU.default";
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+      __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx2") &&
+      __builtin_cpu_supports("fma"))
+    Expected = "ReLU.avx512";
+  else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    Expected = "ReLU.avx2";
+  else if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+    Expected = "ReLU.sse4.2";
+  auto *Bound = static_cast<void **>(cantFail(JIT->lookup("ReLU.ptr")));
+  EXPECT_EQ(*Bound, cantFail(JIT->lookup(Expected))) << Expected;
+}
+#endif
+
+} // namespace
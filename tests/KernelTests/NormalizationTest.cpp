@@ -0,0 +1,125 @@
+#include "Kernels/Normalization.h"
+#include "Kernels/Convolution.h"
+#include "Kernels/WeightPacking.h"
+#include "Runtime/KernelJIT.h"
+#include "TestUtils.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <functional>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+using SoftmaxFn = void(const float *, float *, int64_t, int64_t);
+using LayerNormFn = void(const float *, const float *, const float *, float *, int64_t, int64_t);
+using ConvFn = void(const float *, const float *, float *, int64_t, int64_t, int64_t, int64_t, int64_t, int64_t,
+                    int64_t);
+
+TEST(NormalizationTest, SoftmaxMatchesReference) {
+  std::unique_ptr<KernelJIT> JIT;
+  auto *Softmax = compile<SoftmaxFn>(JIT, [](Module &M) { return createSoftmaxFunction(M, DynamicDim, DynamicDim); });
+
+  // Row lengths below, at and past the vector width, with large logits that
+  // would overflow exp() without subtracting the maximum
+  for (int64_t Cols : {3, 8, 21}) {
+    const int64_t Rows = 3;
+    std::vector<float> Input = makeData(Rows * Cols, 1, 0.25f, 80.0f);
+    std::vector<float> Output(Rows * Cols, -1.0f);
+    Softmax(Input.data(), Output.data(), Rows, Cols);
+
+    for (int64_t Row = 0; Row < Rows; ++Row) {
+      double Max = -INFINITY, Sum = 0.0;
+      for (int64_t Col = 0; Col < Cols; ++Col)
+        Max = std::max<double>(Max, Input[Row * Cols + Col]);
+      for (int64_t Col = 0; Col < Cols; ++Col)
+        Sum += std::exp(Input[Row * Cols + Col] - Max);
+      for (int64_t Col = 0; Col < Cols; ++Col)
+        EXPECT_NEAR(Output[Row * Cols + Col], std::exp(Input[Row * Cols + Col] - Max) / Sum, 1e-6)
+            << "row " << Row << " col " << Col << " of " << Cols;
+    }
+  }
+}
+
+TEST(NormalizationTest, LayerNormMatchesReference) {
+  const int64_t Rows = 2, Cols = 37;
+  std::unique_ptr<KernelJIT> DynamicJIT, StaticJIT;
+  auto *Dynamic = compile<LayerNormFn>(DynamicJIT, [](Module &M) {
+    return createLayerNormFunction(M, DynamicDim, DynamicDim);
+  });
+  auto *Static = compile<LayerNormFn>(StaticJIT, [&](Module &M) { return createLayerNormFunction(M, Rows, Cols); });
+
+  // A large common offset makes E[x^2] - E[x]^2 lose every significant digit
+  std::vector<float> Input = makeData(Rows * Cols, 2, 0.25f, 1000.0f);
+  std::vector<float> Gamma = makeData(Cols, 3), Beta = makeData(Cols, 4);
+  std::vector<float> Expected(Rows * Cols);
+  for (int64_t Row = 0; Row < Rows; ++Row) {
+    double Mean = 0.0, Variance = 0.0;
+    for (int64_t Col = 0; Col < Cols; ++Col)
+      Mean += Input[Row * Cols + Col];
+    Mean /= Cols;
+    for (int64_t Col = 0; Col < Cols; ++Col)
+      Variance += (Input[Row * Cols + Col] - Mean) * (Input[Row * Cols + Col] - Mean);
+    Variance /= Cols;
+    for (int64_t Col = 0; Col < Cols; ++Col)
+      Expected[Row * Cols + Col] =
+          (Input[Row * Cols + Col] - Mean) / std::sqrt(Variance + 1e-5) * Gamma[Col] + Beta[Col];
+  }
+
+  for (LayerNormFn *LayerNorm : {Dynamic, Static}) {
+    std::vector<float> Output(Rows * Cols, -1.0f);
+    LayerNorm(Input.data(), Gamma.data(), Beta.data(), Output.data(), Rows, Cols);
+    for (size_t I = 0; I < Output.size(); ++I)
+      EXPECT_NEAR(Output[I], Expected[I], 1e-3f) << "element " << I;
+  }
+}
+
+TEST(NormalizationTest, BatchNormFoldsIntoConvolution) {
+  ConvolutionDims Dims{1, 3, 6, 5, 5, 3, 3};
+  std::vector<float> Input = makeData(Dims.N * Dims.C * Dims.H * Dims.W, 5);
+  std::vector<float> Weight = makeData(Dims.K * Dims.C * 9, 6);
+  std::vector<float> Gamma = {0.5f, 1.5f, -1.0f, 2.0f, 1.0f}, Beta = {0.1f, -0.2f, 0.3f, 0.0f, 1.0f};
+  std::vector<float> Mean = {0.2f, -0.1f, 0.0f, 1.0f, -2.0f}, Variance = {1.0f, 0.25f, 4.0f, 0.5f, 2.0f};
+
+  // Unfused convolution followed by batch normalization
+  std::unique_ptr<KernelJIT> ConvJIT;
+  auto *Conv = compile<ConvFn>(ConvJIT, [&](Module &M) { return createConvolutionFunction(M, Dims, 1, 1, 1, 1); });
+  std::vector<float> Expected(Dims.K * Dims.H * Dims.W);
+  Conv(Input.data(), Weight.data(), Expected.data(), 0, 0, 0, 0, 0, 0, 0);
+  for (int64_t k = 0; k < Dims.K; ++k)
+    for (int64_t I = 0; I < Dims.H * Dims.W; ++I) {
+      float &Value = Expected[k * Dims.H * Dims.W + I];
+      Value = Gamma[k] * (Value - Mean[k]) / std::sqrt(Variance[k] + 1e-5f) + Beta[k];
+    }
+
+  std::vector<float> Folded = Weight, Bias;
+  foldBatchNorm(Folded, Bias, {Gamma, Beta, Mean, Variance});
+  ASSERT_EQ(Bias.size(), static_cast<size_t>(Dims.K));
+
+  std::vector<float> Packed = packConvolutionWeights(Folded, Dims, 4);
+  std::vector<float> Transformed = transformWinogradWeights(Folded, Dims.K, Dims.C);
+  std::unique_ptr<KernelJIT> PackedJIT, WinogradJIT;
+  auto *PackedConv = compile<ConvFn>(PackedJIT, [&](Module &M) {
+    return createPackedConvolutionFunction(M, Dims, 4, 1, 1, 1, 1, createPackedWeightGlobal(M, Packed, "weights"),
+                                           createPackedWeightGlobal(M, Bias, "bias"));
+  });
+  auto *WinogradConv = compile<ConvFn>(WinogradJIT, [&](Module &M) {
+    return createWinogradConvolutionFunction(M, Dims, 1, 1, createPackedWeightGlobal(M, Transformed, "weights"),
+                                             createPackedWeightGlobal(M, Bias, "bias"));
+  });
+
+  for (ConvFn *Fused : {PackedConv, WinogradConv}) {
+    std::vector<float> Output(Expected.size(), -1.0f);
+    Fused(Input.data(), nullptr, Output.data(), 0, 0, 0, 0, 0, 0, 0);
+    for (size_t I = 0; I < Output.size(); ++I)
+      EXPECT_NEAR(Output[I], Expected[I], 1e-3f) << "element " << I;
+  }
+}
+
+} // namespace
@@ -0,0 +1,117 @@
+#include "Kernels/Reduction.h"
+#include "Runtime/KernelJIT.h"
+#include "TestUtils.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <functional>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+using ReductionFn = void(const float *, float *, int64_t *, const int64_t *);
+
+/// Reduce a 3-D tensor over \p Axes one output at a time.
+void referenceReduce(ReductionKind Kind, const std::vector<float> &Input, const int64_t (&Shape)[3],
+                     ArrayRef<unsigned> Axes, std::vector<float> &Output, std::vector<int64_t> &Indices) {
+  bool Reduced[3] = {false, false, false};
+  for (unsigned Axis : Axes)
+    Reduced[Axis] = true;
+  int64_t OutShape[3];
+  for (unsigned Axis = 0; Axis < 3; ++Axis)
+    OutShape[Axis] = Reduced[Axis] ? 1 : Shape[Axis];
+  Output.assign(OutShape[0] * OutShape[1] * OutShape[2], 0.0f);
+  Indices.assign(Output.size(), 0);
+
+  for (int64_t O = 0; O < static_cast<int64_t>(Output.size()); ++O) {
+    int64_t Kept[3] = {O / (OutShape[1] * OutShape[2]), O / OutShape[2] % OutShape[1], O % OutShape[2]};
+    double Acc = 0.0;
+    if (Kind == ReductionKind::Min)
+      Acc = INFINITY;
+    else if (Kind == ReductionKind::Max || Kind == ReductionKind::ArgMax)
+      Acc = -INFINITY;
+    int64_t Count = 0, Best = 0;
+    for (int64_t I = 0; I < Shape[0]; ++I)
+      for (int64_t J = 0; J < Shape[1]; ++J)
+        for (int64_t K = 0; K < Shape[2]; ++K) {
+          if ((!Reduced[0] && I != Kept[0]) || (!Reduced[1] && J != Kept[1]) || (!Reduced[2] && K != Kept[2]))
+            continue;
+          double X = Input[(I * Shape[1] + J) * Shape[2] + K];
+          if (Kind == ReductionKind::ArgMax && X > Acc)
+            Best = Count;
+          if (Kind == ReductionKind::L2Norm)
+            Acc += X * X;
+          else if (Kind == ReductionKind::Max || Kind == ReductionKind::ArgMax)
+            Acc = std::max(Acc, X);
+          else if (Kind == ReductionKind::Min)
+            Acc = std::min(Acc, X);
+          else
+            Acc += X;
+          ++Count;
+        }
+    if (Kind == ReductionKind::Mean)
+      Acc /= Count;
+    else if (Kind == ReductionKind::L2Norm)
+      Acc = std::sqrt(Acc);
+    Output[O] = Acc;
+    Indices[O] = Best;
+  }
+}
+
+TEST(ReductionTest, ParsesKindNames) {
+  for (ReductionKind Kind : {ReductionKind::Sum, ReductionKind::Mean, ReductionKind::Max, ReductionKind::Min,
+                             ReductionKind::ArgMax, ReductionKind::L2Norm})
+    EXPECT_EQ(parseReductionKind(getReductionKindName(Kind)), Kind);
+  EXPECT_FALSE(parseReductionKind("prod").hasValue());
+}
+
+TEST(ReductionTest, MatchesReferenceOverAxes) {
+  // An odd innermost extent exercises both the vector strips and the remainder
+  const int64_t Shape[3] = {3, 5, 19};
+  auto Input = makeData(3 * 5 * 19, 1);
+  const std::vector<std::vector<unsigned>> AxisSets = {{2}, {1}, {0, 1}, {0, 2}, {0, 1, 2}};
+
+  for (ReductionKind Kind : {ReductionKind::Sum, ReductionKind::Mean, ReductionKind::Max, ReductionKind::Min,
+                             ReductionKind::ArgMax, ReductionKind::L2Norm})
+    for (const auto &Axes : AxisSets) {
+      std::unique_ptr<KernelJIT> JIT;
+      auto *Reduce = compile<ReductionFn>(JIT, [&](Module &M) {
+        return createReductionFunction(M, Kind, {DynamicDim, DynamicDim, DynamicDim}, Axes);
+      });
+
+      std::vector<float> Expected;
+      std::vector<int64_t> ExpectedIndices;
+      referenceReduce(Kind, Input, Shape, Axes, Expected, ExpectedIndices);
+      std::vector<float> Output(Expected.size(), -1.0f);
+      std::vector<int64_t> Indices(Expected.size(), -1);
+      Reduce(Input.data(), Output.data(), Indices.data(), Shape);
+
+      for (size_t I = 0; I < Expected.size(); ++I) {
+        EXPECT_NEAR(Output[I], Expected[I], 1e-3f) << getReductionKindName(Kind).str() << " output " << I;
+        if (Kind == ReductionKind::ArgMax) {
+          EXPECT_EQ(Indices[I], ExpectedIndices[I]) << "output " << I;
+        }
+      }
+    }
+}
+
+TEST(ReductionTest, PartialKeepsRawAccumulators) {
+  std::unique_ptr<KernelJIT> JIT;
+  auto *Reduce = compile<ReductionFn>(
+      JIT, [](Module &M) { return createReductionFunction(M, ReductionKind::L2Norm, {2, 12}, {1}, true); });
+
+  // Static extents ignore the shape argument
+  std::vector<float> Input(24, 2.0f);
+  float Output[2];
+  Reduce(Input.data(), Output, nullptr, nullptr);
+  EXPECT_EQ(Output[0], 48.0f);
+  EXPECT_EQ(Output[1], 48.0f);
+}
+
+} // namespace
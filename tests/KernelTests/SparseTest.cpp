@@ -0,0 +1,149 @@
+#include "Kernels/Sparse.h"
+#include "Runtime/KernelJIT.h"
+#include "TestUtils.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <functional>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+using SparseGemmFn = void(const int32_t *, const int32_t *, const float *, const float *, float *, int64_t, int64_t);
+using SpecializedGemmFn = void(const float *, float *, int64_t);
+using SparseConvFn = void(const float *, const int32_t *, const int32_t *, const float *, float *, int64_t, int64_t,
+                          int64_t, int64_t, int64_t, int64_t, int64_t);
+using SpecializedConvFn = void(const float *, float *, int64_t, int64_t, int64_t, int64_t, int64_t, int64_t, int64_t);
+
+/// A deterministic matrix with roughly 80% of its elements pruned.
+std::vector<float> makePrunedWeights(int64_t Rows, int64_t Cols) {
+  std::vector<float> Dense(Rows * Cols, 0.0f);
+  for (int64_t I = 0; I < Rows * Cols; ++I)
+    if ((I * 7919) % 5 == 0)
+      Dense[I] = static_cast<float>(I % 11) * 0.25f - 1.0f;
+  return Dense;
+}
+
+std::vector<float> makeActivations(int64_t Size) {
+  std::vector<float> Data(Size);
+  for (int64_t I = 0; I < Size; ++I)
+    Data[I] = static_cast<float>(I % 13) * 0.5f - 3.0f;
+  return Data;
+}
+
+std::vector<float> referenceGemm(const std::vector<float> &A, const std::vector<float> &B, int64_t Rows,
+                                 int64_t Inner, int64_t Cols) {
+  std::vector<float> C(Rows * Cols, 0.0f);
+  for (int64_t I = 0; I < Rows; ++I)
+    for (int64_t K = 0; K < Inner; ++K)
+      for (int64_t J = 0; J < Cols; ++J)
+        C[I * Cols + J] += A[I * Inner + K] * B[K * Cols + J];
+  return C;
+}
+
+std::vector<float> referenceConv(const std::vector<float> &Input, const std::vector<float> &Weight,
+                                 const ConvolutionDims &D, unsigned Stride, unsigned Pad) {
+  int64_t OH = (D.H + 2 * Pad - D.R) / Stride + 1, OW = (D.W + 2 * Pad - D.S) / Stride + 1;
+  std::vector<float> Output(D.N * D.K * OH * OW, 0.0f);
+  for (int64_t n = 0; n < D.N; ++n)
+    for (int64_t k = 0; k < D.K; ++k)
+      for (int64_t y = 0; y < OH; ++y)
+        for (int64_t x = 0; x < OW; ++x)
+          for (int64_t c = 0; c < D.C; ++c)
+            for (int64_t r = 0; r < D.R; ++r)
+              for (int64_t s = 0; s < D.S; ++s) {
+                int64_t iy = y * Stride + r - Pad, ix = x * Stride + s - Pad;
+                if (iy < 0 || iy >= D.H || ix < 0 || ix >= D.W)
+                  continue;
+                Output[((n * D.K + k) * OH + y) * OW + x] +=
+                    Input[((n * D.C + c) * D.H + iy) * D.W + ix] * Weight[((k * D.C + c) * D.R + r) * D.S + s];
+              }
+  return Output;
+}
+
+void expectNear(const std::vector<float> &Actual, const std::vector<float> &Expected) {
+  ASSERT_EQ(Actual.size(), Expected.size());
+  for (size_t I = 0; I < Actual.size(); ++I)
+    EXPECT_NEAR(Actual[I], Expected[I], 1e-4f) << "element " << I;
+}
+
+TEST(SparseTest, FromDenseDropsZeroBlocks) {
+  // Only the top-left and bottom-right 2x2 blocks hold nonzeros
+  std::vector<float> Dense = {1, 0, 0, 0,
+                              0, 2, 0, 0,
+                              0, 0, 0, 3,
+                              0, 0, 0, 0};
+  SparseMatrix Sparse = SparseMatrix::fromDense(Dense, 4, 4, 2, 2);
+  EXPECT_EQ(Sparse.getNumBlockRows(), 2);
+  EXPECT_EQ(Sparse.getNumBlocks(), 2);
+  EXPECT_EQ(Sparse.RowOffsets, (std::vector<int32_t>{0, 1, 2}));
+  EXPECT_EQ(Sparse.ColIndices, (std::vector<int32_t>{0, 1}));
+  EXPECT_EQ(Sparse.Values, (std::vector<float>{1, 0, 0, 2, 0, 3, 0, 0}));
+}
+
+TEST(SparseTest, GemmMatchesDense) {
+  const int64_t Rows = 8, Inner = 12, Cols = 19;
+  std::vector<float> A = makePrunedWeights(Rows, Inner), B = makeActivations(Inner * Cols);
+  std::vector<float> Expected = referenceGemm(A, B, Rows, Inner, Cols);
+
+  for (auto Block : {std::make_pair(1u, 1u), std::make_pair(4u, 4u), std::make_pair(2u, 1u)}) {
+    SparseMatrix Sparse = SparseMatrix::fromDense(A, Rows, Inner, Block.first, Block.second);
+
+    std::unique_ptr<KernelJIT> RuntimeJIT, SpecializedJIT;
+    auto *Runtime = compile<SparseGemmFn>(RuntimeJIT, [&](Module &M) {
+      return createSparseGemmFunction(M, Block.first, Block.second, DynamicDim);
+    });
+    auto *Specialized = compile<SpecializedGemmFn>(SpecializedJIT, [&](Module &M) {
+      return createSparseGemmFunction(M, Sparse, Cols);
+    });
+
+    std::vector<float> C(Rows * Cols, -1.0f);
+    Runtime(Sparse.RowOffsets.data(), Sparse.ColIndices.data(), Sparse.Values.data(), B.data(), C.data(),
+            Sparse.getNumBlockRows(), Cols);
+    expectNear(C, Expected);
+
+    std::fill(C.begin(), C.end(), -1.0f);
+    Specialized(B.data(), C.data(), Cols);
+    expectNear(C, Expected);
+  }
+}
+
+TEST(SparseTest, ConvolutionMatchesDense) {
+  ConvolutionDims Dims{2, 3, 7, 6, 4, 3, 3};
+  std::vector<float> Weight = makePrunedWeights(Dims.K, Dims.C * Dims.R * Dims.S);
+  std::vector<float> Input = makeActivations(Dims.N * Dims.C * Dims.H * Dims.W);
+
+  for (unsigned Stride : {1u, 2u}) {
+    for (auto Block : {std::make_pair(1u, 1u), std::make_pair(2u, 3u)}) {
+      const unsigned Pad = 1;
+      std::vector<float> Expected = referenceConv(Input, Weight, Dims, Stride, Pad);
+      SparseMatrix Sparse = SparseMatrix::fromDense(Weight, Dims.K, Dims.C * Dims.R * Dims.S, Block.first,
+                                                    Block.second);
+
+      ConvolutionDims Dynamic;
+      std::unique_ptr<KernelJIT> RuntimeJIT, SpecializedJIT;
+      auto *Runtime = compile<SparseConvFn>(RuntimeJIT, [&](Module &M) {
+        return createSparseConvolutionFunction(M, Dynamic, Block.first, Block.second, Stride, Stride, Pad, Pad);
+      });
+      auto *Specialized = compile<SpecializedConvFn>(SpecializedJIT, [&](Module &M) {
+        return createSparseConvolutionFunction(M, Dims, Sparse, Stride, Stride, Pad, Pad);
+      });
+
+      std::vector<float> Output(Expected.size(), -1.0f);
+      Runtime(Input.data(), Sparse.RowOffsets.data(), Sparse.ColIndices.data(), Sparse.Values.data(), Output.data(),
+              Dims.N, Dims.C, Dims.H, Dims.W, Dims.K, Dims.R, Dims.S);
+      expectNear(Output, Expected);
+
+      std::fill(Output.begin(), Output.end(), -1.0f);
+      Specialized(Input.data(), Output.data(), Dims.N, Dims.C, Dims.H, Dims.W, Dims.K, Dims.R, Dims.S);
+      expectNear(Output, Expected);
+    }
+  }
+}
+
+} // namespace
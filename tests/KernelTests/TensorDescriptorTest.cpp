@@ -0,0 +1,98 @@
+#include "Kernels/TensorDescriptor.h"
+#include "Kernels/Activation.h"
+#include "Runtime/KernelJIT.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+using EntryFn = int32_t(const TensorDescriptor *);
+
+/// ReLU input and output, described as tensors of \p Size elements.
+SmallVector<TensorArgInfo, 2> getReLUTensors(int64_t Size) {
+  TensorArgInfo Input, Output;
+  Input.ArgNo = 0, Input.Dims = {Size}, Input.ReadOnly = true;
+  Output.ArgNo = 1, Output.Dims = {Size};
+  return {Input, Output};
+}
+
+TEST(TensorDescriptorTest, AttachesArgumentGuarantees) {
+  LLVMContext Context;
+  Module M("TensorDescriptorTestModule", Context);
+  Function *Static = createReLUFunction(M, 1024, "staticReLU");
+  Function *Dynamic = createReLUFunction(M, DynamicDim, "dynamicReLU");
+  addTensorArgumentGuarantees(*Static, getReLUTensors(1024));
+  addTensorArgumentGuarantees(*Dynamic, getReLUTensors(DynamicDim));
+  ASSERT_FALSE(verifyModule(M, &errs()));
+
+  for (Function *Kernel : {Static, Dynamic}) {
+    for (unsigned ArgNo : {0u, 1u}) {
+      EXPECT_TRUE(Kernel->hasParamAttribute(ArgNo, Attribute::NoAlias));
+      EXPECT_TRUE(Kernel->hasParamAttribute(ArgNo, Attribute::NonNull));
+      EXPECT_EQ(Kernel->getParamAlign(ArgNo).valueOrOne().value(), 64u);
+    }
+    EXPECT_TRUE(Kernel->hasParamAttribute(0, Attribute::ReadOnly));
+    EXPECT_FALSE(Kernel->hasParamAttribute(1, Attribute::ReadOnly));
+
+    unsigned Assumptions = 0;
+    for (Instruction &I : Kernel->getEntryBlock())
+      if (auto *Assume = dyn_cast<AssumeInst>(&I))
+        Assumptions += Assume->hasOperandBundles();
+    EXPECT_EQ(Assumptions, 2u);
+  }
+  // Only fully static tensors have a known size
+  EXPECT_EQ(Static->getParamDereferenceableBytes(0), 4096u);
+  EXPECT_EQ(Dynamic->getParamDereferenceableBytes(0), 0u);
+}
+
+TEST(TensorDescriptorTest, EntryValidatesDescriptors) {
+  auto Context = std::make_unique<LLVMContext>();
+  auto M = std::make_unique<Module>("TensorDescriptorTestModule", *Context);
+  Function *Kernel = createReLUFunction(*M, DynamicDim);
+  auto Tensors = getReLUTensors(DynamicDim);
+  addTensorArgumentGuarantees(*Kernel, Tensors);
+  createTensorDescriptorEntry(*M, *Kernel, Tensors, {{0, 0}}, "ReLU.desc");
+  ASSERT_FALSE(verifyModule(*M, &errs()));
+
+  auto JIT = cantFail(KernelJIT::create());
+  ASSERT_FALSE(!!JIT->addModule(orc::ThreadSafeModule(std::move(M), std::move(Context))));
+  auto *Entry = reinterpret_cast<EntryFn *>(cantFail(JIT->lookup("ReLU.desc")));
+
+  alignas(64) float Input[40], Output[40];
+  for (int I = 0; I < 40; ++I)
+    Input[I] = static_cast<float>(I % 7) - 3.0f;
+  TensorDescriptor Args[2] = {TensorDescriptor::getContiguous(Input, {37}),
+                              TensorDescriptor::getContiguous(Output, {37})};
+  ASSERT_EQ(Entry(Args), 0);
+  for (int I = 0; I < 37; ++I)
+    EXPECT_EQ(Output[I], std::max(Input[I], 0.0f)) << I;
+
+  // A misaligned output, the wrong dtype or rank, and a strided view are rejected
+  TensorDescriptor Bad[2] = {Args[0], TensorDescriptor::getContiguous(Output + 1, {37})};
+  EXPECT_EQ(Entry(Bad), 2);
+  Bad[1] = TensorDescriptor::getContiguous(Output, {37}, TensorElementType::F16);
+  EXPECT_EQ(Entry(Bad), 2);
+  Bad[0] = TensorDescriptor::getContiguous(Input, {37, 1});
+  EXPECT_EQ(Entry(Bad), 1);
+  Bad[0] = TensorDescriptor::getContiguous(Input, {20});
+  Bad[0].Strides[0] = 2;
+  EXPECT_EQ(Entry(Bad), 1);
+
+  // noalias tensors must not share a byte, but may be adjacent
+  Bad[0] = TensorDescriptor::getContiguous(Input, {32});
+  Bad[1] = TensorDescriptor::getContiguous(Input + 16, {16});
+  EXPECT_EQ(Entry(Bad), 2);
+  Bad[0] = TensorDescriptor::getContiguous(Input, {16});
+  EXPECT_EQ(Entry(Bad), 0);
+}
+
+} // namespace
@@ -0,0 +1,157 @@
+#include "Kernels/WeightPacking.h"
+#include "Kernels/Convolution.h"
+#include "Kernels/Gemm.h"
+#include "Runtime/KernelJIT.h"
+#include "TestUtils.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <functional>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+using ConvFn = void(const float *, const float *, float *, int64_t, int64_t, int64_t, int64_t, int64_t, int64_t,
+                    int64_t);
+using GemmFn = void(const float *, const float *, float *, int64_t, int64_t, int64_t);
+
+std::vector<float> referenceConv(const std::vector<float> &Input, const std::vector<float> &Weight,
+                                 const ConvolutionDims &D, unsigned Stride, unsigned Pad) {
+  int64_t OH = (D.H + 2 * Pad - D.R) / Stride + 1, OW = (D.W + 2 * Pad - D.S) / Stride + 1;
+  std::vector<float> Output(D.N * D.K * OH * OW, 0.0f);
+  for (int64_t n = 0; n < D.N; ++n)
+    for (int64_t k = 0; k < D.K; ++k)
+      for (int64_t y = 0; y < OH; ++y)
+        for (int64_t x = 0; x < OW; ++x)
+          for (int64_t c = 0; c < D.C; ++c)
+            for (int64_t r = 0; r < D.R; ++r)
+              for (int64_t s = 0; s < D.S; ++s) {
+                int64_t iy = y * Stride + r - Pad, ix = x * Stride + s - Pad;
+                if (iy < 0 || iy >= D.H || ix < 0 || ix >= D.W)
+                  continue;
+                Output[((n * D.K + k) * OH + y) * OW + x] +=
+                    Input[((n * D.C + c) * D.H + iy) * D.W + ix] * Weight[((k * D.C + c) * D.R + r) * D.S + s];
+              }
+  return Output;
+}
+
+void expectNear(const std::vector<float> &Actual, const std::vector<float> &Expected, float Tolerance) {
+  ASSERT_EQ(Actual.size(), Expected.size());
+  for (size_t I = 0; I < Actual.size(); ++I)
+    EXPECT_NEAR(Actual[I], Expected[I], Tolerance) << "element " << I;
+}
+
+TEST(WeightPackingTest, ConvolutionLayout) {
+  // K = 3 output channels in blocks of 2, one 1x1 input channel
+  ConvolutionDims Dims{1, 1, 1, 1, 3, 1, 1};
+  std::vector<float> Packed = packConvolutionWeights({1, 2, 3}, Dims, 2);
+  EXPECT_EQ(Packed, (std::vector<float>{1, 2, 3, 0}));
+
+  std::vector<float> Panels = packGemmWeights({1, 2, 3, 4, 5, 6}, 2, 3, 2);
+  EXPECT_EQ(Panels, (std::vector<float>{1, 2, 4, 5, 3, 0, 6, 0}));
+}
+
+TEST(WeightPackingTest, PackedGlobalIsAlignedConstant) {
+  LLVMContext Context;
+  Module M("WeightPackingTestModule", Context);
+  GlobalVariable *GV = createPackedWeightGlobal(M, {1, 2, 3, 4}, "weights");
+  EXPECT_TRUE(GV->isConstant());
+  EXPECT_TRUE(GV->hasInternalLinkage());
+  EXPECT_EQ(GV->getAlign(), MaybeAlign(64));
+}
+
+TEST(WeightPackingTest, PackedConvolutionMatchesDense) {
+  ConvolutionDims Dims{2, 3, 7, 6, 5, 3, 3};
+  std::vector<float> Input = makeData(Dims.N * Dims.C * Dims.H * Dims.W, 1, 0.125f);
+  std::vector<float> Weight = makeData(Dims.K * Dims.C * Dims.R * Dims.S, 2, 0.125f);
+  std::vector<float> Packed = packConvolutionWeights(Weight, Dims, 4);
+
+  for (unsigned Stride : {1u, 2u}) {
+    std::vector<float> Expected = referenceConv(Input, Weight, Dims, Stride, 1);
+
+    std::unique_ptr<KernelJIT> BakedJIT, ArgumentJIT;
+    auto *Baked = compile<ConvFn>(BakedJIT, [&](Module &M) {
+      GlobalVariable *GV = createPackedWeightGlobal(M, Packed, "packedWeights");
+      return createPackedConvolutionFunction(M, Dims, 4, Stride, Stride, 1, 1, GV);
+    });
+    auto *Argument = compile<ConvFn>(ArgumentJIT, [&](Module &M) {
+      return createPackedConvolutionFunction(M, ConvolutionDims(), 4, Stride, Stride, 1, 1);
+    });
+
+    std::vector<float> Output(Expected.size(), -1.0f);
+    Baked(Input.data(), nullptr, Output.data(), 0, 0, 0, 0, 0, 0, 0);
+    expectNear(Output, Expected, 1e-4f);
+
+    std::fill(Output.begin(), Output.end(), -1.0f);
+    Argument(Input.data(), Packed.data(), Output.data(), Dims.N, Dims.C, Dims.H, Dims.W, Dims.K, Dims.R, Dims.S);
+    expectNear(Output, Expected, 1e-4f);
+  }
+}
+
+TEST(WeightPackingTest, WinogradConvolutionMatchesDense) {
+  // Padding 1 on a 7x6 input leaves a 7x6 output with partial last tiles
+  ConvolutionDims Dims{2, 3, 7, 6, 4, 3, 3};
+  ASSERT_TRUE(isWinogradEligible(Dims, 1, 1));
+  EXPECT_FALSE(isWinogradEligible(Dims, 2, 2));
+
+  std::vector<float> Input = makeData(Dims.N * Dims.C * Dims.H * Dims.W, 3, 0.125f);
+  std::vector<float> Weight = makeData(Dims.K * Dims.C * 9, 4, 0.125f);
+  std::vector<float> Transformed = transformWinogradWeights(Weight, Dims.K, Dims.C);
+
+  for (unsigned Pad : {0u, 1u}) {
+    std::vector<float> Expected = referenceConv(Input, Weight, Dims, 1, Pad);
+
+    std::unique_ptr<KernelJIT> BakedJIT, ArgumentJIT;
+    auto *Baked = compile<ConvFn>(BakedJIT, [&](Module &M) {
+      GlobalVariable *GV = createPackedWeightGlobal(M, Transformed, "winogradWeights");
+      return createWinogradConvolutionFunction(M, Dims, Pad, Pad, GV);
+    });
+    auto *Argument = compile<ConvFn>(ArgumentJIT, [&](Module &M) {
+      return createWinogradConvolutionFunction(M, ConvolutionDims(), Pad, Pad);
+    });
+
+    std::vector<float> Output(Expected.size(), -1.0f);
+    Baked(Input.data(), nullptr, Output.data(), 0, 0, 0, 0, 0, 0, 0);
+    expectNear(Output, Expected, 1e-3f);
+
+    std::fill(Output.begin(), Output.end(), -1.0f);
+    Argument(Input.data(), Transformed.data(), Output.data(), Dims.N, Dims.C, Dims.H, Dims.W, Dims.K, 3, 3);
+    expectNear(Output, Expected, 1e-3f);
+  }
+}
+
+TEST(WeightPackingTest, PackedGemmMatchesDense) {
+  const int64_t Rows = 5, K = 7, N = 21;
+  std::vector<float> A = makeData(Rows * K, 5, 0.125f), B = makeData(K * N, 6, 0.125f);
+  std::vector<float> Expected(Rows * N, 0.0f);
+  for (int64_t I = 0; I < Rows; ++I)
+    for (int64_t k = 0; k < K; ++k)
+      for (int64_t J = 0; J < N; ++J)
+        Expected[I * N + J] += A[I * K + k] * B[k * N + J];
+  std::vector<float> Packed = packGemmWeights(B, K, N, 8);
+
+  std::unique_ptr<KernelJIT> BakedJIT, ArgumentJIT;
+  auto *Baked = compile<GemmFn>(BakedJIT, [&](Module &M) {
+    GlobalVariable *GV = createPackedWeightGlobal(M, Packed, "packedB");
+    return createPackedGemmFunction(M, GemmDims{DynamicDim, K, N}, 8, GV);
+  });
+  auto *Argument = compile<GemmFn>(ArgumentJIT, [&](Module &M) {
+    return createPackedGemmFunction(M, GemmDims(), 8);
+  });
+
+  std::vector<float> C(Rows * N, -1.0f);
+  Baked(A.data(), nullptr, C.data(), Rows, 0, 0);
+  expectNear(C, Expected, 1e-4f);
+
+  std::fill(C.begin(), C.end(), -1.0f);
+  Argument(A.data(), Packed.data(), C.data(), Rows, K, N);
+  expectNear(C, Expected, 1e-4f);
+}
+
+} // namespace
@@ -0,0 +1,149 @@
+#include "Optimization/KernelProfiling.h"
+#include "Kernels/Activation.h"
+#include "Runtime/KernelJIT.h"
+#include "Runtime/KernelProfiler.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+TEST(KernelProfilingTest, CountsKernelAndLoop) {
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  initializeCore(Registry);
+  initializeAnalysis(Registry);
+
+  auto Context = std::make_unique<LLVMContext>();
+  auto M = std::make_unique<Module>("KernelProfilingTestModule", *Context);
+  createReLUFunction(*M, DynamicDim, "profiledReLU");
+
+  legacy::PassManager PM;
+  PM.add(createKernelProfilingPass());
+  PM.run(*M);
+  ASSERT_FALSE(verifyModule(*M, &errs()));
+
+  auto JIT = KernelJIT::create();
+  ASSERT_TRUE(!!JIT) << toString(JIT.takeError());
+  ASSERT_FALSE(!!(*JIT)->addModule(orc::ThreadSafeModule(std::move(M), std::move(Context))));
+  auto Kernel = (*JIT)->lookup("profiledReLU");
+  ASSERT_TRUE(!!Kernel) << toString(Kernel.takeError());
+
+  std::vector<float> Input(100, -1.0f), Output(100);
+  auto *ReLU = reinterpret_cast<void (*)(float *, float *, int64_t)>(*Kernel);
+  ReLU(Input.data(), Output.data(), 100);
+  ReLU(Input.data(), Output.data(), 100);
+
+  const KernelProfileSite *KernelSite = nullptr, *LoopSite = nullptr;
+  for (const KernelProfileSite *Site : getKernelProfileSites()) {
+    if (std::strcmp(Site->Kernel, "profiledReLU"))
+      continue;
+    if (!std::strcmp(Site->Region, "kernel"))
+      KernelSite = Site;
+    else
+      LoopSite = Site;
+  }
+  ASSERT_TRUE(KernelSite != nullptr);
+  ASSERT_TRUE(LoopSite != nullptr);
+
+  EXPECT_EQ(KernelSite->Calls.load(), 2u);
+  EXPECT_EQ(LoopSite->Calls.load(), 2u);
+  EXPECT_EQ(LoopSite->Trips.load(), 200u);
+  // One float loaded and one stored per element
+  EXPECT_EQ(LoopSite->Bytes.load(), 200u * 8);
+  EXPECT_EQ(KernelSite->Bytes.load(), 200u * 8);
+  EXPECT_LE(LoopSite->Cycles.load(), KernelSite->Cycles.load());
+
+  std::string Report;
+  raw_string_ostream OS(Report);
+  dumpKernelProfile(OS);
+  EXPECT_NE(OS.str().find("profiledReLU"), std::string::npos);
+
+  resetKernelProfile();
+  EXPECT_EQ(KernelSite->Calls.load(), 0u);
+}
+
+TEST(KernelProfilingTest, IgnoresStackTraffic) {
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  initializeCore(Registry);
+  initializeAnalysis(Registry);
+
+  // Copy one float through a stack accumulator, as unpromoted kernels do
+  auto Context = std::make_unique<LLVMContext>();
+  auto M = std::make_unique<Module>("KernelProfilingTestModule", *Context);
+  auto *FloatPtrTy = Type::getFloatPtrTy(*Context);
+  auto *Kernel = Function::Create(FunctionType::get(Type::getVoidTy(*Context), {FloatPtrTy, FloatPtrTy}, false),
+                                  Function::ExternalLinkage, "stackCopy", *M);
+  IRBuilder<> Builder(BasicBlock::Create(*Context, "entry", Kernel));
+  auto *Acc = Builder.CreateAlloca(Builder.getFloatTy(), nullptr, "acc");
+  Builder.CreateStore(Builder.CreateLoad(Builder.getFloatTy(), Kernel->getArg(0)), Acc);
+  Builder.CreateStore(Builder.CreateLoad(Builder.getFloatTy(), Acc), Kernel->getArg(1));
+  Builder.CreateRetVoid();
+
+  legacy::PassManager PM;
+  PM.add(createKernelProfilingPass());
+  PM.run(*M);
+  ASSERT_FALSE(verifyModule(*M, &errs()));
+
+  auto JIT = cantFail(KernelJIT::create(OptimizationLevel::O0));
+  ASSERT_FALSE(!!JIT->addModule(orc::ThreadSafeModule(std::move(M), std::move(Context))));
+  auto *Copy = reinterpret_cast<void (*)(const float *, float *)>(cantFail(JIT->lookup("stackCopy")));
+  float Input = 2.0f, Output = 0.0f;
+  Copy(&Input, &Output);
+  EXPECT_EQ(Output, 2.0f);
+
+  for (const KernelProfileSite *Site : getKernelProfileSites())
+    if (!std::strcmp(Site->Kernel, "stackCopy")) {
+      EXPECT_EQ(Site->Bytes.load(), 8u);
+    }
+}
+
+/// Count the registered sites of \p Kernel.
+unsigned countSites(const char *Kernel) {
+  unsigned Count = 0;
+  for (const KernelProfileSite *Site : getKernelProfileSites())
+    Count += !std::strcmp(Site->Kernel, Kernel);
+  return Count;
+}
+
+TEST(KernelProfilingTest, UnregistersSitesWithTheJIT) {
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  initializeCore(Registry);
+  initializeAnalysis(Registry);
+
+  // Each JIT's sites go away with it, so later profile reads never touch freed code
+  for (int Round = 0; Round < 2; ++Round) {
+    auto Context = std::make_unique<LLVMContext>();
+    auto M = std::make_unique<Module>("KernelProfilingTestModule", *Context);
+    createReLUFunction(*M, DynamicDim, "shortLivedReLU");
+    legacy::PassManager PM;
+    PM.add(createKernelProfilingPass());
+    PM.run(*M);
+
+    {
+      auto JIT = cantFail(KernelJIT::create());
+      ASSERT_FALSE(!!JIT->addModule(orc::ThreadSafeModule(std::move(M), std::move(Context))));
+      auto *ReLU = reinterpret_cast<void (*)(float *, float *, int64_t)>(cantFail(JIT->lookup("shortLivedReLU")));
+      std::vector<float> Input(16, 1.0f), Output(16);
+      ReLU(Input.data(), Output.data(), 16);
+      EXPECT_EQ(countSites("shortLivedReLU"), 2u);
+    }
+    EXPECT_EQ(countSites("shortLivedReLU"), 0u);
+    resetKernelProfile();
+    std::string Report;
+    raw_string_ostream OS(Report);
+    dumpKernelProfile(OS);
+    EXPECT_EQ(OS.str().find("shortLivedReLU"), std::string::npos);
+  }
+}
+
+} // namespace
@@ -0,0 +1,143 @@
+#include "Optimization/ProfileGuidedSpecialization.h"
+#include "Kernels/Activation.h"
+#include "Optimization/KernelProfiling.h"
+#include "Runtime/KernelJIT.h"
+#include "Runtime/KernelProfiler.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+using ReLUFn = void(float *, float *, int64_t);
+
+TEST(ProfileGuidedSpecializationTest, ProfileRoundTrips) {
+  KernelProfileData Profile;
+  Profile.recordRegion("conv", "loop.0 OuterLoopY.loop", {2, 500, 60});
+  Profile.recordRegion("conv", "loop.0 OuterLoopY.loop", {1, 250, 30});
+  Profile.recordShape("conv", {1, 3, 224, 224}, 90);
+  Profile.recordShape("conv", {1, 3, 112, 112}, 9);
+  Profile.recordShape("conv", {4, 3, 224, 224}, 1);
+
+  std::string Text;
+  raw_string_ostream OS(Text);
+  Profile.print(OS);
+  auto Parsed = KernelProfileData::parse(OS.str());
+  ASSERT_TRUE(!!Parsed) << toString(Parsed.takeError());
+
+  const RegionProfile *Loop = Parsed->getRegion("conv", "loop.0 OuterLoopY.loop");
+  ASSERT_TRUE(Loop != nullptr);
+  EXPECT_EQ(Loop->Calls, 3u);
+  EXPECT_EQ(Loop->Cycles, 750u);
+  EXPECT_DOUBLE_EQ(Loop->getTripsPerCall(), 30.0);
+  EXPECT_EQ(Parsed->getRegion("conv", "kernel"), nullptr);
+
+  auto Hot = Parsed->getHotShapes("conv", 0.05);
+  ASSERT_EQ(Hot.size(), 2u);
+  EXPECT_EQ(Hot[0].Dims, (std::vector<int64_t>{1, 3, 224, 224}));
+  EXPECT_EQ(Hot[0].Count, 90u);
+  EXPECT_EQ(Hot[1].Dims, (std::vector<int64_t>{1, 3, 112, 112}));
+
+  EXPECT_FALSE(!!KernelProfileData::parse("region conv 1 2\n"));
+  EXPECT_FALSE(!!KernelProfileData::parse("shape conv 1 x\n"));
+  EXPECT_FALSE(!!KernelProfileData::parse("edge a b\n"));
+}
+
+TEST(ProfileGuidedSpecializationTest, ChoosesHintsFromTripCounts) {
+  ProfileGuidedConfig Config;
+  ProfiledLoopHints Short = getProfiledLoopHints(3.0, true, Config);
+  EXPECT_EQ(Short.UnrollCount, 3u);
+  EXPECT_EQ(Short.VectorWidth, 1u);
+
+  ProfiledLoopHints Medium = getProfiledLoopHints(12.0, true, Config);
+  EXPECT_EQ(Medium.UnrollCount, 0u);
+  EXPECT_EQ(Medium.VectorWidth, 8u);
+  EXPECT_EQ(Medium.InterleaveCount, 1u);
+
+  ProfiledLoopHints Long = getProfiledLoopHints(4096.0, true, Config);
+  EXPECT_EQ(Long.VectorWidth, 16u);
+  EXPECT_EQ(Long.InterleaveCount, 4u);
+
+  // Outer loops only get an unroll count, and only when short
+  ProfiledLoopHints Outer = getProfiledLoopHints(4096.0, false, Config);
+  EXPECT_EQ(Outer.UnrollCount, 0u);
+  EXPECT_EQ(Outer.VectorWidth, 0u);
+  EXPECT_EQ(getProfiledLoopHints(0.0, true, Config).UnrollCount, 0u);
+}
+
+TEST(ProfileGuidedSpecializationTest, SelectsFasterConvolution) {
+  ConvolutionDims Dims;
+  Dims.N = 1, Dims.C = 8, Dims.H = 16, Dims.W = 16, Dims.K = 8, Dims.R = 3, Dims.S = 3;
+
+  KernelProfileData Empty;
+  EXPECT_EQ(selectConvolutionAlgorithm(Empty, "direct", "winograd", Dims, 1, 1), ConvolutionAlgorithm::Winograd);
+  EXPECT_EQ(selectConvolutionAlgorithm(Empty, "direct", "winograd", Dims, 2, 2), ConvolutionAlgorithm::Direct);
+
+  KernelProfileData Measured;
+  Measured.recordRegion("direct", "kernel", {10, 1000, 0});
+  Measured.recordRegion("winograd", "kernel", {10, 4000, 0});
+  EXPECT_EQ(selectConvolutionAlgorithm(Measured, "direct", "winograd", Dims, 1, 1), ConvolutionAlgorithm::Direct);
+}
+
+TEST(ProfileGuidedSpecializationTest, AppliesRecordedTripCounts) {
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  initializeCore(Registry);
+  initializeAnalysis(Registry);
+
+  // Profile a dynamic ReLU that only ever runs over 4096 elements
+  auto Context = std::make_unique<LLVMContext>();
+  auto M = std::make_unique<Module>("ProfileGuidedSpecializationTestModule", *Context);
+  createReLUFunction(*M, DynamicDim, "pgoReLU");
+  legacy::PassManager Instrument;
+  Instrument.add(createKernelProfilingPass());
+  Instrument.run(*M);
+
+  auto JIT = cantFail(KernelJIT::create());
+  ASSERT_FALSE(!!JIT->addModule(orc::ThreadSafeModule(std::move(M), std::move(Context))));
+  auto *ReLU = reinterpret_cast<ReLUFn *>(cantFail(JIT->lookup("pgoReLU")));
+  std::vector<float> Input(4096, -1.0f), Output(4096);
+  // Sites of other kernels keep zero calls, so only pgoReLU enters the profile
+  resetKernelProfile();
+  for (unsigned I = 0; I < 3; ++I)
+    ReLU(Input.data(), Output.data(), Input.size());
+
+  KernelProfileData Profile;
+  Profile.addRuntimeCounters();
+  resetKernelProfile();
+
+  // Apply the profile to a fresh, uninstrumented copy of the kernel
+  LLVMContext FreshContext;
+  Module Fresh("ProfileGuidedSpecializationTestModule", FreshContext);
+  Function *Kernel = createReLUFunction(Fresh, DynamicDim, "pgoReLU");
+  legacy::PassManager PM;
+  PM.add(createProfileGuidedSpecializationPass(Profile));
+  PM.run(Fresh);
+  ASSERT_FALSE(verifyModule(Fresh, &errs()));
+
+  DominatorTree DT(*Kernel);
+  LoopInfo LI(DT);
+  ASSERT_EQ(LI.getTopLevelLoops().size(), 1u);
+  Loop *L = LI.getTopLevelLoops()[0];
+  Optional<int> Width = getOptionalIntLoopAttribute(L, "llvm.loop.vectorize.width");
+  ASSERT_TRUE(Width.hasValue());
+  EXPECT_EQ(*Width, 16);
+  EXPECT_EQ(getOptionalIntLoopAttribute(L, "llvm.loop.interleave.count").getValueOr(0), 4);
+
+  // The back edge is taken 4095 times for every exit
+  uint64_t TrueWeight, FalseWeight;
+  ASSERT_TRUE(L->getExitingBlock()->getTerminator()->extractProfMetadata(TrueWeight, FalseWeight));
+  EXPECT_EQ(TrueWeight, 3u * 4095);
+  EXPECT_EQ(FalseWeight, 3u);
+}
+
+} // namespace
@@ -0,0 +1,74 @@
+#include "Optimization/RooflineAnalysis.h"
+#include "Kernels/Activation.h"
+#include "Kernels/Convolution.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+SmallVector<RooflineEstimate, 4> estimate(Function &F, const RooflineConfig &Config = RooflineConfig()) {
+  TargetLibraryInfoImpl TLII(Triple(F.getParent()->getTargetTriple()));
+  TargetLibraryInfo TLI(TLII);
+  AssumptionCache AC(F);
+  DominatorTree DT(F);
+  LoopInfo LI(DT);
+  ScalarEvolution SE(F, TLI, AC, DT, LI);
+  return estimateRoofline(F, LI, SE, Config);
+}
+
+TEST(RooflineAnalysisTest, ReLUIsMemoryBound) {
+  LLVMContext Context;
+  Module M("RooflineAnalysisTestModule", Context);
+  Function *ReLU = createReLUFunction(M, 1024);
+
+  auto Estimates = estimate(*ReLU);
+  ASSERT_EQ(Estimates.size(), 1u);
+  // One compare per element, one float loaded and one stored
+  EXPECT_EQ(Estimates[0].Flops, 1024.0);
+  EXPECT_EQ(Estimates[0].Bytes, 1024.0 * 8);
+  EXPECT_TRUE(Estimates[0].Exact);
+  EXPECT_FALSE(Estimates[0].isComputeBound(RooflineConfig()));
+}
+
+TEST(RooflineAnalysisTest, ConvolutionCountsReuseOnce) {
+  LLVMContext Context;
+  Module M("RooflineAnalysisTestModule", Context);
+  ConvolutionDims Dims{1, 1, 8, 8, 1, 3, 3};
+  Function *Conv = createConvolutionFunction(M, Dims, 1, 1, 0, 0);
+
+  auto Estimates = estimate(*Conv);
+  ASSERT_EQ(Estimates.size(), 1u);
+  // 6x6 outputs, each a 3x3 multiply-accumulate
+  EXPECT_EQ(Estimates[0].Flops, 6.0 * 6 * 9 * 2);
+  // Input read per tap, weights once per output channel, outputs stored once
+  EXPECT_EQ(Estimates[0].Bytes, (6.0 * 6 * 9 + 9 + 6 * 6) * 4);
+  EXPECT_TRUE(Estimates[0].Exact);
+
+  RooflineConfig FastMemory;
+  FastMemory.PeakGBps = 1000.0;
+  EXPECT_TRUE(Estimates[0].isComputeBound(FastMemory));
+}
+
+TEST(RooflineAnalysisTest, UnknownTripCountsAreEstimated) {
+  LLVMContext Context;
+  Module M("RooflineAnalysisTestModule", Context);
+  Function *ReLU = createReLUFunction(M, DynamicDim);
+
+  RooflineConfig Config;
+  Config.DefaultTripCount = 10;
+  auto Estimates = estimate(*ReLU, Config);
+  ASSERT_EQ(Estimates.size(), 1u);
+  EXPECT_FALSE(Estimates[0].Exact);
+  EXPECT_EQ(Estimates[0].Flops, 10.0);
+}
+
+} // namespace
@@ -0,0 +1,105 @@
+#include "Optimization/UnrollAndJam.h"
+#include "Kernels/Convolution.h"
+#include "Kernels/TensorDescriptor.h"
+#include "Runtime/KernelJIT.h"
+#include "TestUtils.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetMachine.h"
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+using ConvFn = void(float *, float *, float *, int64_t, int64_t, int64_t, int64_t, int64_t, int64_t, int64_t);
+
+unsigned countFMuls(Function &F) {
+  unsigned Count = 0;
+  for (Instruction &I : instructions(F))
+    Count += I.getOpcode() == Instruction::FMul;
+  return Count;
+}
+
+/// Generate a static 3x3 convolution, optionally with noalias tensors, run the
+/// pass with the host's TTI, check the result and return the number of fmuls.
+unsigned runConvolution(bool NoAlias) {
+  ConvolutionDims Dims;
+  Dims.N = 1, Dims.C = 4, Dims.H = 9, Dims.W = 11, Dims.K = 3, Dims.R = 3, Dims.S = 3;
+  // Padding keeps branches in the channel loop and 11 columns leave a remainder
+  const int64_t OH = 9, OW = 11;
+
+  auto Context = std::make_unique<LLVMContext>();
+  auto M = std::make_unique<Module>("UnrollAndJamTestModule", *Context);
+  Function *Conv = createConvolutionFunction(*M, Dims, 1, 1, 1, 1, "conv");
+  if (NoAlias)
+    addTensorArgumentGuarantees(*Conv, {{0, {1, 4, 9, 11}}, {1, {3, 4, 3, 3}}, {2, {1, 3, OH, OW}}});
+
+  auto TM = cantFail(cantFail(orc::JITTargetMachineBuilder::detectHost()).createTargetMachine());
+  M->setDataLayout(TM->createDataLayout());
+  legacy::PassManager PM;
+  PM.add(createTargetTransformInfoWrapperPass(TM->getTargetIRAnalysis()));
+  PM.add(createUnrollAndJamPass());
+  PM.run(*M);
+  EXPECT_FALSE(verifyModule(*M, &errs()));
+  unsigned FMuls = countFMuls(*Conv);
+
+  auto JIT = cantFail(KernelJIT::create());
+  EXPECT_FALSE(!!JIT->addModule(orc::ThreadSafeModule(std::move(M), std::move(Context))));
+  auto *Run = reinterpret_cast<ConvFn *>(cantFail(JIT->lookup("conv")));
+  auto Input = makeData(4 * 9 * 11, 1);
+  auto Weight = makeData(3 * 4 * 3 * 3, 5);
+  std::vector<float> Output(3 * OH * OW, -1.0f);
+  Run(Input.data(), Weight.data(), Output.data(), 1, 4, 9, 11, 3, 3, 3);
+
+  for (int64_t K = 0; K < 3; ++K)
+    for (int64_t Y = 0; Y < OH; ++Y)
+      for (int64_t X = 0; X < OW; ++X) {
+        float Expected = 0.0f;
+        for (int64_t C = 0; C < 4; ++C)
+          for (int64_t R = 0; R < 3; ++R)
+            for (int64_t S = 0; S < 3; ++S) {
+              int64_t IY = Y + R - 1, IX = X + S - 1;
+              if (IY >= 0 && IY < 9 && IX >= 0 && IX < 11)
+                Expected += Input[(C * 9 + IY) * 11 + IX] * Weight[((K * 4 + C) * 3 + R) * 3 + S];
+            }
+        EXPECT_NEAR(Output[(K * OH + Y) * OW + X], Expected, 1e-3f) << "output " << K << "," << Y << "," << X;
+      }
+  return FMuls;
+}
+
+TEST(UnrollAndJamTest, ChoosesCountFromRegisters) {
+  UnrollAndJamConfig Config;
+  // 9 shared weights leave 7 registers, enough for 3 copies of 2 values
+  EXPECT_EQ(getUnrollAndJamCount(16, 9, 2, Config), 2u);
+  EXPECT_EQ(getUnrollAndJamCount(32, 9, 2, Config), 8u);
+  EXPECT_EQ(getUnrollAndJamCount(32, 1, 1, Config), Config.MaxCount);
+  EXPECT_EQ(getUnrollAndJamCount(8, 9, 2, Config), 1u);
+  EXPECT_EQ(getUnrollAndJamCount(16, 15, 2, Config), 1u);
+}
+
+TEST(UnrollAndJamTest, JamsConvolutionPixels) {
+  InitializeNativeTarget();
+  InitializeNativeTargetAsmPrinter();
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  initializeCore(Registry);
+  initializeAnalysis(Registry);
+
+  // Without noalias the output store may feed a later input load
+  EXPECT_EQ(runConvolution(false), 9u);
+
+  // The 9 filter taps are fully unrolled and then shared by jammed output
+  // columns, plus the epilogue for the remaining columns
+  EXPECT_GT(runConvolution(true), 2 * 9u);
+}
+
+} // namespace
@@ -0,0 +1,111 @@
+#include "Runtime/BatchedDispatcher.h"
+#include "Kernels/Activation.h"
+#include "Kernels/Convolution.h"
+#include "Runtime/KernelJIT.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+using namespace llvm;
+using namespace std::chrono_literals;
+
+namespace {
+
+using ConvFn = void(float *, float *, float *, int64_t, int64_t, int64_t, int64_t, int64_t, int64_t, int64_t);
+using ReLUFn = void(float *, float *, int64_t);
+
+TEST(BatchedDispatcherTest, RunsConvolutionBatches) {
+  // A 3x3 convolution and ReLU with only the batch extent left dynamic
+  ConvolutionDims Dims;
+  Dims.C = 2, Dims.H = 6, Dims.W = 6, Dims.K = 4, Dims.R = 3, Dims.S = 3;
+  const int64_t InputSize = 2 * 6 * 6, OutputSize = 4 * 4 * 4;
+  auto Context = std::make_unique<LLVMContext>();
+  auto M = std::make_unique<Module>("BatchedDispatcherTestModule", *Context);
+  createConvolutionFunction(*M, Dims, 1, 1, 0, 0, "conv");
+  createReLUFunction(*M, DynamicDim, "relu");
+  auto JIT = cantFail(KernelJIT::create());
+  ASSERT_FALSE(!!JIT->addModule(orc::ThreadSafeModule(std::move(M), std::move(Context))));
+  auto *Conv = reinterpret_cast<ConvFn *>(cantFail(JIT->lookup("conv")));
+  auto *ReLU = reinterpret_cast<ReLUFn *>(cantFail(JIT->lookup("relu")));
+
+  std::vector<float> Weight(4 * 2 * 3 * 3);
+  for (size_t I = 0; I < Weight.size(); ++I)
+    Weight[I] = static_cast<float>(I % 5) * 0.5f - 1.0f;
+  auto Network = [&](const void *Input, void *Output, int64_t Batch) {
+    auto *Out = static_cast<float *>(Output);
+    Conv(static_cast<float *>(const_cast<void *>(Input)), Weight.data(), Out, Batch, 2, 6, 6, 4, 3, 3);
+    ReLU(Out, Out, Batch * OutputSize);
+  };
+
+  const unsigned NumRequests = 10;
+  std::vector<std::vector<float>> Inputs, Outputs;
+  std::vector<InferenceRequest> Requests;
+  for (unsigned R = 0; R < NumRequests; ++R) {
+    Inputs.emplace_back(InputSize);
+    for (int64_t I = 0; I < InputSize; ++I)
+      Inputs[R][I] = static_cast<float>((I * 3 + R * 7) % 11) - 5.0f;
+    Outputs.emplace_back(OutputSize, -1.0f);
+  }
+  for (unsigned R = 0; R < NumRequests; ++R)
+    Requests.push_back({Inputs[R].data(), Outputs[R].data()});
+
+  BatchingOptions Options;
+  Options.MaxBatchSize = 4;
+  BatchedDispatcher Dispatcher(Network, InputSize * sizeof(float), OutputSize * sizeof(float), Options);
+  Dispatcher.runBatched(Requests);
+  EXPECT_EQ(Dispatcher.getNumBatches(), 3u);
+
+  // Every request's result matches running it alone
+  std::vector<float> Expected(OutputSize);
+  for (unsigned R = 0; R < NumRequests; ++R) {
+    Network(Inputs[R].data(), Expected.data(), 1);
+    EXPECT_EQ(Outputs[R], Expected) << "request " << R;
+  }
+}
+
+TEST(BatchedDispatcherTest, CoalescesUntilFullOrDue) {
+  std::mutex Mutex;
+  std::vector<int64_t> BatchSizes;
+  auto Double = [&](const void *Input, void *Output, int64_t Batch) {
+    for (int64_t I = 0; I < Batch; ++I)
+      static_cast<float *>(Output)[I] = 2.0f * static_cast<const float *>(Input)[I];
+    std::lock_guard<std::mutex> Lock(Mutex);
+    BatchSizes.push_back(Batch);
+  };
+
+  std::vector<float> Inputs(9), Outputs(9, 0.0f);
+  for (unsigned I = 0; I < Inputs.size(); ++I)
+    Inputs[I] = static_cast<float>(I);
+
+  {
+    // With a long delay, batches only run when full or at shutdown
+    BatchingOptions Options;
+    Options.MaxBatchSize = 4;
+    Options.MaxQueueDelay = 60s;
+    BatchedDispatcher Dispatcher(Double, sizeof(float), sizeof(float), Options);
+    std::vector<std::future<void>> Done;
+    for (unsigned I = 0; I < 9; ++I)
+      Done.push_back(Dispatcher.submit(&Inputs[I], &Outputs[I]));
+    for (unsigned I = 0; I < 8; ++I)
+      EXPECT_EQ(Done[I].wait_for(10s), std::future_status::ready) << "request " << I;
+    EXPECT_EQ(Done[8].wait_for(10ms), std::future_status::timeout);
+  }
+  for (unsigned I = 0; I < Inputs.size(); ++I)
+    EXPECT_EQ(Outputs[I], 2.0f * I);
+  EXPECT_EQ(BatchSizes, (std::vector<int64_t>{4, 4, 1}));
+
+  // A lone request runs once its delay has passed
+  BatchingOptions Options;
+  Options.MaxQueueDelay = 1ms;
+  BatchedDispatcher Dispatcher(Double, sizeof(float), sizeof(float), Options);
+  float Output = 0.0f;
+  EXPECT_EQ(Dispatcher.submit(&Inputs[3], &Output).wait_for(10s), std::future_status::ready);
+  EXPECT_EQ(Output, 6.0f);
+  EXPECT_EQ(Dispatcher.getNumBatches(), 1u);
+}
+
+} // namespace
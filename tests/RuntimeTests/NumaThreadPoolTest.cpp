@@ -0,0 +1,114 @@
+#include "Runtime/NumaThreadPool.h"
+#include "Kernels/Activation.h"
+#include "Runtime/KernelJIT.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+using ReLUFn = void(const float *, float *, int64_t);
+
+/// Two nodes that share CPU 0, so node-aware logic runs on any host.
+NumaTopology getTwoNodeTopology() {
+  NumaTopology Topology;
+  Topology.NodeCPUs = {{0}, {0}};
+  return Topology;
+}
+
+TEST(NumaThreadPoolTest, ParsesCPULists) {
+  std::vector<unsigned> CPUs;
+  ASSERT_TRUE(parseCPUList("0-3,8,10-11\n", CPUs));
+  EXPECT_EQ(CPUs, (std::vector<unsigned>{0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_FALSE(parseCPUList("", CPUs));
+  EXPECT_FALSE(parseCPUList("3-1", CPUs));
+  EXPECT_FALSE(parseCPUList("a", CPUs));
+
+  NumaTopology Host = NumaTopology::detect();
+  ASSERT_GE(Host.getNumNodes(), 1u);
+  for (const auto &CPUs : Host.NodeCPUs)
+    EXPECT_FALSE(CPUs.empty());
+}
+
+TEST(NumaThreadPoolTest, NodesOwnContiguousRanges) {
+  NumaPoolOptions Options;
+  Options.ThreadsPerNode = 3;
+  NumaThreadPool Pool(getTwoNodeTopology(), Options);
+  ASSERT_EQ(Pool.getNumNodes(), 2u);
+  ASSERT_EQ(Pool.getNumThreads(), 6u);
+
+  for (int64_t Extent : {0, 4, 1000}) {
+    std::vector<std::atomic<unsigned>> Visits(Extent);
+    std::vector<std::atomic<int>> Owner(Extent);
+    Pool.parallelFor(Extent, [&](int64_t Begin, int64_t End, unsigned Node) {
+      for (int64_t I = Begin; I < End; ++I) {
+        Visits[I].fetch_add(1);
+        Owner[I].store(Node);
+      }
+    });
+
+    auto First = Pool.getNodeRange(Extent, 0), Second = Pool.getNodeRange(Extent, 1);
+    EXPECT_EQ(First.first, 0);
+    EXPECT_EQ(First.second, Second.first);
+    EXPECT_EQ(Second.second, Extent);
+    for (int64_t I = 0; I < Extent; ++I) {
+      EXPECT_EQ(Visits[I].load(), 1u) << I;
+      EXPECT_EQ(Owner[I].load(), I < First.second ? 0 : 1) << I;
+    }
+  }
+}
+
+TEST(NumaThreadPoolTest, FirstTouchAndReplication) {
+  NumaPoolOptions Options;
+  Options.ThreadsPerNode = 2;
+  Options.ReplicateWeights = true;
+  NumaThreadPool Replicating(getTwoNodeTopology(), Options);
+
+  NumaBuffer Buffer = Replicating.allocateFirstTouch(100, 3 * sizeof(float));
+  ASSERT_TRUE(!!Buffer);
+  EXPECT_EQ(Buffer.size(), 300 * sizeof(float));
+  for (int I = 0; I < 300; ++I)
+    ASSERT_EQ(Buffer.getAs<float>()[I], 0.0f);
+
+  std::vector<float> Weights = {1.0f, -2.0f, 3.0f, -4.0f};
+  auto Replicas = Replicating.replicate(Weights.data(), Weights.size() * sizeof(float));
+  ASSERT_EQ(Replicas.getNumCopies(), 2u);
+  EXPECT_NE(Replicas.get(0), Replicas.get(1));
+  for (unsigned Node = 0; Node < 2; ++Node)
+    EXPECT_EQ(std::vector<float>(Replicas.getAs<float>(Node), Replicas.getAs<float>(Node) + 4), Weights);
+
+  NumaThreadPool Sharing(getTwoNodeTopology(), NumaPoolOptions{1, false});
+  auto Shared = Sharing.replicate(Weights.data(), Weights.size() * sizeof(float));
+  EXPECT_EQ(Shared.getNumCopies(), 1u);
+  EXPECT_EQ(Shared.get(0), Shared.get(1));
+}
+
+TEST(NumaThreadPoolTest, PartitionsKernelOverFirstTouchedRows) {
+  auto Context = std::make_unique<LLVMContext>();
+  auto M = std::make_unique<Module>("NumaThreadPoolTestModule", *Context);
+  createReLUFunction(*M, DynamicDim);
+  auto JIT = cantFail(KernelJIT::create());
+  ASSERT_FALSE(!!JIT->addModule(orc::ThreadSafeModule(std::move(M), std::move(Context))));
+  auto *ReLU = reinterpret_cast<ReLUFn *>(cantFail(JIT->lookup("ReLU")));
+
+  NumaThreadPool Pool(getTwoNodeTopology(), NumaPoolOptions{2, false});
+  const int64_t Rows = 37, Cols = 64;
+  NumaBuffer Input = Pool.allocateFirstTouch(Rows, Cols * sizeof(float));
+  NumaBuffer Output = Pool.allocateFirstTouch(Rows, Cols * sizeof(float));
+  for (int64_t I = 0; I < Rows * Cols; ++I)
+    Input.getAs<float>()[I] = static_cast<float>(I % 9) - 4.0f;
+
+  // Each node runs the kernel over the rows it first-touched
+  Pool.parallelFor(Rows, [&](int64_t Begin, int64_t End, unsigned) {
+    ReLU(Input.getAs<float>() + Begin * Cols, Output.getAs<float>() + Begin * Cols, (End - Begin) * Cols);
+  });
+  for (int64_t I = 0; I < Rows * Cols; ++I)
+    ASSERT_EQ(Output.getAs<float>()[I], std::max(Input.getAs<float>()[I], 0.0f)) << I;
+}
+
+} // namespace
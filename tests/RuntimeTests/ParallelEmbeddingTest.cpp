@@ -0,0 +1,73 @@
+#include "Runtime/ParallelEmbedding.h"
+#include "Kernels/Embedding.h"
+#include "Runtime/KernelJIT.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+/// Two nodes that share CPU 0, so the split runs on any host.
+NumaTopology getTwoNodeTopology() {
+  NumaTopology Topology;
+  Topology.NodeCPUs = {{0}, {0}};
+  return Topology;
+}
+
+TEST(ParallelEmbeddingTest, SplitsBagsByIndexCount) {
+  auto Context = std::make_unique<LLVMContext>();
+  auto M = std::make_unique<Module>("ParallelEmbeddingTestModule", *Context);
+  createEmbeddingBagFunction(*M, EmbeddingBagMode::Sum, DynamicDim);
+  createEmbeddingLookupFunction(*M, DynamicDim);
+  auto JIT = cantFail(KernelJIT::create());
+  ASSERT_FALSE(!!JIT->addModule(orc::ThreadSafeModule(std::move(M), std::move(Context))));
+  auto *Bag = reinterpret_cast<EmbeddingBagKernelFn *>(cantFail(JIT->lookup("embeddingBag")));
+  auto *Lookup = reinterpret_cast<EmbeddingLookupKernelFn *>(cantFail(JIT->lookup("embeddingLookup")));
+
+  const int64_t Rows = 97, Dim = 12;
+  std::vector<float> Table(Rows * Dim);
+  for (int64_t I = 0; I < Rows * Dim; ++I)
+    Table[I] = static_cast<float>(I % 29) - 14.0f;
+
+  // Uneven bags, including leading, inner and trailing empty ones, so worker
+  // ranges start and end inside bags
+  std::vector<int64_t> Offsets = {0, 0};
+  std::vector<int64_t> Indices;
+  for (int64_t Bag = 0; Bag < 30; ++Bag) {
+    for (int64_t I = 0; I < (Bag * 7) % 11; ++I)
+      Indices.push_back((Bag * 13 + I * 5) % Rows);
+    Offsets.push_back(Indices.size());
+  }
+  Offsets.push_back(Indices.size());
+  const int64_t NumBags = Offsets.size() - 1;
+
+  NumaThreadPool Pool(getTwoNodeTopology(), NumaPoolOptions{2, false});
+  std::vector<float> Pooled(NumBags * Dim, -1.0f);
+  parallelEmbeddingBag(Pool, Bag, Table.data(), Indices.data(), Offsets.data(), Pooled.data(), NumBags, Dim);
+  std::vector<float> Gathered(Indices.size() * Dim, -1.0f);
+  parallelEmbeddingLookup(Pool, Lookup, Table.data(), Indices.data(), Gathered.data(), Indices.size(), Dim);
+
+  for (int64_t B = 0; B < NumBags; ++B)
+    for (int64_t D = 0; D < Dim; ++D) {
+      float Expected = 0.0f;
+      for (int64_t I = Offsets[B]; I < Offsets[B + 1]; ++I)
+        Expected += Table[Indices[I] * Dim + D];
+      EXPECT_EQ(Pooled[B * Dim + D], Expected) << "bag " << B << " column " << D;
+    }
+  for (size_t I = 0; I < Indices.size(); ++I)
+    for (int64_t D = 0; D < Dim; ++D)
+      EXPECT_EQ(Gathered[I * Dim + D], Table[Indices[I] * Dim + D]) << "index " << I;
+
+  // A batch of only empty bags still zeroes every output row
+  const std::vector<int64_t> EmptyOffsets = {3, 3, 3};
+  std::vector<float> Empty(2 * Dim, -1.0f);
+  parallelEmbeddingBag(Pool, Bag, Table.data(), Indices.data(), EmptyOffsets.data(), Empty.data(), 2, Dim);
+  for (float Value : Empty)
+    EXPECT_EQ(Value, 0.0f);
+}
+
+} // namespace
@@ -0,0 +1,96 @@
+#include "Runtime/ParallelReduction.h"
+#include "TestUtils.h"
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+/// Two nodes that share CPU 0, so the split runs on any host.
+NumaTopology getTwoNodeTopology() {
+  NumaTopology Topology;
+  Topology.NodeCPUs = {{0}, {0}};
+  return Topology;
+}
+
+/// Generate the 2-D partial reduction that parallelReduce runs per worker.
+std::function<Function *(Module &)> partialReduction(ReductionKind Kind, std::vector<unsigned> Axes) {
+  return [=](Module &M) { return createReductionFunction(M, Kind, {DynamicDim, DynamicDim}, Axes, /*Partial=*/true); };
+}
+
+TEST(ParallelReductionTest, MergesPartialsAcrossWorkers) {
+  NumaThreadPool Pool(getTwoNodeTopology(), NumaPoolOptions{2, false});
+  const int64_t Rows = 101, Cols = 13;
+  std::vector<float> Input(Rows * Cols);
+  for (int64_t I = 0; I < Rows * Cols; ++I)
+    Input[I] = static_cast<float>((I * 5) % 23) - 11.0f;
+  // The largest value appears twice; the first occurrence must win
+  Input[70 * Cols + 4] = 50.0f;
+  Input[90 * Cols + 4] = 50.0f;
+
+  // Column reductions split the reduced axis across the four workers
+  std::unique_ptr<KernelJIT> MeanJIT, ArgMaxJIT;
+  auto *Mean = compile<ReductionKernelFn>(MeanJIT, partialReduction(ReductionKind::Mean, {0}));
+  std::vector<float> ColumnMeans(Cols);
+  parallelReduce(Pool, Mean, ReductionKind::Mean, {Rows, Cols}, {0}, Input.data(), ColumnMeans.data());
+
+  auto *ArgMax = compile<ReductionKernelFn>(ArgMaxJIT, partialReduction(ReductionKind::ArgMax, {0}));
+  std::vector<float> ColumnMax(Cols);
+  std::vector<int64_t> ColumnArgMax(Cols);
+  parallelReduce(Pool, ArgMax, ReductionKind::ArgMax, {Rows, Cols}, {0}, Input.data(), ColumnMax.data(),
+                 ColumnArgMax.data());
+
+  for (int64_t Col = 0; Col < Cols; ++Col) {
+    double Sum = 0.0;
+    int64_t Best = 0;
+    for (int64_t Row = 0; Row < Rows; ++Row) {
+      Sum += Input[Row * Cols + Col];
+      if (Input[Row * Cols + Col] > Input[Best * Cols + Col])
+        Best = Row;
+    }
+    EXPECT_NEAR(ColumnMeans[Col], Sum / Rows, 1e-4) << Col;
+    EXPECT_EQ(ColumnArgMax[Col], Best) << Col;
+    EXPECT_EQ(ColumnMax[Col], Input[Best * Cols + Col]) << Col;
+  }
+  EXPECT_EQ(ColumnArgMax[4], 70);
+
+  // Row reductions give every worker its own rows
+  std::unique_ptr<KernelJIT> NormJIT;
+  auto *Norm = compile<ReductionKernelFn>(NormJIT, partialReduction(ReductionKind::L2Norm, {1}));
+  std::vector<float> RowNorms(Rows);
+  parallelReduce(Pool, Norm, ReductionKind::L2Norm, {Rows, Cols}, {1}, Input.data(), RowNorms.data());
+  for (int64_t Row = 0; Row < Rows; ++Row) {
+    double SumOfSquares = 0.0;
+    for (int64_t Col = 0; Col < Cols; ++Col)
+      SumOfSquares += Input[Row * Cols + Col] * Input[Row * Cols + Col];
+    EXPECT_NEAR(RowNorms[Row], std::sqrt(SumOfSquares), 1e-3) << Row;
+  }
+}
+
+TEST(ParallelReductionTest, EmptyOuterAxis) {
+  NumaThreadPool Pool(getTwoNodeTopology(), NumaPoolOptions{2, false});
+  const float *NoInput = nullptr;
+
+  // Reducing an empty outermost axis leaves every output at the identity
+  std::unique_ptr<KernelJIT> SumJIT, MaxJIT, RowJIT;
+  auto *Sum = compile<ReductionKernelFn>(SumJIT, partialReduction(ReductionKind::Sum, {0}));
+  std::vector<float> Sums(5, -1.0f);
+  parallelReduce(Pool, Sum, ReductionKind::Sum, {0, 5}, {0}, NoInput, Sums.data());
+  EXPECT_EQ(Sums, std::vector<float>(5, 0.0f));
+
+  auto *Max = compile<ReductionKernelFn>(MaxJIT, partialReduction(ReductionKind::Max, {0}));
+  std::vector<float> Maxima(5, 0.0f);
+  parallelReduce(Pool, Max, ReductionKind::Max, {0, 5}, {0}, NoInput, Maxima.data());
+  EXPECT_EQ(Maxima, std::vector<float>(5, -INFINITY));
+
+  // Keeping it leaves nothing to write
+  auto *RowSum = compile<ReductionKernelFn>(RowJIT, partialReduction(ReductionKind::Sum, {1}));
+  float Untouched = -1.0f;
+  parallelReduce(Pool, RowSum, ReductionKind::Sum, {0, 5}, {1}, NoInput, &Untouched);
+  EXPECT_EQ(Untouched, -1.0f);
+}
+
+} // namespace
@@ -0,0 +1,174 @@
+#include "Runtime/PipelineExecutor.h"
+#include "Kernels/Activation.h"
+#include "Kernels/Normalization.h"
+#include "Runtime/KernelJIT.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+using ReLUFn = void(const float *, float *, int64_t);
+using SoftmaxFn = void(const float *, float *, int64_t, int64_t);
+
+TEST(PipelineExecutorTest, SPSCQueuePreservesOrder) {
+  SPSCQueue<unsigned> Queue(8);
+  const unsigned Count = 20000;
+  std::thread Producer([&] {
+    for (unsigned I = 0; I < Count; ++I)
+      while (!Queue.tryPush(I))
+        std::this_thread::yield();
+  });
+
+  unsigned Next = 0, Value;
+  while (Next < Count) {
+    if (Queue.tryPop(Value)) {
+      ASSERT_EQ(Value, Next++);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  Producer.join();
+  EXPECT_FALSE(Queue.tryPop(Value));
+}
+
+TEST(PipelineExecutorTest, MPMCQueueDeliversEveryElementOnce) {
+  MPMCQueue<unsigned> Queue(16);
+  for (unsigned I = 0; I < 16; ++I)
+    ASSERT_TRUE(Queue.tryPush(I));
+  EXPECT_FALSE(Queue.tryPush(16));
+  unsigned Value;
+  for (unsigned I = 0; I < 16; ++I) {
+    ASSERT_TRUE(Queue.tryPop(Value));
+    EXPECT_EQ(Value, I);
+  }
+  EXPECT_FALSE(Queue.tryPop(Value));
+
+  const unsigned PerProducer = 5000, NumThreads = 4;
+  std::vector<std::atomic<unsigned>> Seen(NumThreads * PerProducer);
+  std::atomic<unsigned> Received{0};
+  std::vector<std::thread> Threads;
+  for (unsigned T = 0; T < NumThreads; ++T) {
+    Threads.emplace_back([&, T] {
+      for (unsigned I = 0; I < PerProducer; ++I)
+        while (!Queue.tryPush(T * PerProducer + I))
+          std::this_thread::yield();
+    });
+    Threads.emplace_back([&] {
+      unsigned Value;
+      while (Received.load() < NumThreads * PerProducer) {
+        if (Queue.tryPop(Value)) {
+          Seen[Value].fetch_add(1);
+          Received.fetch_add(1);
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (std::thread &T : Threads)
+    T.join();
+
+  for (auto &Count : Seen)
+    ASSERT_EQ(Count.load(), 1u);
+}
+
+TEST(PipelineExecutorTest, RequestsOverlapAcrossStages) {
+  struct Request {
+    std::vector<unsigned> Trace;
+  };
+  std::atomic<unsigned> Active{0}, MaxActive{0};
+  auto MakeStage = [&](unsigned Id, unsigned Workers) {
+    PipelineStage Stage;
+    Stage.NumWorkers = Workers;
+    Stage.Run = [&, Id](void *R) {
+      unsigned Now = Active.fetch_add(1) + 1;
+      unsigned Max = MaxActive.load();
+      while (Now > Max && !MaxActive.compare_exchange_weak(Max, Now))
+        ;
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+      static_cast<Request *>(R)->Trace.push_back(Id);
+      Active.fetch_sub(1);
+    };
+    return Stage;
+  };
+
+  // The middle stage has two workers, so it is fed and drained by MPMC queues
+  std::vector<Request> Requests(64);
+  std::vector<std::future<void>> Futures;
+  {
+    PipelineExecutor Executor({MakeStage(0, 1), MakeStage(1, 2), MakeStage(2, 1)}, 4);
+    EXPECT_EQ(Executor.getNumStages(), 3u);
+    std::thread Submitter([&] {
+      for (unsigned I = 0; I < Requests.size(); I += 2)
+        Futures.push_back(Executor.submit(&Requests[I]));
+    });
+    std::vector<std::future<void>> Odd;
+    for (unsigned I = 1; I < Requests.size(); I += 2)
+      Odd.push_back(Executor.submit(&Requests[I]));
+    Submitter.join();
+    for (auto &Future : Odd)
+      Future.wait();
+  }
+
+  // Destroying the executor finished every request
+  for (auto &Future : Futures)
+    EXPECT_EQ(Future.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+  for (const Request &R : Requests)
+    EXPECT_EQ(R.Trace, (std::vector<unsigned>{0, 1, 2}));
+  EXPECT_GT(MaxActive.load(), 1u);
+}
+
+TEST(PipelineExecutorTest, StagesRunCompiledKernels) {
+  auto Context = std::make_unique<LLVMContext>();
+  auto M = std::make_unique<Module>("PipelineExecutorTestModule", *Context);
+  const int64_t Cols = 12;
+  createReLUFunction(*M, Cols);
+  createSoftmaxFunction(*M, 1, Cols);
+  auto JIT = cantFail(KernelJIT::create());
+  ASSERT_FALSE(!!JIT->addModule(orc::ThreadSafeModule(std::move(M), std::move(Context))));
+  auto *ReLU = reinterpret_cast<ReLUFn *>(cantFail(JIT->lookup("ReLU")));
+  auto *Softmax = reinterpret_cast<SoftmaxFn *>(cantFail(JIT->lookup("softmax")));
+
+  struct Activations {
+    std::vector<float> Input, Hidden, Output;
+  };
+  PipelineStage First, Second;
+  First.Run = [&](void *R) {
+    auto *A = static_cast<Activations *>(R);
+    ReLU(A->Input.data(), A->Hidden.data(), Cols);
+  };
+  Second.Run = [&](void *R) {
+    auto *A = static_cast<Activations *>(R);
+    Softmax(A->Hidden.data(), A->Output.data(), 1, Cols);
+  };
+  PipelineExecutor Executor({First, Second});
+
+  std::vector<Activations> Requests(16);
+  std::vector<std::future<void>> Futures;
+  for (unsigned I = 0; I < Requests.size(); ++I) {
+    for (int64_t Col = 0; Col < Cols; ++Col)
+      Requests[I].Input.push_back(static_cast<float>((Col * 5 + I) % 7) - 3.0f);
+    Requests[I].Hidden.resize(Cols);
+    Requests[I].Output.resize(Cols);
+    Futures.push_back(Executor.submit(&Requests[I]));
+  }
+
+  for (unsigned I = 0; I < Requests.size(); ++I) {
+    Futures[I].wait();
+    double Sum = 0.0;
+    for (float X : Requests[I].Input)
+      Sum += std::exp(std::max(X, 0.0f));
+    for (int64_t Col = 0; Col < Cols; ++Col)
+      EXPECT_NEAR(Requests[I].Output[Col], std::exp(std::max(Requests[I].Input[Col], 0.0f)) / Sum, 1e-6);
+  }
+}
+
+} // namespace
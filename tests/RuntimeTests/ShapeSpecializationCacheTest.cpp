@@ -0,0 +1,124 @@
+#include "Kernels/Activation.h"
+#include "Kernels/Convolution.h"
+#include "Runtime/ShapeSpecializationCache.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+using ReLUFn = void(float *, float *, int64_t);
+using ConvFn = void(float *, float *, float *, int64_t, int64_t, int64_t, int64_t, int64_t, int64_t, int64_t);
+
+TEST(ShapeSpecializationCacheTest, HotShapeIsSpecialized) {
+  auto Cache = ShapeSpecializationCache::create(
+      [](Module &M, ArrayRef<int64_t> Dims) { return createReLUFunction(M, Dims[0]); }, 1, /*HotThreshold=*/4);
+  ASSERT_TRUE(!!Cache) << toString(Cache.takeError());
+
+  void *Generic = (*Cache)->lookup({8});
+  for (unsigned I = 0; I < 3; ++I)
+    EXPECT_EQ((*Cache)->lookup({8}), Generic);
+  (*Cache)->waitForPendingSpecializations();
+  EXPECT_EQ((*Cache)->getNumSpecializations(), 1u);
+
+  // The hot shape now gets its own variant, other shapes keep the generic one
+  ReLUFn *Specialized = (*Cache)->lookupAs<ReLUFn>({8});
+  EXPECT_NE(reinterpret_cast<void *>(Specialized), Generic);
+  EXPECT_EQ((*Cache)->lookup({16}), Generic);
+
+  std::vector<float> Input = {-2.0f, -1.0f, 0.0f, 1.0f, 2.0f, -3.0f, 3.0f, 4.0f};
+  std::vector<float> Output(8, -1.0f);
+  Specialized(Input.data(), Output.data(), 8);
+  std::vector<float> Expected = {0.0f, 0.0f, 0.0f, 1.0f, 2.0f, 0.0f, 3.0f, 4.0f};
+  EXPECT_EQ(Output, Expected);
+}
+
+TEST(ShapeSpecializationCacheTest, ZeroThresholdSpecializesOnFirstLookup) {
+  auto Cache = cantFail(ShapeSpecializationCache::create(
+      [](Module &M, ArrayRef<int64_t> Dims) { return createReLUFunction(M, Dims[0]); }, 1, /*HotThreshold=*/0));
+  void *Generic = Cache->lookup({8});
+  Cache->waitForPendingSpecializations();
+  EXPECT_EQ(Cache->getNumSpecializations(), 1u);
+  EXPECT_NE(Cache->lookup({8}), Generic);
+}
+
+TEST(ShapeSpecializationCacheTest, ConvolutionVariantsAgree) {
+  auto Cache = ShapeSpecializationCache::create(
+      [](Module &M, ArrayRef<int64_t> Dims) {
+        ConvolutionDims Conv;
+        Conv.N = Dims[0], Conv.C = Dims[1], Conv.H = Dims[2], Conv.W = Dims[3];
+        Conv.K = Dims[4], Conv.R = Dims[5], Conv.S = Dims[6];
+        return createConvolutionFunction(M, Conv, 1, 1, 1, 1);
+      },
+      7, /*HotThreshold=*/1);
+  ASSERT_TRUE(!!Cache) << toString(Cache.takeError());
+
+  // 1x2x4x4 input, 3x2x3x3 weights, padding 1 keeps the output at 4x4
+  const int64_t N = 1, C = 2, H = 4, W = 4, K = 3, R = 3, S = 3;
+  std::vector<float> Input(N * C * H * W), Weight(K * C * R * S);
+  for (size_t I = 0; I < Input.size(); ++I)
+    Input[I] = static_cast<float>(I % 7) - 3.0f;
+  for (size_t I = 0; I < Weight.size(); ++I)
+    Weight[I] = static_cast<float>(I % 5) * 0.5f - 1.0f;
+
+  std::vector<float> Expected(N * K * H * W, 0.0f);
+  for (int64_t k = 0; k < K; ++k)
+    for (int64_t y = 0; y < H; ++y)
+      for (int64_t x = 0; x < W; ++x)
+        for (int64_t c = 0; c < C; ++c)
+          for (int64_t r = 0; r < R; ++r)
+            for (int64_t s = 0; s < S; ++s) {
+              int64_t iy = y + r - 1, ix = x + s - 1;
+              if (iy >= 0 && iy < H && ix >= 0 && ix < W)
+                Expected[(k * H + y) * W + x] += Input[(c * H + iy) * W + ix] * Weight[((k * C + c) * R + r) * S + s];
+            }
+
+  ConvFn *Generic = (*Cache)->lookupAs<ConvFn>({N, C, H, W, K, R, S});
+  std::vector<float> Output(Expected.size());
+  Generic(Input.data(), Weight.data(), Output.data(), N, C, H, W, K, R, S);
+  EXPECT_EQ(Output, Expected);
+
+  (*Cache)->waitForPendingSpecializations();
+  ConvFn *Specialized = (*Cache)->lookupAs<ConvFn>({N, C, H, W, K, R, S});
+  ASSERT_NE(Specialized, Generic);
+  std::fill(Output.begin(), Output.end(), 0.0f);
+  Specialized(Input.data(), Weight.data(), Output.data(), N, C, H, W, K, R, S);
+  EXPECT_EQ(Output, Expected);
+}
+
+TEST(ShapeSpecializationCacheTest, ProfileSeedsHotShapes) {
+  auto Generator = [](Module &M, ArrayRef<int64_t> Dims) { return createReLUFunction(M, Dims[0]); };
+  KernelProfileData Profile;
+  {
+    auto Cache = cantFail(ShapeSpecializationCache::create(Generator, 1, /*HotThreshold=*/100));
+    for (unsigned I = 0; I < 9; ++I)
+      Cache->lookup({64});
+    Cache->lookup({3});
+    Cache->recordShapes(Profile, "ReLU");
+  }
+  auto Hot = Profile.getHotShapes("ReLU", 0.5);
+  ASSERT_EQ(Hot.size(), 1u);
+  EXPECT_EQ(Hot[0].Dims, std::vector<int64_t>{64});
+  EXPECT_EQ(Hot[0].Count, 9u);
+
+  // The next run specializes the profiled shape before its first lookup
+  auto Cache = cantFail(ShapeSpecializationCache::create(Generator, 1, /*HotThreshold=*/100));
+  void *Generic = Cache->lookup({3});
+  ASSERT_FALSE(!!Cache->specializeHotShapes(Profile, "ReLU", 0.5));
+  EXPECT_EQ(Cache->getNumSpecializations(), 1u);
+  ReLUFn *Specialized = Cache->lookupAs<ReLUFn>({64});
+  EXPECT_NE(reinterpret_cast<void *>(Specialized), Generic);
+  EXPECT_EQ(Cache->lookup({3}), Generic);
+
+  std::vector<float> Input(64, -1.0f), Output(64, 5.0f);
+  Input[7] = 2.0f;
+  Specialized(Input.data(), Output.data(), 64);
+  EXPECT_EQ(Output[0], 0.0f);
+  EXPECT_EQ(Output[7], 2.0f);
+}
+
+} // namespace
@@ -0,0 +1,125 @@
+#include "Runtime/TieredKernelJIT.h"
+#include "Kernels/Activation.h"
+#include "Kernels/Normalization.h"
+#include "Optimization/KernelProfiling.h"
+#include "Runtime/KernelProfiler.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/InitializePasses.h"
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+using ReLUFn = void(const float *, float *, int64_t);
+using SoftmaxFn = void(const float *, float *, int64_t, int64_t);
+
+/// A JIT holding a dynamic ReLU and a 2x5 softmax, neither compiled yet.
+std::unique_ptr<TieredKernelJIT> createJIT(TieredJITOptions Options) {
+  auto Context = std::make_unique<LLVMContext>();
+  auto M = std::make_unique<Module>("TieredKernelJITTestModule", *Context);
+  createReLUFunction(*M, DynamicDim);
+  createSoftmaxFunction(*M, 2, 5);
+  auto JIT = cantFail(TieredKernelJIT::create(Options));
+  cantFail(JIT->addModule(orc::ThreadSafeModule(std::move(M), std::move(Context))));
+  return JIT;
+}
+
+void expectReLU(ReLUFn *ReLU) {
+  std::vector<float> Input = {-2.0f, -1.0f, 0.0f, 1.0f, 2.0f, -3.0f, 3.0f};
+  std::vector<float> Output(Input.size(), -1.0f);
+  ReLU(Input.data(), Output.data(), Input.size());
+  EXPECT_EQ(Output, (std::vector<float>{0.0f, 0.0f, 0.0f, 1.0f, 2.0f, 0.0f, 3.0f}));
+}
+
+TEST(TieredKernelJITTest, CompilesOnFirstCallThenPromotes) {
+  auto JIT = createJIT({});
+  auto *ReLU = reinterpret_cast<ReLUFn *>(cantFail(JIT->lookup("ReLU")));
+  ASSERT_TRUE(!!JIT->lookup("softmax"));
+  EXPECT_FALSE(!!JIT->lookup("missing"));
+  EXPECT_EQ(JIT->getNumQuickCompiles(), 0u);
+  EXPECT_EQ(JIT->getTier("ReLU"), TieredKernelJIT::Tier::NotCompiled);
+
+  expectReLU(ReLU);
+  EXPECT_EQ(JIT->getNumQuickCompiles(), 1u);
+  EXPECT_NE(JIT->getTier("ReLU"), TieredKernelJIT::Tier::NotCompiled);
+
+  // The stub handed out before promotion keeps working afterwards
+  JIT->waitForPendingOptimizations();
+  EXPECT_EQ(JIT->getTier("ReLU"), TieredKernelJIT::Tier::Optimized);
+  EXPECT_EQ(JIT->getNumOptimizedCompiles(), 1u);
+  EXPECT_EQ(cantFail(JIT->lookup("ReLU")), reinterpret_cast<void *>(ReLU));
+  expectReLU(ReLU);
+
+  // A kernel that is never called is never compiled
+  EXPECT_EQ(JIT->getTier("softmax"), TieredKernelJIT::Tier::NotCompiled);
+  EXPECT_EQ(JIT->getNumQuickCompiles(), 1u);
+}
+
+TEST(TieredKernelJITTest, TieringCanBeDisabled) {
+  TieredJITOptions Options;
+  Options.EnableTiering = false;
+  auto JIT = createJIT(Options);
+  auto *Softmax = reinterpret_cast<SoftmaxFn *>(cantFail(JIT->lookup("softmax")));
+
+  std::vector<float> Input = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+  std::vector<float> Output(10);
+  Softmax(Input.data(), Output.data(), 2, 5);
+  JIT->waitForPendingOptimizations();
+
+  float Sum = 0.0f;
+  for (int I = 0; I < 5; ++I)
+    Sum += std::exp(Input[I]);
+  for (int I = 0; I < 5; ++I) {
+    EXPECT_NEAR(Output[I], std::exp(Input[I]) / Sum, 1e-5f);
+    EXPECT_NEAR(Output[5 + I], 0.2f, 1e-5f);
+  }
+  EXPECT_EQ(JIT->getTier("softmax"), TieredKernelJIT::Tier::Quick);
+  EXPECT_EQ(JIT->getNumOptimizedCompiles(), 0u);
+}
+
+TEST(TieredKernelJITTest, ProfiledKernelSharesSitesAcrossTiers) {
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  initializeCore(Registry);
+  initializeAnalysis(Registry);
+
+  auto Context = std::make_unique<LLVMContext>();
+  auto M = std::make_unique<Module>("TieredKernelJITTestModule", *Context);
+  createReLUFunction(*M, DynamicDim, "tieredReLU");
+  createSoftmaxFunction(*M, 2, 5, "tieredSoftmax");
+  legacy::PassManager PM;
+  PM.add(createKernelProfilingPass());
+  PM.run(*M);
+
+  auto JIT = cantFail(TieredKernelJIT::create({}));
+  cantFail(JIT->addModule(orc::ThreadSafeModule(std::move(M), std::move(Context))));
+
+  // The module constructor registered the sites before any kernel compiled
+  const KernelProfileSite *KernelSite = nullptr;
+  for (const KernelProfileSite *Site : getKernelProfileSites())
+    if (!std::strcmp(Site->Kernel, "tieredReLU") && !std::strcmp(Site->Region, "kernel"))
+      KernelSite = Site;
+  ASSERT_TRUE(KernelSite != nullptr);
+  EXPECT_EQ(JIT->getNumQuickCompiles(), 0u);
+
+  // Quick and optimized code count into the same site
+  auto *ReLU = reinterpret_cast<ReLUFn *>(cantFail(JIT->lookup("tieredReLU")));
+  expectReLU(ReLU);
+  JIT->waitForPendingOptimizations();
+  ASSERT_EQ(JIT->getTier("tieredReLU"), TieredKernelJIT::Tier::Optimized);
+  expectReLU(ReLU);
+  EXPECT_EQ(KernelSite->Calls.load(), 2u);
+
+  // Destroying the JIT unregisters its sites
+  JIT.reset();
+  for (const KernelProfileSite *Site : getKernelProfileSites())
+    EXPECT_STRNE(Site->Kernel, "tieredReLU");
+}
+
+} // namespace
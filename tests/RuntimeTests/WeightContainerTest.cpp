@@ -0,0 +1,134 @@
+#include "Runtime/WeightContainer.h"
+#include "Kernels/Gemm.h"
+#include "Kernels/WeightPacking.h"
+#include "Runtime/KernelJIT.h"
+#include "TestUtils.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+using GemmFn = void(const float *, const float *, float *, int64_t, int64_t, int64_t);
+
+/// A temporary file path that is removed when the test ends.
+struct TempPath {
+  SmallString<128> Path;
+  TempPath() { EXPECT_FALSE(sys::fs::createTemporaryFile("weights", "dlw", Path)); }
+  ~TempPath() { sys::fs::remove(Path); }
+};
+
+TEST(WeightContainerTest, RoundTripsTensorTable) {
+  TempPath File;
+  std::vector<float> Conv = makeData(2 * 3 * 3 * 3, 1, 0.125f), Bias = makeData(5, 2, 0.125f);
+  std::vector<uint16_t> Half(6, 0x3c00);
+
+  WeightContainerWriter Writer;
+  Writer.addTensor("conv1.weight", {2, 3, 3, 3}, "kcrs", Conv);
+  Writer.addTensor("fc.bias", {5}, "x", Bias);
+  Writer.addTensor("fc.weight", TensorElementType::F16, {2, 3}, "kn",
+                   ArrayRef<char>(reinterpret_cast<const char *>(Half.data()), Half.size() * 2));
+  ASSERT_FALSE(!!Writer.write(File.Path));
+
+  auto Container = WeightContainer::open(File.Path);
+  ASSERT_TRUE(!!Container) << toString(Container.takeError());
+  ASSERT_EQ((*Container)->tensors().size(), 3u);
+
+  for (const WeightTensor &Tensor : (*Container)->tensors())
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(Tensor.Data) % 64, 0u) << Tensor.Name;
+
+  const WeightTensor *Weight = (*Container)->lookup("conv1.weight");
+  ASSERT_NE(Weight, nullptr);
+  EXPECT_EQ(Weight->Layout, "kcrs");
+  EXPECT_EQ(std::vector<int64_t>(Weight->Shape.begin(), Weight->Shape.end()), (std::vector<int64_t>{2, 3, 3, 3}));
+  EXPECT_EQ(std::vector<float>(Weight->getDataAs<float>(), Weight->getDataAs<float>() + Conv.size()), Conv);
+
+  const WeightTensor *Packed = (*Container)->lookup("fc.weight");
+  ASSERT_NE(Packed, nullptr);
+  EXPECT_EQ(Packed->ElemTy, TensorElementType::F16);
+  EXPECT_EQ(Packed->getDataAs<uint16_t>()[5], 0x3c00);
+  EXPECT_EQ((*Container)->lookup("missing"), nullptr);
+
+  // Binding checks the element type and count the kernel expects
+  EXPECT_TRUE(!!(*Container)->bind("fc.bias", TensorElementType::F32, 5));
+  auto Mismatch = (*Container)->bind("fc.weight", TensorElementType::F32, 6);
+  EXPECT_FALSE(!!Mismatch);
+  consumeError(Mismatch.takeError());
+}
+
+TEST(WeightContainerTest, RejectsCorruptFiles) {
+  TempPath File;
+  std::vector<float> Data = makeData(16, 3, 0.125f);
+  WeightContainerWriter Writer;
+  Writer.addTensor("w", {16}, "x", Data);
+  ASSERT_FALSE(!!Writer.write(File.Path));
+
+  // Cut the file inside the tensor data
+  int FD;
+  ASSERT_FALSE(sys::fs::openFileForWrite(File.Path, FD, sys::fs::CD_OpenExisting));
+  EXPECT_FALSE(sys::fs::resize_file(FD, 80));
+  sys::fs::closeFile(FD);
+  auto Truncated = WeightContainer::open(File.Path);
+  EXPECT_FALSE(!!Truncated);
+  consumeError(Truncated.takeError());
+
+  {
+    std::error_code EC;
+    raw_fd_ostream OS(File.Path, EC);
+    OS << "not a weight container, just some bytes of text";
+  }
+  auto Garbage = WeightContainer::open(File.Path);
+  EXPECT_FALSE(!!Garbage);
+  consumeError(Garbage.takeError());
+}
+
+TEST(WeightContainerTest, KernelsReadMappedWeights) {
+  const int64_t Rows = 3, K = 5, N = 12;
+  std::vector<float> A = makeData(Rows * K, 4, 0.125f), B = makeData(K * N, 5, 0.125f);
+  std::vector<float> Expected(Rows * N, 0.0f);
+  for (int64_t I = 0; I < Rows; ++I)
+    for (int64_t k = 0; k < K; ++k)
+      for (int64_t J = 0; J < N; ++J)
+        Expected[I * N + J] += A[I * K + k] * B[k * N + J];
+
+  TempPath File;
+  std::vector<float> Packed = packGemmWeights(B, K, N, 8);
+  WeightContainerWriter Writer;
+  Writer.addTensor("fc.weight", {2, K, 8}, "panel-n8", Packed);
+  ASSERT_FALSE(!!Writer.write(File.Path));
+  auto Container = cantFail(WeightContainer::open(File.Path));
+
+  auto Context = std::make_unique<LLVMContext>();
+  auto M = std::make_unique<Module>("WeightContainerTestModule", *Context);
+  GlobalVariable *GV = declareWeightGlobal(*M, "fc.weight", Container->getAlignment());
+  createPackedGemmFunction(*M, GemmDims{DynamicDim, K, N}, 8, GV, "boundGemm");
+  createPackedGemmFunction(*M, GemmDims(), 8, nullptr, "argumentGemm");
+  EXPECT_FALSE(verifyModule(*M, &errs()));
+
+  auto JIT = cantFail(KernelJIT::create());
+  ASSERT_FALSE(!!JIT->bindWeights(*Container));
+  ASSERT_FALSE(!!JIT->addModule(orc::ThreadSafeModule(std::move(M), std::move(Context))));
+  auto *Bound = reinterpret_cast<GemmFn *>(cantFail(JIT->lookup("boundGemm")));
+  auto *Argument = reinterpret_cast<GemmFn *>(cantFail(JIT->lookup("argumentGemm")));
+
+  std::vector<float> C(Rows * N, -1.0f);
+  Bound(A.data(), nullptr, C.data(), Rows, 0, 0);
+  for (size_t I = 0; I < C.size(); ++I)
+    EXPECT_NEAR(C[I], Expected[I], 1e-4f) << "element " << I;
+
+  // The mapped tensor can equally be passed as the weight argument
+  const WeightTensor &Weight = cantFail(Container->bind("fc.weight", TensorElementType::F32, Packed.size()));
+  std::fill(C.begin(), C.end(), -1.0f);
+  Argument(A.data(), Weight.getDataAs<float>(), C.data(), Rows, K, N);
+  for (size_t I = 0; I < C.size(); ++I)
+    EXPECT_NEAR(C[I], Expected[I], 1e-4f) << "element " << I;
+}
+
+} // namespace
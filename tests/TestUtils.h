@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Runtime/KernelJIT.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// JIT-compile the single kernel \p Generate creates and return its address.
+/// \p JIT receives the JIT that owns the kernel and must outlive every call.
+template <typename FnT>
+FnT *compile(std::unique_ptr<llvm::KernelJIT> &JIT, std::function<llvm::Function *(llvm::Module &)> Generate) {
+  auto Context = std::make_unique<llvm::LLVMContext>();
+  auto M = std::make_unique<llvm::Module>("TestModule", *Context);
+  std::string Name = Generate(*M)->getName().str();
+  EXPECT_FALSE(llvm::verifyModule(*M, &llvm::errs()));
+
+  JIT = llvm::cantFail(llvm::KernelJIT::create());
+  EXPECT_FALSE(!!JIT->addModule(llvm::orc::ThreadSafeModule(std::move(M), std::move(Context))));
+  return reinterpret_cast<FnT *>(llvm::cantFail(JIT->lookup(Name)));
+}
+
+/// Deterministic test data: 17 distinct values \p Scale apart, centred on
+/// \p Offset, with \p Seed shifting the sequence.
+inline std::vector<float> makeData(int64_t Size, int Seed, float Scale = 0.25f, float Offset = 0.0f) {
+  std::vector<float> Data(Size);
+  for (int64_t I = 0; I < Size; ++I)
+    Data[I] = Offset + static_cast<float>((I * 7 + Seed) % 17) * Scale - 8.0f * Scale;
+  return Data;
+}